@@ -50,5 +50,16 @@ public:
 	virtual uint64_t			getBoundaryTime(const char* stdPID, uint32_t tDate, bool isSession = false, bool isStart = true) = 0;
 
 	virtual uint32_t			getContractSize(const char* exchg = "", uint32_t uDate = 0) { return 0; }
+
+	/*
+	 *	按全局索引获取合约，索引是加载合约时按顺序分配的，从0开始连续
+	 *	没有分配索引的实现返回NULL
+	 */
+	virtual WTSContractInfo*	getContractByIndex(uint32_t idx) { return NULL; }
+
+	/*
+	 *	已分配索引的合约数，按索引建平铺数组时用这个作为数组大小
+	 */
+	virtual uint32_t			getIndexedContracts() { return 0; }
 };
 NS_WTP_END
\ No newline at end of file
@@ -23,6 +23,18 @@ class IBaseDataMgr;
 class IHotMgr;
 class WTSVariant;
 
+/*
+ *	@brief 数据缓存统计
+ */
+typedef struct _WTSCacheStats
+{
+	uint64_t	_hits;			//命中次数
+	uint64_t	_misses;		//未命中次数
+	uint64_t	_evictions;		//淘汰条数
+	uint64_t	_bytes;			//当前占用的字节数
+	uint64_t	_budget;		//字节数预算，0为不限制
+	uint64_t	_entries;		//当前缓存条数
+} WTSCacheStats;
 
 /*
  *	@brief 数据读取模块回调接口
@@ -83,6 +95,11 @@ public:
 
 	virtual void		clearCache(){}
 
+	/*
+	 *	@brief	获取数据缓存的统计数据，不支持返回false
+	 */
+	virtual bool		getCacheStats(WTSCacheStats& stats) { return false; }
+
 protected:
 	IRdmDtReaderSink*	_sink;
 };
@@ -13,6 +13,7 @@
 #include <deque>
 #include <string.h>
 #include <chrono>
+#include <memory>
 
 #include "WTSObject.hpp"
 
@@ -20,6 +21,7 @@
 #include "WTSMarcos.h"
 #include "WTSStruct.h"
 #include "WTSCollection.hpp"
+#include "WTSContractInfo.hpp"
 
 using namespace std;
 
@@ -194,6 +196,48 @@ public:
 	}
 };
 
+/*
+ *	把连续的K线中某个字段抽取到连续的数组里
+ *	每个字段一个紧凑的循环，方便编译器向量化
+ */
+inline void extract_bar_field(const WTSBarStruct* bars, std::size_t cnt, WTSKlineFieldType type, double* dest)
+{
+	switch (type)
+	{
+	case KFT_OPEN:
+		for (std::size_t i = 0; i < cnt; i++) dest[i] = bars[i].open;
+		break;
+	case KFT_HIGH:
+		for (std::size_t i = 0; i < cnt; i++) dest[i] = bars[i].high;
+		break;
+	case KFT_LOW:
+		for (std::size_t i = 0; i < cnt; i++) dest[i] = bars[i].low;
+		break;
+	case KFT_CLOSE:
+		for (std::size_t i = 0; i < cnt; i++) dest[i] = bars[i].close;
+		break;
+	case KFT_VOLUME:
+		for (std::size_t i = 0; i < cnt; i++) dest[i] = bars[i].vol;
+		break;
+	case KFT_SVOLUME:
+		for (std::size_t i = 0; i < cnt; i++)
+		{
+			const WTSBarStruct& day = bars[i];
+			if (day.vol > INT_MAX)
+				dest[i] = 1 * ((day.close > day.open) ? 1 : -1);
+			else
+				dest[i] = (int32_t)day.vol * ((day.close > day.open) ? 1 : -1);
+		}
+		break;
+	case KFT_DATE:
+		for (std::size_t i = 0; i < cnt; i++) dest[i] = bars[i].date;
+		break;
+	case KFT_TIME:
+		for (std::size_t i = 0; i < cnt; i++) dest[i] = (double)bars[i].time;
+		break;
+	}
+}
+
 /*
  *	K线数据切片
  *	这个比较特殊,因为要拼接当日和历史的
@@ -208,6 +252,7 @@ private:
 	typedef std::pair<WTSBarStruct*, uint32_t> BarBlock;
 	std::vector<BarBlock> _blocks;
 	uint32_t		_count;
+	std::vector<std::shared_ptr<void>>	_holders;	//切片引用的数据缓存，切片释放之前缓存不会被回收
 
 protected:
 	WTSKlineSlice()
@@ -244,6 +289,15 @@ public:
 		return pRet;
 	}
 
+	/*
+	 *	持有切片引用的数据缓存，缓存被淘汰以后切片仍然可用
+	 */
+	inline void holdBuffer(const std::shared_ptr<void>& buf)
+	{
+		if (buf)
+			_holders.emplace_back(buf);
+	}
+
 	inline bool appendBlock(WTSBarStruct* bars, uint32_t count)
 	{
 		if (bars == NULL || count == 0)
@@ -390,42 +444,30 @@ public:
 		int32_t begin = max(0, min(head, tail));
 		int32_t end = min(max(head, tail), size() - 1);
 
-		WTSValueArray *vArray = NULL;
+		WTSValueArray *vArray = WTSValueArray::create();
+		//区间整个落在范围外面，返回空数组
+		if (begin > end)
+			return vArray;
 
-		vArray = WTSValueArray::create();
+		std::vector<double>& ay = vArray->getDataRef();
+		ay.resize(end - begin + 1);
 
-		for (int32_t i = begin; i <= end; i++)
+		//按块逐列抽取，每块是连续的WTSBarStruct，不用每根K线都去查找所在的块
+		double* dest = ay.data();
+		int32_t offset = 0;
+		for (const BarBlock& item : _blocks)
 		{
-			const WTSBarStruct& day = *at(i);
-			switch (type)
+			int32_t blkBegin = max(begin, offset);
+			int32_t blkEnd = min(end, offset + (int32_t)item.second - 1);
+			if (blkBegin <= blkEnd)
 			{
-			case KFT_OPEN:
-				vArray->append(day.open);
-				break;
-			case KFT_HIGH:
-				vArray->append(day.high);
-				break;
-			case KFT_LOW:
-				vArray->append(day.low);
-				break;
-			case KFT_CLOSE:
-				vArray->append(day.close);
-				break;
-			case KFT_VOLUME:
-				vArray->append(day.vol);
-				break;
-			case KFT_SVOLUME:
-				if (day.vol > INT_MAX)
-					vArray->append(1 * ((day.close > day.open) ? 1 : -1));
-				else
-					vArray->append((int32_t)day.vol * ((day.close > day.open) ? 1 : -1));
-				break;
-			case KFT_DATE:
-				vArray->append(day.date);
-				break;
-			case KFT_TIME:
-				vArray->append((double)day.time);
+				extract_bar_field(item.first + (blkBegin - offset), blkEnd - blkBegin + 1, type, dest);
+				dest += blkEnd - blkBegin + 1;
 			}
+
+			offset += item.second;
+			if (offset > end)
+				break;
 		}
 
 		return vArray;
@@ -752,43 +794,11 @@ public:
 		if(begin >= m_vecBarData.size() || end >= (int32_t)m_vecBarData.size())
 			return NULL;
 
-		WTSValueArray *vArray = NULL;
-
-		vArray = WTSValueArray::create();
-
-		for(uint32_t i = 0; i < m_vecBarData.size(); i++)
-		{
-			const WTSBarStruct& day = m_vecBarData.at(i);
-			switch(type)
-			{
-			case KFT_OPEN:
-				vArray->append(day.open);
-				break;
-			case KFT_HIGH:
-				vArray->append(day.high);
-				break;
-			case KFT_LOW:
-				vArray->append(day.low);
-				break;
-			case KFT_CLOSE:
-				vArray->append(day.close);
-				break;
-			case KFT_VOLUME:
-				vArray->append(day.vol);
-				break;
-			case KFT_SVOLUME:
-				if(day.vol > INT_MAX)
-					vArray->append(1 * ((day.close > day.open) ? 1 : -1));
-				else
-					vArray->append((int32_t)day.vol * ((day.close > day.open)?1:-1));
-				break;
-			case KFT_DATE:
-				vArray->append(day.date);
-				break;
-			case KFT_TIME:
-				vArray->append((double)day.time);
-			}
-		}
+		WTSValueArray *vArray = WTSValueArray::create();
+		std::vector<double>& ay = vArray->getDataRef();
+		ay.resize(m_vecBarData.size());
+		if (!m_vecBarData.empty())
+			extract_bar_field(m_vecBarData.data(), m_vecBarData.size(), type, ay.data());
 
 		return vArray;
 	}
@@ -856,7 +866,7 @@ public:
 class WTSTickData : public WTSPoolObject<WTSTickData>
 {
 public:
-	WTSTickData() :m_pContract(NULL) {}
+	WTSTickData() :m_pContract(NULL), m_iRecvTime(0) {}
 
 	/*
 	 *	创建一个tick数据对象
@@ -1012,24 +1022,39 @@ public:
 	inline void setContractInfo(WTSContractInfo* cInfo) { m_pContract = cInfo; }
 	inline WTSContractInfo* getContractInfo() const { return m_pContract; }
 
+	/*
+	 *	合约的全局索引，没有合约信息或者合约没有分配索引时返回UINT_MAX
+	 *	热点路径上可以用这个索引访问平铺的数组，代替按代码字符串查找
+	 */
+	inline uint32_t getContractIndex() const { return m_pContract ? m_pContract->getTotalIndex() : UINT_MAX; }
+
+	/*
+	 *	行情到达本地的时间，单调时钟的纳秒数，只用于延迟统计，不落地
+	 */
+	inline void setRecvTime(int64_t recvTime) { m_iRecvTime = recvTime; }
+	inline int64_t getRecvTime() const { return m_iRecvTime; }
+
 private:
 	WTSTickStruct		m_tickStruct;
 	WTSContractInfo*	m_pContract;
+	int64_t				m_iRecvTime;
 };
 
-class WTSOrdQueData : public WTSObject
+class WTSOrdQueData : public WTSPoolObject<WTSOrdQueData>
 {
 public:
+	WTSOrdQueData() :m_pContract(NULL) {}
+
 	static inline WTSOrdQueData* create(const char* code)
 	{
-		WTSOrdQueData* pRet = new WTSOrdQueData;
+		WTSOrdQueData* pRet = WTSOrdQueData::allocate();
 		wt_strcpy(pRet->m_oqStruct.code, code);
 		return pRet;
 	}
 
 	static inline WTSOrdQueData* create(WTSOrdQueStruct& ordQueData)
 	{
-		WTSOrdQueData* pRet = new WTSOrdQueData;
+		WTSOrdQueData* pRet = WTSOrdQueData::allocate();
 		memcpy(&pRet->m_oqStruct, &ordQueData, sizeof(WTSOrdQueStruct));
 
 		return pRet;
@@ -1053,19 +1078,21 @@ private:
 	WTSContractInfo*	m_pContract;
 };
 
-class WTSOrdDtlData : public WTSObject
+class WTSOrdDtlData : public WTSPoolObject<WTSOrdDtlData>
 {
 public:
+	WTSOrdDtlData() :m_pContract(NULL) {}
+
 	static inline WTSOrdDtlData* create(const char* code)
 	{
-		WTSOrdDtlData* pRet = new WTSOrdDtlData;
+		WTSOrdDtlData* pRet = WTSOrdDtlData::allocate();
 		wt_strcpy(pRet->m_odStruct.code, code);
 		return pRet;
 	}
 
 	static inline WTSOrdDtlData* create(WTSOrdDtlStruct& odData)
 	{
-		WTSOrdDtlData* pRet = new WTSOrdDtlData;
+		WTSOrdDtlData* pRet = WTSOrdDtlData::allocate();
 		memcpy(&pRet->m_odStruct, &odData, sizeof(WTSOrdDtlStruct));
 
 		return pRet;
@@ -1090,19 +1117,21 @@ private:
 	WTSContractInfo*	m_pContract;
 };
 
-class WTSTransData : public WTSObject
+class WTSTransData : public WTSPoolObject<WTSTransData>
 {
 public:
+	WTSTransData() :m_pContract(NULL) {}
+
 	static inline WTSTransData* create(const char* code)
 	{
-		WTSTransData* pRet = new WTSTransData;
+		WTSTransData* pRet = WTSTransData::allocate();
 		wt_strcpy(pRet->m_tsStruct.code, code);
 		return pRet;
 	}
 
 	static inline WTSTransData* create(WTSTransStruct& transData)
 	{
-		WTSTransData* pRet = new WTSTransData;
+		WTSTransData* pRet = WTSTransData::allocate();
 		memcpy(&pRet->m_tsStruct, &transData, sizeof(WTSTransStruct));
 
 		return pRet;
@@ -1225,6 +1254,7 @@ private:
 	typedef std::pair<WTSTickStruct*, uint32_t> TickBlock;
 	std::vector<TickBlock> _blocks;
 	uint32_t		_count;
+	std::vector<std::shared_ptr<void>>	_holders;
 
 protected:
 	WTSTickSlice() { _blocks.clear(); }
@@ -1255,6 +1285,12 @@ public:
 		return slice;
 	}
 
+	inline void holdBuffer(const std::shared_ptr<void>& buf)
+	{
+		if (buf)
+			_holders.emplace_back(buf);
+	}
+
 	inline bool appendBlock(WTSTickStruct* ticks, uint32_t count)
 	{
 		if (ticks == NULL || count == 0)
@@ -1332,6 +1368,7 @@ private:
 	char				m_strCode[MAX_INSTRUMENT_LENGTH];
 	WTSOrdDtlStruct*	m_ptrBegin;
 	uint32_t			m_uCount;
+	std::vector<std::shared_ptr<void>>	m_vecHolders;
 
 protected:
 	WTSOrdDtlSlice() :m_ptrBegin(NULL), m_uCount(0) {}
@@ -1359,6 +1396,12 @@ public:
 		return slice;
 	}
 
+	inline void holdBuffer(const std::shared_ptr<void>& buf)
+	{
+		if (buf)
+			m_vecHolders.emplace_back(buf);
+	}
+
 	inline uint32_t size() const { return m_uCount; }
 
 	inline bool empty() const { return (m_uCount == 0) || (m_ptrBegin == NULL); }
@@ -1384,6 +1427,7 @@ private:
 	char				m_strCode[MAX_INSTRUMENT_LENGTH];
 	WTSOrdQueStruct*	m_ptrBegin;
 	uint32_t			m_uCount;
+	std::vector<std::shared_ptr<void>>	m_vecHolders;
 
 protected:
 	WTSOrdQueSlice() :m_ptrBegin(NULL), m_uCount(0) {}
@@ -1411,6 +1455,12 @@ public:
 		return slice;
 	}
 
+	inline void holdBuffer(const std::shared_ptr<void>& buf)
+	{
+		if (buf)
+			m_vecHolders.emplace_back(buf);
+	}
+
 	inline uint32_t size() const { return m_uCount; }
 
 	inline bool empty() const { return (m_uCount == 0) || (m_ptrBegin == NULL); }
@@ -1436,6 +1486,7 @@ private:
 	char			m_strCode[MAX_INSTRUMENT_LENGTH];
 	WTSTransStruct*	m_ptrBegin;
 	uint32_t		m_uCount;
+	std::vector<std::shared_ptr<void>>	m_vecHolders;
 
 protected:
 	WTSTransSlice() :m_ptrBegin(NULL), m_uCount(0) {}
@@ -1463,6 +1514,12 @@ public:
 		return slice;
 	}
 
+	inline void holdBuffer(const std::shared_ptr<void>& buf)
+	{
+		if (buf)
+			m_vecHolders.emplace_back(buf);
+	}
+
 	inline uint32_t size() const { return m_uCount; }
 
 	inline bool empty() const { return (m_uCount == 0) || (m_ptrBegin == NULL); }
@@ -13,7 +13,7 @@
 #include <boost/smart_ptr/detail/spinlock.hpp>
 
 #include "WTSMarcos.h"
-#include "../Share/ObjectPool.hpp"
+#include "../Share/MagazinePool.hpp"
 #include "../Share/SpinMutex.hpp"
 
 NS_WTP_BEGIN
@@ -57,37 +57,33 @@ template<typename T>
 class WTSPoolObject : public WTSObject
 {
 private:
-	typedef ObjectPool<T> MyPool;
-	MyPool*			_pool;
-	SpinMutex*	_mutex;
+	typedef MagazinePool<T> MyPool;
+	typename MyPool::ThreadCache*	_owner;
 
 public:
-	WTSPoolObject():_pool(NULL){}
+	WTSPoolObject():_owner(NULL){}
 	virtual ~WTSPoolObject() {}
 
 public:
 	static T*	allocate()
 	{
 		/*
-		 *	By Wesley @ 2022.06.14
-		 *	有用户反馈，这里使用了thread_local，线程销毁的话，内存池也销毁了
-		 *	该用户在Trader里复现了这个bug，如果Trader底层销毁了一个API对象实例
-		 *	那么这里内存池就已经析构了，如果有在系统中存储（retain）Trader创建的对象（WTSOrderInfo等），则会出现访问越界的问题
-		 *	这里如果去掉thread_local，改成纯静态的，可能多线程并发的场景下也会有一些问题
-		 *	总之如果要彻底安全，那么可能需要加一把锁才行，但是这样会带来性能开销
-		 *	所以注释一下，如果有问题的可以参考一下
+		 *	原来这里用的是thread_local的boost::pool加自旋锁
+		 *	线程销毁的时候内存池也跟着析构了，如果其他地方还持有这个线程创建的对象（如Trader里的WTSOrderInfo），就会访问越界
+		 *	现在改成MagazinePool：每个线程一个缓存，本线程分配和归还不加锁
+		 *	其他线程归还的对象压到所属缓存的归还栈上，缓存和内存块都不会随线程销毁而释放
 		 */
-		thread_local static MyPool		pool;
-		thread_local static SpinMutex	mtx;
-
-		mtx.lock();
-		T* ret = pool.construct();
-		mtx.unlock();
-		ret->_pool = &pool;
-		ret->_mutex = &mtx;
+		typename MyPool::ThreadCache* owner = NULL;
+		T* ret = MyPool::construct(owner);
+		ret->_owner = owner;
 		return ret;
 	}
 
+	/*
+	 *	对象池的统计数据，主要用于测试和监控
+	 */
+	static typename MyPool::PoolStats pool_stats() { return MyPool::stats(); }
+
 public:
 	virtual void release() override
 	{
@@ -99,9 +95,7 @@ public:
 			uint32_t cnt = m_uRefs.fetch_sub(1);
 			if (cnt == 1)
 			{
-				_mutex->lock();
-				_pool->destroy((T*)this);
-				_mutex->unlock();
+				MyPool::destroy((T*)this, _owner);
 			}
 		}
 		catch (...)
@@ -10,6 +10,8 @@
 #include "ParserShm.h"
 #include "../Includes/WTSVariant.hpp"
 #include "../Includes/WTSDataDef.hpp"
+#include "../Share/CpuHelper.hpp"
+#include "../Share/TimeUtils.hpp"
 
 #include <boost/bind.hpp>
 
@@ -33,8 +35,6 @@ inline void write_log(IParserSpi* sink, WTSLogLevel ll, const char* format, cons
 #define UDP_MSG_PUSHORDDTL	0x202	//委托明细
 #define UDP_MSG_PUSHTRANS	0x203	//逐笔成交
 
-#define NODATA_FLAG 0xfffffffffffffffe
-
 
 extern "C"
 {
@@ -59,8 +59,11 @@ extern "C"
 ParserShm::ParserShm()
 	: _stopped(false)
 	, _sink(NULL)
-	, _queue(NULL)
+	, _connected(false)
 	, _check_span(0)
+	, _core(0)
+	, _lost_unlogged(0)
+	, _last_lost_log(0)
 {
 }
 
@@ -76,164 +79,187 @@ bool ParserShm::init( WTSVariant* config )
 	if (_gpsize == 0)
 		_gpsize = 1000;
 	_check_span = config->getUInt32("checkspan");
+	_core = config->getUInt32("core");
 
 	return true;
 }
 
 void ParserShm::release()
 {
-	
+	_stopped = true;
+	if (_thrd_parser && _thrd_parser->joinable())
+		_thrd_parser->join();
+}
+
+bool ParserShm::attach_queue(bool bFromLatest)
+{
+	_mapfile.reset(new BoostMappingFile);
+	if (!_mapfile->map(_path.c_str()))
+		return false;
+
+	//写端还没有初始化好队列，或者队列格式不匹配
+	if (_mapfile->size() < sizeof(SpmcRing<DataItem>::Header) || !_reader.attach(_mapfile->addr(), bFromLatest))
+		return false;
+
+	return _mapfile->size() >= SpmcRing<DataItem>::calc_size(_reader.capacity());
 }
 
 bool ParserShm::connect()
 {
 	_thrd_parser.reset(new StdThread([this]() {
 
+		if (_core != 0)
+		{
+			if (!CpuHelper::bind_core(_core - 1))
+				write_log(_sink, LL_ERROR, "[ParserShm] Binding receiving thread to core {} failed", _core);
+			else
+				write_log(_sink, LL_INFO, "[ParserShm] Receiving thread bound to core {}", _core);
+		}
+
 		write_log(_sink, LL_INFO, "[ParserShm] loading {} ...", _path);
-		while (!StdFile::exists(_path.c_str()))
+		while (!_stopped && (!StdFile::exists(_path.c_str()) || !attach_queue(true)))
 		{
-			write_log(_sink, LL_WARN, "[ParserShm] {} not exist yet, waiting for 2 seconds", _path);
-			std::this_thread::sleep_for(std::chrono::seconds(2));
-			continue;
+			write_log(_sink, LL_WARN, "[ParserShm] {} not ready yet, waiting for 2 seconds", _path);
+			std::this_thread::sleep_for(std::chrono::seconds(2));
 		}
 
-		_mapfile.reset(new BoostMappingFile);
-		_mapfile->map(_path.c_str());
-		_queue = (CastQueue*)_mapfile->addr();
-		uint32_t cast_pid = _queue->_pid;
+		if (_stopped)
+			return;
 
+		_connected = true;
 		if (_sink)
 		{
 			_sink->handleEvent(WPE_Connect, 0);
 			_sink->handleEvent(WPE_Login, 0);
 		}
-		write_log(_sink, LL_INFO, "[ParserShm] {} loaded, start to receiving", _path);
+		write_log(_sink, LL_INFO, "[ParserShm] {} loaded, capacity: {}, start to receiving", _path, _reader.capacity());
 
-		uint64_t lastIdx = UINT64_MAX;
+		DataItem item;
+		uint64_t lost = 0;
 		while(!_stopped)
 		{
-			//如果pid不同，说明datakit重启了
-			if(cast_pid != _queue->_pid)
-			{
-				lastIdx = UINT64_MAX;
-				write_log(_sink, LL_WARN, "ShareMemory queue has been reset justnow");
-				cast_pid = _queue->_pid;
-			}
-			
-			if (_queue->_readable == UINT64_MAX)	//刚分配好，还没数据进来
+			//写端重新初始化了队列，说明datakit重启了，容量可能也变了，要重新映射
+			if(_reader.is_reset())
 			{
-				lastIdx = NODATA_FLAG;
-				if(_check_span != 0)
-					std::this_thread::sleep_for(std::chrono::microseconds(_check_span));
+				write_log(_sink, LL_WARN, "[ParserShm] ShareMemory queue has been reset justnow");
+				while (!_stopped && !attach_queue(false))
+					std::this_thread::sleep_for(std::chrono::seconds(2));
 				continue;
 			}
 
-			if (lastIdx == UINT64_MAX)	//有数据，第一次检查，则直接定位到最后一条数据
-			{
-				lastIdx = _queue->_readable;
-				if (_check_span != 0)
-					std::this_thread::sleep_for(std::chrono::microseconds(_check_span));
-				continue;
-			}
-			else if (lastIdx == NODATA_FLAG)	//之前没数据的时候检查了一次，现在有数据了，从0开始读取
-			{
-				lastIdx = 0;
-			}
-			else if (lastIdx >= _queue->_readable)	//没有新的数据进来
+			auto state = _reader.read(item, lost);
+			if (lost > 0)
+				report_lost(lost);
+
+			if (state == CastReader::RS_Empty)
 			{
 				if (_check_span != 0)
 					std::this_thread::sleep_for(std::chrono::microseconds(_check_span));
+				else
+					spmc_cpu_relax();
 				continue;
 			}
-			else
-			{
-				lastIdx++;	//普通情况，下标递增
-			}
 
-			DataItem& item = _queue->_items[lastIdx % _queue->_capacity];
-			switch (item._type)
-			{
-			case 0:
-			{
-				const char* fullCode = fmtutil::format("{}.{}", item._tick.exchg, item._tick.code);
-				auto it = _set_subs.find(fullCode);
-				if (it != _set_subs.end())
-				{
-					WTSTickData* newData = WTSTickData::create(item._tick);
-					if (_sink)
-						_sink->handleQuote(newData, 0);
-					newData->release();
-
-					static uint32_t recv_cnt = 0;
-					recv_cnt++;
-					if (recv_cnt % _gpsize == 0)
-						write_log(_sink, LL_DEBUG, "[ParserShm] {} ticks received in total", recv_cnt);
-				}
-			}
-			break;
-			case 1:
-			{
-				const char* fullCode = fmtutil::format("{}.{}", item._queue.exchg, item._queue.code);
-				auto it = _set_subs.find(fullCode);
-				if (it != _set_subs.end())
-				{
-					WTSOrdQueData* newData = WTSOrdQueData::create(item._queue);
-					if (_sink)
-						_sink->handleOrderQueue(newData);
-					newData->release();
-
-					static uint32_t recv_cnt = 0;
-					recv_cnt++;
-					if (recv_cnt % _gpsize == 0)
-						write_log(_sink, LL_DEBUG, "[ParserShm] {} queues received in total", recv_cnt);
-				}
-			}
-			break;
-			case 2:
-			{
-				const char* fullCode = fmtutil::format("{}.{}", item._order.exchg, item._order.code);
-				auto it = _set_subs.find(fullCode);
-				if (it != _set_subs.end())
-				{
-					WTSOrdDtlData* newData = WTSOrdDtlData::create(item._order);
-					if (_sink)
-						_sink->handleOrderDetail(newData);
-					newData->release();
-
-					static uint32_t recv_cnt = 0;
-					recv_cnt++;
-					if (recv_cnt % _gpsize == 0)
-						write_log(_sink, LL_DEBUG, "[ParserShm] {} orders received in total", recv_cnt);
-				}
-			}
-			break;
-			case 3:
-			{
-				const char* fullCode = fmtutil::format("{}.{}", item._trans.exchg, item._trans.code);
-				auto it = _set_subs.find(fullCode);
-				if (it != _set_subs.end())
-				{
-					WTSTransData* newData = WTSTransData::create(item._trans);
-					if (_sink)
-						_sink->handleTransaction(newData);
-					newData->release();
-
-					static uint32_t recv_cnt = 0;
-					recv_cnt++;
-					if (recv_cnt % _gpsize == 0)
-						write_log(_sink, LL_DEBUG, "[ParserShm] {} transactions received in total", recv_cnt);
-				}
-			}
-			break;
-			default:
-				break;
-			}
+			dispatch_item(item);
 		}
 	}));
 
 	return true;
 }
 
+void ParserShm::report_lost(uint64_t lost)
+{
+	_lost_unlogged += lost;
+	int64_t now = TimeUtils::getLocalTimeNow();
+	if (now - _last_lost_log < 1000)
+		return;
+
+	write_log(_sink, LL_WARN, "[ParserShm] Reader overrun, {} items lost, {} lost in total", _lost_unlogged, _reader.total_lost());
+	_lost_unlogged = 0;
+	_last_lost_log = now;
+}
+
+void ParserShm::dispatch_item(DataItem& item)
+{
+	switch (item._type)
+	{
+	case 0:
+	{
+		const char* fullCode = fmtutil::format("{}.{}", item._tick.exchg, item._tick.code);
+		auto it = _set_subs.find(fullCode);
+		if (it != _set_subs.end())
+		{
+			WTSTickData* newData = WTSTickData::create(item._tick);
+			if (_sink)
+				_sink->handleQuote(newData, 0);
+			newData->release();
+
+			static uint32_t recv_cnt = 0;
+			recv_cnt++;
+			if (recv_cnt % _gpsize == 0)
+				write_log(_sink, LL_DEBUG, "[ParserShm] {} ticks received in total", recv_cnt);
+		}
+	}
+	break;
+	case 1:
+	{
+		const char* fullCode = fmtutil::format("{}.{}", item._queue.exchg, item._queue.code);
+		auto it = _set_subs.find(fullCode);
+		if (it != _set_subs.end())
+		{
+			WTSOrdQueData* newData = WTSOrdQueData::create(item._queue);
+			if (_sink)
+				_sink->handleOrderQueue(newData);
+			newData->release();
+
+			static uint32_t recv_cnt = 0;
+			recv_cnt++;
+			if (recv_cnt % _gpsize == 0)
+				write_log(_sink, LL_DEBUG, "[ParserShm] {} queues received in total", recv_cnt);
+		}
+	}
+	break;
+	case 2:
+	{
+		const char* fullCode = fmtutil::format("{}.{}", item._order.exchg, item._order.code);
+		auto it = _set_subs.find(fullCode);
+		if (it != _set_subs.end())
+		{
+			WTSOrdDtlData* newData = WTSOrdDtlData::create(item._order);
+			if (_sink)
+				_sink->handleOrderDetail(newData);
+			newData->release();
+
+			static uint32_t recv_cnt = 0;
+			recv_cnt++;
+			if (recv_cnt % _gpsize == 0)
+				write_log(_sink, LL_DEBUG, "[ParserShm] {} orders received in total", recv_cnt);
+		}
+	}
+	break;
+	case 3:
+	{
+		const char* fullCode = fmtutil::format("{}.{}", item._trans.exchg, item._trans.code);
+		auto it = _set_subs.find(fullCode);
+		if (it != _set_subs.end())
+		{
+			WTSTransData* newData = WTSTransData::create(item._trans);
+			if (_sink)
+				_sink->handleTransaction(newData);
+			newData->release();
+
+			static uint32_t recv_cnt = 0;
+			recv_cnt++;
+			if (recv_cnt % _gpsize == 0)
+				write_log(_sink, LL_DEBUG, "[ParserShm] {} transactions received in total", recv_cnt);
+		}
+	}
+	break;
+	default:
+		break;
+	}
+}
+
 bool ParserShm::disconnect()
 {
 	_stopped = true;
@@ -243,7 +269,7 @@ bool ParserShm::disconnect()
 
 bool ParserShm::isConnected()
 {
-	return _queue!=NULL;
+	return _connected;
 }
 
 
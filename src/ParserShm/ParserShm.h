@@ -12,6 +12,7 @@
 #include "../Share/StdUtils.hpp"
 #include "../Includes/WTSStruct.h"
 #include "../Share/BoostMappingFile.hpp"
+#include "../Share/SpmcRing.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/asio/io_service.hpp>
@@ -39,22 +40,9 @@ public:
 
 		_DataItem() { memset(this, 0, sizeof(_DataItem)); }
 	} DataItem;
+#pragma pack(pop)
 
-	template <int N = 8 * 1024>
-	struct _DataQueue
-	{
-		uint64_t	_capacity = N;
-		volatile uint64_t	_readable;
-		volatile uint64_t	_writable;
-		uint32_t	_pid;
-		DataItem	_items[N];
-
-		_DataQueue() :_readable(UINT64_MAX), _writable(0), _pid(0) {}
-	};
-
-	typedef _DataQueue<8 * 1024>	CastQueue;
-
-#pragma pack(pop)
+	typedef SpmcRingReader<DataItem>	CastReader;
 
 public:
 	virtual bool init(WTSVariant* config) override;
@@ -72,19 +60,40 @@ public:
 
 	virtual void registerSpi(IParserSpi* listener) override;
 
+private:
+	/*
+	 *	映射共享内存文件并挂到队列上
+	 */
+	bool	attach_queue(bool bFromLatest);
+
+	/*
+	 *	处理一条数据
+	 */
+	void	dispatch_item(DataItem& item);
+
+	/*
+	 *	记录丢失的数据条数，日志最多每秒输出一次，避免读端太慢的时候刷屏
+	 */
+	void	report_lost(uint64_t lost);
+
 private:
 	std::string		_path;
 	typedef std::shared_ptr<BoostMappingFile> MappedFilePtr;
 	MappedFilePtr	_mapfile;
-	CastQueue*		_queue;
+	CastReader		_reader;
+	bool			_connected;
 	uint32_t		_gpsize;
-	uint32_t		_check_span;
+	uint32_t		_check_span;	//没有数据时休眠的微秒数，为0则忙等
+	uint32_t		_core;		//接收线程绑定的cpu核，从1开始，为0则不绑定
 
 	IParserSpi*		_sink;
 	bool			_stopped;
 
 	CodeSet			_set_subs;
 
+	uint64_t		_lost_unlogged;		//还没有输出到日志的丢失条数
+	int64_t			_last_lost_log;		//上一次输出丢失日志的时间，毫秒
+
 	StdThreadPtr	_thrd_parser;
 };
 
@@ -0,0 +1,330 @@
+﻿/*!
+ * \file ParserShmBus.cpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ * 
+ * \brief 
+ */
+#include "ParserShmBus.h"
+#include "../Includes/WTSVariant.hpp"
+#include "../Includes/WTSDataDef.hpp"
+#include "../Share/CpuHelper.hpp"
+#include "../Share/TimeUtils.hpp"
+
+#include "../Share/fmtlib.h"
+template<typename... Args>
+inline void write_log(IParserSpi* sink, WTSLogLevel ll, const char* format, const Args&... args)
+{
+	if (sink == NULL)
+		return;
+
+	static thread_local char buffer[512] = { 0 };
+	fmtutil::format_to(buffer, format, args...);
+
+	sink->handleParserLog(ll, buffer);
+}
+
+
+extern "C"
+{
+	EXPORT_FLAG IParserApi* createParser()
+	{
+		ParserShmBus* parser = new ParserShmBus();
+		return parser;
+	}
+
+	EXPORT_FLAG void deleteParser(IParserApi* &parser)
+	{
+		if (NULL != parser)
+		{
+			delete parser;
+			parser = NULL;
+		}
+	}
+};
+
+
+
+ParserShmBus::ParserShmBus()
+	: _stopped(false)
+	, _sink(NULL)
+	, _connected(false)
+	, _snapshot(false)
+	, _gpsize(1000)
+	, _check_span(0)
+	, _core(0)
+	, _subs_changed(false)
+	, _lost_unlogged(0)
+	, _last_lost_log(0)
+{
+	memset(_recv_cnt, 0, sizeof(_recv_cnt));
+}
+
+
+ParserShmBus::~ParserShmBus()
+{
+}
+
+bool ParserShmBus::init( WTSVariant* config )
+{
+	_path = config->getCString("path");
+	_gpsize = config->getUInt32("gpsize");
+	if (_gpsize == 0)
+		_gpsize = 1000;
+	_check_span = config->getUInt32("checkspan");
+	_core = config->getUInt32("core");
+	_snapshot = config->getBoolean("snapshot");
+
+	return true;
+}
+
+void ParserShmBus::release()
+{
+	_stopped = true;
+	if (_thrd_parser && _thrd_parser->joinable())
+		_thrd_parser->join();
+}
+
+bool ParserShmBus::attach_bus(bool bFromLatest)
+{
+	_mapfile.reset(new BoostMappingFile);
+	if (!_mapfile->map(_path.c_str()))
+		return false;
+
+	//写端还没有初始化好总线，或者总线格式不匹配
+	if (!_reader.attach(_mapfile->addr(), _mapfile->size(), bFromLatest))
+		return false;
+
+	//槽位数可能变了，订阅状态和已推送的版本都要重置
+	_slot_states.assign(_reader.max_slots(), SS_Unknown);
+	_slot_versions.assign(_reader.max_slots(), 0);
+	return true;
+}
+
+bool ParserShmBus::connect()
+{
+	_thrd_parser.reset(new StdThread([this]() {
+
+		if (_core != 0)
+		{
+			if (!CpuHelper::bind_core(_core - 1))
+				write_log(_sink, LL_ERROR, "[ParserShmBus] Binding receiving thread to core {} failed", _core);
+			else
+				write_log(_sink, LL_INFO, "[ParserShmBus] Receiving thread bound to core {}", _core);
+		}
+
+		write_log(_sink, LL_INFO, "[ParserShmBus] loading {} ...", _path);
+		while (!_stopped && (!StdFile::exists(_path.c_str()) || !attach_bus(true)))
+		{
+			write_log(_sink, LL_WARN, "[ParserShmBus] {} not ready yet, waiting for 2 seconds", _path);
+			std::this_thread::sleep_for(std::chrono::seconds(2));
+		}
+
+		if (_stopped)
+			return;
+
+		_connected = true;
+		if (_sink)
+		{
+			_sink->handleEvent(WPE_Connect, 0);
+			_sink->handleEvent(WPE_Login, 0);
+		}
+		write_log(_sink, LL_INFO, "[ParserShmBus] {} loaded, slots: {}, capacity: {}, start to receiving", _path, _reader.max_slots(), _reader.capacity());
+
+		if (_snapshot)
+			push_snapshots();
+
+		BusEvent evt;
+		uint64_t lost = 0;
+		while(!_stopped)
+		{
+			//写端重新初始化了总线，说明datakit重启了，槽位和容量都可能变了，要重新映射
+			if(_reader.is_reset())
+			{
+				write_log(_sink, LL_WARN, "[ParserShmBus] ShareMemory bus has been reset justnow");
+				while (!_stopped && !attach_bus(false))
+					std::this_thread::sleep_for(std::chrono::seconds(2));
+				continue;
+			}
+
+			if (_subs_changed.exchange(false))
+			{
+				_slot_states.assign(_slot_states.size(), SS_Unknown);
+				if (_snapshot)
+					push_snapshots();
+			}
+
+			auto state = _reader.read_event(evt, lost);
+			if (lost > 0)
+				report_lost(lost);
+
+			//没有读到事件的时候evt还是上一条，不能再分发
+			if (state == ShmQuoteBusReader::EventReader::RS_Empty)
+			{
+				if (_check_span != 0)
+					std::this_thread::sleep_for(std::chrono::microseconds(_check_span));
+				else
+					spmc_cpu_relax();
+				continue;
+			}
+
+			dispatch_event(evt);
+		}
+	}));
+
+	return true;
+}
+
+void ParserShmBus::report_lost(uint64_t lost)
+{
+	_lost_unlogged += lost;
+	int64_t now = TimeUtils::getLocalTimeNow();
+	if (now - _last_lost_log < 1000)
+		return;
+
+	write_log(_sink, LL_WARN, "[ParserShmBus] Reader overrun, {} events lost, {} lost in total", _lost_unlogged, _reader.total_lost());
+	_lost_unlogged = 0;
+	_last_lost_log = now;
+}
+
+bool ParserShmBus::is_subscribed(uint32_t slot)
+{
+	if (slot >= _slot_states.size())
+		return false;
+
+	uint8_t& state = _slot_states[slot];
+	if (state == SS_Unknown)
+	{
+		//每个槽位只在第一次遇到的时候查一次订阅表，之后都是按下标判断
+		StdUniqueLock lock(_mtx_subs);
+		state = (_set_subs.find(_reader.slot_code(slot)) != _set_subs.end()) ? SS_Subscribed : SS_Ignored;
+	}
+
+	return state == SS_Subscribed;
+}
+
+void ParserShmBus::push_tick(uint32_t slot)
+{
+	//读端落后的时候，同一个合约排队的多笔tick事件只推送一次最新的快照
+	if (_reader.tick_version(slot) <= _slot_versions[slot])
+		return;
+
+	//直接从快照槽位拷贝到tick对象里，不需要中间的缓存
+	WTSTickData* newData = WTSTickData::allocate();
+	uint64_t version = 0;
+	if (_reader.read_tick(slot, newData->getTickStruct(), version) && version > _slot_versions[slot])
+	{
+		_slot_versions[slot] = version;
+		if (_sink)
+			_sink->handleQuote(newData, 0);
+
+		_recv_cnt[0]++;
+		if (_recv_cnt[0] % _gpsize == 0)
+			write_log(_sink, LL_DEBUG, "[ParserShmBus] {} ticks received in total", _recv_cnt[0]);
+	}
+	newData->release();
+}
+
+void ParserShmBus::push_snapshots()
+{
+	uint32_t cnt = _reader.slot_count();
+	for (uint32_t slot = 0; slot < cnt; slot++)
+	{
+		if (is_subscribed(slot))
+			push_tick(slot);
+	}
+}
+
+void ParserShmBus::dispatch_event(BusEvent& evt)
+{
+	if (!is_subscribed(evt._slot))
+		return;
+
+	switch (evt._type)
+	{
+	case 0:
+		push_tick(evt._slot);
+		break;
+	case 1:
+	{
+		WTSOrdQueData* newData = WTSOrdQueData::create(evt._queue);
+		if (_sink)
+			_sink->handleOrderQueue(newData);
+		newData->release();
+
+		_recv_cnt[1]++;
+		if (_recv_cnt[1] % _gpsize == 0)
+			write_log(_sink, LL_DEBUG, "[ParserShmBus] {} queues received in total", _recv_cnt[1]);
+	}
+	break;
+	case 2:
+	{
+		WTSOrdDtlData* newData = WTSOrdDtlData::create(evt._order);
+		if (_sink)
+			_sink->handleOrderDetail(newData);
+		newData->release();
+
+		_recv_cnt[2]++;
+		if (_recv_cnt[2] % _gpsize == 0)
+			write_log(_sink, LL_DEBUG, "[ParserShmBus] {} orders received in total", _recv_cnt[2]);
+	}
+	break;
+	case 3:
+	{
+		WTSTransData* newData = WTSTransData::create(evt._trans);
+		if (_sink)
+			_sink->handleTransaction(newData);
+		newData->release();
+
+		_recv_cnt[3]++;
+		if (_recv_cnt[3] % _gpsize == 0)
+			write_log(_sink, LL_DEBUG, "[ParserShmBus] {} transactions received in total", _recv_cnt[3]);
+	}
+	break;
+	default:
+		break;
+	}
+}
+
+bool ParserShmBus::disconnect()
+{
+	_stopped = true;
+
+	return true;
+}
+
+bool ParserShmBus::isConnected()
+{
+	return _connected;
+}
+
+
+void ParserShmBus::subscribe( const CodeSet &vecSymbols )
+{
+	StdUniqueLock lock(_mtx_subs);
+	for (const auto& code : vecSymbols)
+		_set_subs.insert(code);
+
+	_subs_changed = true;
+}
+
+void ParserShmBus::unsubscribe(const CodeSet &setSymbols)
+{
+	StdUniqueLock lock(_mtx_subs);
+	for (const auto& code : setSymbols)
+		_set_subs.erase(code);
+
+	_subs_changed = true;
+}
+
+void ParserShmBus::registerSpi( IParserSpi* listener )
+{
+	bool bReplaced = (_sink!=NULL);
+	_sink = listener;
+	if(bReplaced && _sink)
+	{
+		write_log(_sink, LL_WARN, "Listener is replaced");
+	}
+}
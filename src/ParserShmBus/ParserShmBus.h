@@ -0,0 +1,109 @@
+﻿/*!
+ * \file ParserShmBus.h
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ * 
+ * \brief 共享内存行情总线的读端
+ */
+#pragma once
+#include "../Includes/IParserApi.h"
+#include "../Share/StdUtils.hpp"
+#include "../Share/BoostMappingFile.hpp"
+#include "../Share/ShmQuoteBus.hpp"
+
+#include <vector>
+
+USING_NS_WTP;
+
+class ParserShmBus : public IParserApi
+{
+public:
+	ParserShmBus();
+	~ParserShmBus();
+
+	typedef ShmQuoteBusReader::BusEvent		BusEvent;
+
+public:
+	virtual bool init(WTSVariant* config) override;
+
+	virtual void release() override;
+
+	virtual bool connect() override;
+
+	virtual bool disconnect() override;
+
+	virtual bool isConnected() override;
+
+	virtual void subscribe(const CodeSet &vecSymbols) override;
+	virtual void unsubscribe(const CodeSet &vecSymbols) override;
+
+	virtual void registerSpi(IParserSpi* listener) override;
+
+private:
+	/*
+	 *	映射共享内存文件并挂到总线上
+	 */
+	bool	attach_bus(bool bFromLatest);
+
+	/*
+	 *	槽位对应的合约是否订阅了
+	 */
+	bool	is_subscribed(uint32_t slot);
+
+	/*
+	 *	推送一个槽位的最新快照，已经推送过的版本不再推送
+	 */
+	void	push_tick(uint32_t slot);
+
+	/*
+	 *	推送当前所有已订阅合约的快照
+	 */
+	void	push_snapshots();
+
+	/*
+	 *	处理一条事件
+	 */
+	void	dispatch_event(BusEvent& evt);
+
+	/*
+	 *	记录丢失的事件条数，日志最多每秒输出一次，避免读端太慢的时候刷屏
+	 */
+	void	report_lost(uint64_t lost);
+
+private:
+	typedef enum tagSlotState
+	{
+		SS_Unknown = 0,
+		SS_Subscribed,
+		SS_Ignored
+	} SlotState;
+
+	std::string		_path;
+	typedef std::shared_ptr<BoostMappingFile> MappedFilePtr;
+	MappedFilePtr	_mapfile;
+	ShmQuoteBusReader	_reader;
+	bool			_connected;
+	bool			_snapshot;		//挂上总线以后是否先推送一次已有的快照
+	uint32_t		_gpsize;
+	uint32_t		_check_span;	//没有数据时休眠的微秒数，为0则忙等
+	uint32_t		_core;		//接收线程绑定的cpu核，从1开始，为0则不绑定
+
+	IParserSpi*		_sink;
+	bool			_stopped;
+
+	StdUniqueMutex		_mtx_subs;
+	CodeSet				_set_subs;
+	std::atomic<bool>	_subs_changed;	//订阅变了，接收线程要重新判断槽位的订阅状态
+
+	//以下只有接收线程访问
+	std::vector<uint8_t>	_slot_states;
+	std::vector<uint64_t>	_slot_versions;	//每个槽位已经推送过的快照版本号
+	uint64_t				_recv_cnt[4];
+	uint64_t				_lost_unlogged;		//还没有输出到日志的丢失条数
+	int64_t					_last_lost_log;		//上一次输出丢失日志的时间，毫秒
+
+	StdThreadPtr	_thrd_parser;
+};
+
@@ -10,9 +10,14 @@
 #include "ParserUDP.h"
 #include "../Includes/WTSVariant.hpp"
 #include "../Includes/WTSDataDef.hpp"
+#include "../Share/TimeUtils.hpp"
 
 #include <boost/bind.hpp>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
  //By Wesley @ 2022.01.05
 #include "../Share/fmtlib.h"
 template<typename... Args>
@@ -86,6 +91,9 @@ ParserUDP::ParserUDP()
 	, _sink(NULL)
 	, _connecting(false)
 	, _s_inited(false)
+	, _mmsg(false)
+	, _rport(0)
+	, _rtimeout(3000)
 {
 }
 
@@ -103,6 +111,12 @@ bool ParserUDP::init( WTSVariant* config )
 	if (_gpsize == 0)
 		_gpsize = 1000;
 
+	//v2协议的补发端口和recvmmsg
+	_rport = config->getInt32("rport");
+	_mmsg = config->getBoolean("mmsg");
+	if (config->has("rtimeout"))
+		_rtimeout = config->getUInt32("rtimeout");
+
 	ip::address addr = ip::address::from_string(_hots);
 	_server_ep = ip::udp::endpoint(addr, _sport);
 
@@ -246,6 +260,9 @@ bool ParserUDP::connect()
 	if(reconnect(3))
 	{
 		_thrd_parser.reset(new StdThread(boost::bind(&io_service::run, &_io_service)));
+
+		if (_rport != 0)
+			_thrd_replay.reset(new StdThread(boost::bind(&ParserUDP::replay_loop, this)));
 	}
 	else
 	{
@@ -265,6 +282,16 @@ bool ParserUDP::disconnect()
 	}
 
 	_stopped = true;
+	if (_thrd_replay)
+	{
+		{
+			StdUniqueLock lock(_mtx_replay);
+			_cond_replay.notify_all();
+		}
+		_thrd_replay->join();
+		_thrd_replay.reset();
+	}
+
 	_strand.post(boost::bind(&ParserUDP::doOnDisconnected, this));
 
 	return true;
@@ -325,7 +352,16 @@ void ParserUDP::handle_read(const boost::system::error_code& e, std::size_t byte
 	if(_stopped || bytes_transferred<=0)
 		return;
 
-	extract_buffer(bytes_transferred, isBroad);
+	if (isBroad)
+	{
+		extract_buffer(_b_buffer.data(), (uint32_t)bytes_transferred);
+		if (_mmsg)
+			drain_broad();
+	}
+	else
+	{
+		extract_buffer(_s_buffer.data(), (uint32_t)bytes_transferred);
+	}
 
 	if (isBroad && _b_socket)
 	{
@@ -344,22 +380,31 @@ void ParserUDP::handle_read(const boost::system::error_code& e, std::size_t byte
 	}
 }
 
-void ParserUDP::extract_buffer(uint32_t length, bool isBroad /* = true */)
+void ParserUDP::extract_buffer(const char* data, uint32_t length)
 {
-	UDPPacketHead* header = NULL;
-	if(isBroad)
-		header = (UDPTickPacket*)_b_buffer.data();
+	if (length < sizeof(UDPPacketHead))
+		return;
+
+	const UDPPacketHead* header = (const UDPPacketHead*)data;
+	if (header->_type == UDP_MSG_PUSHBATCH)
+		handle_batch(data, length, false);
 	else
-		header = (UDPTickPacket*)_s_buffer.data();
+		dispatch_data(header->_type, data + sizeof(UDPPacketHead), length - sizeof(UDPPacketHead));
+}
 
-	if (header->_type == UDP_MSG_PUSHTICK || header->_type == UDP_MSG_SUBSCRIBE)
+void ParserUDP::dispatch_data(uint32_t type, const char* data, uint32_t length)
+{
+	if (type == UDP_MSG_PUSHTICK || type == UDP_MSG_SUBSCRIBE)
 	{
-		UDPTickPacket* packet = (UDPTickPacket*)header;
-		const char* fullCode = fmtutil::format("{}.{}", packet->_data.exchg, packet->_data.code);
+		if (length < sizeof(WTSTickStruct))
+			return;
+
+		WTSTickStruct* tick = (WTSTickStruct*)data;
+		const char* fullCode = fmtutil::format("{}.{}", tick->exchg, tick->code);
 		auto it = _set_subs.find(fullCode);
 		if (it != _set_subs.end())
 		{
-			WTSTickData* curTick = WTSTickData::create(packet->_data);
+			WTSTickData* curTick = WTSTickData::create(*tick);
 			if (_sink)
 				_sink->handleQuote(curTick, 0);
 
@@ -371,14 +416,17 @@ void ParserUDP::extract_buffer(uint32_t length, bool isBroad /* = true */)
 				write_log(_sink, LL_DEBUG, "[ParserUDP] {} ticks received in total", recv_cnt);
 		}
 	}
-	else if (header->_type == UDP_MSG_PUSHORDDTL)
+	else if (type == UDP_MSG_PUSHORDDTL)
 	{
-		UDPOrdDtlPacket* packet = (UDPOrdDtlPacket*)header;
-		const char* fullCode = fmtutil::format("{}.{}", packet->_data.exchg, packet->_data.code);
+		if (length < sizeof(WTSOrdDtlStruct))
+			return;
+
+		WTSOrdDtlStruct* ordDtl = (WTSOrdDtlStruct*)data;
+		const char* fullCode = fmtutil::format("{}.{}", ordDtl->exchg, ordDtl->code);
 		auto it = _set_subs.find(fullCode);
 		if (it != _set_subs.end())
 		{
-			WTSOrdDtlData* curData = WTSOrdDtlData::create(packet->_data);
+			WTSOrdDtlData* curData = WTSOrdDtlData::create(*ordDtl);
 			if (_sink)
 				_sink->handleOrderDetail(curData);
 
@@ -390,14 +438,17 @@ void ParserUDP::extract_buffer(uint32_t length, bool isBroad /* = true */)
 				write_log(_sink, LL_DEBUG, "[ParserUDP] {} order details received in total", recv_cnt);
 		}
 	}
-	else if (header->_type == UDP_MSG_PUSHORDQUE)
+	else if (type == UDP_MSG_PUSHORDQUE)
 	{
-		UDPOrdQuePacket* packet = (UDPOrdQuePacket*)header;
-		const char* fullCode = fmtutil::format("{}.{}", packet->_data.exchg, packet->_data.code);
+		if (length < sizeof(WTSOrdQueStruct))
+			return;
+
+		WTSOrdQueStruct* ordQue = (WTSOrdQueStruct*)data;
+		const char* fullCode = fmtutil::format("{}.{}", ordQue->exchg, ordQue->code);
 		auto it = _set_subs.find(fullCode);
 		if (it != _set_subs.end())
 		{
-			WTSOrdQueData* curData = WTSOrdQueData::create(packet->_data);
+			WTSOrdQueData* curData = WTSOrdQueData::create(*ordQue);
 			if (_sink)
 				_sink->handleOrderQueue(curData);
 
@@ -409,14 +460,17 @@ void ParserUDP::extract_buffer(uint32_t length, bool isBroad /* = true */)
 				write_log(_sink, LL_DEBUG, "[ParserUDP] {} order queues received in total", recv_cnt);
 		}
 	}
-	else if (header->_type == UDP_MSG_PUSHTRANS)
+	else if (type == UDP_MSG_PUSHTRANS)
 	{
-		UDPTransPacket* packet = (UDPTransPacket*)header;
-		const char* fullCode = fmtutil::format("{}.{}", packet->_data.exchg, packet->_data.code);
+		if (length < sizeof(WTSTransStruct))
+			return;
+
+		WTSTransStruct* trans = (WTSTransStruct*)data;
+		const char* fullCode = fmtutil::format("{}.{}", trans->exchg, trans->code);
 		auto it = _set_subs.find(fullCode);
 		if (it != _set_subs.end())
 		{
-			WTSTransData* curData = WTSTransData::create(packet->_data);
+			WTSTransData* curData = WTSTransData::create(*trans);
 			if (_sink)
 				_sink->handleTransaction(curData);
 
@@ -430,6 +484,220 @@ void ParserUDP::extract_buffer(uint32_t length, bool isBroad /* = true */)
 	}
 }
 
+void ParserUDP::handle_batch(const char* data, uint32_t length, bool isReplay)
+{
+	if (length < sizeof(UDPBatchHead))
+		return;
+
+	const UDPBatchHead* head = (const UDPBatchHead*)data;
+	if (head->_channel >= UDP_CHNL_COUNT)
+		return;
+
+	UDPGapDetector& detector = _detectors[head->_channel];
+	if (isReplay)
+	{
+		//补发期间发送端重启了，补发的数据已经没有意义了
+		//tick和委托队列是快照，补发的比已经收到的旧，再推出去最新价会往回走，只有逐笔数据需要补
+		if (head->_epoch != detector.epoch() || !need_replay(head->_channel))
+			return;
+	}
+	else
+	{
+		detector.check_epoch(head->_epoch);
+	}
+
+	bool bValid = UDPBatchPacker::visit(data, length, [this, &detector](uint64_t seq, uint16_t type, const char* buf, uint16_t len) {
+		if (detector.accept(seq))
+			dispatch_data(type, buf, len);
+	});
+
+	if (!bValid)
+	{
+		write_log(_sink, LL_WARN, "[ParserUDP] Malformed batch packet of {} bytes on channel {}", length, head->_channel);
+		return;
+	}
+
+	UDPGapDetector::SeqRanges gaps;
+	if (!detector.pop_gaps(gaps))
+		return;
+
+	for (const UDPGapDetector::SeqRange& gap : gaps)
+	{
+		write_log(_sink, LL_WARN, "[ParserUDP] Gap [{}, {}) detected on channel {}, {} lost in total",
+			gap.first, gap.second, head->_channel, detector.lost());
+
+		if (_rport == 0 || !need_replay(head->_channel))
+			continue;
+
+		UDPReplayReq req;
+		req._type = UDP_MSG_REPLAY;
+		req._channel = head->_channel;
+		req._from = gap.first;
+		req._to = gap.second;
+
+		StdUniqueLock lock(_mtx_replay);
+		_replay_queue.push(req);
+	}
+
+	if (_rport != 0)
+		_cond_replay.notify_all();
+}
+
+void ParserUDP::drain_broad()
+{
+#ifndef _WIN32
+	const uint32_t BATCH_SIZE = 16;
+	const uint32_t BUFF_SIZE = (uint32_t)_b_buffer.size();
+	if (_mmsg_buffer.empty())
+		_mmsg_buffer.resize(BATCH_SIZE*BUFF_SIZE);
+
+	struct iovec iovs[BATCH_SIZE];
+	struct mmsghdr msgs[BATCH_SIZE];
+	for (;;)
+	{
+		if (_b_socket == NULL || _stopped)
+			break;
+
+		memset(msgs, 0, sizeof(msgs));
+		for (uint32_t i = 0; i < BATCH_SIZE; i++)
+		{
+			iovs[i].iov_base = _mmsg_buffer.data() + i * BUFF_SIZE;
+			iovs[i].iov_len = BUFF_SIZE;
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int ret = recvmmsg(_b_socket->native_handle(), msgs, BATCH_SIZE, MSG_DONTWAIT, NULL);
+		if (ret <= 0)
+			break;
+
+		for (int i = 0; i < ret; i++)
+			extract_buffer(_mmsg_buffer.data() + i * BUFF_SIZE, msgs[i].msg_len);
+
+		if ((uint32_t)ret < BATCH_SIZE)
+			break;
+	}
+#endif
+}
+
+void ParserUDP::replay_loop()
+{
+	while (!_stopped)
+	{
+		UDPReplayReq req;
+		{
+			StdUniqueLock lock(_mtx_replay);
+			if (_replay_queue.empty())
+			{
+				if (!_stopped)
+					_cond_replay.wait(lock);
+				continue;
+			}
+
+			req = _replay_queue.front();
+			_replay_queue.pop();
+		}
+
+		std::shared_ptr<std::string> frames(new std::string);
+		if (!fetch_replay(req, *frames))
+			continue;
+
+		//补发的数据交给io线程处理，丢包检测只在一个线程里访问
+		_io_service.post(boost::bind(&ParserUDP::handle_replay, this, frames));
+	}
+}
+
+bool ParserUDP::fetch_replay(const UDPReplayReq& req, std::string& frames)
+{
+	io_service ios;
+	ip::tcp::socket skt(ios);
+
+	//连接和读写都用异步接口，每100毫秒检查一次超时和是否已经断开，避免disconnect的时候卡在join上
+	boost::system::error_code ec;
+	bool bDone = false;
+	auto on_io = [&ec, &bDone](const boost::system::error_code& e, std::size_t) {
+		ec = e;
+		bDone = true;
+	};
+	auto wait_io = [&]() {
+		int64_t deadline = TimeUtils::getLocalTimeNow() + _rtimeout;
+		ios.restart();
+		while (!bDone)
+		{
+			if (_stopped || TimeUtils::getLocalTimeNow() >= deadline)
+			{
+				boost::system::error_code ignored;
+				skt.close(ignored);
+				ios.run();
+				if (!ec)
+					ec = boost::asio::error::timed_out;
+				break;
+			}
+			ios.run_for(std::chrono::milliseconds(100));
+		}
+		bDone = false;
+		return !ec;
+	};
+
+	bool bSucceed = false;
+	skt.async_connect(ip::tcp::endpoint(_server_ep.address(), _rport), [&on_io](const boost::system::error_code& e) { on_io(e, 0); });
+	if (wait_io())
+	{
+		boost::asio::async_write(skt, buffer(&req, sizeof(UDPReplayReq)), on_io);
+		bSucceed = wait_io();
+	}
+
+	while (bSucceed)
+	{
+		UDPBatchHead head;
+		boost::asio::async_read(skt, buffer(&head, sizeof(UDPBatchHead)), on_io);
+		if (!wait_io())
+			break;
+
+		if (head._type != UDP_MSG_PUSHBATCH || head._length < sizeof(UDPBatchHead))
+		{
+			write_log(_sink, LL_ERROR, "[ParserUDP] Invalid replay frame received on channel {}", req._channel);
+			return false;
+		}
+
+		std::size_t offset = frames.size();
+		frames.resize(offset + head._length);
+		memcpy((char*)frames.data() + offset, &head, sizeof(UDPBatchHead));
+		boost::asio::async_read(skt, buffer((char*)frames.data() + offset + sizeof(UDPBatchHead), head._length - sizeof(UDPBatchHead)), on_io);
+		if (!wait_io())
+			break;
+
+		//条数为0的是结束帧
+		if (head._count == 0)
+			return true;
+	}
+
+	write_log(_sink, LL_ERROR, "[ParserUDP] Replaying [{}, {}) on channel {} failed: {}", req._from, req._to, req._channel, ec.message());
+	return false;
+}
+
+void ParserUDP::handle_replay(std::shared_ptr<std::string> frames)
+{
+	const char* data = frames->data();
+	std::size_t left = frames->size();
+	uint32_t chnl = 0;
+	while (left >= sizeof(UDPBatchHead))
+	{
+		const UDPBatchHead* head = (const UDPBatchHead*)data;
+		chnl = head->_channel;
+		handle_batch(data, head->_length, true);
+		data += head->_length;
+		left -= head->_length;
+	}
+
+	if (chnl < UDP_CHNL_COUNT)
+	{
+		const UDPGapDetector& detector = _detectors[chnl];
+		write_log(_sink, LL_INFO, "[ParserUDP] Replay on channel {} done, lost: {}, recovered: {}, outstanding: {}",
+			chnl, detector.lost(), detector.recovered(), detector.outstanding());
+	}
+}
+
 void ParserUDP::doOnConnected()
 {
 	if(_sink)
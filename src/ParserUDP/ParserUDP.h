@@ -10,6 +10,7 @@
 #pragma once
 #include "../Includes/IParserApi.h"
 #include "../Share/StdUtils.hpp"
+#include "../Share/UDPBatchProto.hpp"
 
 #include <queue>
 
@@ -52,7 +53,28 @@ private:
 
 	void	subscribe();
 
-	void	extract_buffer(uint32_t length, bool isBroad);
+	void	extract_buffer(const char* data, uint32_t length);
+
+	void	dispatch_data(uint32_t type, const char* data, uint32_t length);
+
+	/*
+	 *	v2数据报，检查序号以后再分发，发现丢包则提交补发请求
+	 */
+	void	handle_batch(const char* data, uint32_t length, bool isReplay);
+
+	/*
+	 *	只有逐笔委托和逐笔成交需要补发，tick和委托队列是快照，丢了等下一笔就行
+	 */
+	inline bool	need_replay(uint32_t chnl) const { return chnl == UDP_CHNL_ORDDTL || chnl == UDP_CHNL_TRANS; }
+
+	/*
+	 *	linux下用recvmmsg一次把广播端口上积压的数据报都读出来
+	 */
+	void	drain_broad();
+
+	void	replay_loop();
+	bool	fetch_replay(const UDPReplayReq& req, std::string& frames);
+	void	handle_replay(std::shared_ptr<std::string> frames);
 
 private:
 	void	doOnConnected();
@@ -76,7 +98,7 @@ private:
 	ip::udp::socket*	_s_socket;
 	bool				_s_inited;
 
-	boost::array<char, 1024> _b_buffer;
+	boost::array<char, 65536> _b_buffer;
 	boost::array<char, 1024> _s_buffer;
 
 	IParserSpi*				_sink;
@@ -89,5 +111,17 @@ private:
 
 	StdUniqueMutex			_mtx_queue;
 	std::queue<std::string>	_send_queue;
+
+	//v2协议
+	bool					_mmsg;
+	std::vector<char>		_mmsg_buffer;
+	UDPGapDetector			_detectors[UDP_CHNL_COUNT];
+
+	int						_rport;		//补发端口，为0则不补发
+	uint32_t				_rtimeout;	//补发请求的超时毫秒数
+	StdThreadPtr			_thrd_replay;
+	StdUniqueMutex			_mtx_replay;
+	StdCondVariable			_cond_replay;
+	std::queue<UDPReplayReq>	_replay_queue;
 };
 
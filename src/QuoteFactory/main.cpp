@@ -3,6 +3,7 @@
 #include "../WtDtCore/StateMonitor.h"
 #include "../WtDtCore/UDPCaster.h"
 #include "../WtDtCore/ShmCaster.h"
+#include "../WtDtCore/ShmBusCaster.h"
 #include "../WtDtCore/WtHelper.h"
 #include "../WtDtCore/IndexFactory.h"
 
@@ -23,6 +24,7 @@ WTSHotMgr		g_hotMgr;
 StateMonitor	g_stateMon;
 UDPCaster		g_udpCaster;
 ShmCaster		g_shmCaster;
+ShmBusCaster	g_shmBusCaster;
 DataManager		g_dataMgr;
 ParserAdapterMgr g_parsers;
 IndexFactory	g_idxFactory;
@@ -178,6 +180,12 @@ void initialize(const std::string& filename)
 		g_dataMgr.add_caster(&g_shmCaster);
 	}
 
+	if (config->has("shmbus"))
+	{
+		g_shmBusCaster.init(config->get("shmbus"));
+		g_dataMgr.add_caster(&g_shmBusCaster);
+	}
+
 	if (config->has("broadcaster"))
 	{
 		g_udpCaster.init(config->get("broadcaster"), &g_baseDataMgr, &g_dataMgr);
@@ -0,0 +1,124 @@
+﻿/*!
+ * \file BarCacheFile.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 不压缩的K线缓存文件
+ *
+ * 文件头 + 定长的WTSBarStruct记录，由dsb文件解压以后生成
+ * 回测的时候以只读方式映射到内存，直接在映射的内存上切片，不需要解压，也不占用进程的堆内存
+ * 多个回测进程映射同一个文件，共享同一份页缓存
+ */
+#pragma once
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include "BoostFile.hpp"
+#include "BoostMappingFile.hpp"
+#include "../Includes/WTSStruct.h"
+
+USING_NS_WTP;
+
+#define BAR_CACHE_MAGIC		0x43425457	//"WTBC"
+#define BAR_CACHE_VERSION	1
+
+class BarCacheFile
+{
+public:
+	/*
+	 *	文件头，补齐到64字节，后面的记录按cache line对齐
+	 */
+	typedef struct _BarCacheHeader
+	{
+		uint32_t	_magic;
+		uint32_t	_version;
+		uint32_t	_bar_size;
+		uint32_t	_reserved;
+		uint64_t	_count;
+		char		_padding[40];
+	} BarCacheHeader;
+
+	static_assert(sizeof(BarCacheHeader) == 64, "size of BarCacheHeader must be 64");
+
+public:
+	BarCacheFile() :_bars(NULL), _count(0) {}
+
+	/*
+	 *	写入缓存文件，先写到临时文件再改名，正在读的进程不会读到写了一半的文件
+	 */
+	static bool write(const char* filename, const WTSBarStruct* bars, uint64_t count)
+	{
+		BarCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		header._magic = BAR_CACHE_MAGIC;
+		header._version = BAR_CACHE_VERSION;
+		header._bar_size = sizeof(WTSBarStruct);
+		header._count = count;
+
+		std::string tmpFile = filename;
+		tmpFile += ".tmp";
+		{
+			BoostFile bf;
+			if (!bf.create_new_file(tmpFile.c_str()))
+				return false;
+
+			bf.write_file(&header, sizeof(header));
+			if (count > 0)
+				bf.write_file(bars, (std::size_t)(sizeof(WTSBarStruct)*count));
+			bf.close_file();
+		}
+
+		boost::system::error_code ec;
+		boost::filesystem::rename(tmpFile, filename, ec);
+		return !ec;
+	}
+
+	/*
+	 *	以只读方式映射缓存文件，文件不存在或者校验失败返回false
+	 */
+	bool open(const char* filename)
+	{
+		if (!BoostFile::exists(filename))
+			return false;
+
+		std::shared_ptr<BoostMappingFile> mf(new BoostMappingFile);
+		try
+		{
+			if (!mf->map(filename, boost::interprocess::read_only, boost::interprocess::read_only))
+				return false;
+		}
+		catch (...)
+		{
+			return false;
+		}
+
+		if (mf->size() < sizeof(BarCacheHeader))
+			return false;
+
+		const BarCacheHeader* header = (const BarCacheHeader*)mf->addr();
+		if (header->_magic != BAR_CACHE_MAGIC || header->_version != BAR_CACHE_VERSION || header->_bar_size != sizeof(WTSBarStruct))
+			return false;
+
+		if (mf->size() < sizeof(BarCacheHeader) + sizeof(WTSBarStruct)*header->_count)
+			return false;
+
+		_mapfile = mf;
+		_bars = (const WTSBarStruct*)((const char*)mf->addr() + sizeof(BarCacheHeader));
+		_count = header->_count;
+		return true;
+	}
+
+	inline const WTSBarStruct*	bars() const { return _bars; }
+	inline uint64_t	count() const { return _count; }
+
+private:
+	std::shared_ptr<BoostMappingFile>	_mapfile;
+	const WTSBarStruct*	_bars;
+	uint64_t			_count;
+};
+
+typedef std::shared_ptr<BarCacheFile> BarCacheFilePtr;
@@ -0,0 +1,170 @@
+﻿/*!
+ * \file BarRing.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 导出给外部语言直接读取的K线环形缓冲区
+ *
+ * 每个(策略, 合约, 周期)一个缓冲区，订阅的时候把地址交给调用方，之后只追加不搬移
+ * 调用方记住自己读到的位置，每次只读_cursor之前的新K线，不需要再拷贝整段K线
+ * 缓冲区一旦分配就不再释放，交出去的地址在进程退出之前一直有效
+ */
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <string>
+
+#include "../Includes/WTSStruct.h"
+#include "../Includes/FasterDefs.h"
+#include "fmtlib.h"
+
+USING_NS_WTP;
+
+/*
+ *	缓冲区头，后面紧跟_capacity条K线
+ *	第n条K线(n从0开始)存放在_bars[n % _capacity]
+ *	写第n条的时候先覆盖第n-_capacity条所在的槽位，然后才推进游标，所以可以读的区间是[max(0, _cursor - _capacity + 1), _cursor)
+ *	读的过程中游标可能继续推进，读完以后要再检查一次游标，已经落到新区间外面的K线要丢掉，可以参考BarRingMgr::read
+ *	同一时间的K线再次写入会原地更新最后一条，已经读过的最后一条K线可能会变
+ */
+#pragma pack(push, 8)
+typedef struct _WTSBarRing
+{
+	uint64_t		_cursor;	//已经写入的K线总条数，只增不减
+	uint32_t		_capacity;	//最多保留多少条K线
+	uint32_t		_reserved;
+	WTSBarStruct	_bars[1];
+} WTSBarRing;
+#pragma pack(pop)
+
+class BarRingMgr
+{
+public:
+	BarRingMgr() :_count(0) {}
+
+	/*
+	 *	获取缓冲区，没有则新建一个
+	 *	新建的缓冲区先调用fill灌入历史K线，灌完了才能被append找到，避免新旧K线交错
+	 *	同一个(策略, 合约, 周期)多次订阅返回同一个缓冲区，容量以第一次为准
+	 */
+	template<typename Fn>
+	WTSBarRing* subscribe(uint32_t ctxid, const char* stdCode, const char* period, uint32_t capacity, Fn fill)
+	{
+		if (capacity == 0)
+			return NULL;
+
+		std::string key = fmtutil::format("{}#{}#{}", ctxid, stdCode, period);
+		std::unique_lock<std::mutex> lock(_mtx);
+		auto it = _rings.find(key);
+		if (it != _rings.end())
+			return it->second;
+
+		std::size_t bytes = sizeof(WTSBarRing) + sizeof(WTSBarStruct)*(capacity - 1);
+		WTSBarRing* ring = (WTSBarRing*)calloc(1, bytes);
+		if (ring == NULL)
+			return NULL;
+
+		ring->_capacity = capacity;
+		fill(ring);
+
+		_rings[key] = ring;
+		_count.store((uint32_t)_rings.size(), std::memory_order_release);
+		return ring;
+	}
+
+	/*
+	 *	K线闭合的时候追加，没有订阅的直接返回
+	 *	时间不晚于最后一条的，覆盖最后一条，避免初始化的K线和闭合事件重复
+	 */
+	void append(uint32_t ctxid, const char* stdCode, const char* period, const WTSBarStruct* newBar)
+	{
+		if (_count.load(std::memory_order_acquire) == 0 || newBar == NULL)
+			return;
+
+		const char* key = fmtutil::format("{}#{}#{}", ctxid, stdCode, period);
+
+		WTSBarRing* ring = NULL;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			auto it = _rings.find(key);
+			if (it == _rings.end())
+				return;
+			ring = it->second;
+		}
+
+		push(ring, newBar);
+	}
+
+	/*
+	 *	写入一条K线，先写数据再推进游标
+	 */
+	static inline void push(WTSBarRing* ring, const WTSBarStruct* newBar)
+	{
+		uint64_t cursor = ring->_cursor;
+		if (cursor > 0)
+		{
+			WTSBarStruct& lastBar = ring->_bars[(cursor - 1) % ring->_capacity];
+			if (lastBar.date > newBar->date || (lastBar.date == newBar->date && lastBar.time >= newBar->time))
+			{
+				memcpy(&lastBar, newBar, sizeof(WTSBarStruct));
+				return;
+			}
+		}
+
+		memcpy(&ring->_bars[cursor % ring->_capacity], newBar, sizeof(WTSBarStruct));
+		std::atomic_thread_fence(std::memory_order_release);
+		ring->_cursor = cursor + 1;
+	}
+
+	/*
+	 *	读取第from条开始的K线，最多maxCnt条，返回读到的条数，from更新为下一次要读的位置
+	 *	来不及读就被覆盖的K线会被跳过
+	 */
+	static inline uint32_t read(const WTSBarRing* ring, uint64_t& from, WTSBarStruct* out, uint32_t maxCnt)
+	{
+		const volatile uint64_t& curRef = ring->_cursor;
+		for (;;)
+		{
+			uint64_t cursor = curRef;
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			uint64_t first = (cursor >= ring->_capacity) ? (cursor - ring->_capacity + 1) : 0;
+			if (from < first)
+				from = first;
+
+			uint32_t cnt = (from >= cursor) ? 0 : (uint32_t)std::min<uint64_t>(cursor - from, maxCnt);
+			for (uint32_t i = 0; i < cnt; i++)
+				memcpy(&out[i], &ring->_bars[(from + i) % ring->_capacity], sizeof(WTSBarStruct));
+
+			//读的时候又写了新的K线，读到的第一条如果已经不在可读区间里，说明被覆盖了，重读
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t after = curRef;
+			uint64_t safeFirst = (after >= ring->_capacity) ? (after - ring->_capacity + 1) : 0;
+			if (from >= safeFirst)
+			{
+				from += cnt;
+				return cnt;
+			}
+		}
+	}
+
+	/*
+	 *	批量写入，用于订阅时灌入历史K线
+	 */
+	static inline void push(WTSBarRing* ring, const WTSBarStruct* bars, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			push(ring, &bars[i]);
+	}
+
+private:
+	std::mutex	_mtx;
+	wt_hashmap<std::string, WTSBarRing*>	_rings;
+	std::atomic<uint32_t>	_count;
+};
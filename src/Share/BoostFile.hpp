@@ -148,6 +148,18 @@ public:
 		return boost::interprocess::ipcdetail::write_file(_handle, data.data(), data.size());
 	}
 
+	/*
+	 *	把写入的数据刷到磁盘上
+	 */
+	bool flush_file()
+	{
+#ifdef _WIN32
+		return FlushFileBuffers(_handle) != 0;
+#else
+		return fsync(_handle) == 0;
+#endif
+	}
+
 	bool read_file(void *data, std::size_t numdata)
 	{
 		unsigned long readbytes = 0;
@@ -0,0 +1,298 @@
+﻿/*!
+ * \file FastCsvReader.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 批量转换用的csv读取器
+ *
+ * 文件以只读方式映射到内存，按行切分成字段，字段只记录起止位置，不拷贝也不分配内存
+ * 数值直接从字段的内存上解析，常见的价格格式（15位有效数字以内、没有指数）不经过strtod
+ * 表头的处理和CsvReader一致：去掉BOM和<>"'，转成小写
+ */
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "BoostMappingFile.hpp"
+
+class FastCsvReader
+{
+public:
+	FastCsvReader(char splitter = ',') :_splitter(splitter), _cur(NULL), _end(NULL) {}
+
+	bool load_from_file(const char* filename)
+	{
+		std::shared_ptr<BoostMappingFile> mf(new BoostMappingFile);
+		try
+		{
+			if (!mf->map(filename, boost::interprocess::read_only, boost::interprocess::read_only))
+				return false;
+		}
+		catch (...)
+		{
+			return false;
+		}
+
+		_mapfile = mf;
+		return load_from_buffer((const char*)mf->addr(), mf->size());
+	}
+
+	/*
+	 *	直接从内存读取，调用方要保证内存在读取期间有效
+	 */
+	bool load_from_buffer(const char* data, std::size_t len)
+	{
+		_cur = data;
+		_end = data + len;
+		_fields_map.clear();
+
+		if (len >= 3 && memcmp(_cur, "\xEF\xBB\xBF", 3) == 0)
+			_cur += 3;
+
+		if (!next_row())
+			return false;
+
+		for (uint32_t i = 0; i < _cells.size(); i++)
+		{
+			std::string name;
+			for (const char* p = _cells[i].first; p < _cells[i].first + _cells[i].second; p++)
+			{
+				char c = *p;
+				if (c == '<' || c == '>' || c == '"' || c == '\'' || c == ' ' || c == '\t')
+					continue;
+				name += (char)tolower((unsigned char)c);
+			}
+
+			if (name.empty())
+				break;
+
+			_fields_map[name] = i;
+		}
+		return true;
+	}
+
+	/*
+	 *	读取下一行，空行会跳过
+	 */
+	bool next_row()
+	{
+		_cells.clear();
+		while (_cur < _end)
+		{
+			const char* lineEnd = (const char*)memchr(_cur, '\n', _end - _cur);
+			if (lineEnd == NULL)
+				lineEnd = _end;
+
+			const char* s = _cur;
+			const char* e = lineEnd;
+			_cur = (lineEnd < _end) ? lineEnd + 1 : _end;
+			if (e > s && e[-1] == '\r')
+				e--;
+
+			if (e == s)
+				continue;
+
+			for (;;)
+			{
+				const char* p = (const char*)memchr(s, _splitter, e - s);
+				if (p == NULL)
+				{
+					_cells.emplace_back(s, (uint32_t)(e - s));
+					break;
+				}
+
+				_cells.emplace_back(s, (uint32_t)(p - s));
+				s = p + 1;
+			}
+			return true;
+		}
+
+		return false;
+	}
+
+	/*
+	 *	按字段名查找列号，找不到返回-1
+	 *	循环里应该先查好列号，再按列号取值
+	 */
+	inline int32_t col_of(const char* field) const
+	{
+		auto it = _fields_map.find(field);
+		return (it == _fields_map.end()) ? -1 : it->second;
+	}
+
+	inline uint32_t col_count() const { return (uint32_t)_fields_map.size(); }
+
+	inline uint32_t cell_count() const { return (uint32_t)_cells.size(); }
+
+	/*
+	 *	字段的原始内容，不以0结尾
+	 */
+	inline const char* get_cell(int32_t col, uint32_t& len) const
+	{
+		if (col < 0 || col >= (int32_t)_cells.size())
+		{
+			len = 0;
+			return "";
+		}
+
+		len = _cells[col].second;
+		return _cells[col].first;
+	}
+
+	inline double get_double(int32_t col) const
+	{
+		uint32_t len = 0;
+		const char* s = get_cell(col, len);
+		return parse_double(s, s + len);
+	}
+
+	inline uint64_t get_uint64(int32_t col) const
+	{
+		uint32_t len = 0;
+		const char* s = get_cell(col, len);
+		const char* e = s + len;
+		while (s < e && *s == ' ')
+			s++;
+
+		uint64_t ret = 0;
+		for (; s < e && *s >= '0' && *s <= '9'; s++)
+			ret = ret * 10 + (*s - '0');
+		return ret;
+	}
+
+	inline uint32_t get_uint32(int32_t col) const { return (uint32_t)get_uint64(col); }
+
+	/*
+	 *	读取日期，支持yyyymmdd、yyyy/m/d和yyyy-mm-dd，后面带的时间部分会被忽略
+	 */
+	inline uint32_t get_date(int32_t col) const
+	{
+		uint32_t len = 0;
+		const char* s = get_cell(col, len);
+		const char* e = s + len;
+		while (s < e && *s == ' ')
+			s++;
+
+		uint32_t parts[3] = { 0 };
+		uint32_t idx = 0;
+		for (; s < e && *s != ' ' && *s != 'T'; s++)
+		{
+			char c = *s;
+			if (c >= '0' && c <= '9')
+				parts[idx] = parts[idx] * 10 + (c - '0');
+			else if ((c == '/' || c == '-') && idx < 2)
+				idx++;
+			else
+				break;
+		}
+
+		if (idx == 0)
+			return parts[0];
+
+		return parts[0] * 10000 + parts[1] * 100 + parts[2];
+	}
+
+	/*
+	 *	读取时间，忽略其中的冒号，和strToTime一致：不保留秒的时候，大于10000的值会除以100
+	 */
+	inline uint32_t get_time(int32_t col, bool bKeepSec = false) const
+	{
+		uint32_t len = 0;
+		const char* s = get_cell(col, len);
+		const char* e = s + len;
+		while (s < e && *s == ' ')
+			s++;
+
+		uint32_t ret = 0;
+		for (; s < e; s++)
+		{
+			char c = *s;
+			if (c >= '0' && c <= '9')
+				ret = ret * 10 + (c - '0');
+			else if (c != ':')
+				break;
+		}
+
+		if (ret > 10000 && !bKeepSec)
+			ret /= 100;
+		return ret;
+	}
+
+	/*
+	 *	解析浮点数
+	 *	有效数字不超过15位且没有指数的时候，尾数和10的幂都能用double精确表示，一次除法得到的就是正确舍入的结果
+	 *	其他情况交给strtod
+	 */
+	static double parse_double(const char* s, const char* e)
+	{
+		while (s < e && (*s == ' ' || *s == '\t'))
+			s++;
+
+		const char* begin = s;
+		bool neg = false;
+		if (s < e && (*s == '-' || *s == '+'))
+		{
+			neg = (*s == '-');
+			s++;
+		}
+
+		uint64_t mantissa = 0;
+		uint32_t digits = 0;
+		int32_t scale = 0;
+		for (; s < e && *s >= '0' && *s <= '9'; s++)
+		{
+			if (mantissa != 0 || *s != '0')
+				digits++;
+			mantissa = mantissa * 10 + (*s - '0');
+		}
+
+		if (s < e && *s == '.')
+		{
+			s++;
+			for (; s < e && *s >= '0' && *s <= '9'; s++)
+			{
+				if (mantissa != 0 || *s != '0')
+					digits++;
+				mantissa = mantissa * 10 + (*s - '0');
+				scale++;
+			}
+		}
+
+		bool bTrail = (s < e && *s != ' ' && *s != '\t');
+		if (digits > 15 || scale > 22 || bTrail)
+		{
+			//指数、超长数字或者其他格式，拷贝到栈上再用strtod
+			char buf[64];
+			std::size_t len = (std::size_t)(e - begin);
+			if (len >= sizeof(buf))
+				len = sizeof(buf) - 1;
+			memcpy(buf, begin, len);
+			buf[len] = '\0';
+			return strtod(buf, NULL);
+		}
+
+		static const double POW10[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		double ret = (double)mantissa / POW10[scale];
+		return neg ? -ret : ret;
+	}
+
+private:
+	char			_splitter;
+	const char*		_cur;
+	const char*		_end;
+	std::shared_ptr<BoostMappingFile>	_mapfile;
+
+	std::unordered_map<std::string, int32_t>	_fields_map;
+	std::vector<std::pair<const char*, uint32_t>>	_cells;
+};
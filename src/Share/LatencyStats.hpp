@@ -0,0 +1,315 @@
+﻿/*!
+ * \file LatencyStats.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 分阶段的延迟统计
+ *
+ * 行情从ParserAdapter进来，经过引擎分发、策略处理，到TraderAdapter下单和委托回报，每个阶段的耗时分别统计
+ * 每个线程有自己的直方图，记录的时候只写本线程的直方图，不需要加锁，也没有CAS
+ * 直方图是对数-线性分桶的（类似HDR Histogram），相对误差在1/16以内，汇总的时候把所有线程的直方图合并起来
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "fmtlib.h"
+
+class LatencyStats
+{
+public:
+	typedef enum tagStage
+	{
+		LS_PARSER,		//ParserAdapter收到行情到引擎开始处理
+		LS_DISPATCH,	//引擎开始处理到策略on_tick入口
+		LS_STRATEGY,	//策略on_tick的耗时
+		LS_TICK2ORDER,	//ParserAdapter收到行情到TraderAdapter下单
+		LS_ORDER_RSP,	//TraderAdapter下单到收到第一笔委托回报
+		LS_COUNT
+	} Stage;
+
+	/*
+	 *	单个阶段的汇总数据，单位都是纳秒
+	 */
+	typedef struct _StageSummary
+	{
+		uint64_t	_count;
+		double		_mean;
+		uint64_t	_max;
+		uint64_t	_p50;
+		uint64_t	_p99;
+		uint64_t	_p999;
+	} StageSummary;
+
+private:
+	static const uint32_t SUB_BITS = 4;
+	static const uint32_t SUB_COUNT = 1 << SUB_BITS;
+	static const uint32_t BUCKETS = (64 - SUB_BITS + 1) * SUB_COUNT;
+	static const uint32_t STAMP_SLOTS = 4096;	//委托时间戳的槽位数，要是2的幂
+
+	/*
+	 *	单个线程的直方图，只有所属的线程会写
+	 */
+	typedef struct _ThreadHist
+	{
+		std::atomic<uint64_t>	_buckets[LS_COUNT][BUCKETS];
+		std::atomic<uint64_t>	_count[LS_COUNT];
+		std::atomic<uint64_t>	_sum[LS_COUNT];
+		std::atomic<uint64_t>	_max[LS_COUNT];
+
+		_ThreadHist()
+		{
+			for (uint32_t s = 0; s < LS_COUNT; s++)
+			{
+				for (uint32_t i = 0; i < BUCKETS; i++)
+					_buckets[s][i].store(0, std::memory_order_relaxed);
+				_count[s].store(0, std::memory_order_relaxed);
+				_sum[s].store(0, std::memory_order_relaxed);
+				_max[s].store(0, std::memory_order_relaxed);
+			}
+		}
+	} ThreadHist;
+	typedef std::shared_ptr<ThreadHist> ThreadHistPtr;
+
+	typedef struct _Registry
+	{
+		std::mutex					_mtx;
+		std::vector<ThreadHistPtr>	_hists;		//线程退出以后直方图仍然保留
+		std::atomic<int64_t>		_stamps[STAMP_SLOTS];
+
+		_Registry()
+		{
+			for (uint32_t i = 0; i < STAMP_SLOTS; i++)
+				_stamps[i].store(0, std::memory_order_relaxed);
+		}
+	} Registry;
+
+public:
+	/*
+	 *	单调时钟，纳秒
+	 */
+	static inline int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/*
+	 *	记录一个阶段的耗时
+	 */
+	static inline void record(Stage stage, int64_t elapse)
+	{
+		uint64_t val = (elapse > 0) ? (uint64_t)elapse : 0;
+		ThreadHist* hist = local_hist();
+
+		//只有本线程会写，所以不需要fetch_add
+		std::atomic<uint64_t>& bucket = hist->_buckets[stage][bucket_index(val)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		hist->_count[stage].store(hist->_count[stage].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		hist->_sum[stage].store(hist->_sum[stage].load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+		if (val > hist->_max[stage].load(std::memory_order_relaxed))
+			hist->_max[stage].store(val, std::memory_order_relaxed);
+	}
+
+	/*
+	 *	当前线程正在处理的行情的到达时间，下单的时候用来计算tick到下单的延迟
+	 *	引擎在分发行情之前设置，分发完以后清零
+	 */
+	static inline void set_tick_stamp(int64_t stamp) { tick_stamp() = stamp; }
+	static inline int64_t get_tick_stamp() { return tick_stamp(); }
+
+	/*
+	 *	记录委托发出的时间，本地订单号是进程内唯一的，按订单号取模放到槽位里
+	 */
+	static inline void mark_entrust(uint32_t localid)
+	{
+		registry()._stamps[localid & (STAMP_SLOTS - 1)].store(now(), std::memory_order_relaxed);
+	}
+
+	/*
+	 *	收到委托回报，只有第一次回报会被统计
+	 */
+	static inline void ack_entrust(uint32_t localid)
+	{
+		int64_t sent = registry()._stamps[localid & (STAMP_SLOTS - 1)].exchange(0, std::memory_order_relaxed);
+		if (sent != 0)
+			record(LS_ORDER_RSP, now() - sent);
+	}
+
+	static inline const char* stage_name(Stage stage)
+	{
+		static const char* names[LS_COUNT] = { "parser", "dispatch", "strategy", "tick2order", "order_rsp" };
+		return (stage < LS_COUNT) ? names[stage] : "";
+	}
+
+	/*
+	 *	合并所有线程的直方图，计算一个阶段的汇总数据
+	 */
+	static void summarize(Stage stage, StageSummary& summary)
+	{
+		memset(&summary, 0, sizeof(StageSummary));
+
+		std::vector<uint64_t> merged(BUCKETS, 0);
+		uint64_t total = 0;
+		uint64_t sum = 0;
+		{
+			Registry& reg = registry();
+			std::unique_lock<std::mutex> lock(reg._mtx);
+			for (const ThreadHistPtr& hist : reg._hists)
+			{
+				for (uint32_t i = 0; i < BUCKETS; i++)
+				{
+					uint64_t cnt = hist->_buckets[stage][i].load(std::memory_order_relaxed);
+					merged[i] += cnt;
+					total += cnt;
+				}
+				sum += hist->_sum[stage].load(std::memory_order_relaxed);
+				uint64_t maxVal = hist->_max[stage].load(std::memory_order_relaxed);
+				if (maxVal > summary._max)
+					summary._max = maxVal;
+			}
+		}
+
+		if (total == 0)
+			return;
+
+		summary._count = total;
+		summary._mean = sum * 1.0 / total;
+
+		//百分位按照桶的上界给出
+		uint64_t targets[3] = { (total * 500 + 999) / 1000, (total * 990 + 999) / 1000, (total * 999 + 999) / 1000 };
+		uint64_t* outputs[3] = { &summary._p50, &summary._p99, &summary._p999 };
+		uint32_t k = 0;
+		uint64_t acc = 0;
+		for (uint32_t i = 0; i < BUCKETS && k < 3; i++)
+		{
+			acc += merged[i];
+			while (k < 3 && acc >= targets[k] && targets[k] > 0)
+			{
+				uint64_t upper = bucket_upper(i);
+				*outputs[k] = (upper < summary._max) ? upper : summary._max;
+				k++;
+			}
+		}
+	}
+
+	/*
+	 *	清空统计数据，写线程可能同时在记录，清空以后的数据可能会有少量误差
+	 */
+	static void reset()
+	{
+		Registry& reg = registry();
+		std::unique_lock<std::mutex> lock(reg._mtx);
+		for (const ThreadHistPtr& hist : reg._hists)
+		{
+			for (uint32_t s = 0; s < LS_COUNT; s++)
+			{
+				for (uint32_t i = 0; i < BUCKETS; i++)
+					hist->_buckets[s][i].store(0, std::memory_order_relaxed);
+				hist->_count[s].store(0, std::memory_order_relaxed);
+				hist->_sum[s].store(0, std::memory_order_relaxed);
+				hist->_max[s].store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/*
+	 *	把所有阶段的汇总数据输出成json，没有数据的阶段不输出
+	 */
+	static std::string to_json()
+	{
+		std::string ret = "{";
+		bool bFirst = true;
+		for (uint32_t s = 0; s < LS_COUNT; s++)
+		{
+			StageSummary summary;
+			summarize((Stage)s, summary);
+			if (summary._count == 0)
+				continue;
+
+			if (!bFirst)
+				ret += ",";
+			bFirst = false;
+			ret += fmt::format("\"{}\":{{\"count\":{},\"mean\":{:.1f},\"p50\":{},\"p99\":{},\"p999\":{},\"max\":{}}}",
+				stage_name((Stage)s), summary._count, summary._mean, summary._p50, summary._p99, summary._p999, summary._max);
+		}
+		ret += "}";
+		return ret;
+	}
+
+	static inline uint32_t bucket_index(uint64_t val)
+	{
+		if (val < SUB_COUNT)
+			return (uint32_t)val;
+
+		uint32_t msb = highest_bit(val);
+		uint32_t shift = msb - SUB_BITS;
+		return (shift + 1) * SUB_COUNT + (uint32_t)((val >> shift) - SUB_COUNT);
+	}
+
+	/*
+	 *	桶能容纳的最大值
+	 */
+	static inline uint64_t bucket_upper(uint32_t idx)
+	{
+		if (idx < SUB_COUNT)
+			return idx;
+
+		uint32_t shift = idx / SUB_COUNT - 1;
+		uint64_t sub = idx % SUB_COUNT + SUB_COUNT;
+		if (shift + SUB_BITS >= 63)
+			return UINT64_MAX;
+
+		return ((sub + 1) << shift) - 1;
+	}
+
+private:
+	static inline uint32_t highest_bit(uint64_t val)
+	{
+#ifdef _MSC_VER
+		unsigned long idx = 0;
+		_BitScanReverse64(&idx, val);
+		return (uint32_t)idx;
+#else
+		return 63 - (uint32_t)__builtin_clzll(val);
+#endif
+	}
+
+	static inline Registry& registry()
+	{
+		static Registry reg;
+		return reg;
+	}
+
+	static inline int64_t& tick_stamp()
+	{
+		thread_local static int64_t stamp = 0;
+		return stamp;
+	}
+
+	static inline ThreadHist* local_hist()
+	{
+		thread_local static ThreadHist* hist = NULL;
+		if (hist == NULL)
+		{
+			ThreadHistPtr newHist(new ThreadHist);
+			Registry& reg = registry();
+			std::unique_lock<std::mutex> lock(reg._mtx);
+			reg._hists.emplace_back(newHist);
+			hist = newHist.get();
+		}
+
+		return hist;
+	}
+};
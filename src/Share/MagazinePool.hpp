@@ -0,0 +1,215 @@
+﻿/*!
+ * \file MagazinePool.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 按线程缓存的无锁对象池
+ *
+ * 每个线程有自己的空闲链表，分配和本线程归还都不需要加锁，也没有原子操作的竞争
+ * 对象记录分配它的线程缓存，其他线程归还的对象用CAS压到该缓存的归还栈上
+ * 拥有者本地链表用完了，一次性把归还栈整个取回来，没有ABA问题
+ * 线程缓存和内存块都不会释放：线程退出时缓存被挂起，后面新建的线程会接管它
+ * 所以对象可以比分配它的线程活得更久，这是原来thread_local的boost::pool做不到的
+ */
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+
+template<typename T>
+class MagazinePool
+{
+public:
+	typedef struct _PoolStats
+	{
+		uint64_t	_capacity;		//已经创建的对象槽位数
+		uint64_t	_allocs;		//分配次数
+		uint64_t	_local_frees;	//分配线程自己归还的次数
+		uint64_t	_remote_frees;	//其他线程归还的次数
+		uint32_t	_caches;		//线程缓存数
+		uint32_t	_orphans;		//线程已经退出、还没有被接管的缓存数
+	} PoolStats;
+
+private:
+	union Slot
+	{
+		Slot*	_next;
+		alignas(T) char	_data[sizeof(T)];
+	};
+
+public:
+	/*
+	 *	线程缓存，统计数据都只有一个线程写，用relaxed的原子变量是为了统计的时候能安全读取
+	 */
+	struct alignas(64) ThreadCache
+	{
+		Slot*					_free;
+		uint32_t				_chunk_size;
+		bool					_orphaned;
+		std::atomic<uint64_t>	_capacity;
+		std::atomic<uint64_t>	_allocs;
+		std::atomic<uint64_t>	_local_frees;
+
+		//其他线程访问的部分单独占一个cache line
+		alignas(64) std::atomic<Slot*>	_remote;
+		std::atomic<uint64_t>	_remote_frees;
+
+		ThreadCache() :_free(NULL), _chunk_size(32), _orphaned(false), _capacity(0), _allocs(0), _local_frees(0), _remote(NULL), _remote_frees(0) {}
+	};
+
+public:
+	/*
+	 *	分配一个对象，owner返回对象所属的线程缓存，归还的时候要传回来
+	 */
+	static inline T* construct(ThreadCache*& owner)
+	{
+		ThreadCache* c = local_cache();
+		Slot* s = c->_free;
+		if (s == NULL)
+		{
+			s = c->_remote.exchange(NULL, std::memory_order_acquire);
+			if (s == NULL)
+				s = refill(c);
+		}
+		c->_free = s->_next;
+		c->_allocs.store(c->_allocs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+		owner = c;
+		return new(s->_data) T();
+	}
+
+	/*
+	 *	归还对象，可以在任意线程调用
+	 */
+	static inline void destroy(T* obj, ThreadCache* owner)
+	{
+		obj->~T();
+		Slot* s = (Slot*)obj;
+		if (owner == tls_cache())
+		{
+			s->_next = owner->_free;
+			owner->_free = s;
+			owner->_local_frees.store(owner->_local_frees.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+		else
+		{
+			Slot* head = owner->_remote.load(std::memory_order_relaxed);
+			do
+			{
+				s->_next = head;
+			} while (!owner->_remote.compare_exchange_weak(head, s, std::memory_order_release, std::memory_order_relaxed));
+			owner->_remote_frees.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	/*
+	 *	汇总所有线程缓存的统计数据
+	 */
+	static PoolStats stats()
+	{
+		PoolStats ret{};
+		Registry& reg = registry();
+		std::unique_lock<std::mutex> lock(reg._mtx);
+		for (ThreadCache* c : reg._caches)
+		{
+			ret._capacity += c->_capacity.load(std::memory_order_relaxed);
+			ret._allocs += c->_allocs.load(std::memory_order_relaxed);
+			ret._local_frees += c->_local_frees.load(std::memory_order_relaxed);
+			ret._remote_frees += c->_remote_frees.load(std::memory_order_relaxed);
+		}
+		ret._caches = (uint32_t)reg._caches.size();
+		ret._orphans = (uint32_t)reg._orphans.size();
+		return ret;
+	}
+
+private:
+	typedef struct _Registry
+	{
+		std::mutex					_mtx;
+		std::vector<ThreadCache*>	_caches;
+		std::vector<ThreadCache*>	_orphans;
+	} Registry;
+
+	/*
+	 *	全局登记表，故意不析构，进程退出时还有线程在归还对象也不会出问题
+	 */
+	static Registry& registry()
+	{
+		static Registry* reg = new Registry;
+		return *reg;
+	}
+
+	/*
+	 *	线程退出时挂起自己的缓存
+	 */
+	struct CacheHolder
+	{
+		ThreadCache* _cache;
+
+		CacheHolder()
+		{
+			Registry& reg = registry();
+			std::unique_lock<std::mutex> lock(reg._mtx);
+			if (!reg._orphans.empty())
+			{
+				_cache = reg._orphans.back();
+				reg._orphans.pop_back();
+				_cache->_orphaned = false;
+			}
+			else
+			{
+				_cache = new ThreadCache;
+				reg._caches.emplace_back(_cache);
+			}
+			tls_cache() = _cache;
+		}
+
+		~CacheHolder()
+		{
+			tls_cache() = NULL;
+			Registry& reg = registry();
+			std::unique_lock<std::mutex> lock(reg._mtx);
+			_cache->_orphaned = true;
+			reg._orphans.emplace_back(_cache);
+		}
+	};
+
+	//只是一个指针，没有析构函数，线程退出的过程中也可以安全读取
+	static inline ThreadCache*& tls_cache()
+	{
+		thread_local static ThreadCache* cache = NULL;
+		return cache;
+	}
+
+	static inline ThreadCache* local_cache()
+	{
+		ThreadCache* c = tls_cache();
+		if (c != NULL)
+			return c;
+
+		thread_local static CacheHolder holder;
+		return holder._cache;
+	}
+
+	/*
+	 *	申请一块新的内存，每次翻倍，最多一次1024个对象
+	 */
+	static Slot* refill(ThreadCache* c)
+	{
+		uint32_t cnt = c->_chunk_size;
+		if (c->_chunk_size < 1024)
+			c->_chunk_size *= 2;
+
+		Slot* chunk = (Slot*)::operator new(sizeof(Slot)*cnt);
+		for (uint32_t i = 0; i < cnt - 1; i++)
+			chunk[i]._next = &chunk[i + 1];
+		chunk[cnt - 1]._next = NULL;
+
+		c->_capacity.store(c->_capacity.load(std::memory_order_relaxed) + cnt, std::memory_order_relaxed);
+		return chunk;
+	}
+};
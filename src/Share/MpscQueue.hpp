@@ -0,0 +1,152 @@
+﻿/*!
+ * \file MpscQueue.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 有界无锁多写单读队列
+ *
+ * 基于每个槽位的序号实现（Vyukov bounded queue），容量为2^n
+ * 多个写线程通过CAS抢占写位置，单个读线程按顺序消费，不需要加锁
+ * 队列满时try_emplace返回false，由调用方决定自旋等待还是丢弃
+ */
+#pragma once
+#include <atomic>
+#include <new>
+#include <utility>
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define MPSC_CACHELINE	64
+
+inline void mpsc_cpu_relax()
+{
+#ifdef _MSC_VER
+	_mm_pause();
+#else
+	__builtin_ia32_pause();
+#endif
+}
+
+template <typename T>
+class MpscQueue
+{
+private:
+	struct Cell
+	{
+		std::atomic<uint64_t>	_seq;
+		alignas(T) char			_data[sizeof(T)];
+
+		inline T* item() { return reinterpret_cast<T*>(_data); }
+	};
+
+public:
+	MpscQueue(uint64_t capacity = 16384)
+	{
+		uint64_t cap = 2;
+		while (cap < capacity)
+			cap <<= 1;
+
+		_mask = cap - 1;
+		_cells = new Cell[cap];
+		for (uint64_t i = 0; i < cap; i++)
+			_cells[i]._seq.store(i, std::memory_order_relaxed);
+
+		_head.store(0, std::memory_order_relaxed);
+		_tail = 0;
+	}
+
+	~MpscQueue()
+	{
+		//把没消费的数据析构掉
+		consume([](T&) {});
+		delete[] _cells;
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+public:
+	/*
+	 *	写入一条数据，多个线程可以同时调用
+	 *	队列满了返回false
+	 */
+	template <typename... Args>
+	inline bool try_emplace(Args&&... args)
+	{
+		uint64_t pos = _head.load(std::memory_order_relaxed);
+		Cell* cell = NULL;
+		for (;;)
+		{
+			cell = &_cells[pos & _mask];
+			uint64_t seq = cell->_seq.load(std::memory_order_acquire);
+			int64_t diff = (int64_t)seq - (int64_t)pos;
+			if (diff == 0)
+			{
+				if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				//槽位还没被读线程释放，说明队列满了
+				return false;
+			}
+			else
+			{
+				pos = _head.load(std::memory_order_relaxed);
+			}
+		}
+
+		new(cell->_data) T(std::forward<Args>(args)...);
+		cell->_seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*
+	 *	消费数据，只能由读线程调用
+	 *	handler(T&)处理完以后数据会被析构，max_cnt为0则一直消费到队列为空
+	 *	返回本次消费的条数
+	 */
+	template <typename Handler>
+	inline uint64_t consume(Handler handler, uint64_t max_cnt = 0)
+	{
+		uint64_t cnt = 0;
+		while (max_cnt == 0 || cnt < max_cnt)
+		{
+			Cell* cell = &_cells[_tail & _mask];
+			uint64_t seq = cell->_seq.load(std::memory_order_acquire);
+			if (seq != _tail + 1)
+				break;
+
+			T* item = cell->item();
+			handler(*item);
+			item->~T();
+			cell->_seq.store(_tail + _mask + 1, std::memory_order_release);
+			_tail++;
+			cnt++;
+		}
+
+		return cnt;
+	}
+
+	/*
+	 *	队列是否为空，只有读线程调用时结果才是准确的
+	 */
+	inline bool empty() const
+	{
+		const Cell* cell = &_cells[_tail & _mask];
+		return cell->_seq.load(std::memory_order_acquire) != _tail + 1;
+	}
+
+	inline uint64_t capacity() const { return _mask + 1; }
+
+private:
+	Cell*		_cells;
+	uint64_t	_mask;
+
+	alignas(MPSC_CACHELINE) std::atomic<uint64_t>	_head;	//写位置，多个写线程竞争
+	alignas(MPSC_CACHELINE) uint64_t				_tail;	//读位置，只有读线程访问
+};
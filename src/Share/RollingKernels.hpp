@@ -0,0 +1,321 @@
+﻿/*!
+ * \file RollingKernels.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 连续double数组上的滚动指标计算
+ *
+ * 输入是按列抽取出来的连续数组（如WTSKlineSlice::extractData返回的数组），输出数组和输入等长
+ * 窗口还没填满的位置输出INVALID_DOUBLE，输入里不能有INVALID_DOUBLE
+ * 逐元素的部分和窗口求和用SIMD实现，编译时打开了AVX2就用AVX2，否则用SSE2，都没有则退化成标量
+ */
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include "../Includes/WTSMarcos.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RK_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RK_USE_SSE2
+#endif
+
+class RollingKernels
+{
+public:
+	/*
+	 *	简单移动平均
+	 */
+	static void sma(const double* src, double* dst, std::size_t cnt, uint32_t period)
+	{
+		if (!prepare(dst, cnt, period))
+			return;
+
+		rolling_sum(src, dst, cnt, period);
+		scale(dst + period - 1, cnt - period + 1, 1.0 / period);
+	}
+
+	/*
+	 *	指数移动平均，alpha为2/(period+1)，第一个值用前period个数据的简单平均
+	 */
+	static void ema(const double* src, double* dst, std::size_t cnt, uint32_t period)
+	{
+		if (!prepare(dst, cnt, period))
+			return;
+
+		double alpha = 2.0 / (period + 1);
+		double val = sum(src, period) / period;
+		dst[period - 1] = val;
+		for (std::size_t i = period; i < cnt; i++)
+		{
+			val += alpha * (src[i] - val);
+			dst[i] = val;
+		}
+	}
+
+	/*
+	 *	滚动最大值，单调队列，每个数据只进出队列一次
+	 */
+	static void rolling_max(const double* src, double* dst, std::size_t cnt, uint32_t period)
+	{
+		rolling_extreme(src, dst, cnt, period, true);
+	}
+
+	/*
+	 *	滚动最小值
+	 */
+	static void rolling_min(const double* src, double* dst, std::size_t cnt, uint32_t period)
+	{
+		rolling_extreme(src, dst, cnt, period, false);
+	}
+
+	/*
+	 *	滚动标准差（总体标准差）
+	 */
+	static void stddev(const double* src, double* dst, std::size_t cnt, uint32_t period)
+	{
+		if (!prepare(dst, cnt, period))
+			return;
+
+		//窗口均值和窗口平方和都用滚动求和算出来，然后逐元素算方差
+		std::vector<double> sq(cnt);
+		square(src, sq.data(), cnt);
+
+		std::vector<double> sqSum(cnt);
+		rolling_sum(src, dst, cnt, period);
+		rolling_sum(sq.data(), sqSum.data(), cnt, period);
+		finish_stddev(dst + period - 1, sqSum.data() + period - 1, cnt - period + 1, period);
+	}
+
+	/*
+	 *	真实波幅，第一根K线没有昨收，取最高价减最低价
+	 */
+	static void true_range(const double* high, const double* low, const double* close, double* dst, std::size_t cnt)
+	{
+		if (cnt == 0)
+			return;
+
+		dst[0] = high[0] - low[0];
+		std::size_t i = 1;
+#if defined(RK_USE_AVX2)
+		const __m256d signMask = _mm256_set1_pd(-0.0);
+		for (; i + 4 <= cnt; i += 4)
+		{
+			__m256d h = _mm256_loadu_pd(high + i);
+			__m256d l = _mm256_loadu_pd(low + i);
+			__m256d pc = _mm256_loadu_pd(close + i - 1);
+			__m256d r = _mm256_sub_pd(h, l);
+			r = _mm256_max_pd(r, _mm256_andnot_pd(signMask, _mm256_sub_pd(h, pc)));
+			r = _mm256_max_pd(r, _mm256_andnot_pd(signMask, _mm256_sub_pd(l, pc)));
+			_mm256_storeu_pd(dst + i, r);
+		}
+#elif defined(RK_USE_SSE2)
+		const __m128d signMask = _mm_set1_pd(-0.0);
+		for (; i + 2 <= cnt; i += 2)
+		{
+			__m128d h = _mm_loadu_pd(high + i);
+			__m128d l = _mm_loadu_pd(low + i);
+			__m128d pc = _mm_loadu_pd(close + i - 1);
+			__m128d r = _mm_sub_pd(h, l);
+			r = _mm_max_pd(r, _mm_andnot_pd(signMask, _mm_sub_pd(h, pc)));
+			r = _mm_max_pd(r, _mm_andnot_pd(signMask, _mm_sub_pd(l, pc)));
+			_mm_storeu_pd(dst + i, r);
+		}
+#endif
+		for (; i < cnt; i++)
+		{
+			double r = high[i] - low[i];
+			double a = fabs(high[i] - close[i - 1]);
+			double b = fabs(low[i] - close[i - 1]);
+			if (a > r) r = a;
+			if (b > r) r = b;
+			dst[i] = r;
+		}
+	}
+
+	/*
+	 *	平均真实波幅，Wilder平滑，第一个值用前period个真实波幅的简单平均
+	 */
+	static void atr(const double* high, const double* low, const double* close, double* dst, std::size_t cnt, uint32_t period)
+	{
+		if (!prepare(dst, cnt, period))
+			return;
+
+		std::vector<double> tr(cnt);
+		true_range(high, low, close, tr.data(), cnt);
+
+		double val = sum(tr.data(), period) / period;
+		dst[period - 1] = val;
+		for (std::size_t i = period; i < cnt; i++)
+		{
+			val = (val * (period - 1) + tr[i]) / period;
+			dst[i] = val;
+		}
+	}
+
+	/*
+	 *	数组求和
+	 */
+	static double sum(const double* src, std::size_t cnt)
+	{
+		std::size_t i = 0;
+		double ret = 0;
+#if defined(RK_USE_AVX2)
+		__m256d acc = _mm256_setzero_pd();
+		for (; i + 4 <= cnt; i += 4)
+			acc = _mm256_add_pd(acc, _mm256_loadu_pd(src + i));
+		alignas(32) double lanes[4];
+		_mm256_store_pd(lanes, acc);
+		ret = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(RK_USE_SSE2)
+		__m128d acc = _mm_setzero_pd();
+		for (; i + 2 <= cnt; i += 2)
+			acc = _mm_add_pd(acc, _mm_loadu_pd(src + i));
+		alignas(16) double lanes[2];
+		_mm_store_pd(lanes, acc);
+		ret = lanes[0] + lanes[1];
+#endif
+		for (; i < cnt; i++)
+			ret += src[i];
+		return ret;
+	}
+
+private:
+	/*
+	 *	检查参数，并把窗口没填满的位置填上INVALID_DOUBLE
+	 *	数据不够一个窗口的时候全部为INVALID_DOUBLE，返回false
+	 */
+	static inline bool prepare(double* dst, std::size_t cnt, uint32_t period)
+	{
+		if (period == 0 || cnt == 0)
+			return false;
+
+		std::size_t head = (period - 1 < cnt) ? (period - 1) : cnt;
+		for (std::size_t i = 0; i < head; i++)
+			dst[i] = INVALID_DOUBLE;
+
+		return cnt >= period;
+	}
+
+	/*
+	 *	滚动求和，结果写在窗口的最后一个位置上
+	 *	每过一个窗口重新精确求和一次，避免增量累加的误差越积越大
+	 */
+	static void rolling_sum(const double* src, double* dst, std::size_t cnt, uint32_t period)
+	{
+		double s = 0;
+		for (std::size_t i = period - 1; i < cnt; i++)
+		{
+			if ((i + 1) % period == 0)
+				s = sum(src + i + 1 - period, period);
+			else
+				s += src[i] - src[i - period];
+			dst[i] = s;
+		}
+	}
+
+	static void scale(double* data, std::size_t cnt, double factor)
+	{
+		std::size_t i = 0;
+#if defined(RK_USE_AVX2)
+		__m256d f = _mm256_set1_pd(factor);
+		for (; i + 4 <= cnt; i += 4)
+			_mm256_storeu_pd(data + i, _mm256_mul_pd(_mm256_loadu_pd(data + i), f));
+#elif defined(RK_USE_SSE2)
+		__m128d f = _mm_set1_pd(factor);
+		for (; i + 2 <= cnt; i += 2)
+			_mm_storeu_pd(data + i, _mm_mul_pd(_mm_loadu_pd(data + i), f));
+#endif
+		for (; i < cnt; i++)
+			data[i] *= factor;
+	}
+
+	static void square(const double* src, double* dst, std::size_t cnt)
+	{
+		std::size_t i = 0;
+#if defined(RK_USE_AVX2)
+		for (; i + 4 <= cnt; i += 4)
+		{
+			__m256d v = _mm256_loadu_pd(src + i);
+			_mm256_storeu_pd(dst + i, _mm256_mul_pd(v, v));
+		}
+#elif defined(RK_USE_SSE2)
+		for (; i + 2 <= cnt; i += 2)
+		{
+			__m128d v = _mm_loadu_pd(src + i);
+			_mm_storeu_pd(dst + i, _mm_mul_pd(v, v));
+		}
+#endif
+		for (; i < cnt; i++)
+			dst[i] = src[i] * src[i];
+	}
+
+	/*
+	 *	sums为窗口和，计算完以后替换成标准差，sqSums为窗口平方和
+	 */
+	static void finish_stddev(double* sums, const double* sqSums, std::size_t cnt, uint32_t period)
+	{
+		double inv = 1.0 / period;
+		std::size_t i = 0;
+#if defined(RK_USE_AVX2)
+		__m256d vInv = _mm256_set1_pd(inv);
+		__m256d zero = _mm256_setzero_pd();
+		for (; i + 4 <= cnt; i += 4)
+		{
+			__m256d mean = _mm256_mul_pd(_mm256_loadu_pd(sums + i), vInv);
+			__m256d var = _mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(sqSums + i), vInv), _mm256_mul_pd(mean, mean));
+			_mm256_storeu_pd(sums + i, _mm256_sqrt_pd(_mm256_max_pd(var, zero)));
+		}
+#elif defined(RK_USE_SSE2)
+		__m128d vInv = _mm_set1_pd(inv);
+		__m128d zero = _mm_setzero_pd();
+		for (; i + 2 <= cnt; i += 2)
+		{
+			__m128d mean = _mm_mul_pd(_mm_loadu_pd(sums + i), vInv);
+			__m128d var = _mm_sub_pd(_mm_mul_pd(_mm_loadu_pd(sqSums + i), vInv), _mm_mul_pd(mean, mean));
+			_mm_storeu_pd(sums + i, _mm_sqrt_pd(_mm_max_pd(var, zero)));
+		}
+#endif
+		for (; i < cnt; i++)
+		{
+			double mean = sums[i] * inv;
+			double var = sqSums[i] * inv - mean * mean;
+			sums[i] = sqrt(var > 0 ? var : 0);
+		}
+	}
+
+	static void rolling_extreme(const double* src, double* dst, std::size_t cnt, uint32_t period, bool isMax)
+	{
+		if (!prepare(dst, cnt, period))
+			return;
+
+		//环形缓冲区做单调队列，队列里最多period个下标
+		std::vector<std::size_t> que(period);
+		std::size_t head = 0, tail = 0;	//tail-head为队列长度
+		for (std::size_t i = 0; i < cnt; i++)
+		{
+			//先把滑出窗口的下标出队，保证入队以后队列长度不超过period
+			if (tail > head && que[head % period] + period <= i)
+				head++;
+
+			double v = src[i];
+			while (tail > head)
+			{
+				double last = src[que[(tail - 1) % period]];
+				if (isMax ? (last > v) : (last < v))
+					break;
+				tail--;
+			}
+			que[tail % period] = i;
+			tail++;
+
+			if (i + 1 >= period)
+				dst[i] = src[que[head % period]];
+		}
+	}
+};
@@ -0,0 +1,304 @@
+﻿/*!
+ * \file ShmQuoteBus.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 共享内存行情总线，一个写端（datakit），任意多个读端（各个交易进程）
+ *
+ * 布局：头部 + 按合约分配的tick快照槽位 + 事件队列（SpmcRing）
+ * 每个合约占一个快照槽位，槽位带一个seqlock戳，写入时为奇数，写完以后为偶数，戳/2就是快照的版本号
+ * tick只写到快照槽位里，事件队列里只放槽位编号和版本号；委托队列、逐笔委托、逐笔成交直接放在事件队列里
+ * 读端按槽位编号过滤合约，收到tick事件以后直接从快照槽位拷贝最新的数据
+ * 读端处理不过来时，同一个合约的多笔tick会被合并成最新的一笔，而不会读到撕裂的数据
+ */
+#pragma once
+#include "SpmcRing.hpp"
+#include "../Includes/WTSStruct.h"
+
+USING_NS_WTP;
+
+#define SHM_BUS_MAGIC		0x53554257	//"WBUS"
+#define SHM_BUS_VERSION		1
+#define SHM_BUS_CODE_LEN	(MAX_EXCHANGE_LENGTH + MAX_INSTRUMENT_LENGTH)
+#define SHM_BUS_READ_SPINS	65536	//读快照的最大重试次数，超过了认为写端卡在写的过程中
+
+struct ShmQuoteBus
+{
+	struct alignas(SPMC_CACHELINE) Header
+	{
+		uint32_t	_magic;
+		uint32_t	_version;
+		uint32_t	_tick_size;
+		uint32_t	_event_size;
+		uint32_t	_pid;
+		uint32_t	_max_slots;
+		uint64_t	_epoch;			//写端每次初始化的时间戳，读端用来判断写端是否重启过
+		uint64_t	_ring_offset;	//事件队列相对于头部的偏移量
+
+		//已经分配的快照槽位数，单独占一个cache line
+		alignas(SPMC_CACHELINE) std::atomic<uint32_t>	_slot_count;
+	};
+
+	struct alignas(SPMC_CACHELINE) TickSlot
+	{
+		std::atomic<uint64_t>	_stamp;
+		char					_fullcode[SHM_BUS_CODE_LEN];	//exchg.code，分配槽位的时候写入，之后不再修改
+		WTSTickStruct			_tick;
+	};
+
+#pragma pack(push, 8)
+	typedef struct _BusEvent
+	{
+		uint32_t	_type;		//数据类型， 0-tick,1-委托队列,2-逐笔委托,3-逐笔成交
+		uint32_t	_slot;		//合约的槽位编号
+		uint64_t	_version;	//tick快照的版本号，其他数据无效
+		union
+		{
+			WTSOrdQueStruct _queue;
+			WTSOrdDtlStruct	_order;
+			WTSTransStruct	_trans;
+		};
+
+		//_queue是联合体里最大的，它的构造函数会把整块清零
+		_BusEvent() : _type(0), _slot(0), _version(0), _queue() {}
+	} BusEvent;
+#pragma pack(pop)
+
+	static_assert(sizeof(WTSOrdQueStruct) >= sizeof(WTSOrdDtlStruct) && sizeof(WTSOrdQueStruct) >= sizeof(WTSTransStruct), "_queue must be the largest member of BusEvent");
+
+	typedef SpmcRing<BusEvent>	EventRing;
+
+	static inline std::size_t ring_offset(uint32_t maxSlots)
+	{
+		return sizeof(Header) + sizeof(TickSlot)*maxSlots;
+	}
+
+	/*
+	 *	整块内存的大小
+	 */
+	static inline std::size_t calc_size(uint32_t maxSlots, uint64_t capacity)
+	{
+		return ring_offset(maxSlots) + EventRing::calc_size(capacity);
+	}
+
+	static inline TickSlot* slots(Header* header)
+	{
+		return (TickSlot*)((char*)header + sizeof(Header));
+	}
+};
+
+/*
+ *	写端，一条总线只能有一个写端，多个线程写的时候由调用方加锁
+ */
+class ShmQuoteBusWriter
+{
+	typedef ShmQuoteBus::Header		Header;
+	typedef ShmQuoteBus::TickSlot	TickSlot;
+	typedef ShmQuoteBus::BusEvent	BusEvent;
+
+public:
+	ShmQuoteBusWriter() :_header(NULL), _slots(NULL) {}
+
+	/*
+	 *	在addr上初始化总线，addr至少要有ShmQuoteBus::calc_size(maxSlots, capacity)那么大
+	 */
+	bool init(void* addr, uint32_t maxSlots, uint64_t capacity, uint32_t pid, uint64_t epoch)
+	{
+		if (addr == NULL || maxSlots == 0 || capacity == 0)
+			return false;
+
+		capacity = ShmQuoteBus::EventRing::round_capacity(capacity);
+		memset(addr, 0, ShmQuoteBus::ring_offset(maxSlots));
+
+		_header = new(addr) Header();
+		_header->_magic = SHM_BUS_MAGIC;
+		_header->_version = SHM_BUS_VERSION;
+		_header->_tick_size = sizeof(WTSTickStruct);
+		_header->_event_size = sizeof(BusEvent);
+		_header->_pid = pid;
+		_header->_max_slots = maxSlots;
+		_header->_epoch = epoch;
+		_header->_ring_offset = ShmQuoteBus::ring_offset(maxSlots);
+		_header->_slot_count.store(0, std::memory_order_relaxed);
+
+		_slots = ShmQuoteBus::slots(_header);
+		for (uint32_t i = 0; i < maxSlots; i++)
+			new(&_slots[i]._stamp) std::atomic<uint64_t>(0);
+
+		return _ring.init((char*)addr + _header->_ring_offset, capacity, pid, epoch);
+	}
+
+	/*
+	 *	分配一个快照槽位，槽位用完了返回UINT32_MAX
+	 */
+	inline uint32_t add_slot(const char* fullcode)
+	{
+		uint32_t idx = _header->_slot_count.load(std::memory_order_relaxed);
+		if (idx >= _header->_max_slots)
+			return UINT32_MAX;
+
+		strncpy(_slots[idx]._fullcode, fullcode, SHM_BUS_CODE_LEN - 1);
+		_header->_slot_count.store(idx + 1, std::memory_order_release);
+		return idx;
+	}
+
+	/*
+	 *	更新快照并发布一条tick事件
+	 */
+	inline void publish_tick(uint32_t slot, const WTSTickStruct& tick)
+	{
+		TickSlot& ts = _slots[slot];
+		uint64_t stamp = ts._stamp.load(std::memory_order_relaxed);
+		ts._stamp.store(stamp + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(&ts._tick, &tick, sizeof(WTSTickStruct));
+		ts._stamp.store(stamp + 2, std::memory_order_release);
+
+		uint64_t version = (stamp + 2) / 2;
+		_ring.push([slot, version](BusEvent& evt) {
+			evt._type = 0;
+			evt._slot = slot;
+			evt._version = version;
+		});
+	}
+
+	/*
+	 *	发布一条其他类型的事件，filler(BusEvent&)负责填充数据
+	 */
+	template <typename Filler>
+	inline void publish_event(uint32_t type, uint32_t slot, Filler filler)
+	{
+		_ring.push([type, slot, &filler](BusEvent& evt) {
+			evt._type = type;
+			evt._slot = slot;
+			evt._version = 0;
+			filler(evt);
+		});
+	}
+
+	inline uint32_t	slot_count() const { return _header->_slot_count.load(std::memory_order_relaxed); }
+	inline uint32_t	max_slots() const { return _header->_max_slots; }
+	inline uint64_t	capacity() const { return _ring.capacity(); }
+
+private:
+	Header*		_header;
+	TickSlot*	_slots;
+	SpmcRingWriter<BusEvent>	_ring;
+};
+
+/*
+ *	读端，每个读端自己维护读的位置，互不影响
+ */
+class ShmQuoteBusReader
+{
+	typedef ShmQuoteBus::Header		Header;
+	typedef ShmQuoteBus::TickSlot	TickSlot;
+
+public:
+	typedef ShmQuoteBus::BusEvent			BusEvent;
+	typedef SpmcRingReader<BusEvent>		EventReader;
+	typedef EventReader::ReadState			ReadState;
+
+public:
+	ShmQuoteBusReader() :_header(NULL), _slots(NULL), _epoch(0) {}
+
+	/*
+	 *	挂到已经初始化好的总线上，size为映射的内存大小
+	 *	from_latest为true则从最新的位置开始读事件，否则从队列里最老的事件开始读
+	 */
+	bool attach(void* addr, std::size_t size, bool from_latest = true)
+	{
+		Header* header = (Header*)addr;
+		if (header == NULL || size < sizeof(Header) || header->_magic != SHM_BUS_MAGIC || header->_version != SHM_BUS_VERSION
+			|| header->_tick_size != sizeof(WTSTickStruct) || header->_event_size != sizeof(BusEvent))
+			return false;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (size < header->_ring_offset + sizeof(ShmQuoteBus::EventRing::Header))
+			return false;
+
+		char* ringAddr = (char*)addr + header->_ring_offset;
+		if (!_ring.attach(ringAddr, from_latest))
+			return false;
+
+		if (size < header->_ring_offset + ShmQuoteBus::EventRing::calc_size(_ring.capacity()))
+			return false;
+
+		_header = header;
+		_slots = ShmQuoteBus::slots(header);
+		_epoch = header->_epoch;
+		return true;
+	}
+
+	/*
+	 *	写端是否已经重新初始化了总线
+	 */
+	inline bool is_reset() const
+	{
+		return _header->_epoch != _epoch || _ring.is_reset();
+	}
+
+	inline uint32_t	slot_count() const { return _header->_slot_count.load(std::memory_order_acquire); }
+	inline uint32_t	max_slots() const { return _header->_max_slots; }
+	inline const char* slot_code(uint32_t slot) const { return _slots[slot]._fullcode; }
+
+	/*
+	 *	快照的最新版本号，还没有写入过则为0
+	 */
+	inline uint64_t tick_version(uint32_t slot) const
+	{
+		return _slots[slot]._stamp.load(std::memory_order_acquire) / 2;
+	}
+
+	/*
+	 *	读取快照，直接拷贝到调用方提供的结构体里
+	 *	还没有写入过返回false
+	 *	写端写到一半退出了，版本号会一直停在奇数上，重试SHM_BUS_READ_SPINS次还读不到也返回false
+	 */
+	inline bool read_tick(uint32_t slot, WTSTickStruct& tick, uint64_t& version) const
+	{
+		const TickSlot& ts = _slots[slot];
+		for (uint32_t i = 0; i < SHM_BUS_READ_SPINS; i++)
+		{
+			uint64_t s1 = ts._stamp.load(std::memory_order_acquire);
+			if (s1 & 1)
+			{
+				spmc_cpu_relax();
+				continue;
+			}
+
+			if (s1 == 0)
+				return false;
+
+			memcpy((void*)&tick, (const void*)&ts._tick, sizeof(WTSTickStruct));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (ts._stamp.load(std::memory_order_relaxed) == s1)
+			{
+				version = s1 / 2;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/*
+	 *	读取一条事件，lost返回本次跳过的事件条数
+	 */
+	inline ReadState read_event(BusEvent& evt, uint64_t& lost)
+	{
+		return _ring.read(evt, lost);
+	}
+
+	inline uint64_t	capacity() const { return _ring.capacity(); }
+	inline uint64_t	total_lost() const { return _ring.total_lost(); }
+	inline uint32_t	writer_pid() const { return _header->_pid; }
+
+private:
+	Header*			_header;
+	const TickSlot*	_slots;
+	uint64_t		_epoch;
+	EventReader		_ring;
+};
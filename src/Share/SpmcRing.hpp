@@ -0,0 +1,282 @@
+﻿/*!
+ * \file SpmcRing.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 单写多读的环形队列，可以直接构建在共享内存（内存映射文件）上
+ *
+ * 布局：头部 + 2^n个槽位，写游标和每个槽位都按cache line对齐
+ * 每个槽位都带一个seqlock戳，序号为seq的数据写入时戳为2*seq+1，写完以后为2*seq+2
+ * 读端拷贝数据前后各检查一次戳，戳不一致说明被写端覆盖了（读端太慢）
+ * 这时读端会跳过丢失的数据并报告丢失的条数，而不会读到撕裂的数据
+ */
+#pragma once
+#include <atomic>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define SPMC_RING_MAGIC		0x47524D53	//"SMRG"
+#define SPMC_RING_VERSION	1
+#define SPMC_CACHELINE		64
+
+inline void spmc_cpu_relax()
+{
+#ifdef _MSC_VER
+	_mm_pause();
+#else
+	__builtin_ia32_pause();
+#endif
+}
+
+template <typename T>
+struct SpmcRing
+{
+	struct alignas(SPMC_CACHELINE) Header
+	{
+		uint32_t	_magic;
+		uint32_t	_version;
+		uint32_t	_item_size;
+		uint32_t	_pid;
+		uint64_t	_capacity;
+		uint64_t	_mask;
+		uint64_t	_epoch;		//写端每次初始化的时间戳，读端用来判断写端是否重启过
+
+		//下一个要写入的序号，即已经发布的数据条数，单独占一个cache line
+		alignas(SPMC_CACHELINE) std::atomic<uint64_t>	_cursor;
+	};
+
+	struct alignas(SPMC_CACHELINE) Slot
+	{
+		std::atomic<uint64_t>	_stamp;
+		T						_data;
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "64bit atomic must be lock free to live in shared memory");
+
+	/*
+	 *	将容量向上取整到2的幂
+	 */
+	static uint64_t round_capacity(uint64_t capacity)
+	{
+		uint64_t ret = 1;
+		while (ret < capacity)
+			ret <<= 1;
+		return ret;
+	}
+
+	/*
+	 *	容量为capacity时整块内存的大小
+	 */
+	static std::size_t calc_size(uint64_t capacity)
+	{
+		return sizeof(Header) + sizeof(Slot)*round_capacity(capacity);
+	}
+
+	static inline Slot* slots(Header* header)
+	{
+		return (Slot*)((char*)header + sizeof(Header));
+	}
+};
+
+/*
+ *	写端，一个队列只能有一个写端
+ */
+template <typename T>
+class SpmcRingWriter
+{
+	typedef SpmcRing<T>					Ring;
+	typedef typename Ring::Header		Header;
+	typedef typename Ring::Slot			Slot;
+
+public:
+	SpmcRingWriter() :_header(NULL), _slots(NULL), _mask(0), _next(0) {}
+
+	/*
+	 *	在addr上初始化一个新队列，addr至少要有Ring::calc_size(capacity)那么大
+	 */
+	bool init(void* addr, uint64_t capacity, uint32_t pid, uint64_t epoch)
+	{
+		if (addr == NULL || capacity == 0)
+			return false;
+
+		capacity = Ring::round_capacity(capacity);
+		memset(addr, 0, Ring::calc_size(capacity));
+
+		_header = new(addr) Header();
+		_header->_magic = SPMC_RING_MAGIC;
+		_header->_version = SPMC_RING_VERSION;
+		_header->_item_size = sizeof(T);
+		_header->_pid = pid;
+		_header->_capacity = capacity;
+		_header->_mask = capacity - 1;
+		_header->_epoch = epoch;
+		_header->_cursor.store(0, std::memory_order_relaxed);
+
+		_slots = Ring::slots(_header);
+		for (uint64_t i = 0; i < capacity; i++)
+			new(&_slots[i]._stamp) std::atomic<uint64_t>(0);
+
+		_mask = capacity - 1;
+		_next = 0;
+		std::atomic_thread_fence(std::memory_order_release);
+		return true;
+	}
+
+	/*
+	 *	写入一条数据
+	 *	filler(T&)负责填充数据，直接写到槽位里，避免多一次拷贝
+	 */
+	template <typename Filler>
+	inline void push(Filler filler)
+	{
+		uint64_t seq = _next++;
+		Slot& slot = _slots[seq & _mask];
+		slot._stamp.store(2 * seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		filler(slot._data);
+		slot._stamp.store(2 * seq + 2, std::memory_order_release);
+		_header->_cursor.store(seq + 1, std::memory_order_release);
+	}
+
+	inline uint64_t	capacity() const { return _mask + 1; }
+	inline uint64_t	written() const { return _next; }
+
+private:
+	Header*		_header;
+	Slot*		_slots;
+	uint64_t	_mask;
+	uint64_t	_next;
+};
+
+/*
+ *	读端，每个读端自己维护读的位置，互不影响
+ */
+template <typename T>
+class SpmcRingReader
+{
+	typedef SpmcRing<T>					Ring;
+	typedef typename Ring::Header		Header;
+	typedef typename Ring::Slot			Slot;
+
+public:
+	typedef enum tagReadState
+	{
+		RS_Empty = 0,	//没有新数据，跳过了被覆盖的数据但是后面没有可读的数据时也返回这个，lost大于0
+		RS_OK,			//读到一条数据
+		RS_Overrun		//读端太慢，有数据被覆盖了，丢失的条数通过lost返回，同时也读到了一条数据
+	} ReadState;
+
+public:
+	SpmcRingReader() :_header(NULL), _slots(NULL), _mask(0), _next(0), _epoch(0), _lost(0) {}
+
+	/*
+	 *	挂到已经初始化好的队列上
+	 *	from_latest为true则从最新的位置开始读，否则从队列里最老的数据开始读
+	 */
+	bool attach(void* addr, bool from_latest = true)
+	{
+		Header* header = (Header*)addr;
+		if (header == NULL || header->_magic != SPMC_RING_MAGIC || header->_version != SPMC_RING_VERSION
+			|| header->_item_size != sizeof(T))
+			return false;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		_header = header;
+		_slots = Ring::slots(header);
+		_mask = header->_mask;
+		_epoch = header->_epoch;
+		uint64_t cursor = header->_cursor.load(std::memory_order_acquire);
+		if (from_latest)
+			_next = cursor;
+		else
+			_next = (cursor > capacity()) ? (cursor - capacity()) : 0;
+		return true;
+	}
+
+	/*
+	 *	写端是否已经重新初始化了队列
+	 */
+	inline bool is_reset() const
+	{
+		return _header->_epoch != _epoch;
+	}
+
+	/*
+	 *	读取一条数据，数据拷贝到item中，只有返回RS_OK和RS_Overrun的时候item才有效
+	 *	lost返回本次跳过的数据条数，返回RS_Empty的时候也可能大于0
+	 */
+	inline ReadState read(T& item, uint64_t& lost)
+	{
+		lost = 0;
+		for (;;)
+		{
+			uint64_t cursor = _header->_cursor.load(std::memory_order_acquire);
+			if (_next >= cursor)
+			{
+				_lost += lost;
+				return RS_Empty;
+			}
+
+			//已经落后超过一圈了，直接跳到最老的有效数据
+			if (cursor - _next > capacity())
+			{
+				uint64_t newNext = cursor - capacity();
+				lost += newNext - _next;
+				_next = newNext;
+			}
+
+			const Slot& slot = _slots[_next & _mask];
+			uint64_t expected = 2 * _next + 2;
+			uint64_t s1 = slot._stamp.load(std::memory_order_acquire);
+			if (s1 == expected)
+			{
+				memcpy((void*)&item, (const void*)&slot._data, sizeof(T));
+				std::atomic_thread_fence(std::memory_order_acquire);
+				uint64_t s2 = slot._stamp.load(std::memory_order_relaxed);
+				if (s2 == s1)
+				{
+					_next++;
+					_lost += lost;
+					return lost == 0 ? RS_OK : RS_Overrun;
+				}
+			}
+			else if (s1 < expected)
+			{
+				//游标是在戳之后发布的，正常不会走到这里，保险起见当作没有数据
+				_lost += lost;
+				return RS_Empty;
+			}
+
+			//读的过程中槽位被覆盖了，跳过这一条，下一轮再按游标重新定位
+			lost++;
+			_next++;
+		}
+	}
+
+	/*
+	 *	还没读的数据条数
+	 */
+	inline uint64_t	pending() const
+	{
+		uint64_t cursor = _header->_cursor.load(std::memory_order_acquire);
+		return cursor > _next ? (cursor - _next) : 0;
+	}
+
+	inline uint64_t	capacity() const { return _mask + 1; }
+	inline uint64_t	total_lost() const { return _lost; }
+	inline uint32_t	writer_pid() const { return _header->_pid; }
+
+private:
+	Header*			_header;
+	const Slot*		_slots;
+	uint64_t		_mask;
+	uint64_t		_next;
+	uint64_t		_epoch;
+	uint64_t		_lost;
+};
@@ -0,0 +1,135 @@
+﻿/*!
+ * \file SpscQueue.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 有界无锁单写单读队列
+ *
+ * 环形缓冲区，容量为2^n，写线程只修改写位置，读线程只修改读位置
+ * 两端各自缓存一份对端的位置，只有缓存的位置不够用时才去读对端的原子变量，减少cache line争用
+ * 读端可以在不同的线程之间转移，但是同一时刻只能有一个线程读，转移时要由调用方保证内存可见性
+ */
+#pragma once
+#include <atomic>
+#include <new>
+#include <utility>
+#include <stdint.h>
+
+#define SPSC_CACHELINE	64
+
+template <typename T>
+class SpscQueue
+{
+private:
+	struct Cell
+	{
+		alignas(T) char	_data[sizeof(T)];
+
+		inline T* item() { return reinterpret_cast<T*>(_data); }
+	};
+
+public:
+	SpscQueue(uint64_t capacity = 1024)
+	{
+		uint64_t cap = 2;
+		while (cap < capacity)
+			cap <<= 1;
+
+		_mask = cap - 1;
+		_cells = new Cell[cap];
+
+		_head.store(0, std::memory_order_relaxed);
+		_tail.store(0, std::memory_order_relaxed);
+		_cached_tail = 0;
+		_cached_head = 0;
+	}
+
+	~SpscQueue()
+	{
+		//把没消费的数据析构掉
+		consume([](T&) {});
+		delete[] _cells;
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+public:
+	/*
+	 *	写入一条数据，只能由写线程调用
+	 *	队列满了返回false
+	 */
+	template <typename... Args>
+	inline bool try_emplace(Args&&... args)
+	{
+		uint64_t pos = _head.load(std::memory_order_relaxed);
+		if (pos - _cached_tail > _mask)
+		{
+			_cached_tail = _tail.load(std::memory_order_acquire);
+			if (pos - _cached_tail > _mask)
+				return false;
+		}
+
+		new(_cells[pos & _mask]._data) T(std::forward<Args>(args)...);
+		_head.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*
+	 *	消费数据，只能由读线程调用
+	 *	handler(T&)处理完以后数据会被析构，max_cnt为0则一直消费到队列为空
+	 *	返回本次消费的条数
+	 */
+	template <typename Handler>
+	inline uint64_t consume(Handler handler, uint64_t max_cnt = 0)
+	{
+		uint64_t pos = _tail.load(std::memory_order_relaxed);
+		uint64_t cnt = 0;
+		while (max_cnt == 0 || cnt < max_cnt)
+		{
+			if (pos == _cached_head)
+			{
+				_cached_head = _head.load(std::memory_order_acquire);
+				if (pos == _cached_head)
+					break;
+			}
+
+			T* item = _cells[pos & _mask].item();
+			handler(*item);
+			item->~T();
+			pos++;
+			cnt++;
+
+			//每条都更新读位置，写端可以尽快复用槽位
+			_tail.store(pos, std::memory_order_release);
+		}
+
+		return cnt;
+	}
+
+	/*
+	 *	队列里的数据条数，两端都可以调用，其他线程调用时只是一个近似值
+	 */
+	inline uint64_t size() const
+	{
+		uint64_t tail = _tail.load(std::memory_order_acquire);
+		uint64_t head = _head.load(std::memory_order_acquire);
+		return head - tail;
+	}
+
+	inline bool empty() const { return size() == 0; }
+
+	inline uint64_t capacity() const { return _mask + 1; }
+
+private:
+	Cell*		_cells;
+	uint64_t	_mask;
+
+	alignas(SPSC_CACHELINE) std::atomic<uint64_t>	_head;			//写位置，只有写线程修改
+	uint64_t										_cached_tail;	//写线程缓存的读位置
+
+	alignas(SPSC_CACHELINE) std::atomic<uint64_t>	_tail;			//读位置，只有读线程修改
+	uint64_t										_cached_head;	//读线程缓存的写位置
+};
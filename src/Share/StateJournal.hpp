@@ -0,0 +1,551 @@
+﻿/*!
+ * \file StateJournal.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 策略状态的二进制日志
+ *
+ * 文件映射到内存，按(类型,键)保存状态记录，只追加不修改，同一个键的最后一条记录有效
+ * 写入的内容和当前有效的记录完全相同时不追加，所以每次保存只写发生变化的记录
+ * 一批记录写完以后commit才会更新文件头里的已提交长度，进程中途退出时没有提交的记录在重新打开时会被丢弃
+ * 每条记录带校验和，打开时遇到校验失败的记录就截断到这里
+ * 失效的记录越来越多时，由compact把有效的记录写到新文件再替换掉原文件
+ * 扩容或者整理失败以后日志不再可用，commit返回false，调用方要改用别的方式保存
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "BoostFile.hpp"
+#include "BoostMappingFile.hpp"
+
+#define STATE_JOURNAL_MAGIC		0x4A535457	//"WTSJ"
+#define STATE_JOURNAL_VERSION	1
+
+class StateJournal
+{
+public:
+	/*
+	 *	文件头，补齐到64字节
+	 */
+	typedef struct _JournalHeader
+	{
+		uint32_t	_magic;
+		uint32_t	_version;
+		uint32_t	_schema;		//记录格式的版本，由调用方指定，和文件里的不一致则丢弃原有的记录
+		uint32_t	_reserved;
+		uint64_t	_committed;		//已经提交的记录的总字节数
+		char		_padding[40];
+	} JournalHeader;
+
+	static_assert(sizeof(JournalHeader) == 64, "size of JournalHeader must be 64");
+
+	/*
+	 *	记录头，后面依次是以0结尾的键和数据，数据按8字节对齐
+	 */
+	typedef struct _RecordHeader
+	{
+		uint32_t	_size;			//整条记录的大小，按8字节对齐
+		uint16_t	_type;
+		uint16_t	_deleted;		//删除记录，没有数据
+		uint32_t	_key_len;		//键的长度，不含结尾的0
+		uint32_t	_data_len;
+		uint32_t	_checksum;		//键和数据的校验和
+		uint32_t	_reserved;
+	} RecordHeader;
+
+	static_assert(sizeof(RecordHeader) == 24, "size of RecordHeader must be 24");
+
+private:
+	typedef struct _IndexItem
+	{
+		uint64_t	_offset;
+		uint32_t	_gen;
+		uint16_t	_type;
+	} IndexItem;
+
+	typedef std::unordered_map<std::string, IndexItem> IndexMap;
+
+public:
+	StateJournal() :_header(NULL), _schema(0), _init_size(0), _tail(0), _live_bytes(0), _gen(0), _fresh(true), _failed(false) {}
+
+	/*
+	 *	打开日志文件，文件不存在或者格式不一致时新建一个空的日志
+	 *	格式不一致的原文件会被改名为filename.bak
+	 */
+	bool open(const char* filename, uint32_t schema, uint64_t initSize = 1024 * 1024)
+	{
+		_filename = filename;
+		_schema = schema;
+		_init_size = initSize;
+		_fresh = true;
+		_failed = false;
+
+		if (BoostFile::exists(filename) && map_file() && check_header())
+		{
+			replay();
+			_fresh = _index.empty();
+			return true;
+		}
+
+		if (_mapfile)
+		{
+			_mapfile.reset();
+			std::string bakFile = _filename + ".bak";
+			boost::system::error_code ec;
+			boost::filesystem::rename(_filename, bakFile, ec);
+		}
+
+		return create_file(_filename.c_str(), initSize) && map_file() && check_header();
+	}
+
+	/*
+	 *	是否是新建的日志（或者打开的时候没有任何有效记录），调用方可以据此从旧格式的文件里导入数据
+	 */
+	inline bool is_fresh() const { return _fresh; }
+
+	/*
+	 *	日志是否可用，写入或者整理失败以后不再可用
+	 */
+	inline bool is_valid() const { return _header != NULL && !_failed; }
+
+	/*
+	 *	开始一批写入，之后put过的记录在sweep的时候会保留下来
+	 */
+	inline void begin() { _gen++; }
+
+	/*
+	 *	写入一条记录，和当前有效的记录内容相同则不写入
+	 *	返回是否真的追加了记录
+	 */
+	bool put(uint16_t type, const char* key, const void* data, uint32_t len)
+	{
+		if (_header == NULL)
+			return false;
+
+		make_key(type, key);
+		auto it = _index.find(_key_buf);
+		if (it != _index.end())
+		{
+			IndexItem& item = it->second;
+			const RecordHeader* rh = record_at(item._offset);
+			if (rh->_data_len == len && (len == 0 || memcmp(data_of(rh), data, len) == 0))
+			{
+				item._gen = _gen;
+				return false;
+			}
+		}
+
+		uint64_t offset = 0;
+		if (!append(type, key, data, len, false, offset))
+			return false;
+
+		if (it != _index.end())
+		{
+			_live_bytes -= record_at(it->second._offset)->_size;
+			it->second._offset = offset;
+			it->second._gen = _gen;
+		}
+		else
+		{
+			IndexItem& item = _index[_key_buf];
+			item._offset = offset;
+			item._gen = _gen;
+			item._type = type;
+		}
+
+		_live_bytes += record_at(offset)->_size;
+		return true;
+	}
+
+	/*
+	 *	删除一条记录
+	 */
+	bool remove(uint16_t type, const char* key)
+	{
+		if (_header == NULL)
+			return false;
+
+		make_key(type, key);
+		auto it = _index.find(_key_buf);
+		if (it == _index.end())
+			return false;
+
+		uint64_t offset = 0;
+		if (!append(type, key, NULL, 0, true, offset))
+			return false;
+
+		_live_bytes -= record_at(it->second._offset)->_size;
+		_index.erase(it);
+		return true;
+	}
+
+	/*
+	 *	删除本批次里没有put过的指定类型的记录
+	 *	调用方每次把某个类型的全部记录put一遍，再sweep一下，就能把已经不存在的记录删掉
+	 */
+	uint32_t sweep(uint16_t type)
+	{
+		if (_header == NULL)
+			return 0;
+
+		std::vector<std::string> keys;
+		for (auto& m : _index)
+		{
+			const IndexItem& item = m.second;
+			if (item._type == type && item._gen != _gen)
+				keys.emplace_back(m.first.substr(sizeof(uint16_t)));
+		}
+
+		for (const std::string& key : keys)
+			remove(type, key.c_str());
+
+		return (uint32_t)keys.size();
+	}
+
+	/*
+	 *	提交之前写入的记录
+	 *	日志已经不可用时返回false，这一批记录不会提交，避免只提交了一部分
+	 */
+	inline bool commit()
+	{
+		if (!is_valid())
+			return false;
+
+		std::atomic_thread_fence(std::memory_order_release);
+		_header->_committed = _tail;
+		return true;
+	}
+
+	/*
+	 *	遍历所有有效的记录，cb(uint16_t type, const char* key, const char* data, uint32_t len)
+	 *	按写入的先后顺序回调
+	 */
+	template<typename Callback>
+	void iterate(Callback cb) const
+	{
+		std::vector<uint64_t> offsets;
+		offsets.reserve(_index.size());
+		for (auto& m : _index)
+			offsets.emplace_back(m.second._offset);
+		std::sort(offsets.begin(), offsets.end());
+
+		for (uint64_t offset : offsets)
+		{
+			const RecordHeader* rh = record_at(offset);
+			cb(rh->_type, key_of(rh), data_of(rh), rh->_data_len);
+		}
+	}
+
+	/*
+	 *	失效的记录占了一半以上时，把有效的记录写到新文件里替换原文件
+	 *	只能在commit以后调用，force为true则不管失效记录多少都整理
+	 */
+	bool compact(bool force = false)
+	{
+		if (_header == NULL)
+			return false;
+
+		uint64_t committed = _header->_committed;
+		if (!force && (committed < 64 * 1024 || committed < _live_bytes * 2))
+			return false;
+
+		std::string tmpFile = _filename + ".tmp";
+		uint64_t capacity = std::max(_init_size, _live_bytes * 2);
+		std::vector<std::pair<uint64_t, std::string>> items;
+		items.reserve(_index.size());
+		for (auto& m : _index)
+			items.emplace_back(m.second._offset, m.first);
+		std::sort(items.begin(), items.end());
+
+		boost::system::error_code ec;
+		std::vector<uint64_t> newOffsets;
+		newOffsets.reserve(items.size());
+		{
+			BoostFile bf;
+			if (!bf.create_new_file(tmpFile.c_str()))
+				return false;
+
+			JournalHeader header;
+			memset(&header, 0, sizeof(header));
+			header._magic = STATE_JOURNAL_MAGIC;
+			header._version = STATE_JOURNAL_VERSION;
+			header._schema = _schema;
+			header._committed = _live_bytes;
+			bool bSucceed = bf.write_file(&header, sizeof(header));
+
+			uint64_t newOffset = 0;
+			for (auto& item : items)
+			{
+				if (!bSucceed)
+					break;
+
+				const RecordHeader* rh = record_at(item.first);
+				bSucceed = bf.write_file(rh, rh->_size);
+				newOffsets.emplace_back(newOffset);
+				newOffset += rh->_size;
+			}
+
+			std::string zeros((std::size_t)(capacity - newOffset), 0);
+			bSucceed = bSucceed && bf.write_file(zeros.data(), zeros.size());
+
+			//替换之前新文件必须已经落盘，否则掉电以后可能留下一个空的或者不完整的文件
+			bSucceed = bSucceed && bf.flush_file();
+			bf.close_file();
+
+			//新文件没写完整，原文件不动
+			if (!bSucceed)
+			{
+				boost::filesystem::remove(tmpFile, ec);
+				return false;
+			}
+		}
+
+		//Windows下映射着的文件不能被替换，要先关掉映射
+		_mapfile.reset();
+		_header = NULL;
+		boost::filesystem::rename(tmpFile, _filename, ec);
+		if (ec)
+		{
+			//替换失败，原文件还是完整的，重新打开原文件
+			boost::filesystem::remove(tmpFile, ec);
+			if (map_file())
+				replay();
+			else
+				_failed = true;
+			return false;
+		}
+
+		if (!map_file())
+		{
+			_failed = true;
+			return false;
+		}
+
+		for (std::size_t i = 0; i < items.size(); i++)
+			_index[items[i].second]._offset = newOffsets[i];
+		_tail = _header->_committed;
+		return true;
+	}
+
+	inline std::size_t	record_count() const { return _index.size(); }
+	inline uint64_t		live_bytes() const { return _live_bytes; }
+	inline uint64_t		used_bytes() const { return _tail; }
+	inline uint64_t		capacity() const { return _mapfile ? _mapfile->size() - sizeof(JournalHeader) : 0; }
+
+private:
+	static inline uint32_t align8(uint64_t len) { return (uint32_t)((len + 7) & ~(uint64_t)7); }
+
+	static inline uint32_t data_pos(uint32_t keyLen) { return align8(sizeof(RecordHeader) + keyLen + 1); }
+
+	static inline uint32_t checksum(const char* key, uint32_t keyLen, const void* data, uint32_t len)
+	{
+		//FNV-1a
+		uint32_t h = 2166136261U;
+		for (uint32_t i = 0; i < keyLen; i++)
+			h = (h ^ (uint8_t)key[i]) * 16777619U;
+		const uint8_t* p = (const uint8_t*)data;
+		for (uint32_t i = 0; i < len; i++)
+			h = (h ^ p[i]) * 16777619U;
+		return h;
+	}
+
+	inline char* records() const { return (char*)_header + sizeof(JournalHeader); }
+
+	inline const RecordHeader* record_at(uint64_t offset) const { return (const RecordHeader*)(records() + offset); }
+
+	static inline const char* key_of(const RecordHeader* rh) { return (const char*)rh + sizeof(RecordHeader); }
+
+	static inline const char* data_of(const RecordHeader* rh) { return (const char*)rh + data_pos(rh->_key_len); }
+
+	inline void make_key(uint16_t type, const char* key)
+	{
+		_key_buf.assign((const char*)&type, sizeof(uint16_t));
+		_key_buf.append(key);
+	}
+
+	static bool create_file(const char* filename, uint64_t initSize)
+	{
+		JournalHeader header;
+		memset(&header, 0, sizeof(header));
+		header._magic = STATE_JOURNAL_MAGIC;
+		header._version = STATE_JOURNAL_VERSION;
+
+		BoostFile bf;
+		if (!bf.create_new_file(filename))
+			return false;
+
+		bf.write_file(&header, sizeof(header));
+		std::string zeros((std::size_t)initSize, 0);
+		bf.write_file(zeros.data(), zeros.size());
+		bf.close_file();
+		return true;
+	}
+
+	bool map_file()
+	{
+		std::shared_ptr<BoostMappingFile> mf(new BoostMappingFile);
+		try
+		{
+			if (!mf->map(_filename.c_str()))
+				return false;
+		}
+		catch (...)
+		{
+			return false;
+		}
+
+		if (mf->size() < sizeof(JournalHeader))
+			return false;
+
+		_mapfile = mf;
+		_header = (JournalHeader*)mf->addr();
+		return true;
+	}
+
+	bool check_header()
+	{
+		if (_header->_magic != STATE_JOURNAL_MAGIC || _header->_version != STATE_JOURNAL_VERSION)
+			return false;
+
+		//新建的文件还没有写入schema
+		if (_header->_committed == 0)
+			_header->_schema = _schema;
+
+		return _header->_schema == _schema && _header->_committed <= capacity();
+	}
+
+	/*
+	 *	从头读取已经提交的记录，重建索引，遇到损坏的记录就截断
+	 */
+	void replay()
+	{
+		_index.clear();
+		_live_bytes = 0;
+
+		uint64_t committed = _header->_committed;
+		uint64_t offset = 0;
+		while (offset + sizeof(RecordHeader) <= committed)
+		{
+			const RecordHeader* rh = record_at(offset);
+			if (rh->_size < sizeof(RecordHeader) || (rh->_size & 7) != 0 || offset + rh->_size > committed)
+				break;
+
+			uint64_t need = rh->_deleted ? sizeof(RecordHeader) + rh->_key_len + 1 : (uint64_t)data_pos(rh->_key_len) + rh->_data_len;
+			if (need > rh->_size || key_of(rh)[rh->_key_len] != '\0')
+				break;
+
+			if (checksum(key_of(rh), rh->_key_len, rh->_deleted ? NULL : data_of(rh), rh->_deleted ? 0 : rh->_data_len) != rh->_checksum)
+				break;
+
+			make_key(rh->_type, key_of(rh));
+			auto it = _index.find(_key_buf);
+			if (it != _index.end())
+			{
+				_live_bytes -= record_at(it->second._offset)->_size;
+				if (rh->_deleted)
+					_index.erase(it);
+				else
+					it->second._offset = offset;
+			}
+			else if (!rh->_deleted)
+			{
+				IndexItem& item = _index[_key_buf];
+				item._offset = offset;
+				item._gen = 0;
+				item._type = rh->_type;
+			}
+
+			if (!rh->_deleted)
+				_live_bytes += rh->_size;
+
+			offset += rh->_size;
+		}
+
+		_header->_committed = offset;
+		_tail = offset;
+	}
+
+	/*
+	 *	空间不够时扩大文件并重新映射
+	 */
+	bool ensure_space(uint64_t size)
+	{
+		uint64_t cap = capacity();
+		if (_tail + size <= cap)
+			return true;
+
+		uint64_t newCap = std::max(cap * 2, _tail + size);
+		std::string zeros((std::size_t)(newCap - cap), 0);
+		try
+		{
+			BoostFile f;
+			if (!f.open_existing_file(_filename.c_str()) || !f.seek_to_end() || !f.write_file(zeros.data(), zeros.size()))
+				return false;
+			f.close_file();
+		}
+		catch (...)
+		{
+			return false;
+		}
+
+		_mapfile.reset();
+		_header = NULL;
+		return map_file();
+	}
+
+	bool append(uint16_t type, const char* key, const void* data, uint32_t len, bool bDeleted, uint64_t& offset)
+	{
+		uint32_t keyLen = (uint32_t)strlen(key);
+		uint32_t size = bDeleted ? align8(sizeof(RecordHeader) + keyLen + 1) : align8((uint64_t)data_pos(keyLen) + len);
+		if (!ensure_space(size))
+		{
+			_failed = true;
+			return false;
+		}
+
+		offset = _tail;
+		char* p = records() + offset;
+		memset(p, 0, size);
+
+		RecordHeader* rh = (RecordHeader*)p;
+		rh->_size = size;
+		rh->_type = type;
+		rh->_deleted = bDeleted ? 1 : 0;
+		rh->_key_len = keyLen;
+		rh->_data_len = bDeleted ? 0 : len;
+		memcpy(p + sizeof(RecordHeader), key, keyLen);
+		if (!bDeleted && len > 0)
+			memcpy(p + data_pos(keyLen), data, len);
+		rh->_checksum = checksum(key, keyLen, bDeleted ? NULL : data, rh->_data_len);
+
+		_tail += size;
+		return true;
+	}
+
+private:
+	std::string		_filename;
+	std::shared_ptr<BoostMappingFile>	_mapfile;
+	JournalHeader*	_header;
+	uint32_t		_schema;
+	uint64_t		_init_size;
+
+	uint64_t		_tail;			//下一条记录写入的位置
+	uint64_t		_live_bytes;	//有效记录的总字节数
+	uint32_t		_gen;
+	bool			_fresh;
+	bool			_failed;		//扩容或者整理失败了
+
+	IndexMap		_index;
+	std::string		_key_buf;
+};
+
+typedef std::shared_ptr<StateJournal> StateJournalPtr;
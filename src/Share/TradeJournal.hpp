@@ -0,0 +1,351 @@
+﻿/*!
+ * \file TradeJournal.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 订单和成交的异步日志
+ *
+ * 交易通道的回调线程只把定长的记录写到无锁队列里，格式化和写文件都在后台线程批量完成
+ * 队列是有界的，满了以后回调线程会等待后台线程腾出位置，不会丢记录
+ * 停止时会把队列里剩下的记录全部写完，停止以后再来的记录直接在调用线程同步写文件
+ * 支持两种格式：csv和定长的二进制格式，二进制文件可以用bin_to_csv转成csv
+ */
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <string.h>
+
+#include "BoostFile.hpp"
+#include "MpscQueue.hpp"
+#include "fmtlib.h"
+
+#define JOURNAL_MAGIC	0x4E4A5457	//"WTJN"
+#define JOURNAL_VERSION	1
+
+class TradeJournal
+{
+public:
+	typedef enum tagJournalFormat
+	{
+		JF_CSV,
+		JF_BIN
+	} JournalFormat;
+
+	typedef enum tagRecordType
+	{
+		JRT_ORDER,
+		JRT_TRADE
+	} RecordType;
+
+	/*
+	 *	二进制文件的文件头
+	 */
+	typedef struct _JournalHeader
+	{
+		uint32_t	_magic;
+		uint16_t	_version;
+		uint16_t	_type;			//RecordType
+		uint32_t	_record_size;
+		uint32_t	_reserved;
+	} JournalHeader;
+
+	/*
+	 *	定长的日志记录，订单和成交共用
+	 */
+	typedef struct _JournalRecord
+	{
+		uint32_t	_type;			//RecordType
+		uint32_t	_localid;
+		uint32_t	_date;
+		uint32_t	_canceled;		//订单是否撤销，成交记录无效
+		uint64_t	_time;
+		double		_volume;
+		double		_traded;		//订单的成交数量，成交记录无效
+		double		_price;
+		char		_code[32];
+		char		_action[8];
+		char		_tradeid[64];	//成交编号，订单记录无效
+		char		_orderid[64];
+		char		_remark[64];	//订单状态信息，太长的会被截断
+	} JournalRecord;
+
+public:
+	TradeJournal() : _format(JF_CSV), _stopped(false), _pushing(0), _stalls(0) {}
+
+	~TradeJournal() { stop(); }
+
+public:
+	/*
+	 *	初始化，在folder下创建trades和orders两个文件
+	 *	format为csv或者bin，capacity为队列可以容纳的记录条数
+	 */
+	bool init(const char* folder, const char* format = "csv", uint32_t capacity = 8192)
+	{
+		if (_queue)
+			return false;
+
+		_format = (strcmp(format, "bin") == 0) ? JF_BIN : JF_CSV;
+
+		BoostFile::create_directories(folder);
+		std::string root = folder;
+		if (_format == JF_CSV)
+		{
+			_trades_log = open_file((root + "trades.csv").c_str(), JRT_TRADE);
+			_orders_log = open_file((root + "orders.csv").c_str(), JRT_ORDER);
+		}
+		else
+		{
+			_trades_log = open_file((root + "trades.dat").c_str(), JRT_TRADE);
+			_orders_log = open_file((root + "orders.dat").c_str(), JRT_ORDER);
+		}
+
+		if (_trades_log == NULL || _orders_log == NULL)
+			return false;
+
+		_queue.reset(new MpscQueue<JournalRecord>(capacity));
+		_worker.reset(new std::thread([this]() {
+			while (!_stopped)
+			{
+				if (flush() == 0)
+					std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+
+			//退出之前把剩下的记录写完
+			flush();
+		}));
+
+		return true;
+	}
+
+	/*
+	 *	停止后台线程，队列里剩下的记录会全部写到文件里
+	 */
+	void stop()
+	{
+		//持有锁直到收尾完成，停止以后同步写文件的调用会等在这里
+		std::unique_lock<std::mutex> lock(_sync_mtx);
+		if (_worker == NULL || _stopped)
+			return;
+
+		_stopped = true;
+		_worker->join();
+		_worker.reset();
+
+		//等正在入队的调用返回，再把后台线程退出以后才入队的记录写掉
+		while (_pushing > 0)
+			std::this_thread::yield();
+		flush();
+	}
+
+	inline void log_order(uint32_t localid, const char* stdCode, uint32_t uDate, uint64_t uTime, const char* action,
+		double volume, double traded, double price, const char* orderid, bool isCanceled, const char* remark)
+	{
+		JournalRecord rec;
+		memset(&rec, 0, sizeof(rec));
+		rec._type = JRT_ORDER;
+		rec._localid = localid;
+		rec._date = uDate;
+		rec._time = uTime;
+		rec._volume = volume;
+		rec._traded = traded;
+		rec._price = price;
+		rec._canceled = isCanceled ? 1 : 0;
+		copy_str(rec._code, stdCode, sizeof(rec._code));
+		copy_str(rec._action, action, sizeof(rec._action));
+		copy_str(rec._orderid, orderid, sizeof(rec._orderid));
+		copy_str(rec._remark, remark, sizeof(rec._remark));
+		push(rec);
+	}
+
+	inline void log_trade(uint32_t localid, const char* stdCode, uint32_t uDate, uint64_t uTime, const char* action,
+		double volume, double price, const char* tradeid, const char* orderid)
+	{
+		JournalRecord rec;
+		memset(&rec, 0, sizeof(rec));
+		rec._type = JRT_TRADE;
+		rec._localid = localid;
+		rec._date = uDate;
+		rec._time = uTime;
+		rec._volume = volume;
+		rec._price = price;
+		copy_str(rec._code, stdCode, sizeof(rec._code));
+		copy_str(rec._action, action, sizeof(rec._action));
+		copy_str(rec._tradeid, tradeid, sizeof(rec._tradeid));
+		copy_str(rec._orderid, orderid, sizeof(rec._orderid));
+		push(rec);
+	}
+
+	/*
+	 *	队列满了需要等待的次数
+	 */
+	inline uint64_t stalls() const { return _stalls; }
+
+	/*
+	 *	把二进制日志文件转成csv
+	 */
+	static bool bin_to_csv(const char* binFile, const char* csvFile)
+	{
+		std::string content;
+		if (!BoostFile::read_file_contents(binFile, content) || content.size() < sizeof(JournalHeader))
+			return false;
+
+		const JournalHeader* header = (const JournalHeader*)content.data();
+		if (header->_magic != JOURNAL_MAGIC || header->_record_size != sizeof(JournalRecord))
+			return false;
+
+		std::string output = csv_header(header->_type);
+		std::size_t count = (content.size() - sizeof(JournalHeader)) / sizeof(JournalRecord);
+		const JournalRecord* recs = (const JournalRecord*)(content.data() + sizeof(JournalHeader));
+		for (std::size_t i = 0; i < count; i++)
+			output += to_csv(recs[i]);
+
+		return BoostFile::write_file_contents(csvFile, output.data(), (uint32_t)output.size());
+	}
+
+private:
+	static inline void copy_str(char* dst, const char* src, std::size_t len)
+	{
+		if (src == NULL)
+			return;
+
+		strncpy(dst, src, len - 1);
+	}
+
+	static std::string csv_header(uint32_t rType)
+	{
+		if (rType == JRT_TRADE)
+			return "localid,date,time,code,action,volume,price,tradeid,orderid\n";
+		else
+			return "localid,date,inserttime,code,action,volume,traded,price,orderid,canceled,remark\n";
+	}
+
+	static std::string to_csv(const JournalRecord& rec)
+	{
+		if (rec._type == JRT_TRADE)
+			return fmt::format("{},{},{},{},{},{},{},{},{}\n",
+				rec._localid, rec._date, rec._time, rec._code, rec._action,
+				rec._volume, rec._price, rec._tradeid, rec._orderid);
+		else
+			return fmt::format("{},{},{},{},{},{},{},{},{},{},{}\n",
+				rec._localid, rec._date, rec._time, rec._code, rec._action,
+				rec._volume, rec._traded, rec._price, rec._orderid, rec._canceled ? "TRUE" : "FALSE", rec._remark);
+	}
+
+	std::shared_ptr<BoostFile> open_file(const char* filename, RecordType rType)
+	{
+		std::shared_ptr<BoostFile> bf(new BoostFile());
+		bool isNewFile = !BoostFile::exists(filename);
+		if (!bf->create_or_open_file(filename))
+			return std::shared_ptr<BoostFile>();
+
+		if (isNewFile)
+		{
+			if (_format == JF_CSV)
+			{
+				bf->write_file(csv_header(rType));
+			}
+			else
+			{
+				JournalHeader header;
+				memset(&header, 0, sizeof(header));
+				header._magic = JOURNAL_MAGIC;
+				header._version = JOURNAL_VERSION;
+				header._type = rType;
+				header._record_size = sizeof(JournalRecord);
+				bf->write_file(&header, sizeof(header));
+			}
+		}
+		else
+		{
+			bf->seek_to_end();
+		}
+
+		return bf;
+	}
+
+	inline void push(const JournalRecord& rec)
+	{
+		if (_queue == NULL)
+			return;
+
+		//先登记再检查停止标记，stop要等登记的调用都返回才做最后一次写入
+		_pushing++;
+		bool bQueued = false;
+		while (!_stopped)
+		{
+			if (_queue->try_emplace(rec))
+			{
+				bQueued = true;
+				break;
+			}
+
+			//队列满了就等后台线程腾出位置，宁可慢一点也不能丢记录
+			_stalls++;
+			std::this_thread::yield();
+		}
+		_pushing--;
+
+		if (!bQueued)
+			write_sync(rec);
+	}
+
+	/*
+	 *	后台线程已经停了，直接写文件
+	 */
+	void write_sync(const JournalRecord& rec)
+	{
+		std::unique_lock<std::mutex> lock(_sync_mtx);
+		std::shared_ptr<BoostFile>& bf = (rec._type == JRT_TRADE) ? _trades_log : _orders_log;
+		if (_format == JF_CSV)
+			bf->write_file(to_csv(rec));
+		else
+			bf->write_file(&rec, sizeof(rec));
+	}
+
+	/*
+	 *	把队列里的记录批量写到文件里，返回写入的条数
+	 */
+	uint64_t flush()
+	{
+		_trades_buf.clear();
+		_orders_buf.clear();
+		uint64_t cnt = _queue->consume([this](JournalRecord& rec) {
+			std::string& buf = (rec._type == JRT_TRADE) ? _trades_buf : _orders_buf;
+			if (_format == JF_CSV)
+				buf += to_csv(rec);
+			else
+				buf.append((const char*)&rec, sizeof(rec));
+		});
+
+		if (!_trades_buf.empty())
+			_trades_log->write_file(_trades_buf);
+		if (!_orders_buf.empty())
+			_orders_log->write_file(_orders_buf);
+
+		return cnt;
+	}
+
+private:
+	JournalFormat	_format;
+	std::shared_ptr<BoostFile>	_trades_log;
+	std::shared_ptr<BoostFile>	_orders_log;
+
+	std::shared_ptr<MpscQueue<JournalRecord>>	_queue;
+	std::shared_ptr<std::thread>	_worker;
+	std::atomic<bool>		_stopped;
+	std::atomic<uint32_t>	_pushing;	//正在入队的调用数
+	std::atomic<uint64_t>	_stalls;
+	std::mutex				_sync_mtx;	//停止以后同步写文件用
+
+	//只有后台线程使用的缓存
+	std::string		_trades_buf;
+	std::string		_orders_buf;
+};
+
+typedef std::shared_ptr<TradeJournal> TradeJournalPtr;
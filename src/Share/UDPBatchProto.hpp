@@ -0,0 +1,404 @@
+﻿/*!
+ * \file UDPBatchProto.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief UDP行情广播v2协议
+ *
+ * 每种数据是一个通道，通道内每条数据有连续的序号
+ * 一个数据报里打包多条数据，数据报头里记录第一条数据的序号和条数，接收端据此检测丢包
+ * 发送端为每个通道保留最近的数据，接收端丢包以后可以通过TCP请求补发
+ * 补发的应答由若干个和UDP数据报格式相同的帧组成，最后一帧的条数为0
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+#define UDP_MSG_PUSHBATCH	0x300	//v2批量数据包
+#define UDP_MSG_REPLAY		0x301	//v2补发请求
+
+#define UDP_PROTO_VERSION	2
+
+//通道，每种数据一个通道，序号各自独立
+#define UDP_CHNL_TICK		0
+#define UDP_CHNL_ORDQUE		1
+#define UDP_CHNL_ORDDTL		2
+#define UDP_CHNL_TRANS		3
+#define UDP_CHNL_COUNT		4
+
+#pragma pack(push,1)
+//v2数据报头，后面紧跟_count条数据，每条数据由UDPEventHead和数据结构体组成
+typedef struct _UDPBatchHead
+{
+	uint32_t	_type;		//固定为UDP_MSG_PUSHBATCH，老的接收端会忽略这个类型
+	uint16_t	_version;
+	uint16_t	_count;		//数据条数
+	uint16_t	_channel;
+	uint16_t	_length;	//包括报头在内的总长度
+	uint32_t	_epoch;		//发送端启动时间，发送端重启以后序号从头开始
+	uint64_t	_seq;		//第一条数据的序号，从1开始
+} UDPBatchHead;
+
+typedef struct _UDPEventHead
+{
+	uint16_t	_type;		//UDP_MSG_PUSHTICK等
+	uint16_t	_length;	//数据结构体的长度
+} UDPEventHead;
+
+//补发请求，请求[_from, _to)区间的数据
+typedef struct _UDPReplayReq
+{
+	uint32_t	_type;		//固定为UDP_MSG_REPLAY
+	uint32_t	_channel;
+	uint64_t	_from;
+	uint64_t	_to;
+} UDPReplayReq;
+#pragma pack(pop)
+
+/*
+ *	把多条数据打包到一个数据报里
+ */
+class UDPBatchPacker
+{
+public:
+	UDPBatchPacker() :_capacity(0), _next_seq(1) {}
+
+	void init(uint16_t channel, uint32_t epoch, uint32_t capacity)
+	{
+		if (capacity > 65535)
+			capacity = 65535;
+		if (capacity < 1024)
+			capacity = 1024;
+
+		_capacity = capacity;
+		_buffer.resize(capacity);
+		batch_head()->_type = UDP_MSG_PUSHBATCH;
+		batch_head()->_version = UDP_PROTO_VERSION;
+		batch_head()->_channel = channel;
+		batch_head()->_epoch = epoch;
+		reset(_next_seq);
+	}
+
+	/*
+	 *	清空数据报，nextSeq为下一条数据的序号
+	 */
+	inline void reset(uint64_t nextSeq)
+	{
+		_next_seq = nextSeq;
+		batch_head()->_count = 0;
+		batch_head()->_length = sizeof(UDPBatchHead);
+		batch_head()->_seq = nextSeq;
+	}
+
+	/*
+	 *	追加一条数据，放不下返回0，否则返回这条数据的序号
+	 */
+	inline uint64_t append(uint16_t type, const void* data, uint16_t len)
+	{
+		UDPBatchHead* head = batch_head();
+		uint32_t need = sizeof(UDPEventHead) + len;
+		if (head->_length + need > _capacity || head->_count == 65535)
+			return 0;
+
+		char* p = _buffer.data() + head->_length;
+		UDPEventHead* evt = (UDPEventHead*)p;
+		evt->_type = type;
+		evt->_length = len;
+		memcpy(p + sizeof(UDPEventHead), data, len);
+
+		head->_length += need;
+		head->_count++;
+		return _next_seq++;
+	}
+
+	inline bool		empty() const { return batch_head()->_count == 0; }
+	inline uint32_t	count() const { return batch_head()->_count; }
+	inline const char*	data() const { return _buffer.data(); }
+	inline uint32_t	size() const { return batch_head()->_length; }
+	inline uint64_t	next_seq() const { return _next_seq; }
+
+	/*
+	 *	遍历一个数据报里的数据，cb的参数为(seq, type, data, len)
+	 *	数据报不完整或者格式不对返回false
+	 */
+	template<typename Fn>
+	static bool visit(const char* buf, std::size_t len, Fn cb)
+	{
+		if (len < sizeof(UDPBatchHead))
+			return false;
+
+		const UDPBatchHead* head = (const UDPBatchHead*)buf;
+		if (head->_type != UDP_MSG_PUSHBATCH || head->_version != UDP_PROTO_VERSION || head->_length > len)
+			return false;
+
+		std::size_t offset = sizeof(UDPBatchHead);
+		for (uint16_t i = 0; i < head->_count; i++)
+		{
+			if (offset + sizeof(UDPEventHead) > head->_length)
+				return false;
+
+			const UDPEventHead* evt = (const UDPEventHead*)(buf + offset);
+			offset += sizeof(UDPEventHead);
+			if (offset + evt->_length > head->_length)
+				return false;
+
+			cb(head->_seq + i, evt->_type, buf + offset, evt->_length);
+			offset += evt->_length;
+		}
+
+		return true;
+	}
+
+private:
+	inline UDPBatchHead* batch_head() { return (UDPBatchHead*)_buffer.data(); }
+	inline const UDPBatchHead* batch_head() const { return (const UDPBatchHead*)_buffer.data(); }
+
+private:
+	std::vector<char>	_buffer;
+	uint32_t			_capacity;
+	uint64_t			_next_seq;
+};
+
+/*
+ *	接收端的丢包检测
+ *	序号跳跃的区间记为缺口，缺口里的数据后面再收到（乱序或者补发）会被接受并从缺口里去掉
+ *	已经收到过的序号会被当成重复数据丢弃
+ */
+class UDPGapDetector
+{
+public:
+	typedef std::pair<uint64_t, uint64_t>	SeqRange;	//[from, to)
+	typedef std::vector<SeqRange>			SeqRanges;
+
+public:
+	UDPGapDetector(uint32_t maxGaps = 4096)
+		: _epoch(0), _expected(0), _max_gaps(maxGaps)
+		, _received(0), _lost(0), _recovered(0), _duplicated(0), _expired(0)
+	{
+	}
+
+	/*
+	 *	发送端重启以后序号从头开始，要清掉所有状态
+	 */
+	inline void check_epoch(uint32_t epoch)
+	{
+		if (epoch == _epoch)
+			return;
+
+		_epoch = epoch;
+		_expected = 0;
+		_gaps.clear();
+		_new_gaps.clear();
+	}
+
+	/*
+	 *	检查一个序号，返回false表示是重复数据
+	 */
+	inline bool accept(uint64_t seq)
+	{
+		if (seq == _expected)
+		{
+			_expected++;
+			_received++;
+			return true;
+		}
+
+		//第一条数据，之前的数据不算丢失
+		if (_expected == 0)
+		{
+			_expected = seq + 1;
+			_received++;
+			return true;
+		}
+
+		if (seq > _expected)
+		{
+			_gaps[_expected] = seq;
+			_new_gaps.emplace_back(_expected, seq);
+			_lost += seq - _expected;
+			_expected = seq + 1;
+			_received++;
+
+			while (_gaps.size() > _max_gaps)
+			{
+				auto it = _gaps.begin();
+				_expired += it->second - it->first;
+				_gaps.erase(it);
+			}
+			return true;
+		}
+
+		return fill(seq);
+	}
+
+	/*
+	 *	取出上次调用以后新发现的缺口
+	 */
+	inline bool pop_gaps(SeqRanges& gaps)
+	{
+		if (_new_gaps.empty())
+			return false;
+
+		gaps.swap(_new_gaps);
+		_new_gaps.clear();
+		return true;
+	}
+
+	inline uint32_t	epoch() const { return _epoch; }
+	inline uint64_t	expected() const { return _expected; }
+	inline uint64_t	outstanding() const
+	{
+		uint64_t ret = 0;
+		for (auto& item : _gaps)
+			ret += item.second - item.first;
+		return ret;
+	}
+
+	inline uint64_t	received() const { return _received; }
+	inline uint64_t	lost() const { return _lost; }
+	inline uint64_t	recovered() const { return _recovered; }
+	inline uint64_t	duplicated() const { return _duplicated; }
+	inline uint64_t	expired() const { return _expired; }
+
+private:
+	inline bool fill(uint64_t seq)
+	{
+		auto it = _gaps.upper_bound(seq);
+		if (it == _gaps.begin())
+		{
+			_duplicated++;
+			return false;
+		}
+
+		it--;
+		uint64_t from = it->first;
+		uint64_t to = it->second;
+		if (seq >= to)
+		{
+			_duplicated++;
+			return false;
+		}
+
+		//把缺口拆成两段
+		_gaps.erase(it);
+		if (seq > from)
+			_gaps[from] = seq;
+		if (seq + 1 < to)
+			_gaps[seq + 1] = to;
+
+		_received++;
+		_recovered++;
+		return true;
+	}
+
+private:
+	uint32_t	_epoch;
+	uint64_t	_expected;
+	uint32_t	_max_gaps;
+
+	std::map<uint64_t, uint64_t>	_gaps;
+	SeqRanges	_new_gaps;
+
+	uint64_t	_received;
+	uint64_t	_lost;
+	uint64_t	_recovered;
+	uint64_t	_duplicated;
+	uint64_t	_expired;
+};
+
+/*
+ *	发送端保留最近数据的环形缓冲区，一个通道一个
+ *	一个通道只有一种数据，所以每个槽位的大小是固定的
+ */
+class UDPReplayRing
+{
+public:
+	UDPReplayRing() :_slot_size(0), _capacity(0), _last_seq(0) {}
+
+	void init(uint32_t dataSize, uint32_t capacity)
+	{
+		std::unique_lock<std::mutex> lock(_mtx);
+		_slot_size = sizeof(UDPEventHead) + dataSize;
+		_capacity = capacity;
+		_buffer.resize((std::size_t)_slot_size*capacity);
+		_last_seq = 0;
+	}
+
+	inline bool is_valid() const { return _capacity != 0; }
+
+	/*
+	 *	写入一条数据，序号必须是连续的
+	 */
+	inline void push(uint64_t seq, uint16_t type, const void* data, uint16_t len)
+	{
+		if (_capacity == 0 || sizeof(UDPEventHead) + len > _slot_size)
+			return;
+
+		std::unique_lock<std::mutex> lock(_mtx);
+		char* p = _buffer.data() + (std::size_t)(seq % _capacity)*_slot_size;
+		UDPEventHead* evt = (UDPEventHead*)p;
+		evt->_type = type;
+		evt->_length = len;
+		memcpy(p + sizeof(UDPEventHead), data, len);
+		_last_seq = seq;
+	}
+
+	/*
+	 *	把[from, to)区间里还保留着的数据打包成补发应答
+	 *	每一帧是一个完整的v2数据报，最后追加一个条数为0的结束帧，返回补发的数据条数
+	 */
+	uint64_t make_replay(uint64_t from, uint64_t to, UDPBatchPacker& packer, std::string& out)
+	{
+		uint64_t cnt = 0;
+		std::unique_lock<std::mutex> lock(_mtx);
+		if (_capacity == 0)
+		{
+			to = from;
+		}
+		else
+		{
+			//只能补发还保留在缓冲区里的数据
+			uint64_t first = (_last_seq >= _capacity) ? (_last_seq - _capacity + 1) : 1;
+			if (from < first)
+				from = first;
+			if (to > _last_seq + 1)
+				to = _last_seq + 1;
+			if (to < from)
+				to = from;
+		}
+
+		packer.reset(from);
+		for (uint64_t seq = from; seq < to; seq++)
+		{
+			const char* p = _buffer.data() + (std::size_t)(seq % _capacity)*_slot_size;
+			const UDPEventHead* evt = (const UDPEventHead*)p;
+			if (packer.append(evt->_type, p + sizeof(UDPEventHead), evt->_length) == 0)
+			{
+				out.append(packer.data(), packer.size());
+				packer.reset(seq);
+				packer.append(evt->_type, p + sizeof(UDPEventHead), evt->_length);
+			}
+			cnt++;
+		}
+
+		if (!packer.empty())
+			out.append(packer.data(), packer.size());
+
+		packer.reset(to);
+		out.append(packer.data(), packer.size());
+		return cnt;
+	}
+
+private:
+	std::mutex			_mtx;
+	std::vector<char>	_buffer;
+	uint32_t			_slot_size;
+	uint32_t			_capacity;
+	uint64_t			_last_seq;
+};
@@ -0,0 +1,210 @@
+﻿/*!
+ * \file WtLruCache.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 按字节数限制容量的线程安全LRU缓存
+ *
+ * 缓存的值是shared_ptr，淘汰只是从缓存里拿掉，外面还持有的引用不受影响
+ * 每条缓存记录自己占用的字节数，总数超过预算就从最久没有访问的开始淘汰
+ * 最近放进来的一条不会被淘汰，即使它自己就超过了预算
+ */
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class WtLruCache
+{
+public:
+	typedef struct _CacheStats
+	{
+		uint64_t	_hits;			//命中次数
+		uint64_t	_misses;		//未命中次数
+		uint64_t	_evictions;		//淘汰条数
+		uint64_t	_evicted_bytes;	//淘汰的字节数
+		uint64_t	_bytes;			//当前占用的字节数
+		uint64_t	_budget;		//字节数预算，0为不限制
+		uint64_t	_entries;		//当前缓存条数
+	} CacheStats;
+
+private:
+	typedef struct _CacheItem
+	{
+		std::string				_key;
+		std::shared_ptr<void>	_data;
+		uint64_t				_bytes;
+	} CacheItem;
+
+	typedef std::list<CacheItem>	CacheList;
+	typedef std::unordered_map<std::string, CacheList::iterator>	CacheIndex;
+	typedef std::vector<std::shared_ptr<void>>	DataList;
+
+public:
+	WtLruCache(uint64_t budget = 0)
+		: _budget(budget), _bytes(0)
+		, _hits(0), _misses(0), _evictions(0), _evicted_bytes(0)
+	{
+	}
+
+	/*
+	 *	设置字节数预算，0为不限制
+	 */
+	void set_budget(uint64_t budget)
+	{
+		DataList evicted;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			_budget = budget;
+			evict(evicted);
+		}
+	}
+
+	/*
+	 *	读取缓存，命中的记录移到最前面
+	 */
+	template<typename T>
+	std::shared_ptr<T> get(const std::string& key)
+	{
+		std::unique_lock<std::mutex> lock(_mtx);
+		auto it = _index.find(key);
+		if (it == _index.end())
+		{
+			_misses++;
+			return std::shared_ptr<T>();
+		}
+
+		_hits++;
+		_items.splice(_items.begin(), _items, it->second);
+		return std::static_pointer_cast<T>(it->second->_data);
+	}
+
+	/*
+	 *	放入缓存，已经有的会被替换
+	 */
+	void put(const std::string& key, const std::shared_ptr<void>& data, uint64_t bytes)
+	{
+		DataList evicted;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			auto it = _index.find(key);
+			if (it != _index.end())
+			{
+				CacheItem& item = *it->second;
+				_bytes -= item._bytes;
+				evicted.emplace_back(item._data);
+				item._data = data;
+				item._bytes = bytes;
+				_items.splice(_items.begin(), _items, it->second);
+			}
+			else
+			{
+				_items.push_front(CacheItem{ key, data, bytes });
+				_index[key] = _items.begin();
+			}
+			_bytes += bytes;
+			evict(evicted);
+		}
+	}
+
+	/*
+	 *	缓存的对象大小发生了变化，如K线后面又追加了数据
+	 */
+	void update_size(const std::string& key, uint64_t bytes)
+	{
+		DataList evicted;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			auto it = _index.find(key);
+			if (it == _index.end())
+				return;
+
+			CacheItem& item = *it->second;
+			_bytes = _bytes - item._bytes + bytes;
+			item._bytes = bytes;
+			evict(evicted);
+		}
+	}
+
+	void erase(const std::string& key)
+	{
+		std::shared_ptr<void> data;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			auto it = _index.find(key);
+			if (it == _index.end())
+				return;
+
+			data = it->second->_data;
+			_bytes -= it->second->_bytes;
+			_items.erase(it->second);
+			_index.erase(it);
+		}
+	}
+
+	void clear()
+	{
+		CacheList items;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			items.swap(_items);
+			_index.clear();
+			_bytes = 0;
+		}
+	}
+
+	CacheStats stats()
+	{
+		std::unique_lock<std::mutex> lock(_mtx);
+		CacheStats ret;
+		ret._hits = _hits;
+		ret._misses = _misses;
+		ret._evictions = _evictions;
+		ret._evicted_bytes = _evicted_bytes;
+		ret._bytes = _bytes;
+		ret._budget = _budget;
+		ret._entries = _items.size();
+		return ret;
+	}
+
+private:
+	/*
+	 *	从尾部开始淘汰，直到不超过预算
+	 *	淘汰的数据放到evicted里，等解锁以后再释放，大块内存的释放不占用锁
+	 */
+	void evict(DataList& evicted)
+	{
+		if (_budget == 0)
+			return;
+
+		while (_bytes > _budget && _items.size() > 1)
+		{
+			CacheItem& item = _items.back();
+			_bytes -= item._bytes;
+			_evictions++;
+			_evicted_bytes += item._bytes;
+			evicted.emplace_back(std::move(item._data));
+			_index.erase(item._key);
+			_items.pop_back();
+		}
+	}
+
+private:
+	std::mutex	_mtx;
+	CacheList	_items;
+	CacheIndex	_index;
+
+	uint64_t	_budget;
+	uint64_t	_bytes;
+
+	uint64_t	_hits;
+	uint64_t	_misses;
+	uint64_t	_evictions;
+	uint64_t	_evicted_bytes;
+};
@@ -0,0 +1,49 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../WtBtCore/SharedDataCache.h"
+
+#include <vector>
+
+TEST(test_bar_cache, test_write_and_map)
+{
+	std::vector<WTSBarStruct> bars(100);
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		bars[i].date = 20220101;
+		bars[i].time = 202201010900 + i;
+		bars[i].close = 100 + i;
+	}
+
+	const char* filename = "./test_bar_cache.wbc";
+	EXPECT_TRUE(BarCacheFile::write(filename, bars.data(), bars.size()));
+
+	BarCacheFilePtr cacheFile(new BarCacheFile);
+	EXPECT_TRUE(cacheFile->open(filename));
+	EXPECT_EQ(cacheFile->count(), 100);
+	EXPECT_DOUBLE_EQ(cacheFile->bars()[99].close, 199);
+
+	//挂到映射的文件上以后，数据直接来自映射的内存
+	BarArray ay;
+	ay.attach(cacheFile);
+	EXPECT_TRUE(ay.is_mapped());
+	EXPECT_EQ(ay.size(), 100);
+	EXPECT_EQ(ay.data(), cacheFile->bars());
+	EXPECT_EQ(ay.end() - ay.begin(), 100);
+	EXPECT_EQ(ay[10].time, 202201010910);
+
+	//修改的时候先拷贝一份
+	ay.emplace_back(bars[0]);
+	EXPECT_FALSE(ay.is_mapped());
+	EXPECT_EQ(ay.size(), 101);
+	EXPECT_NE(ay.data(), cacheFile->bars());
+	EXPECT_DOUBLE_EQ(ay[99].close, 199);
+
+	cacheFile.reset();
+	ay.clear();
+	boost::filesystem::remove(filename);
+
+	//不是缓存文件的不能打开
+	BoostFile::write_file_contents(filename, "abcd", 4);
+	BarCacheFile badFile;
+	EXPECT_FALSE(badFile.open(filename));
+	boost::filesystem::remove(filename);
+}
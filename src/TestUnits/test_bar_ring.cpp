@@ -0,0 +1,94 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/BarRing.hpp"
+
+static WTSBarStruct make_bar(uint32_t date, uint32_t time, double close)
+{
+	WTSBarStruct bar;
+	bar.date = date;
+	bar.time = time;
+	bar.close = close;
+	return bar;
+}
+
+TEST(test_bar_ring, test_subscribe_and_append)
+{
+	BarRingMgr mgr;
+
+	//没有订阅的时候直接丢弃
+	WTSBarStruct bar = make_bar(20220104, 931, 1.0);
+	mgr.append(1, "CFFEX.IF.HOT", "m1", &bar);
+
+	uint32_t fillCnt = 0;
+	WTSBarRing* ring = mgr.subscribe(1, "CFFEX.IF.HOT", "m1", 4, [&fillCnt](WTSBarRing* r) {
+		WTSBarStruct bars[3] = { make_bar(20220104, 931, 1.0), make_bar(20220104, 932, 2.0), make_bar(20220104, 933, 3.0) };
+		BarRingMgr::push(r, bars, 3);
+		fillCnt++;
+	});
+	ASSERT_TRUE(ring != NULL);
+	EXPECT_EQ(ring->_capacity, 4);
+	EXPECT_EQ(ring->_cursor, 3);
+
+	//重复订阅返回同一个缓冲区，不会再灌历史数据
+	WTSBarRing* again = mgr.subscribe(1, "CFFEX.IF.HOT", "m1", 8, [&fillCnt](WTSBarRing*) { fillCnt++; });
+	EXPECT_EQ(again, ring);
+	EXPECT_EQ(fillCnt, 1);
+
+	//和最后一根时间相同的覆盖，不推进游标
+	bar = make_bar(20220104, 933, 3.5);
+	mgr.append(1, "CFFEX.IF.HOT", "m1", &bar);
+	EXPECT_EQ(ring->_cursor, 3);
+	EXPECT_EQ(ring->_bars[2].close, 3.5);
+
+	//其他策略的K线不会写进来
+	bar = make_bar(20220104, 934, 9.0);
+	mgr.append(2, "CFFEX.IF.HOT", "m1", &bar);
+	EXPECT_EQ(ring->_cursor, 3);
+
+	//写满以后从头覆盖，第n根在n % capacity
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		bar = make_bar(20220104, 934 + i, 4.0 + i);
+		mgr.append(1, "CFFEX.IF.HOT", "m1", &bar);
+	}
+	EXPECT_EQ(ring->_cursor, 6);
+	EXPECT_EQ(ring->_bars[4 % 4].close, 5.0);
+	EXPECT_EQ(ring->_bars[5 % 4].close, 6.0);
+	EXPECT_EQ(ring->_bars[3 % 4].close, 4.0);
+}
+
+TEST(test_bar_ring, test_read_incrementally)
+{
+	BarRingMgr mgr;
+	WTSBarRing* ring = mgr.subscribe(6000, "SSE.600000", "m5", 4, [](WTSBarRing*) {});
+	ASSERT_TRUE(ring != NULL);
+
+	WTSBarStruct out[8];
+	uint64_t from = 0;
+	EXPECT_EQ(BarRingMgr::read(ring, from, out, 8), 0);
+
+	WTSBarStruct bar;
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		bar = make_bar(20220104, 935 + i * 5, i + 1);
+		mgr.append(6000, "SSE.600000", "m5", &bar);
+	}
+
+	//只读新的K线
+	EXPECT_EQ(BarRingMgr::read(ring, from, out, 8), 2);
+	EXPECT_EQ(from, 2);
+	EXPECT_EQ(out[1].close, 2.0);
+	EXPECT_EQ(BarRingMgr::read(ring, from, out, 8), 0);
+
+	//再写5条，容量是4，能读的只有最后3条，来不及读的被跳过
+	for (uint32_t i = 2; i < 7; i++)
+	{
+		bar = make_bar(20220104, 935 + i * 5, i + 1);
+		mgr.append(6000, "SSE.600000", "m5", &bar);
+	}
+	EXPECT_EQ(ring->_cursor, 7);
+	EXPECT_EQ(BarRingMgr::read(ring, from, out, 8), 3);
+	EXPECT_EQ(from, 7);
+	EXPECT_EQ(out[0].close, 5.0);
+	EXPECT_EQ(out[2].close, 7.0);
+}
+
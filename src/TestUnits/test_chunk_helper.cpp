@@ -0,0 +1,75 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../WtDataStorage/ChunkHelper.hpp"
+
+#include <vector>
+
+USING_NS_WTP;
+
+static std::string make_chunked_block(const std::vector<WTSTickStruct>& ticks, uint32_t chunkItems)
+{
+	std::string cmpData = ChunkHelper::compress_chunks(ticks.data(), ticks.size(), chunkItems);
+
+	std::string content;
+	content.resize(sizeof(BlockHeaderV2));
+	BlockHeaderV2* block = (BlockHeaderV2*)content.data();
+	strcpy(block->_blk_flag, BLK_FLAG);
+	block->_version = BLOCK_VERSION_CHK_V2;
+	block->_type = BT_HIS_Ticks;
+	block->_size = cmpData.size();
+	content.append(cmpData);
+	return content;
+}
+
+TEST(test_chunk_helper, test_round_trip)
+{
+	std::vector<WTSTickStruct> ticks(10000);
+	for (uint32_t i = 0; i < ticks.size(); i++)
+	{
+		ticks[i].action_date = 20230704;
+		ticks[i].action_time = 90000000 + i * 500;
+		ticks[i].price = 3700 + i % 37;
+	}
+
+	std::string content = make_chunked_block(ticks, 1024);
+	const BlockHeaderV2* blk = (const BlockHeaderV2*)content.data();
+	EXPECT_TRUE(blk->is_compressed());
+	EXPECT_TRUE(blk->is_chunked());
+
+	const BlockChunkFooter* ft = ChunkHelper::footer(blk);
+	ASSERT_TRUE(ft != NULL);
+	EXPECT_EQ(ft->_chunk_count, 10);
+	EXPECT_EQ(ft->_total_count, 10000);
+	EXPECT_EQ(ChunkHelper::uncompressed_size(blk), sizeof(WTSTickStruct) * 10000);
+
+	std::string buffer;
+	ChunkHelper::uncompress_append(buffer, blk);
+	ASSERT_EQ(buffer.size(), sizeof(WTSTickStruct) * 10000);
+	EXPECT_EQ(memcmp(buffer.data(), ticks.data(), buffer.size()), 0);
+}
+
+TEST(test_chunk_helper, test_locate_chunk)
+{
+	std::vector<WTSTickStruct> ticks(5000);
+	for (uint32_t i = 0; i < ticks.size(); i++)
+	{
+		ticks[i].action_date = 20230704;
+		ticks[i].action_time = 90000000 + i * 500;
+	}
+
+	std::string content = make_chunked_block(ticks, 1000);
+	const BlockHeaderV2* blk = (const BlockHeaderV2*)content.data();
+
+	//比第一条还早，没有数据块
+	EXPECT_EQ(ChunkHelper::locate_chunk(blk, ChunkHelper::item_time(ticks[0])), -1);
+	EXPECT_EQ(ChunkHelper::locate_chunk(blk, ChunkHelper::item_time(ticks[1])), 0);
+	//第1000条是第二块的第一条，严格小于它的数据都在第一块
+	EXPECT_EQ(ChunkHelper::locate_chunk(blk, ChunkHelper::item_time(ticks[1000])), 0);
+	EXPECT_EQ(ChunkHelper::locate_chunk(blk, ChunkHelper::item_time(ticks[1001])), 1);
+	EXPECT_EQ(ChunkHelper::locate_chunk(blk, UINT64_MAX), 4);
+
+	std::string chunk;
+	EXPECT_TRUE(ChunkHelper::uncompress_chunk(blk, 3, chunk));
+	ASSERT_EQ(chunk.size(), sizeof(WTSTickStruct) * 1000);
+	EXPECT_EQ(memcmp(chunk.data(), &ticks[3000], chunk.size()), 0);
+	EXPECT_FALSE(ChunkHelper::uncompress_chunk(blk, 5, chunk));
+}
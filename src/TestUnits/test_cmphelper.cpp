@@ -0,0 +1,80 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../WTSUtils/WTSCmpHelper.hpp"
+#include "../Includes/WTSStruct.h"
+
+#include <vector>
+
+USING_NS_WTP;
+
+static void make_ticks(std::vector<WTSTickStruct>& ticks, uint32_t count)
+{
+	ticks.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		WTSTickStruct& ts = ticks[i];
+		strcpy(ts.exchg, "SHFE");
+		strcpy(ts.code, "rb2310");
+		ts.action_date = 20230704;
+		ts.action_time = 90000000 + i * 500;
+		ts.price = 3700 + i % 37;
+		ts.total_volume = i;
+	}
+}
+
+TEST(test_cmphelper, test_uncompress_to)
+{
+	std::vector<WTSTickStruct> ticks;
+	make_ticks(ticks, 10000);
+	std::string cmpData = WTSCmpHelper::compress_data(ticks.data(), sizeof(WTSTickStruct)*ticks.size());
+
+	std::size_t rawSize = WTSCmpHelper::uncompressed_size(cmpData.data(), cmpData.size());
+	EXPECT_EQ(rawSize, sizeof(WTSTickStruct)*ticks.size());
+
+	//直接解压到结构体数组中
+	std::vector<WTSTickStruct> decoded(rawSize / sizeof(WTSTickStruct));
+	EXPECT_EQ(WTSCmpHelper::uncompress_to(decoded.data(), rawSize, cmpData.data(), cmpData.size()), rawSize);
+	EXPECT_EQ(memcmp(decoded.data(), ticks.data(), rawSize), 0);
+
+	//追加到块头后面
+	std::string buffer("HEAD");
+	WTSCmpHelper::uncompress_append(buffer, cmpData.data(), cmpData.size());
+	EXPECT_EQ(buffer.size(), 4 + rawSize);
+	EXPECT_EQ(buffer.compare(0, 4, "HEAD"), 0);
+	EXPECT_EQ(memcmp(buffer.data() + 4, ticks.data(), rawSize), 0);
+
+	//目标缓存不够大要报错
+	EXPECT_THROW(WTSCmpHelper::uncompress_to(decoded.data(), rawSize - 1, cmpData.data(), cmpData.size()), std::runtime_error);
+}
+
+TEST(test_cmphelper, test_stream_chunks)
+{
+	std::vector<WTSTickStruct> ticks;
+	make_ticks(ticks, 10000);
+	std::string cmpData = WTSCmpHelper::compress_data(ticks.data(), sizeof(WTSTickStruct)*ticks.size());
+
+	WTSCmpStream stream;
+	std::vector<WTSTickStruct> chunk(333);
+	for (int round = 0; round < 2; round++)
+	{
+		//解压器可以重复使用
+		stream.reset(cmpData.data(), cmpData.size());
+		uint32_t idx = 0;
+		uint32_t mismatch = 0;
+		std::size_t total = stream.for_each_chunk(chunk.data(), chunk.size(), [&](const WTSTickStruct* items, std::size_t cnt) {
+			EXPECT_LE(cnt, chunk.size());
+			for (std::size_t i = 0; i < cnt; i++, idx++)
+			{
+				if (memcmp(&items[i], &ticks[idx], sizeof(WTSTickStruct)) != 0)
+					mismatch++;
+			}
+		});
+
+		EXPECT_EQ(total, ticks.size());
+		EXPECT_EQ(mismatch, 0);
+		EXPECT_TRUE(stream.finished());
+	}
+
+	//数据被截断要报错
+	stream.reset(cmpData.data(), cmpData.size() / 2);
+	EXPECT_THROW(stream.for_each_chunk(chunk.data(), chunk.size(), [](const WTSTickStruct*, std::size_t) {}), std::runtime_error);
+}
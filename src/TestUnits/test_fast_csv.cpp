@@ -0,0 +1,61 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/FastCsvReader.hpp"
+
+#include <random>
+
+TEST(test_fast_csv, test_parse_double)
+{
+	const char* cases[] = { "0", "-0.5", "3512.2", "+12.000", "0.000001", " 42.75 ", "1e-3", "6.02E23", "123456789012345678", "0.1234567890123456789" };
+	for (const char* s : cases)
+		EXPECT_EQ(FastCsvReader::parse_double(s, s + strlen(s)), strtod(s, NULL)) << s;
+
+	//随机生成的价格，快速路径的结果必须和strtod完全一致
+	std::mt19937 gen(20200330);
+	std::uniform_int_distribution<uint64_t> dist(0, 99999999999ULL);
+	char buf[64];
+	for (int i = 0; i < 10000; i++)
+	{
+		uint64_t v = dist(gen);
+		int len = sprintf(buf, "%llu.%04u", (unsigned long long)(v / 10000), (uint32_t)(v % 10000));
+		EXPECT_EQ(FastCsvReader::parse_double(buf, buf + len), strtod(buf, NULL)) << buf;
+	}
+}
+
+TEST(test_fast_csv, test_rows)
+{
+	std::string content = "\xEF\xBB\xBF<Date>,<Time>,Open,Close\r\n"
+		"2021/3/5,09:01:00,3500.2,3501\r\n"
+		"\r\n"
+		"2021-03-05,1502,3501.4,\n"
+		"20210308,0,3490";
+
+	FastCsvReader reader;
+	ASSERT_TRUE(reader.load_from_buffer(content.data(), content.size()));
+	EXPECT_EQ(reader.col_count(), 4);
+	EXPECT_EQ(reader.col_of("open"), 2);
+	EXPECT_EQ(reader.col_of("volume"), -1);
+
+	int32_t colDate = reader.col_of("date");
+	int32_t colTime = reader.col_of("time");
+	int32_t colClose = reader.col_of("close");
+
+	ASSERT_TRUE(reader.next_row());
+	EXPECT_EQ(reader.get_date(colDate), 20210305);
+	EXPECT_EQ(reader.get_time(colTime), 901);
+	EXPECT_EQ(reader.get_time(colTime, true), 90100);
+	EXPECT_EQ(reader.get_double(colClose), 3501);
+
+	//空行跳过，空字段和缺少的字段都为0
+	ASSERT_TRUE(reader.next_row());
+	EXPECT_EQ(reader.get_date(colDate), 20210305);
+	EXPECT_EQ(reader.get_time(colTime), 1502);
+	EXPECT_EQ(reader.cell_count(), 4);
+	EXPECT_EQ(reader.get_double(colClose), 0);
+
+	ASSERT_TRUE(reader.next_row());
+	EXPECT_EQ(reader.get_date(colDate), 20210308);
+	EXPECT_EQ(reader.cell_count(), 3);
+	EXPECT_EQ(reader.get_double(colClose), 0);
+
+	EXPECT_FALSE(reader.next_row());
+}
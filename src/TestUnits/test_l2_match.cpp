@@ -0,0 +1,186 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../WtBtCore/L2MatchEngine.h"
+#include "../WtBtCore/HisDataReplayer.h"
+#include "../Includes/WTSDataDef.hpp"
+
+#include <functional>
+
+USING_NS_WTP;
+
+/*
+ *	L2MatchEngine只用回放器取合约的最小变动价位，取不到的时候按0.01处理
+ *	测试工程不链接WtBtCore，这里给一个空实现
+ */
+WTSCommodityInfo* HisDataReplayer::get_commodity_info(const char* stdCode)
+{
+	return NULL;
+}
+
+namespace
+{
+	const char* TEST_CODE = "SSE.600000";
+
+	typedef struct _MatchRecord
+	{
+		uint32_t	_localid;
+		bool		_trade;
+		double		_qty;		//成交回报为成交量，订单回报为剩余数量
+		double		_price;
+		bool		_canceled;
+	} MatchRecord;
+
+	class TestMatchSink : public IMatchSink
+	{
+	public:
+		virtual void handle_trade(uint32_t localid, const char* stdCode, bool isBuy, double vol, double fireprice, double price, uint64_t ordTime) override
+		{
+			_records.emplace_back(MatchRecord{ localid, true, vol, price, false });
+			if (_on_trade)
+				_on_trade(localid);
+		}
+
+		virtual void handle_order(uint32_t localid, const char* stdCode, bool isBuy, double leftover, double price, bool isCanceled, uint64_t ordTime) override
+		{
+			_records.emplace_back(MatchRecord{ localid, false, leftover, price, isCanceled });
+		}
+
+		virtual void handle_entrust(uint32_t localid, const char* stdCode, bool bSuccess, const char* message, uint64_t ordTime) override {}
+
+		double traded(uint32_t localid) const
+		{
+			double ret = 0;
+			for (const MatchRecord& r : _records)
+			{
+				if (r._trade && r._localid == localid)
+					ret += r._qty;
+			}
+			return ret;
+		}
+
+		std::vector<MatchRecord>		_records;
+		std::function<void(uint32_t)>	_on_trade;
+	};
+
+	void order_detail(L2MatchEngine& engine, uint64_t ordId, char side, double price, uint32_t qty)
+	{
+		WTSOrdDtlStruct od;
+		od.action_date = 20220104;
+		od.action_time = 93000000 + (uint32_t)ordId;
+		od.index = ordId;
+		od.price = price;
+		od.volume = qty;
+		od.side = side;
+		od.otype = ODT_LimitPrice;
+
+		WTSOrdDtlData* data = WTSOrdDtlData::create(od);
+		engine.handle_order_detail(TEST_CODE, data);
+		data->release();
+	}
+
+	void transaction(L2MatchEngine& engine, char ttype, char side, double price, uint32_t qty, int64_t bidOrd, int64_t askOrd)
+	{
+		WTSTransStruct ts;
+		ts.ttype = ttype;
+		ts.side = side;
+		ts.price = price;
+		ts.volume = qty;
+		ts.bidorder = bidOrd;
+		ts.askorder = askOrd;
+
+		WTSTransData* data = WTSTransData::create(ts);
+		engine.handle_transaction(TEST_CODE, data);
+		data->release();
+	}
+}
+
+TEST(test_l2_match, test_queue_and_partial_fill)
+{
+	L2MatchEngine engine(NULL);
+	TestMatchSink sink;
+	engine.regisSink(&sink);
+
+	order_detail(engine, 1, BDT_Buy, 10.0, 10);
+	order_detail(engine, 2, BDT_Buy, 10.0, 20);
+	engine.place(1, TEST_CODE, true, 10.0, 5, 0);
+	order_detail(engine, 3, BDT_Buy, 10.0, 15);
+
+	//排在前面的只有先到的两笔市场委托
+	EXPECT_EQ(engine.queue_ahead(1), 30);
+	EXPECT_TRUE(sink._records.empty());
+
+	//前面的委托成交，排队位置前移，自己的订单不成交
+	transaction(engine, TT_Match, BDT_Sell, 10.0, 10, 1, 100);
+	EXPECT_EQ(engine.queue_ahead(1), 20);
+	transaction(engine, TT_Match, BDT_Sell, 10.0, 20, 2, 101);
+	EXPECT_EQ(engine.queue_ahead(1), 0);
+	EXPECT_TRUE(sink._records.empty());
+
+	//排在后面的委托成交，说明轮到自己了，只成交一部分
+	transaction(engine, TT_Match, BDT_Sell, 10.0, 3, 3, 102);
+	ASSERT_EQ(sink._records.size(), 2);
+	EXPECT_TRUE(sink._records[0]._trade);
+	EXPECT_EQ(sink._records[0]._qty, 3);
+	EXPECT_FALSE(sink._records[1]._trade);
+	EXPECT_EQ(sink._records[1]._qty, 2);
+
+	//剩下的撤掉
+	EXPECT_EQ(engine.cancel(1), 2);
+	EXPECT_EQ(engine.cancel(1), 0);
+}
+
+TEST(test_l2_match, test_cancel_ahead)
+{
+	L2MatchEngine engine(NULL);
+	TestMatchSink sink;
+	engine.regisSink(&sink);
+
+	order_detail(engine, 1, BDT_Sell, 10.5, 10);
+	order_detail(engine, 2, BDT_Sell, 10.5, 20);
+	engine.place(7, TEST_CODE, false, 10.5, 4, 0);
+	EXPECT_EQ(engine.queue_ahead(7), 30);
+
+	//前面的委托部分撤单和全部撤单
+	transaction(engine, TT_Cancel, BDT_Unknown, 0, 5, 0, 2);
+	EXPECT_EQ(engine.queue_ahead(7), 25);
+	transaction(engine, TT_Cancel, BDT_Unknown, 0, 10, 0, 1);
+	EXPECT_EQ(engine.queue_ahead(7), 15);
+	EXPECT_TRUE(sink._records.empty());
+
+	//更差的价位上成交，说明更优价位上的订单已经成交完了
+	transaction(engine, TT_Match, BDT_Buy, 10.6, 6, 200, 300);
+	EXPECT_EQ(sink.traded(7), 4);
+	EXPECT_EQ(engine.queue_ahead(7), 0);
+	EXPECT_EQ(engine.cancel(7), 0);
+}
+
+TEST(test_l2_match, test_cancel_and_place_in_callback)
+{
+	L2MatchEngine engine(NULL);
+	TestMatchSink sink;
+	engine.regisSink(&sink);
+
+	order_detail(engine, 1, BDT_Buy, 10.0, 10);
+	engine.place(1, TEST_CODE, true, 10.02, 2, 0);
+	engine.place(2, TEST_CODE, true, 10.01, 2, 0);
+
+	//第一笔成交的回调里撤掉第二笔，再下一笔新单，新单会复用释放的节点
+	bool bPlaced = false;
+	sink._on_trade = [&](uint32_t localid) {
+		if (bPlaced)
+			return;
+
+		bPlaced = true;
+		engine.cancel(2);
+		engine.place(3, TEST_CODE, true, 10.01, 100, 0);
+	};
+
+	transaction(engine, TT_Match, BDT_Sell, 10.0, 10, 1, 100);
+
+	//两笔订单都在回调之前成交完，新单不会被当成旧单成交
+	EXPECT_TRUE(bPlaced);
+	EXPECT_EQ(sink.traded(1), 2);
+	EXPECT_EQ(sink.traded(2), 2);
+	EXPECT_EQ(sink.traded(3), 0);
+	EXPECT_EQ(engine.queue_ahead(3), 0);
+	EXPECT_EQ(engine.cancel(3), 100);
+}
@@ -0,0 +1,73 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/LatencyStats.hpp"
+
+#include <thread>
+
+TEST(test_latency_stats, test_buckets)
+{
+	//小于16的值每个值一个桶
+	for (uint64_t v = 0; v < 16; v++)
+	{
+		EXPECT_EQ(LatencyStats::bucket_index(v), v);
+		EXPECT_EQ(LatencyStats::bucket_upper((uint32_t)v), v);
+	}
+
+	//桶的编号是连续的，每个值都落在自己桶的范围内
+	uint32_t lastIdx = 15;
+	for (uint64_t v = 16; v < 100000; v++)
+	{
+		uint32_t idx = LatencyStats::bucket_index(v);
+		EXPECT_TRUE(idx == lastIdx || idx == lastIdx + 1);
+		EXPECT_GE(LatencyStats::bucket_upper(idx), v);
+		if (idx > 0)
+		{
+			EXPECT_LT(LatencyStats::bucket_upper(idx - 1), v);
+		}
+		lastIdx = idx;
+	}
+
+	EXPECT_EQ(LatencyStats::bucket_upper(LatencyStats::bucket_index(UINT64_MAX)), UINT64_MAX);
+}
+
+TEST(test_latency_stats, test_percentiles)
+{
+	LatencyStats::reset();
+
+	//两个线程各记录一半，汇总的时候要合并
+	auto worker = [](uint64_t from, uint64_t to) {
+		for (uint64_t v = from; v <= to; v++)
+			LatencyStats::record(LatencyStats::LS_STRATEGY, (int64_t)v);
+	};
+	std::thread t1(worker, 1, 500);
+	std::thread t2(worker, 501, 1000);
+	t1.join();
+	t2.join();
+
+	LatencyStats::StageSummary summary;
+	LatencyStats::summarize(LatencyStats::LS_STRATEGY, summary);
+	EXPECT_EQ(summary._count, 1000);
+	EXPECT_EQ(summary._max, 1000);
+	EXPECT_DOUBLE_EQ(summary._mean, 500.5);
+
+	//分桶的相对误差在1/16以内
+	EXPECT_GE(summary._p50, 500);
+	EXPECT_LE(summary._p50, 500 * 17 / 16);
+	EXPECT_GE(summary._p99, 990);
+	EXPECT_LE(summary._p99, 1000);
+	EXPECT_GE(summary._p999, 999);
+	EXPECT_LE(summary._p999, 1000);
+
+	LatencyStats::summarize(LatencyStats::LS_PARSER, summary);
+	EXPECT_EQ(summary._count, 0);
+
+	//委托回报只统计第一次
+	LatencyStats::mark_entrust(12345);
+	LatencyStats::ack_entrust(12345);
+	LatencyStats::ack_entrust(12345);
+	LatencyStats::summarize(LatencyStats::LS_ORDER_RSP, summary);
+	EXPECT_EQ(summary._count, 1);
+
+	LatencyStats::reset();
+	LatencyStats::summarize(LatencyStats::LS_STRATEGY, summary);
+	EXPECT_EQ(summary._count, 0);
+}
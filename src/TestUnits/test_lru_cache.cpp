@@ -0,0 +1,102 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/WtLruCache.hpp"
+
+#include <thread>
+
+TEST(test_lru_cache, test_get_and_put)
+{
+	WtLruCache cache;
+	EXPECT_FALSE(cache.get<std::string>("a"));
+
+	cache.put("a", std::make_shared<std::string>("hello"), 5);
+	std::shared_ptr<std::string> a = cache.get<std::string>("a");
+	ASSERT_TRUE(a);
+	EXPECT_EQ(*a, "hello");
+
+	//替换已有的记录，字节数也要跟着变
+	cache.put("a", std::make_shared<std::string>("world!"), 6);
+	EXPECT_EQ(*cache.get<std::string>("a"), "world!");
+	EXPECT_EQ(*a, "hello");
+
+	WtLruCache::CacheStats stats = cache.stats();
+	EXPECT_EQ(stats._hits, 2);
+	EXPECT_EQ(stats._misses, 1);
+	EXPECT_EQ(stats._bytes, 6);
+	EXPECT_EQ(stats._entries, 1);
+
+	cache.erase("a");
+	EXPECT_EQ(cache.stats()._bytes, 0);
+	EXPECT_FALSE(cache.get<std::string>("a"));
+}
+
+TEST(test_lru_cache, test_evict_by_budget)
+{
+	WtLruCache cache(300);
+	cache.put("a", std::make_shared<int>(1), 100);
+	cache.put("b", std::make_shared<int>(2), 100);
+	cache.put("c", std::make_shared<int>(3), 100);
+
+	//依次访问a、c、b以后，最久没访问的是a
+	std::shared_ptr<int> a = cache.get<int>("a");
+	cache.get<int>("c");
+	cache.get<int>("b");
+	cache.put("d", std::make_shared<int>(4), 100);
+
+	EXPECT_FALSE(cache.get<int>("a"));
+	EXPECT_TRUE(cache.get<int>("c"));
+	EXPECT_TRUE(cache.get<int>("d"));
+
+	//被淘汰的对象外面还持有引用，不能被释放
+	EXPECT_EQ(*a, 1);
+
+	WtLruCache::CacheStats stats = cache.stats();
+	EXPECT_EQ(stats._evictions, 1);
+	EXPECT_EQ(stats._evicted_bytes, 100);
+	EXPECT_EQ(stats._bytes, 300);
+
+	//对象变大以后也要淘汰，最近放进来的一条保留
+	cache.update_size("d", 1000);
+	stats = cache.stats();
+	EXPECT_EQ(stats._entries, 1);
+	EXPECT_EQ(stats._bytes, 1000);
+	EXPECT_TRUE(cache.get<int>("d"));
+
+	//调小预算
+	cache.put("e", std::make_shared<int>(5), 10);
+	cache.set_budget(10);
+	EXPECT_EQ(cache.stats()._entries, 1);
+	EXPECT_TRUE(cache.get<int>("e"));
+
+	cache.clear();
+	EXPECT_EQ(cache.stats()._entries, 0);
+	EXPECT_EQ(cache.stats()._bytes, 0);
+}
+
+TEST(test_lru_cache, test_concurrent_access)
+{
+	WtLruCache cache(64 * 8);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&cache, t]() {
+			for (int i = 0; i < 10000; i++)
+			{
+				std::string key = std::to_string((i * 7 + t) % 128);
+				std::shared_ptr<int> v = cache.get<int>(key);
+				if (v)
+					EXPECT_EQ(*v, atoi(key.c_str()));
+				else
+					cache.put(key, std::make_shared<int>(atoi(key.c_str())), 8);
+			}
+		});
+	}
+
+	for (auto& thrd : threads)
+		thrd.join();
+
+	WtLruCache::CacheStats stats = cache.stats();
+	EXPECT_LE(stats._bytes, 64 * 8);
+	EXPECT_EQ(stats._bytes, stats._entries * 8);
+	EXPECT_EQ(stats._hits + stats._misses, 40000);
+}
@@ -0,0 +1,88 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/MpscQueue.hpp"
+
+#include <thread>
+#include <vector>
+#include <memory>
+
+typedef struct _QueueItem
+{
+	uint32_t	_producer;
+	uint64_t	_seq;
+	std::shared_ptr<int>	_ref;	//用来检查出队以后有没有正确析构
+
+	_QueueItem(uint32_t producer, uint64_t seq, const std::shared_ptr<int>& ref)
+		: _producer(producer), _seq(seq), _ref(ref) {}
+} QueueItem;
+
+TEST(test_mpsc_queue, test_push_consume)
+{
+	std::shared_ptr<int> ref(new int(0));
+	{
+		MpscQueue<QueueItem> queue(10);
+		EXPECT_EQ(queue.capacity(), 16);
+		EXPECT_TRUE(queue.empty());
+
+		for (uint64_t i = 0; i < 16; i++)
+			EXPECT_TRUE(queue.try_emplace(0, i, ref));
+
+		//队列满了
+		EXPECT_FALSE(queue.try_emplace(0, 16, ref));
+		EXPECT_EQ(ref.use_count(), 17);
+
+		uint64_t next = 0;
+		uint64_t cnt = queue.consume([&next](QueueItem& item) { EXPECT_EQ(item._seq, next++); }, 10);
+		EXPECT_EQ(cnt, 10);
+		EXPECT_EQ(ref.use_count(), 7);
+		EXPECT_TRUE(queue.try_emplace(0, 16, ref));
+
+		//剩下的留给析构函数处理
+	}
+	EXPECT_EQ(ref.use_count(), 1);
+}
+
+TEST(test_mpsc_queue, test_multi_producers)
+{
+	const uint32_t producers = 4;
+	const uint64_t total = 200000;
+	std::shared_ptr<int> ref(new int(0));
+
+	MpscQueue<QueueItem> queue(1024);
+	std::vector<std::thread> threads;
+	for (uint32_t p = 0; p < producers; p++)
+	{
+		threads.emplace_back([&, p]() {
+			for (uint64_t i = 0; i < total; i++)
+			{
+				while (!queue.try_emplace(p, i, ref))
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	//每个写线程的数据必须按顺序出队，且不能多也不能少
+	std::vector<uint64_t> nexts(producers, 0);
+	uint64_t received = 0;
+	uint64_t disorder = 0;
+	while (received < producers * total)
+	{
+		uint64_t cnt = queue.consume([&](QueueItem& item) {
+			if (item._seq != nexts[item._producer])
+				disorder++;
+			nexts[item._producer] = item._seq + 1;
+		});
+
+		if (cnt == 0)
+			std::this_thread::yield();
+		received += cnt;
+	}
+
+	for (auto& t : threads)
+		t.join();
+
+	EXPECT_EQ(disorder, 0);
+	EXPECT_TRUE(queue.empty());
+	EXPECT_EQ(ref.use_count(), 1);
+	for (uint32_t p = 0; p < producers; p++)
+		EXPECT_EQ(nexts[p], total);
+}
@@ -75,4 +75,146 @@ private:
 //	}
 //	uint64_t time_b = ticker.nano_seconds();
 //	printf("boost::object_pool: %I64d - optimized_object_pool: %I64d\n", time_a, time_b);
-//}
\ No newline at end of file
+//}
+#include <thread>
+#include <vector>
+#include "../Includes/WTSObject.hpp"
+
+USING_NS_WTP;
+
+class PoolItem : public WTSPoolObject<PoolItem>
+{
+public:
+	PoolItem() :_seq(0) { _alive++; }
+	virtual ~PoolItem() { _alive--; }
+
+	uint64_t	_seq;
+	char		_buf[120];
+
+	static std::atomic<int64_t>	_alive;
+};
+std::atomic<int64_t> PoolItem::_alive(0);
+
+TEST(test_object_pool, test_magazine_local)
+{
+	auto before = PoolItem::pool_stats();
+
+	std::vector<PoolItem*> items;
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		PoolItem* p = PoolItem::allocate();
+		p->_seq = i;
+		items.emplace_back(p);
+	}
+	EXPECT_EQ(PoolItem::_alive, 1000);
+
+	//引用计数没有归零之前不能回到池子里
+	items[0]->retain();
+	for (PoolItem* p : items)
+		p->release();
+	EXPECT_EQ(PoolItem::_alive, 1);
+	EXPECT_EQ(items[0]->_seq, 0);
+	items[0]->release();
+	EXPECT_EQ(PoolItem::_alive, 0);
+
+	//归还的槽位会被重新使用，容量不再增长
+	auto mid = PoolItem::pool_stats();
+	for (uint32_t i = 0; i < 1000; i++)
+		items[i] = PoolItem::allocate();
+	for (PoolItem* p : items)
+		p->release();
+
+	auto after = PoolItem::pool_stats();
+	EXPECT_EQ(after._capacity, mid._capacity);
+	EXPECT_EQ(after._allocs - before._allocs, 2000);
+	EXPECT_EQ(after._local_frees - before._local_frees, 2000);
+	EXPECT_EQ(after._remote_frees, before._remote_frees);
+}
+
+TEST(test_object_pool, test_magazine_cross_thread)
+{
+	auto before = PoolItem::pool_stats();
+
+	const uint32_t producers = 4;
+	const uint32_t count = 20000;
+	std::vector<std::vector<PoolItem*>> queues(producers);
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < producers; t++)
+	{
+		threads.emplace_back([&queues, t, count]() {
+			for (uint32_t i = 0; i < count; i++)
+			{
+				PoolItem* p = PoolItem::allocate();
+				p->_seq = t * count + i;
+				queues[t].emplace_back(p);
+			}
+		});
+	}
+	for (auto& th : threads)
+		th.join();
+	threads.clear();
+
+	//生产线程都已经退出，对象在其他线程里释放，同时还有线程在分配
+	for (uint32_t t = 0; t < producers; t++)
+	{
+		threads.emplace_back([&queues, t, count]() {
+			for (uint32_t i = 0; i < count; i++)
+			{
+				PoolItem* p = queues[t][i];
+				EXPECT_EQ(p->_seq, t * count + i);
+				p->release();
+
+				PoolItem* q = PoolItem::allocate();
+				q->release();
+			}
+		});
+	}
+	for (auto& th : threads)
+		th.join();
+
+	EXPECT_EQ(PoolItem::_alive, 0);
+
+	auto after = PoolItem::pool_stats();
+	EXPECT_EQ(after._allocs - before._allocs, producers * count * 2);
+	EXPECT_EQ((after._local_frees + after._remote_frees) - (before._local_frees + before._remote_frees), producers * count * 2);
+	EXPECT_GT(after._remote_frees, before._remote_frees);
+	//线程缓存被后面的线程接管，不会随着线程数一直增长
+	EXPECT_LE(after._caches, before._caches + producers);
+}
+
+//防止编译器把new/delete优化掉
+static A* volatile g_sink = NULL;
+
+TEST(test_object_pool, test_magazine_benchmark)
+{
+	const uint32_t times = 1000000;
+	TimeUtils::Ticker ticker;
+	for (uint32_t i = 0; i < times; i++)
+	{
+		A* p = new A;
+		g_sink = p;
+		delete p;
+	}
+	uint64_t time_a = ticker.nano_seconds();
+
+	boost::object_pool<A> boost_pool;
+	ticker.reset();
+	for (uint32_t i = 0; i < times; i++)
+	{
+		A* p = boost_pool.construct();
+		boost_pool.destroy(p);
+	}
+	uint64_t time_b = ticker.nano_seconds();
+
+	ticker.reset();
+	for (uint32_t i = 0; i < times; i++)
+	{
+		MagazinePool<A>::ThreadCache* owner = NULL;
+		A* p = MagazinePool<A>::construct(owner);
+		MagazinePool<A>::destroy(p, owner);
+	}
+	uint64_t time_c = ticker.nano_seconds();
+
+	printf("new/delete: %.1fns - boost::object_pool: %.1fns - MagazinePool: %.1fns\n",
+		time_a*1.0 / times, time_b*1.0 / times, time_c*1.0 / times);
+}
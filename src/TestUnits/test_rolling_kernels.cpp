@@ -0,0 +1,151 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/RollingKernels.hpp"
+#include "../Includes/WTSDataDef.hpp"
+
+#include <random>
+
+USING_NS_WTP;
+
+namespace
+{
+	std::vector<double> make_prices(std::size_t cnt)
+	{
+		std::mt19937 gen(20200330);
+		std::normal_distribution<double> dist(0, 2.0);
+		std::vector<double> ret(cnt);
+		double px = 3500;
+		for (std::size_t i = 0; i < cnt; i++)
+		{
+			px += dist(gen);
+			ret[i] = px;
+		}
+		return ret;
+	}
+}
+
+TEST(test_rolling_kernels, test_window_kernels)
+{
+	const std::size_t cnt = 1003;	//故意不是4的倍数，尾部要走标量
+	const uint32_t period = 20;
+	std::vector<double> src = make_prices(cnt);
+	std::vector<double> dst(cnt);
+
+	RollingKernels::sma(src.data(), dst.data(), cnt, period);
+	for (std::size_t i = 0; i < period - 1; i++)
+		EXPECT_EQ(dst[i], INVALID_DOUBLE);
+	for (std::size_t i = period - 1; i < cnt; i++)
+	{
+		double s = 0;
+		for (std::size_t j = i + 1 - period; j <= i; j++)
+			s += src[j];
+		EXPECT_NEAR(dst[i], s / period, 1e-8);
+	}
+
+	RollingKernels::stddev(src.data(), dst.data(), cnt, period);
+	for (std::size_t i = period - 1; i < cnt; i++)
+	{
+		double s = 0, sq = 0;
+		for (std::size_t j = i + 1 - period; j <= i; j++)
+			s += src[j];
+		double mean = s / period;
+		for (std::size_t j = i + 1 - period; j <= i; j++)
+			sq += (src[j] - mean)*(src[j] - mean);
+		EXPECT_NEAR(dst[i], sqrt(sq / period), 1e-5);
+	}
+
+	std::vector<double> lows(cnt);
+	RollingKernels::rolling_max(src.data(), dst.data(), cnt, period);
+	RollingKernels::rolling_min(src.data(), lows.data(), cnt, period);
+	for (std::size_t i = period - 1; i < cnt; i++)
+	{
+		double hh = src[i], ll = src[i];
+		for (std::size_t j = i + 1 - period; j <= i; j++)
+		{
+			if (src[j] > hh) hh = src[j];
+			if (src[j] < ll) ll = src[j];
+		}
+		EXPECT_EQ(dst[i], hh);
+		EXPECT_EQ(lows[i], ll);
+	}
+
+	RollingKernels::ema(src.data(), dst.data(), cnt, period);
+	double val = 0;
+	for (std::size_t i = 0; i < period; i++)
+		val += src[i];
+	val /= period;
+	EXPECT_NEAR(dst[period - 1], val, 1e-8);
+	for (std::size_t i = period; i < cnt; i++)
+	{
+		val = val + 2.0 / (period + 1) * (src[i] - val);
+		EXPECT_NEAR(dst[i], val, 1e-8);
+	}
+
+	//数据不够一个窗口，全部为无效值
+	RollingKernels::sma(src.data(), dst.data(), 5, period);
+	for (std::size_t i = 0; i < 5; i++)
+		EXPECT_EQ(dst[i], INVALID_DOUBLE);
+}
+
+TEST(test_rolling_kernels, test_atr)
+{
+	const std::size_t cnt = 501;
+	const uint32_t period = 14;
+	std::vector<double> close = make_prices(cnt);
+	std::vector<double> high(cnt), low(cnt);
+	for (std::size_t i = 0; i < cnt; i++)
+	{
+		high[i] = close[i] + (i % 7) * 0.5;
+		low[i] = close[i] - (i % 5) * 0.5;
+	}
+
+	std::vector<double> tr(cnt), dst(cnt);
+	RollingKernels::true_range(high.data(), low.data(), close.data(), tr.data(), cnt);
+	EXPECT_DOUBLE_EQ(tr[0], high[0] - low[0]);
+	for (std::size_t i = 1; i < cnt; i++)
+	{
+		double r = std::max(high[i] - low[i], std::max(fabs(high[i] - close[i - 1]), fabs(low[i] - close[i - 1])));
+		EXPECT_DOUBLE_EQ(tr[i], r);
+	}
+
+	RollingKernels::atr(high.data(), low.data(), close.data(), dst.data(), cnt, period);
+	double val = 0;
+	for (std::size_t i = 0; i < period; i++)
+		val += tr[i];
+	val /= period;
+	EXPECT_NEAR(dst[period - 1], val, 1e-8);
+	for (std::size_t i = period; i < cnt; i++)
+	{
+		val = (val * (period - 1) + tr[i]) / period;
+		EXPECT_NEAR(dst[i], val, 1e-8);
+	}
+}
+
+TEST(test_rolling_kernels, test_extract_slice)
+{
+	WTSBarStruct bars[5];
+	for (uint32_t i = 0; i < 5; i++)
+		bars[i].close = i + 1;
+
+	//两个块，抽取的区间跨块
+	WTSKlineSlice* slice = WTSKlineSlice::create("CFFEX.IF.HOT", KP_Minute1, 1, bars, 2);
+	slice->appendBlock(bars + 2, 3);
+
+	WTSValueArray* ay = slice->extractData(KFT_CLOSE, 1, 3);
+	ASSERT_TRUE(ay != NULL);
+	ASSERT_EQ(ay->size(), 3);
+	EXPECT_EQ(ay->at(0), 2);
+	EXPECT_EQ(ay->at(2), 4);
+	ay->release();
+
+	ay = slice->extractData(KFT_CLOSE);
+	EXPECT_EQ(ay->size(), 5);
+	ay->release();
+
+	//区间整个超出范围返回空数组
+	ay = slice->extractData(KFT_CLOSE, 5, 8);
+	ASSERT_TRUE(ay != NULL);
+	EXPECT_EQ(ay->size(), 0);
+	ay->release();
+
+	slice->release();
+}
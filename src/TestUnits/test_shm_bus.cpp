@@ -0,0 +1,122 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/ShmQuoteBus.hpp"
+
+#include <thread>
+#include <vector>
+
+static void* aligned_addr(std::vector<char>& buffer)
+{
+	return (void*)(((uintptr_t)buffer.data() + SPMC_CACHELINE - 1) & ~(uintptr_t)(SPMC_CACHELINE - 1));
+}
+
+TEST(test_shm_bus, test_snapshot_and_events)
+{
+	std::size_t size = ShmQuoteBus::calc_size(4, 16);
+	std::vector<char> buffer(size + SPMC_CACHELINE);
+	void* addr = aligned_addr(buffer);
+
+	ShmQuoteBusWriter writer;
+	EXPECT_TRUE(writer.init(addr, 4, 16, 1, 1));
+	EXPECT_EQ(writer.add_slot("SHFE.rb2301"), 0);
+	EXPECT_EQ(writer.add_slot("SHFE.hc2301"), 1);
+
+	ShmQuoteBusReader reader;
+	EXPECT_FALSE(reader.attach(addr, size - 1, true));
+	EXPECT_TRUE(reader.attach(addr, size, true));
+	EXPECT_EQ(reader.slot_count(), 2);
+	EXPECT_STREQ(reader.slot_code(1), "SHFE.hc2301");
+
+	WTSTickStruct tick;
+	uint64_t version = 0;
+	EXPECT_FALSE(reader.read_tick(0, tick, version));
+
+	//同一个合约连续写三笔，快照只保留最新的一笔，事件有三条
+	for (uint32_t i = 1; i <= 3; i++)
+	{
+		WTSTickStruct ts;
+		ts.price = 100 + i;
+		writer.publish_tick(0, ts);
+	}
+
+	EXPECT_EQ(reader.tick_version(0), 3);
+	EXPECT_TRUE(reader.read_tick(0, tick, version));
+	EXPECT_EQ(version, 3);
+	EXPECT_DOUBLE_EQ(tick.price, 103);
+
+	//写端写到一半就退出了，版本号停在奇数上，读端不能一直等
+	ShmQuoteBus::slots((ShmQuoteBus::Header*)addr)[1]._stamp.store(1);
+	EXPECT_FALSE(reader.read_tick(1, tick, version));
+
+	writer.publish_event(3, 1, [](ShmQuoteBus::BusEvent& evt) {
+		evt._trans.price = 55;
+	});
+
+	ShmQuoteBus::BusEvent evt;
+	uint64_t lost = 0;
+	for (uint64_t i = 1; i <= 3; i++)
+	{
+		EXPECT_EQ(reader.read_event(evt, lost), ShmQuoteBusReader::EventReader::RS_OK);
+		EXPECT_EQ(evt._type, 0);
+		EXPECT_EQ(evt._slot, 0);
+		EXPECT_EQ(evt._version, i);
+	}
+	EXPECT_EQ(reader.read_event(evt, lost), ShmQuoteBusReader::EventReader::RS_OK);
+	EXPECT_EQ(evt._type, 3);
+	EXPECT_EQ(evt._slot, 1);
+	EXPECT_DOUBLE_EQ(evt._trans.price, 55);
+	EXPECT_EQ(reader.read_event(evt, lost), ShmQuoteBusReader::EventReader::RS_Empty);
+
+	//槽位用完了
+	EXPECT_EQ(writer.add_slot("SHFE.au2302"), 2);
+	EXPECT_EQ(writer.add_slot("SHFE.ag2302"), 3);
+	EXPECT_EQ(writer.add_slot("SHFE.cu2302"), UINT32_MAX);
+
+	//写端重新初始化以后，读端要能检测到
+	EXPECT_TRUE(writer.init(addr, 4, 16, 1, 2));
+	EXPECT_TRUE(reader.is_reset());
+}
+
+TEST(test_shm_bus, test_no_torn_snapshot)
+{
+	std::size_t size = ShmQuoteBus::calc_size(1, 1024);
+	std::vector<char> buffer(size + SPMC_CACHELINE);
+	void* addr = aligned_addr(buffer);
+
+	ShmQuoteBusWriter writer;
+	EXPECT_TRUE(writer.init(addr, 1, 1024, 1, 1));
+	writer.add_slot("SHFE.rb2301");
+
+	ShmQuoteBusReader reader;
+	EXPECT_TRUE(reader.attach(addr, size, true));
+
+	const uint32_t total = 200000;
+	std::thread thrd([&writer]() {
+		WTSTickStruct ts;
+		for (uint32_t i = 1; i <= total; i++)
+		{
+			//每个字段都写成同一个值，读到撕裂的数据就能发现
+			ts.price = ts.open = ts.high = ts.low = ts.volume = i;
+			ts.action_time = i;
+			writer.publish_tick(0, ts);
+		}
+	});
+
+	uint64_t lastVer = 0;
+	bool bTorn = false;
+	while (lastVer < total)
+	{
+		WTSTickStruct tick;
+		uint64_t version = 0;
+		if (!reader.read_tick(0, tick, version))
+			continue;
+
+		if (tick.action_time != version || tick.price != version || tick.low != version || tick.volume != version)
+			bTorn = true;
+
+		EXPECT_GE(version, lastVer);
+		lastVer = version;
+	}
+	thrd.join();
+
+	EXPECT_FALSE(bTorn);
+}
@@ -0,0 +1,155 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/SpmcRing.hpp"
+
+#include <thread>
+#include <vector>
+
+typedef struct _TestItem
+{
+	uint64_t	_seq;
+	uint64_t	_check;
+	char		_payload[200];
+} TestItem;
+
+typedef SpmcRing<TestItem>			TestRing;
+typedef SpmcRingWriter<TestItem>	TestWriter;
+typedef SpmcRingReader<TestItem>	TestReader;
+
+TEST(test_spmc_ring, test_read_write)
+{
+	EXPECT_EQ(TestRing::round_capacity(1000), 1024);
+	EXPECT_EQ(TestRing::round_capacity(1024), 1024);
+
+	std::vector<char> buffer(TestRing::calc_size(16) + SPMC_CACHELINE);
+	void* addr = (void*)(((uintptr_t)buffer.data() + SPMC_CACHELINE - 1) & ~(uintptr_t)(SPMC_CACHELINE - 1));
+
+	TestWriter writer;
+	EXPECT_TRUE(writer.init(addr, 16, 1, 1));
+
+	TestReader reader;
+	EXPECT_TRUE(reader.attach(addr, true));
+
+	TestItem item;
+	uint64_t lost = 0;
+	EXPECT_EQ(reader.read(item, lost), TestReader::RS_Empty);
+
+	for (uint64_t i = 0; i < 10; i++)
+		writer.push([i](TestItem& it) { it._seq = i; it._check = ~i; });
+
+	for (uint64_t i = 0; i < 10; i++)
+	{
+		EXPECT_EQ(reader.read(item, lost), TestReader::RS_OK);
+		EXPECT_EQ(item._seq, i);
+		EXPECT_EQ(item._check, ~i);
+	}
+	EXPECT_EQ(reader.read(item, lost), TestReader::RS_Empty);
+
+	//写入超过一圈，读端应该检测到丢失
+	for (uint64_t i = 10; i < 50; i++)
+		writer.push([i](TestItem& it) { it._seq = i; it._check = ~i; });
+
+	EXPECT_EQ(reader.read(item, lost), TestReader::RS_Overrun);
+	EXPECT_EQ(lost, 24);
+	EXPECT_EQ(item._seq, 34);
+	EXPECT_EQ(reader.total_lost(), 24);
+	EXPECT_EQ(reader.pending(), 15);
+}
+
+TEST(test_spmc_ring, test_lost_without_data)
+{
+	std::vector<char> buffer(TestRing::calc_size(16) + SPMC_CACHELINE);
+	void* addr = (void*)(((uintptr_t)buffer.data() + SPMC_CACHELINE - 1) & ~(uintptr_t)(SPMC_CACHELINE - 1));
+
+	TestWriter writer;
+	EXPECT_TRUE(writer.init(addr, 16, 1, 1));
+
+	TestReader reader;
+	EXPECT_TRUE(reader.attach(addr, true));
+
+	for (uint64_t i = 0; i < 20; i++)
+		writer.push([i](TestItem& it) { it._seq = i; it._check = ~i; });
+
+	//跳过了4条，但是要读的槽位还没有写好，不能返回旧数据，丢失的条数也要记上
+	TestRing::Slot* slots = TestRing::slots((TestRing::Header*)addr);
+	slots[4]._stamp.store(0);
+
+	TestItem item;
+	item._seq = UINT64_MAX;
+	uint64_t lost = 0;
+	EXPECT_EQ(reader.read(item, lost), TestReader::RS_Empty);
+	EXPECT_EQ(lost, 4);
+	EXPECT_EQ(item._seq, UINT64_MAX);
+	EXPECT_EQ(reader.total_lost(), 4);
+}
+
+TEST(test_spmc_ring, test_multi_readers)
+{
+	const uint64_t capacity = 1024;
+	const uint64_t total = 200000;
+	std::vector<char> buffer(TestRing::calc_size(capacity) + SPMC_CACHELINE);
+	void* addr = (void*)(((uintptr_t)buffer.data() + SPMC_CACHELINE - 1) & ~(uintptr_t)(SPMC_CACHELINE - 1));
+
+	TestWriter writer;
+	writer.init(addr, capacity, 1, 1);
+
+	//读端要在写入前挂上去，保证从第一条开始读
+	std::vector<TestReader> readers(4);
+	for (auto& reader : readers)
+		EXPECT_TRUE(reader.attach(addr, false));
+
+	std::vector<std::thread> threads;
+	std::vector<uint64_t> torn(4, 0);
+	std::vector<uint64_t> received(4, 0);
+	std::vector<uint64_t> lostCnt(4, 0);
+	for (int i = 0; i < 4; i++)
+	{
+		threads.emplace_back([&, i]() {
+			TestReader& reader = readers[i];
+			TestItem item;
+			uint64_t lost = 0;
+			uint64_t last = 0;
+			bool bFirst = true;
+			while (true)
+			{
+				auto state = reader.read(item, lost);
+				if (state == TestReader::RS_Empty)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				if (item._check != ~item._seq)
+					torn[i]++;
+
+				//序号必须严格递增，且跳过的条数等于报告的丢失条数
+				if (!bFirst && item._seq != last + 1 + lost)
+					torn[i]++;
+
+				bFirst = false;
+				last = item._seq;
+				received[i]++;
+				lostCnt[i] += lost;
+				if (last == total - 1)
+					break;
+			}
+		});
+	}
+
+	for (uint64_t i = 0; i < total; i++)
+	{
+		writer.push([i](TestItem& it) {
+			it._seq = i;
+			memset(it._payload, (int)i, sizeof(it._payload));
+			it._check = ~i;
+		});
+	}
+
+	for (auto& t : threads)
+		t.join();
+
+	for (int i = 0; i < 4; i++)
+	{
+		EXPECT_EQ(torn[i], 0);
+		EXPECT_EQ(received[i] + lostCnt[i], total);
+	}
+}
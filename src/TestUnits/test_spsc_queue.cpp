@@ -0,0 +1,77 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/SpscQueue.hpp"
+
+#include <thread>
+#include <memory>
+
+typedef struct _SpscItem
+{
+	uint64_t	_seq;
+	std::shared_ptr<int>	_ref;	//用来检查出队以后有没有正确析构
+
+	_SpscItem(uint64_t seq, const std::shared_ptr<int>& ref) : _seq(seq), _ref(ref) {}
+} SpscItem;
+
+TEST(test_spsc_queue, test_push_consume)
+{
+	std::shared_ptr<int> ref(new int(0));
+	{
+		SpscQueue<SpscItem> queue(10);
+		EXPECT_EQ(queue.capacity(), 16);
+		EXPECT_TRUE(queue.empty());
+
+		for (uint64_t i = 0; i < 16; i++)
+			EXPECT_TRUE(queue.try_emplace(i, ref));
+
+		//队列满了
+		EXPECT_FALSE(queue.try_emplace(16, ref));
+		EXPECT_EQ(queue.size(), 16);
+		EXPECT_EQ(ref.use_count(), 17);
+
+		uint64_t next = 0;
+		uint64_t cnt = queue.consume([&next](SpscItem& item) { EXPECT_EQ(item._seq, next++); }, 10);
+		EXPECT_EQ(cnt, 10);
+		EXPECT_EQ(queue.size(), 6);
+		EXPECT_EQ(ref.use_count(), 7);
+		EXPECT_TRUE(queue.try_emplace(16, ref));
+
+		//剩下的留给析构函数处理
+	}
+	EXPECT_EQ(ref.use_count(), 1);
+}
+
+TEST(test_spsc_queue, test_two_threads)
+{
+	const uint64_t total = 1000000;
+	std::shared_ptr<int> ref(new int(0));
+
+	SpscQueue<SpscItem> queue(256);
+	std::thread producer([&]() {
+		for (uint64_t i = 0; i < total; i++)
+		{
+			while (!queue.try_emplace(i, ref))
+				std::this_thread::yield();
+		}
+	});
+
+	//数据必须按顺序出队，且不能多也不能少
+	uint64_t next = 0;
+	uint64_t disorder = 0;
+	while (next < total)
+	{
+		uint64_t cnt = queue.consume([&](SpscItem& item) {
+			if (item._seq != next)
+				disorder++;
+			next = item._seq + 1;
+		});
+
+		if (cnt == 0)
+			std::this_thread::yield();
+	}
+
+	producer.join();
+
+	EXPECT_EQ(disorder, 0);
+	EXPECT_TRUE(queue.empty());
+	EXPECT_EQ(ref.use_count(), 1);
+}
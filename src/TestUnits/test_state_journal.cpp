@@ -0,0 +1,162 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/StateJournal.hpp"
+
+#include <map>
+
+namespace
+{
+	typedef std::map<std::string, std::string> StateMap;
+
+	StateMap read_all(const StateJournal& journal)
+	{
+		StateMap ret;
+		journal.iterate([&ret](uint16_t type, const char* key, const char* data, uint32_t len) {
+			ret[std::to_string(type) + ":" + key] = std::string(data, len);
+		});
+		return ret;
+	}
+}
+
+TEST(test_state_journal, test_put_and_replay)
+{
+	const char* filename = "./test_state_journal.sdj";
+	boost::filesystem::remove(filename);
+
+	{
+		StateJournal journal;
+		ASSERT_TRUE(journal.open(filename, 1, 4096));
+		EXPECT_TRUE(journal.is_fresh());
+
+		journal.begin();
+		EXPECT_TRUE(journal.put(1, "SHFE.rb.HOT", "pos-1", 5));
+		EXPECT_TRUE(journal.put(1, "DCE.i.HOT", "pos-2", 5));
+		EXPECT_TRUE(journal.put(2, "SHFE.rb.HOT", "sig", 3));
+		journal.sweep(1);
+		journal.commit();
+
+		//内容没变的记录不再追加
+		uint64_t used = journal.used_bytes();
+		journal.begin();
+		EXPECT_FALSE(journal.put(1, "SHFE.rb.HOT", "pos-1", 5));
+		EXPECT_TRUE(journal.put(1, "DCE.i.HOT", "pos-22", 6));
+		EXPECT_GT(journal.used_bytes(), used);
+		EXPECT_EQ(journal.sweep(1), 0);
+		journal.commit();
+
+		//没有put过的记录会被sweep删掉，其他类型的不受影响
+		journal.begin();
+		journal.put(1, "DCE.i.HOT", "pos-22", 6);
+		EXPECT_EQ(journal.sweep(1), 1);
+		journal.commit();
+
+		//没有提交的记录重新打开以后就没有了
+		journal.put(3, "uncommitted", "x", 1);
+	}
+
+	{
+		StateJournal journal;
+		ASSERT_TRUE(journal.open(filename, 1, 4096));
+		EXPECT_FALSE(journal.is_fresh());
+
+		StateMap states = read_all(journal);
+		EXPECT_EQ(states.size(), 2);
+		EXPECT_EQ(states["1:DCE.i.HOT"], "pos-22");
+		EXPECT_EQ(states["2:SHFE.rb.HOT"], "sig");
+	}
+
+	//schema不一致的时候丢弃原有的记录
+	{
+		StateJournal journal;
+		ASSERT_TRUE(journal.open(filename, 2, 4096));
+		EXPECT_TRUE(journal.is_fresh());
+		EXPECT_EQ(journal.record_count(), 0);
+	}
+
+	boost::filesystem::remove(filename);
+	boost::filesystem::remove(std::string(filename) + ".bak");
+}
+
+TEST(test_state_journal, test_grow_and_compact)
+{
+	const char* filename = "./test_state_journal_compact.sdj";
+	boost::filesystem::remove(filename);
+
+	StateMap expected;
+	{
+		StateJournal journal;
+		ASSERT_TRUE(journal.open(filename, 1, 1024));
+
+		//反复覆盖同一批键，文件要扩容，失效的记录远多于有效的记录
+		for (uint32_t round = 0; round < 200; round++)
+		{
+			journal.begin();
+			for (uint32_t i = 0; i < 20; i++)
+			{
+				std::string key = "code" + std::to_string(i);
+				std::string val(64 + i, (char)('a' + (round + i) % 26));
+				journal.put(1, key.c_str(), val.data(), (uint32_t)val.size());
+				expected["1:" + key] = val;
+			}
+			journal.commit();
+		}
+		EXPECT_GT(journal.capacity(), 1024);
+
+		uint64_t used = journal.used_bytes();
+		EXPECT_TRUE(journal.compact());
+		EXPECT_TRUE(journal.is_valid());
+		EXPECT_FALSE(boost::filesystem::exists(std::string(filename) + ".tmp"));
+		EXPECT_LT(journal.used_bytes(), used);
+		EXPECT_EQ(journal.used_bytes(), journal.live_bytes());
+		EXPECT_EQ(read_all(journal), expected);
+
+		//整理以后继续写入
+		journal.begin();
+		journal.put(2, "fund", "123", 3);
+		EXPECT_TRUE(journal.commit());
+		expected["2:fund"] = "123";
+	}
+
+	{
+		StateJournal journal;
+		ASSERT_TRUE(journal.open(filename, 1, 1024));
+		EXPECT_EQ(read_all(journal), expected);
+	}
+
+	boost::filesystem::remove(filename);
+}
+
+TEST(test_state_journal, test_torn_record)
+{
+	const char* filename = "./test_state_journal_torn.sdj";
+	boost::filesystem::remove(filename);
+
+	uint64_t firstSize = 0;
+	{
+		StateJournal journal;
+		ASSERT_TRUE(journal.open(filename, 1, 4096));
+		journal.put(1, "a", "11111111", 8);
+		journal.commit();
+		firstSize = journal.used_bytes();
+		journal.put(1, "b", "22222222", 8);
+		journal.commit();
+	}
+
+	//模拟写了一半的记录：第二条记录的数据被破坏
+	{
+		BoostMappingFile mf;
+		ASSERT_TRUE(mf.map(filename));
+		char* p = (char*)mf.addr() + sizeof(StateJournal::JournalHeader) + firstSize;
+		p[sizeof(StateJournal::RecordHeader) + 8] ^= 0x5A;
+	}
+
+	{
+		StateJournal journal;
+		ASSERT_TRUE(journal.open(filename, 1, 4096));
+		StateMap states = read_all(journal);
+		EXPECT_EQ(states.size(), 1);
+		EXPECT_EQ(states["1:a"], "11111111");
+		EXPECT_EQ(journal.used_bytes(), firstSize);
+	}
+
+	boost::filesystem::remove(filename);
+}
@@ -0,0 +1,276 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Share/UDPBatchProto.hpp"
+#include "../Share/TimeUtils.hpp"
+#include "../Includes/WTSStruct.h"
+
+#include <boost/asio.hpp>
+#include <thread>
+
+USING_NS_WTP;
+
+#define UDP_MSG_PUSHTRANS	0x203
+
+TEST(test_udp_batch, test_pack_and_visit)
+{
+	UDPBatchPacker packer;
+	packer.init(UDP_CHNL_TRANS, 7, 1400);
+
+	WTSTransStruct trans;
+	uint32_t cnt = 0;
+	for (;;)
+	{
+		trans.index = cnt + 1;
+		uint64_t seq = packer.append(UDP_MSG_PUSHTRANS, &trans, sizeof(WTSTransStruct));
+		if (seq == 0)
+			break;
+
+		EXPECT_EQ(seq, cnt + 1);
+		cnt++;
+	}
+	EXPECT_EQ(cnt, (1400 - sizeof(UDPBatchHead)) / (sizeof(UDPEventHead) + sizeof(WTSTransStruct)));
+	EXPECT_LE(packer.size(), 1400);
+
+	uint32_t visited = 0;
+	bool bValid = UDPBatchPacker::visit(packer.data(), packer.size(), [&visited](uint64_t seq, uint16_t type, const char* data, uint16_t len) {
+		EXPECT_EQ(type, UDP_MSG_PUSHTRANS);
+		EXPECT_EQ(len, sizeof(WTSTransStruct));
+		EXPECT_EQ(((WTSTransStruct*)data)->index, (int64_t)seq);
+		visited++;
+	});
+	EXPECT_TRUE(bValid);
+	EXPECT_EQ(visited, cnt);
+
+	//截断的数据报不能通过检查
+	EXPECT_FALSE(UDPBatchPacker::visit(packer.data(), packer.size() - 1, [](uint64_t, uint16_t, const char*, uint16_t) {}));
+
+	//序号接着上一个数据报往后排
+	packer.reset(packer.next_seq());
+	EXPECT_TRUE(packer.empty());
+	EXPECT_EQ(packer.append(UDP_MSG_PUSHTRANS, &trans, sizeof(WTSTransStruct)), cnt + 1);
+}
+
+TEST(test_udp_batch, test_gap_detector)
+{
+	UDPGapDetector detector;
+	detector.check_epoch(1);
+
+	//中途加入，之前的数据不算丢失
+	EXPECT_TRUE(detector.accept(100));
+	EXPECT_TRUE(detector.accept(101));
+	EXPECT_TRUE(detector.accept(105));
+	EXPECT_TRUE(detector.accept(106));
+	EXPECT_EQ(detector.lost(), 3);
+
+	UDPGapDetector::SeqRanges gaps;
+	EXPECT_TRUE(detector.pop_gaps(gaps));
+	ASSERT_EQ(gaps.size(), 1);
+	EXPECT_EQ(gaps[0].first, 102);
+	EXPECT_EQ(gaps[0].second, 105);
+	EXPECT_FALSE(detector.pop_gaps(gaps));
+
+	//乱序到达的数据补上缺口，重复的数据丢弃
+	EXPECT_TRUE(detector.accept(103));
+	EXPECT_FALSE(detector.accept(103));
+	EXPECT_FALSE(detector.accept(101));
+	EXPECT_FALSE(detector.accept(106));
+	EXPECT_EQ(detector.outstanding(), 2);
+	EXPECT_TRUE(detector.accept(102));
+	EXPECT_TRUE(detector.accept(104));
+	EXPECT_EQ(detector.outstanding(), 0);
+	EXPECT_EQ(detector.recovered(), 3);
+	EXPECT_EQ(detector.duplicated(), 3);
+
+	//发送端重启
+	detector.check_epoch(2);
+	EXPECT_TRUE(detector.accept(1));
+	EXPECT_TRUE(detector.accept(2));
+	EXPECT_EQ(detector.expected(), 3);
+}
+
+TEST(test_udp_batch, test_replay_ring)
+{
+	UDPReplayRing ring;
+	ring.init(sizeof(WTSTransStruct), 1000);
+
+	WTSTransStruct trans;
+	for (uint64_t seq = 1; seq <= 2500; seq++)
+	{
+		trans.index = seq;
+		ring.push(seq, UDP_MSG_PUSHTRANS, &trans, sizeof(WTSTransStruct));
+	}
+
+	UDPBatchPacker packer;
+	packer.init(UDP_CHNL_TRANS, 1, 1400);
+
+	//只保留最后1000条
+	std::string frames;
+	EXPECT_EQ(ring.make_replay(1, 3000, packer, frames), 1000);
+
+	uint64_t expected = 1501;
+	uint32_t frameCnt = 0;
+	const char* p = frames.data();
+	std::size_t left = frames.size();
+	while (left > 0)
+	{
+		const UDPBatchHead* head = (const UDPBatchHead*)p;
+		ASSERT_LE(head->_length, left);
+		EXPECT_TRUE(UDPBatchPacker::visit(p, head->_length, [&expected](uint64_t seq, uint16_t, const char* data, uint16_t) {
+			EXPECT_EQ(seq, expected);
+			EXPECT_EQ(((WTSTransStruct*)data)->index, (int64_t)seq);
+			expected++;
+		}));
+		frameCnt++;
+		p += head->_length;
+		left -= head->_length;
+
+		if (head->_count == 0)
+			break;
+	}
+	EXPECT_EQ(left, 0);
+	EXPECT_EQ(expected, 2501);
+	EXPECT_GT(frameCnt, 1);
+}
+
+/*
+ *	本机回环测试：故意丢掉一部分数据报，接收端检测缺口，再从补发缓冲区把数据补齐
+ */
+TEST(test_udp_batch, test_loopback_recovery)
+{
+	const uint32_t total = 200000;
+	const uint32_t dropEvery = 50;	//每50个数据报丢一个
+
+	typedef boost::asio::ip::udp udp;
+	boost::asio::io_service ios;
+	udp::socket receiver(ios, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+	receiver.set_option(udp::socket::receive_buffer_size(8 * 1024 * 1024));
+	udp::endpoint target = receiver.local_endpoint();
+
+	UDPReplayRing ring;
+	ring.init(sizeof(WTSTransStruct), total);
+
+	UDPGapDetector detector;
+	std::vector<bool> delivered(total + 1, false);
+	uint64_t deliverCnt = 0;
+	auto on_batch = [&](const char* data, std::size_t len) {
+		const UDPBatchHead* head = (const UDPBatchHead*)data;
+		detector.check_epoch(head->_epoch);
+		UDPBatchPacker::visit(data, len, [&](uint64_t seq, uint16_t, const char* buf, uint16_t) {
+			if (!detector.accept(seq))
+				return;
+
+			int64_t idx = ((WTSTransStruct*)buf)->index;
+			EXPECT_FALSE(delivered[idx]);
+			delivered[idx] = true;
+			deliverCnt++;
+		});
+	};
+
+	std::atomic<bool> bDone(false);
+	std::vector<char> rcvBuf(65536);
+	udp::endpoint from;
+	std::function<void()> do_recv = [&]() {
+		receiver.async_receive_from(boost::asio::buffer(rcvBuf), from, [&](const boost::system::error_code& ec, std::size_t len) {
+			if (ec)
+				return;
+
+			//4字节的是结束标记
+			if (len == sizeof(uint32_t))
+			{
+				bDone = true;
+				ios.stop();
+				return;
+			}
+
+			on_batch(rcvBuf.data(), len);
+			do_recv();
+		});
+	};
+	do_recv();
+	std::thread thrdRecv([&ios]() { ios.run_for(std::chrono::seconds(10)); });
+
+	uint32_t sentCnt = 0;
+	uint32_t droppedCnt = 0;
+	TimeUtils::Ticker ticker;
+	{
+		boost::asio::io_service sendIos;
+		udp::socket sender(sendIos, udp::endpoint(udp::v4(), 0));
+		UDPBatchPacker packer;
+		packer.init(UDP_CHNL_TRANS, 1, 1400);
+
+		uint32_t dgramCnt = 0;
+		auto flush = [&]() {
+			dgramCnt++;
+			if (dgramCnt % dropEvery == 0)
+				droppedCnt++;
+			else
+			{
+				sender.send_to(boost::asio::buffer(packer.data(), packer.size()), target);
+				sentCnt++;
+			}
+			packer.reset(packer.next_seq());
+		};
+
+		WTSTransStruct trans;
+		for (uint32_t i = 1; i <= total; i++)
+		{
+			trans.index = i;
+			uint64_t seq = packer.append(UDP_MSG_PUSHTRANS, &trans, sizeof(WTSTransStruct));
+			if (seq == 0)
+			{
+				flush();
+				seq = packer.append(UDP_MSG_PUSHTRANS, &trans, sizeof(WTSTransStruct));
+			}
+			ring.push(seq, UDP_MSG_PUSHTRANS, &trans, sizeof(WTSTransStruct));
+
+			//模拟行情的节奏，不要一下子把接收缓冲区打满
+			if (i % 20000 == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if (!packer.empty())
+			flush();
+
+		uint32_t marker = 0;
+		for (uint32_t i = 0; i < 3 && !bDone; i++)
+		{
+			sender.send_to(boost::asio::buffer(&marker, sizeof(marker)), target);
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	}
+	double elapse = ticker.nano_seconds() / 1e9;
+	thrdRecv.join();
+
+	uint64_t received = deliverCnt;
+	EXPECT_GT(detector.lost(), 0);
+
+	//尾部丢失的数据接收端是看不到缺口的，按发送端最后的序号补一段
+	UDPGapDetector::SeqRanges gaps;
+	detector.pop_gaps(gaps);
+	if (detector.expected() <= total)
+		gaps.emplace_back(detector.expected(), total + 1);
+
+	UDPBatchPacker replayPacker;
+	replayPacker.init(UDP_CHNL_TRANS, 1, 1400);
+	for (const UDPGapDetector::SeqRange& gap : gaps)
+	{
+		std::string frames;
+		ring.make_replay(gap.first, gap.second, replayPacker, frames);
+		const char* p = frames.data();
+		std::size_t left = frames.size();
+		while (left >= sizeof(UDPBatchHead))
+		{
+			const UDPBatchHead* head = (const UDPBatchHead*)p;
+			on_batch(p, head->_length);
+			p += head->_length;
+			left -= head->_length;
+		}
+	}
+
+	EXPECT_EQ(deliverCnt, total);
+	EXPECT_EQ(detector.outstanding(), 0);
+
+	printf("%u events in %u datagrams (%u dropped on purpose) sent in %.3fs, %.0f events/s\n",
+		total, sentCnt + droppedCnt, droppedCnt, elapse, total / elapse);
+	printf("received: %llu, lost: %llu, recovered: %llu, duplicated: %llu\n",
+		(unsigned long long)received, (unsigned long long)detector.lost(),
+		(unsigned long long)(deliverCnt - received), (unsigned long long)detector.duplicated());
+}
@@ -0,0 +1,199 @@
+﻿#include "gtest/gtest/gtest.h"
+#include "../Includes/IDataWriter.h"
+#include "../Includes/IBaseDataMgr.h"
+#include "../Includes/WTSDataDef.hpp"
+#include "../Includes/WTSContractInfo.hpp"
+#include "../Includes/WTSSessionInfo.hpp"
+#include "../Includes/WTSVariant.hpp"
+#include "../Share/DLLHelper.hpp"
+#include "../Share/TimeUtils.hpp"
+#include "../Share/BoostFile.hpp"
+#include "../Share/fmtlib.h"
+
+USING_NS_WTP;
+
+/*
+ *	WtDataWriterAD批量提交的性能测试
+ *	用一个交易日的模拟tick回放到WtDataWriterAD，对比逐条提交和批量提交两种模式
+ *	测试比较耗时，默认不执行，需要加上--gtest_also_run_disabled_tests
+ */
+
+static const char* BENCH_EXCHG = "SHFE";
+static const char* BENCH_PID = "rb";
+static const uint32_t BENCH_DATE = 20230704;
+static const uint32_t BENCH_CONTRACTS = 2;
+
+class BenchBDMgr : public IBaseDataMgr
+{
+public:
+	BenchBDMgr()
+	{
+		_session = WTSSessionInfo::create("FN0230", "bench");
+		_session->addTradingSection(900, 1015);
+		_session->addTradingSection(1030, 1130);
+		_session->addTradingSection(1330, 1500);
+
+		_comm = WTSCommodityInfo::create(BENCH_PID, "bench", BENCH_EXCHG, "FN0230", "CHINA");
+		_comm->setSessionInfo(_session);
+
+		for (uint32_t i = 0; i < BENCH_CONTRACTS; i++)
+		{
+			std::string code = fmt::format("{}{}", BENCH_PID, 2310 + i);
+			WTSContractInfo* ct = WTSContractInfo::create(code.c_str(), code.c_str(), BENCH_EXCHG, BENCH_PID);
+			ct->setCommInfo(_comm);
+			_contracts.emplace_back(ct);
+		}
+	}
+
+	~BenchBDMgr()
+	{
+		for (WTSContractInfo* ct : _contracts)
+			ct->release();
+		_comm->release();
+		_session->release();
+	}
+
+	const std::vector<WTSContractInfo*>& contracts() const { return _contracts; }
+
+public:
+	virtual WTSCommodityInfo* getCommodity(const char* exchgpid) override { return _comm; }
+	virtual WTSCommodityInfo* getCommodity(const char* exchg, const char* pid) override { return _comm; }
+	virtual WTSContractInfo* getContract(const char* code, const char* exchg = "", uint32_t uDate = 0) override
+	{
+		for (WTSContractInfo* ct : _contracts)
+		{
+			if (strcmp(ct->getCode(), code) == 0)
+				return ct;
+		}
+		return NULL;
+	}
+	virtual WTSArray* getContracts(const char* exchg = "", uint32_t uDate = 0) override { return NULL; }
+	virtual WTSSessionInfo* getSession(const char* sid) override { return _session; }
+	virtual WTSSessionInfo* getSessionByCode(const char* code, const char* exchg = "") override { return _session; }
+	virtual WTSArray* getAllSessions() override { return NULL; }
+	virtual bool isHoliday(const char* pid, uint32_t uDate, bool isTpl = false) override { return false; }
+	virtual uint32_t calcTradingDate(const char* stdPID, uint32_t uDate, uint32_t uTime, bool isSession = false) override { return BENCH_DATE; }
+	virtual uint64_t getBoundaryTime(const char* stdPID, uint32_t tDate, bool isSession = false, bool isStart = true) override { return 0; }
+
+private:
+	WTSSessionInfo*		_session;
+	WTSCommodityInfo*	_comm;
+	std::vector<WTSContractInfo*>	_contracts;
+};
+
+class BenchWriterSink : public IDataWriterSink
+{
+public:
+	BenchWriterSink(IBaseDataMgr* bdMgr) :_bd_mgr(bdMgr) {}
+
+	virtual IBaseDataMgr* getBDMgr() override { return _bd_mgr; }
+	virtual bool canSessionReceive(const char* sid) override { return true; }
+	virtual void broadcastTick(WTSTickData* curTick) override {}
+	virtual void broadcastOrdQue(WTSOrdQueData* curOrdQue) override {}
+	virtual void broadcastOrdDtl(WTSOrdDtlData* curOrdDtl) override {}
+	virtual void broadcastTrans(WTSTransData* curTrans) override {}
+	virtual CodeSet* getSessionComms(const char* sid) override { return NULL; }
+	virtual uint32_t getTradingDate(const char* pid) override { return BENCH_DATE; }
+	virtual void outputLog(WTSLogLevel ll, const char* message) override
+	{
+		if (ll >= LL_INFO)
+			printf("%s\r\n", message);
+	}
+
+private:
+	IBaseDataMgr*	_bd_mgr;
+};
+
+/*
+ *	生成一个交易日的tick，每个合约每500毫秒一笔
+ */
+static void make_day_ticks(BenchBDMgr& bdMgr, std::vector<WTSTickData*>& ticks)
+{
+	const uint32_t sections[3][2] = { {900, 1015}, {1030, 1130}, {1330, 1500} };
+	for (auto& sec : sections)
+	{
+		uint32_t sMins = sec[0] / 100 * 60 + sec[0] % 100;
+		uint32_t eMins = sec[1] / 100 * 60 + sec[1] % 100;
+		for (uint32_t ms = sMins * 60000; ms < eMins * 60000; ms += 500)
+		{
+			uint32_t secs = ms / 1000;
+			uint32_t actTime = (secs / 3600 * 10000 + secs % 3600 / 60 * 100 + secs % 60) * 1000 + ms % 1000;
+			for (WTSContractInfo* ct : bdMgr.contracts())
+			{
+				WTSTickData* curTick = WTSTickData::create(ct->getCode());
+				WTSTickStruct& ts = curTick->getTickStruct();
+				strcpy(ts.exchg, ct->getExchg());
+				ts.action_date = BENCH_DATE;
+				ts.action_time = actTime;
+				ts.trading_date = BENCH_DATE;
+				ts.price = 3700 + (double)(ticks.size() % 37);
+				ts.volume = 2;
+				ts.total_volume = ticks.size();
+				ts.turn_over = ts.price * 20;
+				ts.open_interest = 100000;
+				curTick->setContractInfo(ct);
+				ticks.emplace_back(curTick);
+			}
+		}
+	}
+}
+
+static void replay_day(const char* tag, uint32_t commitSize, const char* durability, const std::vector<WTSTickData*>& ticks, BenchWriterSink& sink)
+{
+	std::string module = DLLHelper::wrap_module("WtDataStorageAD");
+	DllHandle hInst = DLLHelper::load_library(module.c_str());
+	if (hInst == NULL)
+	{
+		printf("%s not found, benchmark skipped\r\n", module.c_str());
+		return;
+	}
+
+	FuncCreateWriter funcCreate = (FuncCreateWriter)DLLHelper::get_symbol(hInst, "createWriter");
+	FuncDeleteWriter funcDelete = (FuncDeleteWriter)DLLHelper::get_symbol(hInst, "deleteWriter");
+	ASSERT_TRUE(funcCreate != NULL && funcDelete != NULL);
+
+	std::string path = fmt::format("./bench_writer_ad/{}/", tag);
+	if (BoostFile::exists(path.c_str()))
+		boost::filesystem::remove_all(path);
+
+	WTSVariant* params = WTSVariant::createObject();
+	params->append("path", path.c_str());
+	params->append("groupsize", (uint32_t)100000);
+	params->append("disablemin5", true);
+	params->append("tickmapsize", (uint32_t)64 * 1024 * 1024);
+	params->append("commitsize", commitSize);
+	params->append("commitspan", (uint32_t)2000);
+	params->append("durability", durability);
+
+	IDataWriter* writer = funcCreate();
+	writer->init(params, &sink);
+
+	TimeUtils::Ticker ticker;
+	for (WTSTickData* curTick : ticks)
+		writer->writeTick(curTick, 0);
+	writer->release();
+	int64_t ns = ticker.nano_seconds();
+
+	printf("[%s] %u ticks replayed in %.3f ms, %.1f ticks/s\r\n", tag, (uint32_t)ticks.size(), ns / 1000000.0, ticks.size()*1e9 / ns);
+
+	funcDelete(writer);
+	params->release();
+}
+
+TEST(test_writer_ad, DISABLED_bench_group_commit)
+{
+	BenchBDMgr bdMgr;
+	BenchWriterSink sink(&bdMgr);
+
+	std::vector<WTSTickData*> ticks;
+	make_day_ticks(bdMgr, ticks);
+
+	replay_day("immediate_sync", 1, "sync", ticks, sink);
+	replay_day("batch_sync", 1000, "sync", ticks, sink);
+	replay_day("immediate_nosync", 1, "nosync", ticks, sink);
+	replay_day("batch_nosync", 1000, "nosync", ticks, sink);
+	replay_day("batch_mapasync", 1000, "mapasync", ticks, sink);
+
+	for (WTSTickData* curTick : ticks)
+		curTick->release();
+}
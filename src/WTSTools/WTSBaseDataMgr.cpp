@@ -25,11 +25,13 @@ WTSBaseDataMgr::WTSBaseDataMgr()
 	, m_mapSessions(NULL)
 	, m_mapCommodities(NULL)
 	, m_mapContracts(NULL)
+	, m_ayContracts(NULL)
 {
 	m_mapExchgContract = WTSExchgContract::create();
 	m_mapSessions = WTSSessionMap::create();
 	m_mapCommodities = WTSCommodityMap::create();
 	m_mapContracts = WTSContractMap::create();
+	m_ayContracts = WTSArray::create();
 }
 
 
@@ -58,6 +60,12 @@ WTSBaseDataMgr::~WTSBaseDataMgr()
 		m_mapContracts->release();
 		m_mapContracts = NULL;
 	}
+
+	if (m_ayContracts)
+	{
+		m_ayContracts->release();
+		m_ayContracts = NULL;
+	}
 }
 
 WTSCommodityInfo* WTSBaseDataMgr::getCommodity(const char* exchgpid)
@@ -132,6 +140,22 @@ WTSContractInfo* WTSBaseDataMgr::getContract(const char* code, const char* exchg
 	return NULL;
 }
 
+WTSContractInfo* WTSBaseDataMgr::getContractByIndex(uint32_t idx)
+{
+	if (m_ayContracts == NULL || idx >= m_ayContracts->size())
+		return NULL;
+
+	return (WTSContractInfo*)m_ayContracts->at(idx);
+}
+
+uint32_t WTSBaseDataMgr::getIndexedContracts()
+{
+	if (m_ayContracts == NULL)
+		return 0;
+
+	return (uint32_t)m_ayContracts->size();
+}
+
 uint32_t  WTSBaseDataMgr::getContractSize(const char* exchg /* = "" */, uint32_t uDate /* = 0 */)
 {
 	uint32_t ret = 0;
@@ -278,6 +302,12 @@ void WTSBaseDataMgr::release()
 		m_mapCommodities->release();
 		m_mapCommodities = NULL;
 	}
+
+	if (m_ayContracts)
+	{
+		m_ayContracts->release();
+		m_ayContracts = NULL;
+	}
 }
 
 bool WTSBaseDataMgr::loadSessions(const char* filename)
@@ -527,6 +557,10 @@ bool WTSBaseDataMgr::loadContracts(const char* filename)
 				sMargin = jcInfo->getDouble("shortmarginratio");
 			cInfo->setMarginRatios(lMargin, sMargin);
 
+			//按加载顺序分配全局索引，数组持有一份引用，合约被替换了索引也不会失效
+			cInfo->setTotalIndex((uint32_t)m_ayContracts->size());
+			m_ayContracts->append(cInfo, true);
+
 			WTSContractList* contractList = (WTSContractList*)m_mapExchgContract->get(std::string(cInfo->getExchg()));
 			if (contractList == NULL)
 			{
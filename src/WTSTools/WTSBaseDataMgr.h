@@ -48,6 +48,9 @@ public:
 
 	virtual uint32_t			getContractSize(const char* exchg = "", uint32_t uDate = 0) override;
 
+	virtual WTSContractInfo*	getContractByIndex(uint32_t idx) override;
+	virtual uint32_t			getIndexedContracts() override;
+
 	void		release();
 
 	bool		loadSessions(const char* filename);
@@ -76,5 +79,6 @@ private:
 	WTSSessionMap*		m_mapSessions;
 	WTSCommodityMap*	m_mapCommodities;
 	WTSContractMap*		m_mapContracts;
+	WTSArray*			m_ayContracts;		//按全局索引排列的合约
 };
 
@@ -9,12 +9,132 @@
  */
 #pragma once
 #include <string>
+#include <stdexcept>
 #include <stdint.h>
+#include <string.h>
 
 #include "../WTSUtils/zstdlib/zstd.h"
 
+/*
+ *	流式解压器
+ *	ZSTD_DCtx可以重复使用，解压结果直接写到调用方提供的缓存里
+ *	适合按块遍历很大的历史数据，不需要一次性申请整块解压后的内存
+ */
+class WTSCmpStream
+{
+public:
+	WTSCmpStream() :_src(NULL), _src_len(0), _src_pos(0), _finished(true)
+	{
+		_dctx = ZSTD_createDCtx();
+	}
+
+	~WTSCmpStream()
+	{
+		if (_dctx)
+			ZSTD_freeDCtx(_dctx);
+	}
+
+	WTSCmpStream(const WTSCmpStream&) = delete;
+	WTSCmpStream& operator=(const WTSCmpStream&) = delete;
+
+public:
+	/*
+	 *	开始解压一段新的压缩数据，数据在解压完成前必须一直有效
+	 */
+	void reset(const void* data, size_t dataLen)
+	{
+		ZSTD_DCtx_reset(_dctx, ZSTD_reset_session_only);
+		_src = (const char*)data;
+		_src_len = dataLen;
+		_src_pos = 0;
+		_finished = (dataLen == 0);
+	}
+
+	/*
+	 *	解压到dst中，最多写入dstCap个字节
+	 *	返回实际写入的字节数，返回0说明已经解压完了
+	 */
+	size_t read(void* dst, size_t dstCap)
+	{
+		ZSTD_outBuffer output = { dst, dstCap, 0 };
+		while (!_finished && output.pos < output.size)
+		{
+			ZSTD_inBuffer input = { _src, _src_len, _src_pos };
+			size_t const ret = ZSTD_decompressStream(_dctx, &output, &input);
+			if (ZSTD_isError(ret))
+				throw std::runtime_error(ZSTD_getErrorName(ret));
+
+			bool bStalled = (input.pos == _src_pos && output.pos < output.size);
+			_src_pos = input.pos;
+			if (ret == 0)
+				_finished = true;
+			else if (bStalled && _src_pos >= _src_len)
+				throw std::runtime_error("compressed data is truncated");
+		}
+
+		return output.pos;
+	}
+
+	/*
+	 *	按块遍历解压后的记录，每次最多解压chunkCnt条到buffer中，再回调cb(const T* items, size_t cnt)
+	 *	buffer至少要能容纳chunkCnt条记录，返回总条数
+	 */
+	template<typename T, typename Callback>
+	size_t for_each_chunk(T* buffer, size_t chunkCnt, Callback cb)
+	{
+		size_t total = 0;
+		size_t left = 0;	//上一块剩下的不完整记录的字节数
+		for (;;)
+		{
+			size_t got = read((char*)buffer + left, sizeof(T)*chunkCnt - left);
+			size_t bytes = left + got;
+			size_t cnt = bytes / sizeof(T);
+			if (cnt > 0)
+			{
+				cb((const T*)buffer, cnt);
+				total += cnt;
+			}
+
+			left = bytes - cnt * sizeof(T);
+			if (left > 0)
+				memmove(buffer, (char*)buffer + cnt * sizeof(T), left);
+
+			if (got == 0)
+				break;
+		}
+
+		return total;
+	}
+
+	inline bool finished() const { return _finished; }
+
+private:
+	ZSTD_DCtx*	_dctx;
+	const char*	_src;
+	size_t		_src_len;
+	size_t		_src_pos;
+	bool		_finished;
+};
+
 class WTSCmpHelper
 {
+private:
+	/*
+	 *	每个线程一个解压上下文，避免每次解压都重新创建
+	 */
+	static ZSTD_DCtx* thread_dctx()
+	{
+		struct DCtxHolder
+		{
+			ZSTD_DCtx* _ctx;
+			DCtxHolder() :_ctx(ZSTD_createDCtx()) {}
+			~DCtxHolder() { ZSTD_freeDCtx(_ctx); }
+		};
+
+		thread_local static DCtxHolder holder;
+		return holder._ctx;
+	}
+
 public:
 	static std::string compress_data(const void* data, size_t dataLen, uint32_t uLevel = 1)
 	{
@@ -31,10 +151,48 @@ public:
 		std::string desBuf;
 		unsigned long long const desLen = ZSTD_getFrameContentSize(data, dataLen);
 		desBuf.resize((std::size_t)desLen, 0);
-		size_t const dSize = ZSTD_decompress((void*)desBuf.data(), (size_t)desLen, data, dataLen);
+		size_t const dSize = ZSTD_decompressDCtx(thread_dctx(), (void*)desBuf.data(), (size_t)desLen, data, dataLen);
 		if (dSize != desLen)
 			throw std::runtime_error("uncompressed data size does not match calculated data size");
 		return desBuf;
 	}
+
+	/*
+	 *	获取压缩数据解压后的大小
+	 */
+	static std::size_t uncompressed_size(const void* data, size_t dataLen)
+	{
+		unsigned long long const desLen = ZSTD_getFrameContentSize(data, dataLen);
+		if (desLen == ZSTD_CONTENTSIZE_ERROR || desLen == ZSTD_CONTENTSIZE_UNKNOWN)
+			throw std::runtime_error("uncompressed data size cannot be determined");
+		return (std::size_t)desLen;
+	}
+
+	/*
+	 *	解压到调用方提供的缓存中，dstCap必须不小于解压后的大小
+	 *	返回解压后的字节数
+	 */
+	static std::size_t uncompress_to(void* dst, size_t dstCap, const void* data, size_t dataLen)
+	{
+		size_t const dSize = ZSTD_decompressDCtx(thread_dctx(), dst, dstCap, data, dataLen);
+		if (ZSTD_isError(dSize))
+			throw std::runtime_error(ZSTD_getErrorName(dSize));
+		return dSize;
+	}
+
+	/*
+	 *	解压并追加到dst的尾部，用于保留块头的场景，省掉中间缓存
+	 *	std::string没有不初始化的resize，追加的部分还是会先清零一次，只是遍历数据、不需要整块留在内存里的场景用WTSCmpStream
+	 */
+	static std::size_t uncompress_append(std::string& dst, const void* data, size_t dataLen)
+	{
+		std::size_t const desLen = uncompressed_size(data, dataLen);
+		std::size_t const oldLen = dst.size();
+		dst.resize(oldLen + desLen);
+		size_t const dSize = uncompress_to((char*)dst.data() + oldLen, desLen, data, dataLen);
+		if (dSize != desLen)
+			throw std::runtime_error("uncompressed data size does not match calculated data size");
+		return dSize;
+	}
 };
 
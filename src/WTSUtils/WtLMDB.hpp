@@ -54,7 +54,13 @@ public:
 		return _dbi;
 	}
 
-	bool open(const char* path, std::size_t mapsize = 16*1024*1024)
+	/*
+	 *	打开数据库
+	 *	@path		数据库路径
+	 *	@mapsize	映射大小
+	 *	@flags		环境标记，如MDB_NOSYNC、MDB_WRITEMAP|MDB_MAPASYNC，用于控制落盘的方式
+	 */
+	bool open(const char* path, std::size_t mapsize = 16*1024*1024, unsigned int flags = 0)
 	{
 #if _MSC_VER
         int ret = _access(path, 0);
@@ -74,7 +80,7 @@ public:
 		if (_errno != MDB_SUCCESS)
 			return false;
 
-		_errno = mdb_env_open(_env, path, 0, 0664);
+		_errno = mdb_env_open(_env, path, flags, 0664);
 		if (_errno != MDB_SUCCESS)
 			return false;
 
@@ -83,6 +89,18 @@ public:
 		return true;
 	}
 
+	/*
+	 *	将数据刷到磁盘，在MDB_NOSYNC或者MDB_MAPASYNC模式下需要主动调用
+	 */
+	inline bool sync(bool bForce = true)
+	{
+		if (_env == NULL)
+			return false;
+
+		_errno = mdb_env_sync(_env, bForce ? 1 : 0);
+		return _errno == MDB_SUCCESS;
+	}
+
 	inline void update_errno(int error) { _errno = error; }
 
 	inline bool has_error() const { return _errno != MDB_SUCCESS; }
@@ -0,0 +1,107 @@
+﻿/*!
+ * \file BatchBacktester.cpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief
+ */
+#include "BatchBacktester.h"
+#include "HisDataReplayer.h"
+#include "CtaMocker.h"
+
+#include "../Includes/WTSVariant.hpp"
+#include "../Share/TimeUtils.hpp"
+#include "../Share/threadpool.hpp"
+#include "../WTSTools/WTSLogger.h"
+
+#include <set>
+#include <atomic>
+
+bool BatchBacktester::run(WTSVariant* cfg)
+{
+	WTSVariant* cfgEnv = cfg->get("env");
+	WTSVariant* cfgBatch = cfg->get("batch");
+	WTSVariant* cfgCta = cfg->get("cta");
+	if (cfgEnv == NULL || cfgBatch == NULL)
+	{
+		WTSLogger::error("No batch configured for batch backtesting");
+		return false;
+	}
+
+	if (strcmp(cfgEnv->getCString("mocker"), "cta") != 0 || cfgCta == NULL)
+	{
+		WTSLogger::error("Batch backtesting only supports cta mocker");
+		return false;
+	}
+
+	WTSVariant* cfgStras = cfgBatch->get("strategies");
+	if (cfgStras == NULL || cfgStras->type() != WTSVariant::VT_Array || cfgStras->size() == 0)
+	{
+		WTSLogger::error("No strategies configured for batch backtesting");
+		return false;
+	}
+
+	std::set<std::string> ids;
+	for (uint32_t i = 0; i < cfgStras->size(); i++)
+	{
+		const char* id = cfgStras->get(i)->getCString("id");
+		if (!ids.insert(id).second)
+		{
+			WTSLogger::error("Duplicate strategy id {} in batch, outputs would overwrite each other", id);
+			return false;
+		}
+	}
+
+	uint32_t threads = cfgBatch->getUInt32("threads");
+	if (threads == 0)
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	threads = std::min(threads, cfgStras->size());
+
+	int32_t slippage = cfgEnv->getInt32("slippage");
+	WTSVariant* cfgReplayer = cfg->get("replayer");
+
+	SharedDataCache cache;
+	std::atomic<uint32_t> doneCnt(0);
+	TimeUtils::Ticker ticker;
+	WTSLogger::info("Batch backtesting of {} strategies started with {} threads", cfgStras->size(), threads);
+
+	boost::threadpool::pool pool(threads);
+	for (uint32_t i = 0; i < cfgStras->size(); i++)
+	{
+		WTSVariant* cfgStra = cfgStras->get(i);
+		pool.schedule([cfgReplayer, cfgCta, cfgStra, slippage, &cache, &doneCnt, cfgStras]() {
+			//每个回测都有自己的回放器，只有K线缓存是共享的
+			HisDataReplayer replayer;
+			replayer.set_shared_cache(&cache);
+			replayer.init(cfgReplayer);
+
+			WTSVariant* cfgItem = WTSVariant::createObject();
+			cfgItem->append("module", cfgCta->getCString("module"));
+			cfgItem->append("strategy", cfgStra, true);
+
+			CtaMocker* mocker = new CtaMocker(&replayer, "cta", slippage);
+			if (mocker->init_cta_factory(cfgItem))
+			{
+				replayer.register_sink(mocker, cfgStra->getCString("id"));
+				replayer.prepare();
+				replayer.run(true);
+			}
+			else
+			{
+				WTSLogger::error("Initializing strategy {} failed", cfgStra->getCString("id"));
+			}
+			cfgItem->release();
+			delete mocker;
+
+			uint32_t done = ++doneCnt;
+			WTSLogger::info("Backtesting of {} done, {}/{} finished", cfgStra->getCString("id"), done, cfgStras->size());
+		});
+	}
+	pool.wait();
+
+	WTSLogger::info("Batch backtesting of {} strategies done in {} ms, {} bytes of bars shared", 
+		cfgStras->size(), ticker.milli_seconds(), cache.size());
+	return true;
+}
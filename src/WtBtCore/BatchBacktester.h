@@ -0,0 +1,37 @@
+﻿/*!
+ * \file BatchBacktester.h
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 批量回测，用于参数寻优这类场景
+ *
+ * 所有的回测共享一份只读的K线缓存，每个回测有自己的回放器和CtaMocker，在线程池中并行执行
+ * 每个回测的结果按照策略ID分别输出到各自的目录
+ * 只支持C++编写的CTA策略，回调到外部语言的策略没法并行执行
+ */
+#pragma once
+#include "../Includes/WTSMarcos.h"
+
+NS_WTP_BEGIN
+class WTSVariant;
+NS_WTP_END
+
+USING_NS_WTP;
+
+class BatchBacktester
+{
+public:
+	/*
+	 *	按配置里的batch段执行批量回测，全部回测结束以后才返回
+	 *
+	 *	batch:
+	 *		threads: 4		#并行的回测数，0则为CPU核数
+	 *		strategies:		#每个策略的配置，和cta.strategy的格式一致，id不能重复
+	 *		-	id: dt_1
+	 *			name: DualThrust
+	 *			params: ...
+	 */
+	static bool run(WTSVariant* cfg);
+};
@@ -0,0 +1,197 @@
+﻿/*!
+ * \file HftDataPrefetcher.cpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief
+ */
+#include "HftDataPrefetcher.h"
+#include "../Share/fmtlib.h"
+#include "../Share/TimeUtils.hpp"
+
+#include <string.h>
+
+inline std::string make_item_key(HftDataPrefetcher::HftDataType dType, const char* stdCode, uint32_t uDate)
+{
+	return fmtutil::format("{}#{}#{}", (uint32_t)dType, stdCode, uDate);
+}
+
+HftDataPrefetcher::HftDataPrefetcher()
+	: _stopped(false)
+	, _max_bytes(0)
+	, _held_bytes(0)
+	, _last_date(0)
+{
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+HftDataPrefetcher::~HftDataPrefetcher()
+{
+	stop();
+}
+
+void HftDataPrefetcher::start(uint64_t maxBytes, FuncLoadData loader)
+{
+	if (_worker)
+		return;
+
+	_max_bytes = maxBytes;
+	_loader = loader;
+	_stopped = false;
+	_worker.reset(new StdThread([this]() {
+		work();
+	}));
+}
+
+void HftDataPrefetcher::stop()
+{
+	{
+		StdUniqueLock lock(_mtx);
+		_stopped = true;
+		_cond.notify_all();
+	}
+
+	if (_worker)
+	{
+		_worker->join();
+		_worker.reset();
+	}
+
+	_items.clear();
+	_queue.clear();
+	_held_bytes = 0;
+	_last_date = 0;
+}
+
+void HftDataPrefetcher::schedule(uint32_t uDate, const DataItems& items)
+{
+	StdUniqueLock lock(_mtx);
+	if (_stopped || uDate <= _last_date)
+		return;
+
+	_last_date = uDate;
+	for (const DataItem& item : items)
+	{
+		std::string key = make_item_key(item.first, item.second.c_str(), uDate);
+		if (_items.find(key) != _items.end())
+			continue;
+
+		PrefetchItemPtr pItem(new PrefetchItem);
+		pItem->_type = item.first;
+		pItem->_code = item.second;
+		pItem->_date = uDate;
+		pItem->_state = IS_PENDING;
+		pItem->_hit = false;
+		_items[key] = pItem;
+		_queue.emplace_back(pItem);
+		_stats._scheduled++;
+	}
+
+	_cond.notify_all();
+}
+
+bool HftDataPrefetcher::take(HftDataType dType, const char* stdCode, uint32_t uDate, std::string& buffer, bool& bHit)
+{
+	StdUniqueLock lock(_mtx);
+	auto it = _items.find(make_item_key(dType, stdCode, uDate));
+	if (it == _items.end())
+		return false;
+
+	PrefetchItemPtr pItem = it->second;
+	_items.erase(it);
+
+	//还没开始读的，从队列里拿掉，调用方自己读，避免后台线程因为内存上限卡住的时候互相等
+	if (pItem->_state == IS_PENDING)
+	{
+		for (auto qit = _queue.begin(); qit != _queue.end(); qit++)
+		{
+			if (*qit == pItem)
+			{
+				_queue.erase(qit);
+				break;
+			}
+		}
+		_stats._fallbacks++;
+		return false;
+	}
+
+	if (pItem->_state == IS_LOADING)
+	{
+		TimeUtils::Ticker ticker;
+		while (pItem->_state != IS_DONE)
+			_cond.wait(lock);
+		_stats._wait_ns += ticker.nano_seconds();
+	}
+
+	_held_bytes -= pItem->_data.size();
+	_stats._prefetched++;
+	bHit = pItem->_hit;
+	buffer.swap(pItem->_data);
+	_cond.notify_all();
+	return true;
+}
+
+void HftDataPrefetcher::discard_before(uint32_t uDate)
+{
+	StdUniqueLock lock(_mtx);
+	for (auto it = _queue.begin(); it != _queue.end();)
+	{
+		if ((*it)->_date < uDate)
+			it = _queue.erase(it);
+		else
+			it++;
+	}
+
+	//正在读的留给后台线程收尾
+	for (auto it = _items.begin(); it != _items.end();)
+	{
+		PrefetchItemPtr& pItem = it->second;
+		if (pItem->_date < uDate && pItem->_state != IS_LOADING)
+		{
+			_held_bytes -= pItem->_data.size();
+			it = _items.erase(it);
+		}
+		else
+			it++;
+	}
+
+	_cond.notify_all();
+}
+
+HftDataPrefetcher::PrefetchStats HftDataPrefetcher::stats()
+{
+	StdUniqueLock lock(_mtx);
+	return _stats;
+}
+
+void HftDataPrefetcher::work()
+{
+	StdUniqueLock lock(_mtx);
+	while (!_stopped)
+	{
+		if (_queue.empty() || (_max_bytes != 0 && _held_bytes >= _max_bytes))
+		{
+			_cond.wait(lock);
+			continue;
+		}
+
+		PrefetchItemPtr pItem = _queue.front();
+		_queue.pop_front();
+		pItem->_state = IS_LOADING;
+
+		lock.unlock();
+		std::string buffer;
+		bool bHit = _loader(pItem->_type, pItem->_code.c_str(), pItem->_date, buffer);
+		lock.lock();
+
+		pItem->_hit = bHit;
+		pItem->_data.swap(buffer);
+		pItem->_state = IS_DONE;
+		_stats._bytes += pItem->_data.size();
+		_held_bytes += pItem->_data.size();
+
+		_cond.notify_all();
+	}
+}
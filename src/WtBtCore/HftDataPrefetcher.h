@@ -0,0 +1,131 @@
+﻿/*!
+ * \file HftDataPrefetcher.h
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 按天回放高频数据时，在后台线程预读后面几个交易日的数据
+ *
+ * 回放线程回放当天数据的同时，后台线程读取并解压后面交易日的tick、委托明细、委托队列和成交明细
+ * 回放线程到了新的一天直接取走已经读好的数据，取不到的再自己读
+ * 读好但是还没取走的数据总量有上限，超过上限后台线程就暂停预读
+ */
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include "../Includes/FasterDefs.h"
+#include "../Share/StdUtils.hpp"
+
+USING_NS_WTP;
+
+class HftDataPrefetcher
+{
+public:
+	//数据类型
+	typedef enum tagHftDataType
+	{
+		HDT_TICK = 0,
+		HDT_ORDDTL,
+		HDT_ORDQUE,
+		HDT_TRANS
+	} HftDataType;
+
+	typedef std::pair<HftDataType, std::string>	DataItem;		//数据类型+合约代码
+	typedef std::vector<DataItem>				DataItems;
+
+	/*
+	 *	读取数据的回调，参数为数据类型、合约代码、日期和输出缓冲区，读不到返回false
+	 *	会在后台线程里调用
+	 */
+	typedef std::function<bool(HftDataType, const char*, uint32_t, std::string&)>	FuncLoadData;
+
+	typedef struct _PrefetchStats
+	{
+		uint64_t	_scheduled;		//预读的数据项数
+		uint64_t	_prefetched;	//回放线程直接取走的项数
+		uint64_t	_fallbacks;		//还没开始读，回放线程自己读的项数
+		uint64_t	_wait_ns;		//回放线程等后台线程读完的时间
+		uint64_t	_bytes;			//预读的字节数
+	} PrefetchStats;
+
+public:
+	HftDataPrefetcher();
+	~HftDataPrefetcher();
+
+public:
+	/*
+	 *	启动后台线程
+	 *
+	 *	@maxBytes	读好但是还没取走的数据的字节数上限，0为不限制
+	 */
+	void	start(uint64_t maxBytes, FuncLoadData loader);
+
+	void	stop();
+
+	inline bool	is_running() const { return _worker != NULL; }
+
+	/*
+	 *	把一个交易日的数据放到预读队列里，已经放过的日期会被忽略
+	 */
+	void	schedule(uint32_t uDate, const DataItems& items);
+
+	/*
+	 *	取走预读的数据
+	 *	正在读的会等读完，没有预读或者还没开始读的返回false，由调用方自己读
+	 *
+	 *	@bHit	数据是否存在
+	 */
+	bool	take(HftDataType dType, const char* stdCode, uint32_t uDate, std::string& buffer, bool& bHit);
+
+	/*
+	 *	丢掉uDate之前的日期里没有被取走的数据
+	 */
+	void	discard_before(uint32_t uDate);
+
+	PrefetchStats	stats();
+
+private:
+	void	work();
+
+private:
+	typedef enum tagItemState
+	{
+		IS_PENDING = 0,	//等待读取
+		IS_LOADING,		//正在读
+		IS_DONE			//读完了
+	} ItemState;
+
+	typedef struct _PrefetchItem
+	{
+		HftDataType	_type;
+		std::string	_code;
+		uint32_t	_date;
+		ItemState	_state;
+		bool		_hit;
+		std::string	_data;
+	} PrefetchItem;
+	typedef std::shared_ptr<PrefetchItem>	PrefetchItemPtr;
+
+	typedef wt_hashmap<std::string, PrefetchItemPtr>	PrefetchMap;
+	typedef std::deque<PrefetchItemPtr>		PrefetchQueue;
+
+	StdUniqueMutex	_mtx;
+	StdCondVariable	_cond;
+	StdThreadPtr	_worker;
+	bool			_stopped;
+
+	FuncLoadData	_loader;
+	uint64_t		_max_bytes;
+	uint64_t		_held_bytes;
+	uint32_t		_last_date;
+
+	PrefetchMap		_items;
+	PrefetchQueue	_queue;
+
+	PrefetchStats	_stats;
+};
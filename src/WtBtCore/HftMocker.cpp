@@ -125,6 +125,7 @@ HftMocker::HftMocker(HisDataReplayer* replayer, const char* name)
 	, _has_hook(false)
 	, _hook_valid(true)
 	, _resumed(false)
+	, _l2_matcher(NULL)
 {
 	_commodities = CommodityMap::create();
 
@@ -145,6 +146,9 @@ HftMocker::~HftMocker()
 
 	_ticks->release();
 	_ticks = NULL;
+
+	if (_l2_matcher)
+		delete _l2_matcher;
 }
 
 void HftMocker::procTask()
@@ -223,6 +227,14 @@ bool HftMocker::init_hft_factory(WTSVariant* cfg)
 
 	log_info("HFT match params: use_newpx-{}, error_rate-{}, match_this_tick-{}", _use_newpx, _error_rate, _match_this_tick);
 
+	if (strcmp(cfg->getCString("matcher"), "l2") == 0)
+	{
+		_l2_matcher = new L2MatchEngine(_replayer);
+		_l2_matcher->init(cfg->get("l2matcher"));
+		_l2_matcher->regisSink(this);
+		log_info("Orders will be matched with order details and transactions");
+	}
+
 	DllHandle hInst = DLLHelper::load_library(module);
 	if (hInst == NULL)
 		return false;
@@ -257,7 +269,14 @@ void HftMocker::handle_tick(const char* stdCode, WTSTickData* curTick, uint32_t
 
 void HftMocker::handle_order_detail(const char* stdCode, WTSOrdDtlData* curOrdDtl)
 {
+	if (_l2_matcher)
+		_l2_matcher->handle_order_detail(stdCode, curOrdDtl);
+
 	on_order_detail(stdCode, curOrdDtl);
+
+	//逐笔撮合模式下，策略在逐笔数据里下的单也要及时处理
+	if (_l2_matcher)
+		procTask();
 }
 
 void HftMocker::handle_order_queue(const char* stdCode, WTSOrdQueData* curOrdQue)
@@ -267,7 +286,13 @@ void HftMocker::handle_order_queue(const char* stdCode, WTSOrdQueData* curOrdQue
 
 void HftMocker::handle_transaction(const char* stdCode, WTSTransData* curTrans)
 {
+	if (_l2_matcher)
+		_l2_matcher->handle_transaction(stdCode, curTrans);
+
 	on_transaction(stdCode, curTrans);
+
+	if (_l2_matcher)
+		procTask();
 }
 
 void HftMocker::handle_bar_close(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar)
@@ -349,9 +374,13 @@ void HftMocker::on_tick(const char* stdCode, WTSTickData* newTick)
 
 	update_dyn_profit(stdCode, newTick);
 
+	//逐笔撮合模式下，订单由撮合引擎处理，不再按tick撮合
 	OrderIDs all_ids;
-	for (auto it = _orders.begin(); it != _orders.end(); it++)
-		all_ids.push_back(it->first);
+	if (_l2_matcher == NULL)
+	{
+		for (auto it = _orders.begin(); it != _orders.end(); it++)
+			all_ids.push_back(it->first);
+	}
 	//如果开启了同tick撮合，则先触发策略的ontick，再处理订单
 	//如果没开启同tick撮合，则先处理订单，再触发策略的ontick
 	if (_match_this_tick)
@@ -558,6 +587,8 @@ bool HftMocker::stra_cancel(uint32_t localid)
 		}
 		
 		ordInfo->_left = 0;
+		if (_l2_matcher)
+			_l2_matcher->cancel(localid);
 
 		on_order(localid, ordInfo->_code, ordInfo->_isBuy, ordInfo->_total, ordInfo->_left, ordInfo->_price, true, ordInfo->_usertag);
 
@@ -627,6 +658,7 @@ OrderIDs HftMocker::stra_buy(const char* stdCode, double price, double qty, cons
 	postTask([this, localid](){
 		const OrderInfoPtr& ordInfo = _orders[localid];
 		on_entrust(localid, ordInfo->_code, true, "下单成功", ordInfo->_usertag);
+		placeToL2(localid);
 	});
 
 	OrderIDs ids;
@@ -782,6 +814,65 @@ bool HftMocker::procOrder(uint32_t localid)
 	return false;
 }
 
+void HftMocker::placeToL2(uint32_t localid)
+{
+	if (_l2_matcher == NULL)
+		return;
+
+	OrderInfoPtr ordInfo;
+	{
+		StdLocker<StdRecurMutex> lock(_mtx_ords);
+		auto it = _orders.find(localid);
+		if (it == _orders.end())
+			return;
+
+		ordInfo = it->second;
+	}
+
+	ordInfo->_proced_after_placed = true;
+	on_order(localid, ordInfo->_code, ordInfo->_isBuy, ordInfo->_total, ordInfo->_left, ordInfo->_price, false, ordInfo->_usertag);
+
+	uint64_t curTime = (uint64_t)_replayer->get_date() * 1000000000 + (uint64_t)_replayer->get_raw_time() * 100000 + _replayer->get_secs();
+	_l2_matcher->place(localid, ordInfo->_code, ordInfo->_isBuy, ordInfo->_price, ordInfo->_left, curTime);
+}
+
+void HftMocker::handle_trade(uint32_t localid, const char* stdCode, bool isBuy, double vol, double fireprice, double price, uint64_t ordTime)
+{
+	OrderInfoPtr ordInfo;
+	{
+		StdLocker<StdRecurMutex> lock(_mtx_ords);
+		auto it = _orders.find(localid);
+		if (it == _orders.end())
+			return;
+
+		ordInfo = it->second;
+	}
+
+	on_trade(localid, stdCode, isBuy, vol, price, ordInfo->_usertag);
+
+	double curPos = stra_get_position(stdCode);
+	_sig_logs << _replayer->get_date() << "." << _replayer->get_raw_time() << "." << _replayer->get_secs() << ","
+		<< (isBuy ? "+" : "-") << vol << "," << curPos << "," << price << std::endl;
+}
+
+void HftMocker::handle_order(uint32_t localid, const char* stdCode, bool isBuy, double leftover, double price, bool isCanceled, uint64_t ordTime)
+{
+	OrderInfoPtr ordInfo;
+	{
+		StdLocker<StdRecurMutex> lock(_mtx_ords);
+		auto it = _orders.find(localid);
+		if (it == _orders.end())
+			return;
+
+		ordInfo = it->second;
+		if (isCanceled || decimal::eq(leftover, 0.0))
+			_orders.erase(it);
+	}
+
+	ordInfo->_left = leftover;
+	on_order(localid, stdCode, isBuy, ordInfo->_total, leftover, ordInfo->_price, isCanceled, ordInfo->_usertag);
+}
+
 OrderIDs HftMocker::stra_sell(const char* stdCode, double price, double qty, const char* userTag, int flag /* = 0 */, bool bForceClose /* = false */)
 {
 	WTSCommodityInfo* commInfo = _replayer->get_commodity_info(stdCode);
@@ -827,6 +918,7 @@ OrderIDs HftMocker::stra_sell(const char* stdCode, double price, double qty, con
 	postTask([this, localid]() {
 		const OrderInfoPtr& ordInfo = _orders[localid];
 		on_entrust(localid, ordInfo->_code, true, "下单成功", ordInfo->_usertag);
+		placeToL2(localid);
 	});
 
 	OrderIDs ids;
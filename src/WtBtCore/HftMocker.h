@@ -12,6 +12,7 @@
 #include <sstream>
 
 #include "HisDataReplayer.h"
+#include "L2MatchEngine.h"
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/IHftStraCtx.h"
@@ -23,7 +24,7 @@
 
 class HisDataReplayer;
 
-class HftMocker : public IDataSink, public IHftStraCtx
+class HftMocker : public IDataSink, public IHftStraCtx, public IMatchSink
 {
 public:
 	HftMocker(HisDataReplayer* replayer, const char* name);
@@ -68,6 +69,12 @@ public:
 
 	virtual void	handle_replay_done() override;
 
+	//////////////////////////////////////////////////////////////////////////
+	//IMatchSink，逐笔撮合引擎的回报
+	virtual void	handle_trade(uint32_t localid, const char* stdCode, bool isBuy, double vol, double fireprice, double price, uint64_t ordTime) override;
+	virtual void	handle_order(uint32_t localid, const char* stdCode, bool isBuy, double leftover, double price, bool isCanceled, uint64_t ordTime) override;
+	virtual void	handle_entrust(uint32_t localid, const char* stdCode, bool bSuccess, const char* message, uint64_t ordTime) override {}
+
 	virtual void	on_tick_updated(const char* stdCode, WTSTickData* newTick) override;
 	virtual void	on_ordque_updated(const char* stdCode, WTSOrdQueData* newOrdQue) override;
 	virtual void	on_orddtl_updated(const char* stdCode, WTSOrdDtlData* newOrdDtl) override;
@@ -175,6 +182,11 @@ private:
 
 	bool	procOrder(uint32_t localid);
 
+	/*
+	 *	把订单提交到逐笔撮合引擎
+	 */
+	void	placeToL2(uint32_t localid);
+
 	void	do_set_position(const char* stdCode, double qty, double price = 0.0, const char* userTag = "");
 	void	update_dyn_profit(const char* stdCode, WTSTickData* newTick);
 
@@ -190,6 +202,9 @@ private:
 	uint32_t		_error_rate;
 	bool			_match_this_tick;	//是否在当前tick撮合
 
+	//逐笔撮合引擎，配置了matcher为l2时才会创建，否则还是按照tick撮合
+	L2MatchEngine*	_l2_matcher;
+
 	typedef wt_hashmap<std::string, double> PriceMap;
 	PriceMap		_price_map;
 
@@ -53,7 +53,11 @@ bool HisDataMgr::load_raw_bars(const char* exchg, const char* code, WTSKlinePeri
 	}
 
 	std::string buffer;
-	bool bSucc = _reader->read_raw_bars(exchg, code, period, buffer);
+	bool bSucc = false;
+	{
+		StdUniqueLock lock(_mtx);
+		bSucc = _reader->read_raw_bars(exchg, code, period, buffer);
+	}
 	if (bSucc)
 		cb(buffer);
 	return bSucc;
@@ -68,7 +72,11 @@ bool HisDataMgr::load_raw_ticks(const char* exchg, const char* code, uint32_t uD
 	}
 
 	std::string buffer;
-	bool bSucc = _reader->read_raw_ticks(exchg, code, uDate, buffer);
+	bool bSucc = false;
+	{
+		StdUniqueLock lock(_mtx);
+		bSucc = _reader->read_raw_ticks(exchg, code, uDate, buffer);
+	}
 	if (bSucc)
 		cb(buffer);
 	return bSucc;
@@ -83,7 +91,11 @@ bool HisDataMgr::load_raw_trans(const char* exchg, const char* code, uint32_t uD
 	}
 
 	std::string buffer;
-	bool bSucc = _reader->read_raw_transactions(exchg, code, uDate, buffer);
+	bool bSucc = false;
+	{
+		StdUniqueLock lock(_mtx);
+		bSucc = _reader->read_raw_transactions(exchg, code, uDate, buffer);
+	}
 	if (bSucc)
 		cb(buffer);
 	return bSucc;
@@ -98,7 +110,11 @@ bool HisDataMgr::load_raw_ordque(const char* exchg, const char* code, uint32_t u
 	}
 
 	std::string buffer;
-	bool bSucc = _reader->read_raw_order_queues(exchg, code, uDate, buffer);
+	bool bSucc = false;
+	{
+		StdUniqueLock lock(_mtx);
+		bSucc = _reader->read_raw_order_queues(exchg, code, uDate, buffer);
+	}
 	if (bSucc)
 		cb(buffer);
 	return bSucc;
@@ -113,7 +129,11 @@ bool HisDataMgr::load_raw_orddtl(const char* exchg, const char* code, uint32_t u
 	}
 
 	std::string buffer;
-	bool bSucc = _reader->read_raw_order_details(exchg, code, uDate, buffer);
+	bool bSucc = false;
+	{
+		StdUniqueLock lock(_mtx);
+		bSucc = _reader->read_raw_order_details(exchg, code, uDate, buffer);
+	}
 	if (bSucc)
 		cb(buffer);
 	return bSucc;
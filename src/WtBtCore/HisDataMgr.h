@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include <functional>
 #include "../Includes/IBtDtReader.h"
+#include "../Share/StdUtils.hpp"
 
 typedef std::function<void(std::string&)> FuncLoadDataCallback;
 
@@ -34,5 +35,6 @@ public:
 
 private:
 	IBtDtReader*	_reader;
+	StdUniqueMutex	_mtx;	//高频数据会在预读线程里读取，reader不一定是线程安全的
 };
 
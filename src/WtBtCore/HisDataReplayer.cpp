@@ -12,6 +12,8 @@
 #include "WtHelper.h"
 
 #include <fstream>
+#include <algorithm>
+#include <functional>
 
 #include "../Includes/WTSVariant.hpp"
 #include "../Includes/WTSDataDef.hpp"
@@ -28,6 +30,7 @@
 #include "../WTSTools/CsvHelper.h"
 
 #include "../WTSUtils/WTSCmpHelper.hpp"
+#include "../WtDataStorage/ChunkHelper.hpp"
 #include "../WTSUtils/WTSCfgLoader.h"
 
 #include "../Share/CodeHelper.hpp"
@@ -69,8 +72,20 @@ bool proc_block_data(const char* tag, std::string& content, bool isBar, bool bKe
 			return false;
 		}
 
+		//新版本结构体不需要转换，块头和解压的数据直接写到最终的缓存里
+		if (!bOldVer)
+		{
+			if (bKeepHead)
+				buffer.append(content.data(), BLOCK_HEADER_SIZE);
+			ChunkHelper::uncompress_append(buffer, blkV2);
+			if (bKeepHead)
+				((BlockHeader*)buffer.data())->_version = BLOCK_VERSION_RAW_V2;
+			content.swap(buffer);
+			return true;
+		}
+
 		//将文件头后面的数据进行解压
-		buffer = WTSCmpHelper::uncompress_data(content.data() + BLOCK_HEADERV2_SIZE, blkV2->_size);
+		ChunkHelper::uncompress_append(buffer, blkV2);
 	}
 	else
 	{
@@ -140,6 +155,43 @@ bool proc_block_data(const char* tag, std::string& content, bool isBar, bool bKe
 	return true;
 }
 
+/*
+ *	处理块数据，并直接解码到最终的缓存items中
+ *	新版本的压缩数据直接解压到items的内存里，不再经过中间缓存，也省掉一次拷贝
+ */
+template<typename T>
+bool proc_block_data(const char* tag, std::string& content, std::vector<T>& items, bool isBar)
+{
+	BlockHeader* header = (BlockHeader*)content.data();
+	if (header->is_compressed() && !header->is_old_version())
+	{
+		BlockHeaderV2* blkV2 = (BlockHeaderV2*)content.c_str();
+		if (content.size() != (sizeof(BlockHeaderV2) + blkV2->_size))
+		{
+			WTSLogger::error("Size check failed while processing {} data of {}", isBar ? "bar" : "tick", tag);
+			return false;
+		}
+
+		std::size_t rawSize = ChunkHelper::uncompressed_size(blkV2);
+		if (rawSize % sizeof(T) != 0)
+		{
+			WTSLogger::error("Size check failed while processing {} data of {}", isBar ? "bar" : "tick", tag);
+			return false;
+		}
+
+		items.resize(rawSize / sizeof(T));
+		ChunkHelper::uncompress_to(items.data(), rawSize, blkV2);
+		return true;
+	}
+
+	if (!proc_block_data(tag, content, isBar, false))
+		return false;
+
+	items.resize(content.size() / sizeof(T));
+	memcpy(items.data(), content.data(), items.size() * sizeof(T));
+	return true;
+}
+
 HisDataReplayer::HisDataReplayer()
 	: _listener(NULL)
 	, _cur_date(0)
@@ -157,6 +209,11 @@ HisDataReplayer::HisDataReplayer()
 	, _min_period("d")
 	, _cache_clear_days(0)
 	, _align_by_section(false)
+	, _shared_cache(NULL)
+	, _bars_touched(false)
+	, _prefetch_days(1)
+	, _prefetch_bytes(0)
+	, _io_wait_ns(0)
 {
 }
 
@@ -211,6 +268,13 @@ bool HisDataReplayer::init(WTSVariant* cfg, EventNotifier* notifier /* = NULL */
 
 	_cache_clear_days = cfg->getUInt32("cache_clear_days");
 	WTSLogger::info("Unused cache data will be cleard in {} days", _cache_clear_days);
+
+	//不压缩的K线缓存目录，由WtDtHelper的build_bar_cache生成
+	if (cfg->has("bar_cache"))
+	{
+		_bar_cache_dir = StrUtil::standardisePath(cfg->getCString("bar_cache"));
+		WTSLogger::info("Bar cache files in {} will be mapped if available", _bar_cache_dir);
+	}
 	
 
 	_tick_enabled = cfg->getBoolean("tick");
@@ -225,6 +289,12 @@ bool HisDataReplayer::init(WTSVariant* cfg, EventNotifier* notifier /* = NULL */
 	_nosim_if_notrade = cfg->getBoolean("dont_simtick_if_notrade");
 	WTSLogger::info("nosim_if_notrade is {}", _nosim_if_notrade);
 
+	//按tick回放的时候，后台预读后面几个交易日的高频数据，prefetch_mem单位为MB
+	if (cfg->has("prefetch_days"))
+		_prefetch_days = cfg->getUInt32("prefetch_days");
+	_prefetch_bytes = (cfg->has("prefetch_mem") ? cfg->getUInt64("prefetch_mem") : 1024) * 1024 * 1024;
+	WTSLogger::info("HFT data of {} trading days will be prefetched, memory limit {} MB", _prefetch_days, _prefetch_bytes / 1024 / 1024);
+
 	//基础数据文件
 	WTSVariant* cfgBF = cfg->get("basefiles");
 	if (cfgBF->get("session"))
@@ -440,6 +510,10 @@ void HisDataReplayer::clear_cache()
 
 	_bars_cache.clear();
 	_unbars_cache.clear();
+	_bars_sched.clear();
+	_unbars_sched.clear();
+	_due_bars.clear();
+	_due_unbars.clear();
 	_unsubbed_in_need.clear();
 
 	_main_key = "";
@@ -485,11 +559,16 @@ void HisDataReplayer::reset()
 	{
 		BarsListPtr& cacheItem = (BarsListPtr&)m.second;
 		cacheItem->_cursor = UINT_MAX;
+		cacheItem->_sched_time = 0;
 
 		WTSLogger::info("Reading flag of {} has been reset", m.first.c_str());
 	}
 
 	_unbars_cache.clear();
+	_bars_sched.clear();
+	_unbars_sched.clear();
+	_due_bars.clear();
+	_due_unbars.clear();
 
 	_day_cache.clear();
 	_ticker_keys.clear();
@@ -743,8 +822,22 @@ void HisDataReplayer::run_by_ticks(bool bNeedDump /* = false */)
 	uint32_t etime = (uint32_t)(_end_time % 10000);
 	uint64_t end_tdate = _bd_mgr.calcTradingDate(DEFAULT_SESSIONID, edt, etime, true);
 
+	//外部加载器和csv的数据不一定能在其他线程读取，只预读自定义数据文件
+	if (_prefetch_days > 0 && NULL == _bt_loader && _mode != "csv")
+	{
+		_prefetcher.start(_prefetch_bytes, [this](HftDataPrefetcher::HftDataType dType, const char* stdCode, uint32_t uDate, std::string& buffer) {
+			return loadHftDataFromBin(dType, stdCode, uDate, buffer);
+		});
+	}
+
+	TimeUtils::Ticker ticker;
+	_io_wait_ns = 0;
+	uint32_t replayDays = 0;
 	while (_cur_tdate <= end_tdate && !_terminated)
 	{
+		if (_prefetcher.is_running())
+			prefetch_hft_datas(_cur_tdate);
+
 		if (checkAllTicks(_cur_tdate))
 		{
 			WTSLogger::info("Start to replay tick data of {}...", _cur_tdate);
@@ -752,6 +845,7 @@ void HisDataReplayer::run_by_ticks(bool bNeedDump /* = false */)
 			check_cache_days();
 			replayHftDatasByDay(_cur_tdate);
 			_listener->handle_session_end(_cur_tdate);
+			replayDays++;
 		}
 
 		_cur_tdate = TimeUtils::getNextDate(_cur_tdate);
@@ -760,6 +854,17 @@ void HisDataReplayer::run_by_ticks(bool bNeedDump /* = false */)
 	if (_terminated)
 		WTSLogger::debug("Replaying by ticks terminated forcely");
 
+	int64_t totalNs = ticker.nano_seconds();
+	WTSLogger::info("{} days of tick data replayed in {} ms, {} ms waiting for data loading, {} ms replaying",
+		replayDays, totalNs / 1000000, _io_wait_ns / 1000000, (totalNs - (int64_t)_io_wait_ns) / 1000000);
+	if (_prefetcher.is_running())
+	{
+		HftDataPrefetcher::PrefetchStats stats = _prefetcher.stats();
+		WTSLogger::info("Prefetching: {} items scheduled, {} taken, {} loaded in place, {} MB read, {} ms waiting for prefetching",
+			stats._scheduled, stats._prefetched, stats._fallbacks, stats._bytes / 1024 / 1024, stats._wait_ns / 1000000);
+		_prefetcher.stop();
+	}
+
 	WTSLogger::log_raw(LL_INFO, "All back data replayed, replaying done");
 	_listener->handle_replay_done();
 	if (_notifier)
@@ -1219,177 +1324,101 @@ void HisDataReplayer::run_by_tasks(bool bNeedDump /* = false */)
 	}
 }
 
-void HisDataReplayer::simTicks(uint32_t uDate, uint32_t uTime, uint32_t endTDate /* = 0 */, int pxType /* = 0 */)
+//已经取出来等待处理的序列，不再重复放到堆里
+static const uint64_t SCHED_DUE = UINT64_MAX;
+
+void HisDataReplayer::schedule_bars(BarsSchedHeap& heap, const std::string& key, const BarsListPtr& barsList)
 {
-	//这里应该触发检查
-	uint64_t nowTime = (uint64_t)uDate * 10000 + uTime;
+	if (barsList->_period == KP_DAY || barsList->_sched_time == SCHED_DUE)
+		return;
 
-	for (auto it = _bars_cache.begin(); it != _bars_cache.end(); it++)
+	if (barsList->_cursor == UINT_MAX || barsList->_cursor >= barsList->_bars.size())
 	{
-		BarsListPtr& barsList = (BarsListPtr&)it->second;
-		if (barsList->_period != KP_DAY)
-		{
-			if (barsList->_bars.size() > barsList->_cursor)
-			{
-				for(;;)
-				{
-					WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
-
-					/*
-					 *	By Wesley @ 2023.05.05
-					 *	如果没有禁止0成交模拟tick，或者K线成交量不为0，就可以模拟tick
-					 */
-					bool bCanSim = !_nosim_if_notrade || !decimal::eq(nextBar.vol, 0.0);
+		barsList->_sched_time = 0;
+		return;
+	}
 
-					uint64_t barTime = 199000000000 + nextBar.time;
-					if (barTime == nowTime && bCanSim)
-					{
-						const std::string& ticker = _ticker_keys[barsList->_code];
-						if (ticker == it->first)
-						{
-							//开高低收
-							WTSTickStruct& curTS = _day_cache[barsList->_code];
-							strcpy(curTS.code, barsList->_code.c_str());
-							curTS.action_date = _cur_date;
-							curTS.action_time = _cur_time * 100000;
-
-							double newPx = 0.0;
-							if (pxType == 0)
-								newPx = nextBar.open;
-							else if (pxType == 1)
-								newPx = nextBar.high;
-							else if (pxType == 2)
-								newPx = nextBar.low;
-							else if (pxType == 3)
-								newPx = nextBar.close;
-
-							curTS.price = newPx;
-							curTS.volume = nextBar.vol;
-							curTS.total_volume += nextBar.vol;
-
-							//更新开高低三个字段
-							if (decimal::eq(curTS.open, 0))
-								curTS.open = curTS.price;
-							curTS.high = max(curTS.price, curTS.high);
-							if (decimal::eq(curTS.low, 0))
-								curTS.low = curTS.price;
-							else
-								curTS.low = min(curTS.price, curTS.low);
-
-							update_price(barsList->_code.c_str(), curTS.price);
-							WTSTickData* curTick = WTSTickData::create(curTS);
-							_listener->handle_tick(barsList->_code.c_str(), curTick, pxType);
-							curTick->release();
-						}
+	uint64_t nextTime = 199000000000 + barsList->_bars[barsList->_cursor].time;
+	if (nextTime == barsList->_sched_time)
+		return;
 
-						break;
-					}
-					else if (barTime < nowTime)
-					{
-						barsList->_cursor++;
+	//原来的项不用删除，弹出的时候发现时间对不上就会丢弃
+	barsList->_key = key;
+	barsList->_sched_time = nextTime;
+	heap.emplace_back(nextTime, barsList);
+	std::push_heap(heap.begin(), heap.end(), std::greater<BarsSchedItem>());
+}
 
-						if (barsList->_cursor == barsList->_bars.size())
-							break;
+void HisDataReplayer::collect_due_bars(BarsSchedHeap& heap, BarsCache& cache, BarsDueList& dueList, uint64_t nowTime)
+{
+	std::size_t oldSize = dueList.size();
+	while (!heap.empty() && heap.front()._time <= nowTime)
+	{
+		std::pop_heap(heap.begin(), heap.end(), std::greater<BarsSchedItem>());
+		BarsSchedItem item = std::move(heap.back());
+		heap.pop_back();
 
-						continue;
-					}
-					else
-					{
-						break;
-					}
-				} 
-			}
-		}
-		else
-		{
-			if (barsList->_bars.size() > barsList->_cursor)
-			{
-				for (;;)
-				{
-					WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
+		BarsListPtr& barsList = item._bars;
+		if (barsList->_sched_time != item._time)
+			continue;
 
-					if (nextBar.date == endTDate)
-					{
-						const std::string& ticker = _ticker_keys[barsList->_code];
-						if (ticker == it->first)
-						{
-							CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(barsList->_code.c_str(), &_hot_mgr);
-							WTSCommodityInfo* commInfo = _bd_mgr.getCommodity(cInfo._exchg, cInfo._product);
-
-							std::string realCode = barsList->_code;
-							if (cInfo.isExright())
-								realCode = realCode.substr(0, realCode.size() - 1);
-
-							WTSSessionInfo* sInfo = get_session_info(realCode.c_str(), true);
-							uint32_t curTime = sInfo->getCloseTime();
-							//开高低收
-							WTSTickStruct curTS;
-							strcpy(curTS.code, realCode.c_str());
-							curTS.action_date = _cur_date;
-							curTS.action_time = curTime * 100000;
-
-							double newPx = 0.0;
-							if (pxType == 0)
-								newPx = nextBar.open;
-							else if (pxType == 1)
-								newPx = nextBar.high;
-							else if (pxType == 2)
-								newPx = nextBar.low;
-							else if (pxType == 3)
-								newPx = nextBar.close;
-
-							curTS.price = newPx;
-							curTS.volume = nextBar.vol;
-							update_price(barsList->_code.c_str(), curTS.price);
-							WTSTickData* curTick = WTSTickData::create(curTS);
-							_listener->handle_tick(realCode.c_str(), curTick, pxType);
-							curTick->release();
-						}
+		//缓存可能已经被清理或者替换了
+		auto it = cache.find(barsList->_key);
+		if (it == cache.end() || it->second != barsList)
+			continue;
 
-						break;
-					}
-					else if (nextBar.date == endTDate)
-					{
-						barsList->_cursor++;
+		barsList->_sched_time = SCHED_DUE;
+		dueList.emplace_back(barsList);
+	}
 
-						if (barsList->_cursor == barsList->_bars.size())
-							break;
-					}
-					else
-					{
-						break;
-					}
-				}
-			}
-		}
+	//同一分钟内按照键排序，保证每次回放的顺序是一样的
+	if (dueList.size() > oldSize)
+	{
+		std::sort(dueList.begin() + oldSize, dueList.end(), [](const BarsListPtr& a, const BarsListPtr& b) {
+			return a->_key < b->_key;
+		});
 	}
 }
 
-void HisDataReplayer::simTickWithUnsubBars(uint64_t stime, uint64_t nowTime, uint32_t endTDate /* = 0 */, int pxType /* = 0 */)
+void HisDataReplayer::purge_schedule(BarsSchedHeap& heap, BarsCache& cache)
 {
-	//uint64_t nowTime = (uint64_t)uDate * 10000 + uTime;
-	uint32_t uDate = (uint32_t)(stime / 10000);
+	auto it = std::remove_if(heap.begin(), heap.end(), [&cache](const BarsSchedItem& item) {
+		if (item._bars->_sched_time != item._time)
+			return true;
 
-	for (auto& item : _unbars_cache)
+		auto cit = cache.find(item._bars->_key);
+		return (cit == cache.end() || cit->second != item._bars);
+	});
+	heap.erase(it, heap.end());
+	std::make_heap(heap.begin(), heap.end(), std::greater<BarsSchedItem>());
+}
+
+void HisDataReplayer::simTicks(uint32_t uDate, uint32_t uTime, uint32_t endTDate /* = 0 */, int pxType /* = 0 */)
+{
+	//这里应该触发检查
+	uint64_t nowTime = (uint64_t)uDate * 10000 + uTime;
+
+	//分钟K线只处理下一根K线已经到点的序列
+	collect_due_bars(_bars_sched, _bars_cache, _due_bars, nowTime);
+	for (BarsListPtr& barsList : _due_bars)
 	{
-		BarsListPtr& barsList = (BarsListPtr&)item.second;
-		if (barsList->_period != KP_DAY)
+		if (barsList->_bars.size() > barsList->_cursor)
 		{
-			//如果历史数据指标不在尾部, 说明是回测模式, 要继续回放历史数据
-			if (barsList->_bars.size() > barsList->_cursor)
+			for(;;)
 			{
-				for (;;)
-				{
-					WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
+				WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
 
-					/*
-					 *	By Wesley @ 2023.05.05
-					 *	如果没有禁止0成交模拟tick，或者K线成交量不为0，就可以模拟tick
-					 */
-					bool bCanSim = !_nosim_if_notrade || !decimal::eq(nextBar.vol, 0.0);
+				/*
+				 *	By Wesley @ 2023.05.05
+				 *	如果没有禁止0成交模拟tick，或者K线成交量不为0，就可以模拟tick
+				 */
+				bool bCanSim = !_nosim_if_notrade || !decimal::eq(nextBar.vol, 0.0);
 
-					uint64_t barTime = 199000000000 + nextBar.time;
-					if (barTime == nowTime && bCanSim)
+				uint64_t barTime = 199000000000 + nextBar.time;
+				if (barTime == nowTime && bCanSim)
+				{
+					const std::string& ticker = _ticker_keys[barsList->_code];
+					if (ticker == barsList->_key)
 					{
 						//开高低收
 						WTSTickStruct& curTS = _day_cache[barsList->_code];
@@ -1397,7 +1426,6 @@ void HisDataReplayer::simTickWithUnsubBars(uint64_t stime, uint64_t nowTime, uin
 						curTS.action_date = _cur_date;
 						curTS.action_time = _cur_time * 100000;
 
-						curTS.volume = nextBar.vol;
 						double newPx = 0.0;
 						if (pxType == 0)
 							newPx = nextBar.open;
@@ -1409,6 +1437,9 @@ void HisDataReplayer::simTickWithUnsubBars(uint64_t stime, uint64_t nowTime, uin
 							newPx = nextBar.close;
 
 						curTS.price = newPx;
+						curTS.volume = nextBar.vol;
+						curTS.total_volume += nextBar.vol;
+
 						//更新开高低三个字段
 						if (decimal::eq(curTS.open, 0))
 							curTS.open = curTS.price;
@@ -1418,54 +1449,67 @@ void HisDataReplayer::simTickWithUnsubBars(uint64_t stime, uint64_t nowTime, uin
 						else
 							curTS.low = min(curTS.price, curTS.low);
 
-
+						update_price(barsList->_code.c_str(), curTS.price);
 						WTSTickData* curTick = WTSTickData::create(curTS);
 						_listener->handle_tick(barsList->_code.c_str(), curTick, pxType);
 						curTick->release();
-						break;
 					}
-					else if (barTime < nowTime)
-					{
-						barsList->_cursor++;
 
-						if (barsList->_cursor == barsList->_bars.size())
-							break;
+					break;
+				}
+				else if (barTime < nowTime)
+				{
+					barsList->_cursor++;
 
-						continue;
-					}
-					else
-					{
+					if (barsList->_cursor == barsList->_bars.size())
 						break;
-					}
+
+					continue;
 				}
-			}
+				else
+				{
+					break;
+				}
+			} 
 		}
-		else
+	}
+
+	//日线只在交易日结束的时候才会回放
+	if (endTDate == 0)
+		return;
+
+	for (auto it = _bars_cache.begin(); it != _bars_cache.end(); it++)
+	{
+		BarsListPtr& barsList = (BarsListPtr&)it->second;
+		if (barsList->_period != KP_DAY)
+			continue;
+
+		if (barsList->_bars.size() > barsList->_cursor)
 		{
-			if (barsList->_bars.size() > barsList->_cursor)
+			for (;;)
 			{
-				for (;;)
-				{
-					WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
+				WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
 
-					if (nextBar.date == endTDate)
+				if (nextBar.date == endTDate)
+				{
+					const std::string& ticker = _ticker_keys[barsList->_code];
+					if (ticker == it->first)
 					{
 						CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(barsList->_code.c_str(), &_hot_mgr);
 						WTSCommodityInfo* commInfo = _bd_mgr.getCommodity(cInfo._exchg, cInfo._product);
 
 						std::string realCode = barsList->_code;
-						if (commInfo->isStock() && cInfo.isExright())
+						if (cInfo.isExright())
 							realCode = realCode.substr(0, realCode.size() - 1);
 
 						WTSSessionInfo* sInfo = get_session_info(realCode.c_str(), true);
-						uint32_t curTime = sInfo->getOpenTime();
+						uint32_t curTime = sInfo->getCloseTime();
 						//开高低收
 						WTSTickStruct curTS;
 						strcpy(curTS.code, realCode.c_str());
 						curTS.action_date = _cur_date;
 						curTS.action_time = curTime * 100000;
 
-						curTS.volume = nextBar.vol;
 						double newPx = 0.0;
 						if (pxType == 0)
 							newPx = nextBar.open;
@@ -1477,36 +1521,178 @@ void HisDataReplayer::simTickWithUnsubBars(uint64_t stime, uint64_t nowTime, uin
 							newPx = nextBar.close;
 
 						curTS.price = newPx;
-						//更新开高低三个字段
-						if (decimal::eq(curTS.open, 0))
-							curTS.open = curTS.price;
-						curTS.high = max(curTS.price, curTS.high);
-						if (decimal::eq(curTS.low, 0))
-							curTS.low = curTS.price;
-						else
-							curTS.low = min(curTS.price, curTS.low);
-
+						curTS.volume = nextBar.vol;
+						update_price(barsList->_code.c_str(), curTS.price);
 						WTSTickData* curTick = WTSTickData::create(curTS);
 						_listener->handle_tick(realCode.c_str(), curTick, pxType);
 						curTick->release();
+					}
 
+					break;
+				}
+				else if (nextBar.date == endTDate)
+				{
+					barsList->_cursor++;
+
+					if (barsList->_cursor == barsList->_bars.size())
 						break;
-					}
-					else if (nextBar.date < endTDate)
-					{
-						barsList->_cursor++;
+				}
+				else
+				{
+					break;
+				}
+			}
+		}
+	}
+}
 
-						if (barsList->_cursor == barsList->_bars.size())
-							break;
+void HisDataReplayer::simTickWithUnsubBars(uint64_t stime, uint64_t nowTime, uint32_t endTDate /* = 0 */, int pxType /* = 0 */)
+{
+	//uint64_t nowTime = (uint64_t)uDate * 10000 + uTime;
+	uint32_t uDate = (uint32_t)(stime / 10000);
 
-						continue;
-					}
+	collect_due_bars(_unbars_sched, _unbars_cache, _due_unbars, nowTime);
+	for (BarsListPtr& barsList : _due_unbars)
+	{
+		//如果历史数据指标不在尾部, 说明是回测模式, 要继续回放历史数据
+		if (barsList->_bars.size() > barsList->_cursor)
+		{
+			for (;;)
+			{
+				WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
+
+				/*
+				 *	By Wesley @ 2023.05.05
+				 *	如果没有禁止0成交模拟tick，或者K线成交量不为0，就可以模拟tick
+				 */
+				bool bCanSim = !_nosim_if_notrade || !decimal::eq(nextBar.vol, 0.0);
+
+				uint64_t barTime = 199000000000 + nextBar.time;
+				if (barTime == nowTime && bCanSim)
+				{
+					//开高低收
+					WTSTickStruct& curTS = _day_cache[barsList->_code];
+					strcpy(curTS.code, barsList->_code.c_str());
+					curTS.action_date = _cur_date;
+					curTS.action_time = _cur_time * 100000;
+
+					curTS.volume = nextBar.vol;
+					double newPx = 0.0;
+					if (pxType == 0)
+						newPx = nextBar.open;
+					else if (pxType == 1)
+						newPx = nextBar.high;
+					else if (pxType == 2)
+						newPx = nextBar.low;
+					else if (pxType == 3)
+						newPx = nextBar.close;
+
+					curTS.price = newPx;
+					//更新开高低三个字段
+					if (decimal::eq(curTS.open, 0))
+						curTS.open = curTS.price;
+					curTS.high = max(curTS.price, curTS.high);
+					if (decimal::eq(curTS.low, 0))
+						curTS.low = curTS.price;
 					else
-					{
+						curTS.low = min(curTS.price, curTS.low);
+
+
+					WTSTickData* curTick = WTSTickData::create(curTS);
+					_listener->handle_tick(barsList->_code.c_str(), curTick, pxType);
+					curTick->release();
+					break;
+				}
+				else if (barTime < nowTime)
+				{
+					barsList->_cursor++;
+
+					if (barsList->_cursor == barsList->_bars.size())
+						break;
+
+					continue;
+				}
+				else
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	if (endTDate == 0)
+		return;
+
+	for (auto& item : _unbars_cache)
+	{
+		BarsListPtr& barsList = (BarsListPtr&)item.second;
+		if (barsList->_period != KP_DAY)
+			continue;
+
+		if (barsList->_bars.size() > barsList->_cursor)
+		{
+			for (;;)
+			{
+				WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
+
+				if (nextBar.date == endTDate)
+				{
+					CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(barsList->_code.c_str(), &_hot_mgr);
+					WTSCommodityInfo* commInfo = _bd_mgr.getCommodity(cInfo._exchg, cInfo._product);
+
+					std::string realCode = barsList->_code;
+					if (commInfo->isStock() && cInfo.isExright())
+						realCode = realCode.substr(0, realCode.size() - 1);
+
+					WTSSessionInfo* sInfo = get_session_info(realCode.c_str(), true);
+					uint32_t curTime = sInfo->getOpenTime();
+					//开高低收
+					WTSTickStruct curTS;
+					strcpy(curTS.code, realCode.c_str());
+					curTS.action_date = _cur_date;
+					curTS.action_time = curTime * 100000;
+
+					curTS.volume = nextBar.vol;
+					double newPx = 0.0;
+					if (pxType == 0)
+						newPx = nextBar.open;
+					else if (pxType == 1)
+						newPx = nextBar.high;
+					else if (pxType == 2)
+						newPx = nextBar.low;
+					else if (pxType == 3)
+						newPx = nextBar.close;
+
+					curTS.price = newPx;
+					//更新开高低三个字段
+					if (decimal::eq(curTS.open, 0))
+						curTS.open = curTS.price;
+					curTS.high = max(curTS.price, curTS.high);
+					if (decimal::eq(curTS.low, 0))
+						curTS.low = curTS.price;
+					else
+						curTS.low = min(curTS.price, curTS.low);
+
+					WTSTickData* curTick = WTSTickData::create(curTS);
+					_listener->handle_tick(realCode.c_str(), curTick, pxType);
+					curTick->release();
+
+					break;
+				}
+				else if (nextBar.date < endTDate)
+				{
+					barsList->_cursor++;
+
+					if (barsList->_cursor == barsList->_bars.size())
 						break;
-					}
 
+					continue;
+				}
+				else
+				{
+					break;
 				}
+
 			}
 		}
 	}
@@ -1994,41 +2180,84 @@ void HisDataReplayer::onMinuteEnd(uint32_t uDate, uint32_t uTime, uint32_t endTD
 	//这里应该触发检查
 	uint64_t nowTime = (uint64_t)uDate * 10000 + uTime;
 
-	for (auto it = _bars_cache.begin(); it != _bars_cache.end(); it++)
+	/*
+	 *	缓存清理是按照交易日检查的，这里只做一个标记，检查的时候再统一标记全部K线
+	 *	这样每分钟就不用遍历全部缓存了
+	 */
+	_bars_touched = true;
+
+	//分钟K线只处理到点的序列，处理完以后按照新的游标重新调度
+	collect_due_bars(_bars_sched, _bars_cache, _due_bars, nowTime);
+	for (BarsListPtr& barsList : _due_bars)
 	{
-		BarsListPtr& barsList = (BarsListPtr&)it->second;
-		barsList->mark();
-		double factor = 1.0;// barsList->_factor;
-		if (barsList->_period != KP_DAY)
+		if (barsList->_bars.size() > barsList->_cursor)
 		{
-			if (barsList->_bars.size() > barsList->_cursor)
+			for (;;)
 			{
-				for (;;)
+				WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
+
+				uint64_t barTime = 199000000000 + nextBar.time;
+				if (barTime <= nowTime)
 				{
-					WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
+					uint32_t times = barsList->_times;
+					if (barsList->_period == KP_Minute5)
+						times *= 5;
+					_listener->handle_bar_close(barsList->_code.c_str(), "m", times, &nextBar);
+				}
+				else
+				{
+					break;
+				}
 
-					uint64_t barTime = 199000000000 + nextBar.time;
-					if (barTime <= nowTime)
-					{
-						uint32_t times = barsList->_times;
-						if (barsList->_period == KP_Minute5)
-							times *= 5;
-						_listener->handle_bar_close(barsList->_code.c_str(), "m", times, &nextBar);
-					}
-					else
-					{
-						break;
-					}
+				barsList->_cursor++;
 
-					barsList->_cursor++;
+				if (barsList->_cursor == barsList->_bars.size())
+					break;
+			}
+		}
+	}
 
-					if (barsList->_cursor == barsList->_bars.size())
-						break;
-				}
+	for (BarsListPtr& barsList : _due_bars)
+	{
+		barsList->_sched_time = 0;
+		schedule_bars(_bars_sched, barsList->_key, barsList);
+	}
+	_due_bars.clear();
+
+	collect_due_bars(_unbars_sched, _unbars_cache, _due_unbars, nowTime);
+	for (BarsListPtr& barsList : _due_unbars)
+	{
+		if (barsList->_bars.size() > barsList->_cursor)
+		{
+			for (;;)
+			{
+				WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
+
+				uint64_t barTime = 199000000000 + nextBar.time;
+				if (barTime > nowTime)
+					break;
+
+				barsList->_cursor++;
+
+				if (barsList->_cursor == barsList->_bars.size())
+					break;
 			}
 		}
-		else
+
+		barsList->_sched_time = 0;
+		schedule_bars(_unbars_sched, barsList->_key, barsList);
+	}
+	_due_unbars.clear();
+
+	//日线只在交易日结束的时候才会闭合
+	if (endTDate != 0)
+	{
+		for (auto it = _bars_cache.begin(); it != _bars_cache.end(); it++)
 		{
+			BarsListPtr& barsList = (BarsListPtr&)it->second;
+			if (barsList->_period != KP_DAY)
+				continue;
+
 			if (barsList->_bars.size() > barsList->_cursor)
 			{
 				for (;;)
@@ -2051,33 +2280,13 @@ void HisDataReplayer::onMinuteEnd(uint32_t uDate, uint32_t uTime, uint32_t endTD
 				}
 			}
 		}
-	}
 
-	for (auto it = _unbars_cache.begin(); it != _unbars_cache.end(); it++)
-	{
-		BarsListPtr& barsList = (BarsListPtr&)it->second;
-		double factor = 1.0;// barsList->_factor;
-		if (barsList->_period != KP_DAY)
+		for (auto it = _unbars_cache.begin(); it != _unbars_cache.end(); it++)
 		{
-			if (barsList->_bars.size() > barsList->_cursor)
-			{
-				for (;;)
-				{
-					WTSBarStruct& nextBar = barsList->_bars[barsList->_cursor];
-
-					uint64_t barTime = 199000000000 + nextBar.time;
-					if (barTime > nowTime)
-						break;
-
-					barsList->_cursor++;
+			BarsListPtr& barsList = (BarsListPtr&)it->second;
+			if (barsList->_period != KP_DAY)
+				continue;
 
-					if (barsList->_cursor == barsList->_bars.size())
-						break;
-				}
-			}
-		}
-		else
-		{
 			if (barsList->_bars.size() > barsList->_cursor)
 			{
 				for (;;)
@@ -2173,25 +2382,7 @@ WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char*
 			std::string rawKey = StrUtil::printf("%s#%s#%u", stdCode, period, baseTimes);
 			if (_bars_cache.find(rawKey) == _bars_cache.end())
 			{
-				/*
-				 *	By Wesley @ 2021.12.20
-				 *	先从extloader加载数据，如果加载不到，再走原来的历史数据存储引擎加载
-				 */
-				if(NULL != _bt_loader)
-					bHasHisData = cacheFinalBarsFromLoader(rawKey, stdCode, kp);
-				
-				if(!bHasHisData)
-				{
-					if (_mode == "csv")
-					{
-						bHasHisData = cacheRawBarsFromCSV(rawKey, stdCode, kp);
-					}
-					else
-					{
-						bHasHisData = cacheRawBarsFromBin(rawKey, stdCode, kp);
-					}
-				}
-				
+				bHasHisData = cacheBars(rawKey, stdCode, kp);
 			}
 			else
 			{
@@ -2200,27 +2391,7 @@ WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char*
 		}
 		else
 		{
-			/*
-			 *	By Wesley @ 2021.12.20
-			 *	先从extloader加载数据，如果加载不到，再走原来的历史数据存储引擎加载
-			 */
-			if (NULL != _bt_loader)
-			{
-				bHasHisData = cacheFinalBarsFromLoader(key, stdCode, kp);
-			}
-
-			if(!bHasHisData)
-			{
-				if (_mode == "csv")
-				{
-					bHasHisData = cacheRawBarsFromCSV(key, stdCode, kp);
-				}
-				else
-				{
-					bHasHisData = cacheRawBarsFromBin(key, stdCode, kp);
-				}
-			}
-			
+			bHasHisData = cacheBars(key, stdCode, kp);
 		}
 	}
 	else
@@ -2246,7 +2417,8 @@ WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char*
 		WTSKlineSlice* rawKline = WTSKlineSlice::create(stdCode, kp, realTimes, &rawBars->_bars[0], rawBars->_bars.size());
 		rawKline->setCode(stdCode);
 
-		static WTSDataFactory dataFact;
+		//批量回测时多个回放器在不同的线程里重采样
+		thread_local static WTSDataFactory dataFact;
 		WTSKlineData* kData = dataFact.extractKlineData(rawKline, kp, realTimes, sInfo, true, _align_by_section);
 		rawKline->release();
 
@@ -2396,6 +2568,9 @@ WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char*
 	}
 
 
+	//游标可能被初始化或者移动过，按照新的游标调度
+	schedule_bars(_bars_sched, key, kBlkPair);
+
 	if (kBlkPair->_cursor == 0)
 		return NULL;
 
@@ -3135,28 +3310,7 @@ void HisDataReplayer::checkUnbars()
 		else
 			kp = KP_DAY;
 
-		/*
-		 *	By Wesley @ 2021.12.20
-		 *	先从extloader加载最终的K线数据
-		 *	如果加载不到，再从配置的历史数据存储引擎加载数据
-		 */
-		if (NULL != _bt_loader)
-		{
-			bHasHisData = cacheFinalBarsFromLoader(key, stdCode.c_str(), kp, false);
-		}
-
-		if(!bHasHisData)
-		{
-			if (_mode == "csv")
-			{
-				bHasHisData = cacheRawBarsFromCSV(key, stdCode.c_str(), kp, false);
-			}
-			else
-			{
-				bHasHisData = cacheRawBarsFromBin(key, stdCode.c_str(), kp, false);
-			}
-		}
-		
+		bHasHisData = cacheBars(key, stdCode.c_str(), kp, false);
 		if (!bHasHisData)
 			continue;
 
@@ -3190,6 +3344,7 @@ void HisDataReplayer::checkUnbars()
 			}
 
 			kBlkPair->_cursor = eIdx + 1;
+			schedule_bars(_unbars_sched, key, kBlkPair);
 		}
 	}
 }
@@ -3233,48 +3388,114 @@ uint32_t strToDate(const char* strDate)
 	return strtoul(ss.str().c_str(), NULL, 10);
 }
 
-bool HisDataReplayer::cacheRawTicksFromBin(const std::string& key, const char* stdCode, uint32_t uDate)
+bool HisDataReplayer::loadHftDataFromBin(HftDataPrefetcher::HftDataType dType, const char* stdCode, uint32_t uDate, std::string& buffer)
 {
 	CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, &_hot_mgr);
-	std::string stdPID = StrUtil::printf("%s.%s", cInfo._exchg, cInfo._product);
-	
-	std::string rawCode = cInfo._code;
-	if(strlen(cInfo._ruletag) > 0)
+	auto cb = [&buffer](std::string& data) {
+		buffer.swap(data);
+	};
+
+	bool bHit = false;
+	switch (dType)
+	{
+	case HftDataPrefetcher::HDT_TICK:
 	{
-		rawCode = _hot_mgr.getCustomRawCode(cInfo._ruletag, cInfo.stdCommID(), uDate);
+		std::string rawCode = cInfo._code;
+		if (strlen(cInfo._ruletag) > 0)
+		{
+			rawCode = _hot_mgr.getCustomRawCode(cInfo._ruletag, cInfo.stdCommID(), uDate);
+		}
+
+		//先检查有没有HOT、SND的主力次主力的tick文件
+		const char* ruleTag = cInfo._ruletag;
+		if (strlen(ruleTag) > 0)
+		{
+			const char* hot_flag = ruleTag;
+			std::string wrappCode = StrUtil::printf("%s_%s", cInfo._product, hot_flag);
+			bHit = _his_dt_mgr.load_raw_ticks(cInfo._exchg, wrappCode.c_str(), uDate, cb);
+		}
+
+		//如果没有找到，则读取分月合约
+		if (!bHit)
+		{
+			/*
+			 *	By Wesley @ 2022.01.11
+			 *	这里将直接从文件读取，改成从HisDtMgr封装的接口加载
+			 */
+			bHit = _his_dt_mgr.load_raw_ticks(cInfo._exchg, rawCode.c_str(), uDate, cb);
+		}
+
+		if (!bHit)
+			WTSLogger::warn("No ticks data of {} on {} found", stdCode, uDate);
+		break;
+	}
+	case HftDataPrefetcher::HDT_ORDDTL:
+		bHit = _his_dt_mgr.load_raw_orddtl(cInfo._exchg, cInfo._code, uDate, cb);
+		if (!bHit)
+			WTSLogger::warn("No order detail data of {} on {} found", stdCode, uDate);
+		break;
+	case HftDataPrefetcher::HDT_ORDQUE:
+		bHit = _his_dt_mgr.load_raw_ordque(cInfo._exchg, cInfo._code, uDate, cb);
+		if (!bHit)
+			WTSLogger::warn("No order queue data of {} on {} found", stdCode, uDate);
+		break;
+	case HftDataPrefetcher::HDT_TRANS:
+		bHit = _his_dt_mgr.load_raw_trans(cInfo._exchg, cInfo._code, uDate, cb);
+		if (!bHit)
+			WTSLogger::warn("No transaction data of {} on {} found", stdCode, uDate);
+		break;
+	default:
+		break;
 	}
 
+	return bHit;
+}
 
-	std::string content;
+bool HisDataReplayer::fetchHftData(HftDataPrefetcher::HftDataType dType, const char* stdCode, uint32_t uDate, std::string& buffer)
+{
+	TimeUtils::Ticker ticker;
 	bool bHit = false;
-	//先检查有没有HOT、SND的主力次主力的tick文件
-	const char* ruleTag = cInfo._ruletag;
-	if(strlen(ruleTag) > 0)
-	{
-		const char* hot_flag = ruleTag;
-		std::string wrappCode = StrUtil::printf("%s_%s", cInfo._product, hot_flag);
-		bHit = _his_dt_mgr.load_raw_ticks(cInfo._exchg, wrappCode.c_str(), uDate, [&content](std::string& data) {
-			content.swap(data);
-		});
-	}
+	if (!_prefetcher.take(dType, stdCode, uDate, buffer, bHit))
+		bHit = loadHftDataFromBin(dType, stdCode, uDate, buffer);
+
+	_io_wait_ns += ticker.nano_seconds();
+	return bHit;
+}
 
-	//如果没有找到，则读取分月合约
-	if (!bHit)
+void HisDataReplayer::prefetch_hft_datas(uint32_t curTDate)
+{
+	_prefetcher.discard_before(curTDate);
+
+	HftDataPrefetcher::DataItems items;
+	for (auto& v : _tick_sub_map)
+		items.emplace_back(HftDataPrefetcher::HDT_TICK, v.first);
+	for (auto& v : _orddtl_sub_map)
+		items.emplace_back(HftDataPrefetcher::HDT_ORDDTL, v.first);
+	for (auto& v : _ordque_sub_map)
+		items.emplace_back(HftDataPrefetcher::HDT_ORDQUE, v.first);
+	for (auto& v : _trans_sub_map)
+		items.emplace_back(HftDataPrefetcher::HDT_TRANS, v.first);
+
+	if (items.empty())
+		return;
+
+	//交易日按回放任务的节假日模板推算，没有任务的时候用默认模板
+	const char* trdtpl = (_task != NULL) ? _task->_trdtpl : "CHINA";
+
+	//已经放进队列的日期会被忽略，所以每天只会新增最后一个交易日
+	uint32_t uDate = curTDate;
+	for (uint32_t i = 0; i < _prefetch_days; i++)
 	{
-		/*
-		 *	By Wesley @ 2022.01.11
-		 *	这里将直接从文件读取，改成从HisDtMgr封装的接口加载
-		 */
-		bHit = _his_dt_mgr.load_raw_ticks(cInfo._exchg, rawCode.c_str(), uDate, [&content](std::string& data) {
-			content.swap(data);
-		});
+		uDate = _bd_mgr.getNextTDate(trdtpl, uDate, 1, true);
+		_prefetcher.schedule(uDate, items);
 	}
+}
 
-	if(!bHit)
-	{
-		WTSLogger::warn("No ticks data of {} on {} found", stdCode, uDate);
+bool HisDataReplayer::cacheRawTicksFromBin(const std::string& key, const char* stdCode, uint32_t uDate)
+{
+	std::string content;
+	if (!fetchHftData(HftDataPrefetcher::HDT_TICK, stdCode, uDate, content))
 		return false;
-	}
 
 	auto& ticksList = _ticks_cache[key];
 	uint32_t tickcnt = 0;
@@ -3292,18 +3513,9 @@ bool HisDataReplayer::cacheRawTicksFromBin(const std::string& key, const char* s
 
 bool HisDataReplayer::cacheRawOrdDtlFromBin(const std::string& key, const char* stdCode, uint32_t uDate)
 {
-	CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, &_hot_mgr);
-
 	std::string content;
-	bool bHit = _his_dt_mgr.load_raw_orddtl(cInfo._exchg, cInfo._code, uDate, [&content](std::string& data) {
-		content.swap(data);
-	});
-
-	if (!bHit)
-	{
-		WTSLogger::warn("No order detail data of {} on {} found", stdCode, uDate);
+	if (!fetchHftData(HftDataPrefetcher::HDT_ORDDTL, stdCode, uDate, content))
 		return false;
-	}
 
 	auto& dataList = _orddtl_cache[key];
 	uint32_t dataCnt = 0;
@@ -3321,18 +3533,9 @@ bool HisDataReplayer::cacheRawOrdDtlFromBin(const std::string& key, const char*
 
 bool HisDataReplayer::cacheRawOrdQueFromBin(const std::string& key, const char* stdCode, uint32_t uDate)
 {
-	CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, &_hot_mgr);
-
 	std::string content;
-	bool bHit = _his_dt_mgr.load_raw_ordque(cInfo._exchg, cInfo._code, uDate, [&content](std::string& data) {
-		content.swap(data);
-	});
-
-	if (!bHit)
-	{
-		WTSLogger::warn("No order queue data of {} on {} found", stdCode, uDate);
+	if (!fetchHftData(HftDataPrefetcher::HDT_ORDQUE, stdCode, uDate, content))
 		return false;
-	}
 
 	auto& dataList = _ordque_cache[key];
 	uint32_t dataCnt = 0;
@@ -3350,18 +3553,9 @@ bool HisDataReplayer::cacheRawOrdQueFromBin(const std::string& key, const char*
 
 bool HisDataReplayer::cacheRawTransFromBin(const std::string& key, const char* stdCode, uint32_t uDate)
 {
-	CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, &_hot_mgr);
-
 	std::string content;
-	bool bHit = _his_dt_mgr.load_raw_trans(cInfo._exchg, cInfo._code, uDate, [&content](std::string& data) {
-		content.swap(data);
-	});
-
-	if (!bHit)
-	{
-		WTSLogger::warn("No transaction data of {} on {} found", stdCode, uDate);
+	if (!fetchHftData(HftDataPrefetcher::HDT_TRANS, stdCode, uDate, content))
 		return false;
-	}
 
 	auto& dataList = _trans_cache[key];
 	uint32_t dataCnt = 0;
@@ -3429,11 +3623,13 @@ bool HisDataReplayer::cacheRawTicksFromCSV(const std::string& key, const char* s
 		}
 
 		WTSLogger::info("Processing file content of {}...", filename);
-		proc_block_data(filename.c_str(), content, false, false);
-		uint32_t tickcnt = content.size() / sizeof(WTSTickStruct);
 		auto& ticksList = _ticks_cache[key];
-		ticksList._items.resize(tickcnt);
-		memcpy(ticksList._items.data(), content.data(), content.size());
+		if (!proc_block_data(filename.c_str(), content, ticksList._items, false))
+		{
+			_ticks_cache.erase(key);
+			return false;
+		}
+		uint32_t tickcnt = (uint32_t)ticksList._items.size();
 		ticksList._cursor = UINT_MAX;
 		ticksList._code = stdCode;
 		ticksList._date = uDate;
@@ -3523,6 +3719,66 @@ bool HisDataReplayer::cacheRawTicksFromCSV(const std::string& key, const char* s
 	return true;
 }
 
+bool HisDataReplayer::cacheBars(const std::string& key, const char* stdCode, WTSKlinePeriod period, bool bSubbed /* = true */)
+{
+	if (_shared_cache == NULL)
+		return cacheBarsFromSource(key, stdCode, period, bSubbed);
+
+	BarsCache& barsCache = bSubbed ? _bars_cache : _unbars_cache;
+	SharedDataCache::BarsEntry entry;
+	bool bSucc = _shared_cache->get_bars(key, entry, [this, &barsCache, &key, stdCode, period, bSubbed](SharedDataCache::BarsEntry& item) {
+		if (!cacheBarsFromSource(key, stdCode, period, bSubbed))
+			return false;
+
+		BarsListPtr& barsList = barsCache[key];
+		if (barsList == NULL)
+			return false;
+
+		item._bars = barsList->_data;
+		item._count = barsList->_count;
+		item._factor = barsList->_factor;
+		return true;
+	});
+
+	if (!bSucc)
+		return false;
+
+	//数据是别的回放器加载的，这里只需要引用共享的数据
+	BarsListPtr& barsList = barsCache[key];
+	if (barsList == NULL || barsList->_data != entry._bars)
+	{
+		barsList.reset(new BarsList(entry._bars));
+		barsList->_code = stdCode;
+		barsList->_period = period;
+		barsList->_count = entry._count;
+		barsList->_factor = entry._factor;
+		WTSLogger::debug("{} items of back bars of {} referenced from shared cache", entry._count, key);
+	}
+
+	return true;
+}
+
+bool HisDataReplayer::cacheBarsFromSource(const std::string& key, const char* stdCode, WTSKlinePeriod period, bool bSubbed /* = true */)
+{
+	/*
+	 *	By Wesley @ 2021.12.20
+	 *	先从extloader加载数据，如果加载不到，再走原来的历史数据存储引擎加载
+	 */
+	bool bHasHisData = false;
+	if (NULL != _bt_loader)
+		bHasHisData = cacheFinalBarsFromLoader(key, stdCode, period, bSubbed);
+
+	if (!bHasHisData)
+	{
+		if (_mode == "csv")
+			bHasHisData = cacheRawBarsFromCSV(key, stdCode, period, bSubbed);
+		else
+			bHasHisData = cacheRawBarsFromBin(key, stdCode, period, bSubbed);
+	}
+
+	return bHasHisData;
+}
+
 bool HisDataReplayer::cacheFinalBarsFromLoader(const std::string& key, const char* stdCode, WTSKlinePeriod period, bool bSubbed /* = true */)
 {
 	if (NULL == _bt_loader)
@@ -3579,18 +3835,19 @@ bool HisDataReplayer::cacheFinalBarsFromLoader(const std::string& key, const cha
 		}
 		else
 		{
+			//转储的数据直接解压到K线缓存里
 			HisKlineBlockV2* kBlock = (HisKlineBlockV2*)content.c_str();
-			std::string rawData = WTSCmpHelper::uncompress_data(kBlock->_data, kBlock->_size);
-			uint32_t barcnt = rawData.size() / sizeof(WTSBarStruct);
+			std::size_t rawSize = ChunkHelper::uncompressed_size(kBlock);
+			uint32_t barcnt = (uint32_t)(rawSize / sizeof(WTSBarStruct));
 
+			BarsListPtr barsList(new BarsList);
+			barsList->_bars.resize(barcnt);
+			ChunkHelper::uncompress_to(barsList->_bars.data(), barcnt * sizeof(WTSBarStruct), kBlock);
 			if (bSubbed)
-				_bars_cache[key].reset(new BarsList);
+				_bars_cache[key] = barsList;
 			else
-				_unbars_cache[key].reset(new BarsList);
+				_unbars_cache[key] = barsList;
 
-			BarsListPtr& barsList = bSubbed ? _bars_cache[key] : _unbars_cache[key];
-			barsList->_bars.resize(barcnt);
-			memcpy(barsList->_bars.data(), rawData.data(), rawData.size());
 			barsList->_cursor = UINT_MAX;
 			barsList->_code = stdCode;
 			barsList->_period = period;
@@ -3727,17 +3984,16 @@ bool HisDataReplayer::cacheRawBarsFromCSV(const std::string& key, const char* st
 
 		//By Wesley @ 2021.12.30
 		//转储的数据不做检查，直接重新生成即可
-		proc_block_data(filename.c_str(), content, true, false);
-		uint32_t barcnt = content.size() / sizeof(WTSBarStruct);
+		BarsListPtr barsList(new BarsList);
+		if (!proc_block_data(filename.c_str(), content, barsList->_bars.own(), true) || barsList->_bars.empty())
+			return false;
 
+		uint32_t barcnt = (uint32_t)barsList->_bars.size();
 		if (bSubbed)
-			_bars_cache[key].reset(new BarsList);
+			_bars_cache[key] = barsList;
 		else
-			_unbars_cache[key].reset(new BarsList);
+			_unbars_cache[key] = barsList;
 
-		BarsListPtr& barsList = bSubbed ? _bars_cache[key] : _unbars_cache[key];
-		barsList->_bars.resize(barcnt);
-		memcpy(barsList->_bars.data(), content.data(), content.size());
 		barsList->_cursor = UINT_MAX;
 		barsList->_code = stdCode;
 		barsList->_period = period;
@@ -3884,9 +4140,7 @@ bool HisDataReplayer::cacheIntegratedFutBarsFromBin(void* codeInfo, const std::s
 		std::string wrappCode = StrUtil::printf("%s.%s_%s", cInfo->_exchg, cInfo->_product, ruleTag);
 		if (cInfo->isExright())
 			wrappCode += cInfo->_exright == 1 ? SUFFIX_QFQ : SUFFIX_HFQ;
-		bool bSucc = _his_dt_mgr.load_raw_bars(cInfo->_exchg, wrappCode.c_str(), period, [&content](std::string& data) {
-			content.swap(data);
-		});
+		bool bSucc = read_raw_bars(cInfo->_exchg, wrappCode.c_str(), period, content);
 
 		if(!bSucc)
 		{
@@ -4006,9 +4260,7 @@ bool HisDataReplayer::cacheIntegratedFutBarsFromBin(void* codeInfo, const std::s
 
 		if (!bLoaded)
 		{
-			bLoaded = _his_dt_mgr.load_raw_bars(cInfo->_exchg, curCode, period, [&buffer](std::string& data) {
-				buffer.swap(data);
-			});
+			bLoaded = read_raw_bars(cInfo->_exchg, curCode, period, buffer);
 
 			if (!bLoaded)
 			{
@@ -4128,7 +4380,8 @@ bool HisDataReplayer::cacheIntegratedFutBarsFromBin(void* codeInfo, const std::s
 
 const HisDataReplayer::AdjFactorList& HisDataReplayer::getAdjFactors(const char* code, const char* exchg, const char* pid /* = "" */)
 {
-	static char key[20] = { 0 };
+	//批量回测时多个回放器会并行调用，这里不能用静态变量
+	thread_local static char key[20] = { 0 };
 	fmtutil::format_to(key, "{}.{}.{}", exchg, pid, code);
 
 	auto it = _adj_factors.find(key);
@@ -4207,9 +4460,7 @@ bool HisDataReplayer::cacheAdjustedStkBarsFromBin(void* codeInfo, const std::str
 		 */
 		std::string wrappCode = fmt::format("{}{}", cInfo->_code, (cInfo->_exright == 1 ? SUFFIX_QFQ : SUFFIX_HFQ));
 		std::string content;
-		bool bSucc = _his_dt_mgr.load_raw_bars(cInfo->_exchg, wrappCode.c_str(), period, [&content](std::string& data) {
-			content.swap(data);
-		});
+		bool bSucc = read_raw_bars(cInfo->_exchg, wrappCode.c_str(), period, content);
 
 		if(!bSucc)
 		{
@@ -4277,9 +4528,7 @@ bool HisDataReplayer::cacheAdjustedStkBarsFromBin(void* codeInfo, const std::str
 			 *	By Wesley @ 2022.01.11
 			 *	这里将文件读取改为从HisDtMgr封装的接口读取
 			 */
-			bLoaded = _his_dt_mgr.load_raw_bars(cInfo->_exchg, curCode, period, [&buffer](std::string& data) {
-				buffer.swap(data);
-			});
+			bLoaded = read_raw_bars(cInfo->_exchg, curCode, period, buffer);
 
 			if (!bLoaded)
 			{
@@ -4418,6 +4667,50 @@ bool HisDataReplayer::cacheAdjustedStkBarsFromBin(void* codeInfo, const std::str
 }
 
 
+BarCacheFilePtr HisDataReplayer::open_bar_cache(const char* exchg, const char* code, WTSKlinePeriod period)
+{
+	if (_bar_cache_dir.empty())
+		return BarCacheFilePtr();
+
+	std::string filename = fmt::format("{}{}/{}/{}.wbc", _bar_cache_dir, PERIOD_NAME[period], exchg, code);
+	if (!StdFile::exists(filename.c_str()))
+		return BarCacheFilePtr();
+
+	//缓存文件比原始数据文件旧，说明数据更新以后还没有重新生成缓存，不能用
+	std::string dsbFile = fmt::format("{}his/{}/{}/{}.dsb", _base_dir, PERIOD_NAME[period], exchg, code);
+	boost::system::error_code ec;
+	if (StdFile::exists(dsbFile.c_str()) &&
+		boost::filesystem::last_write_time(dsbFile, ec) > boost::filesystem::last_write_time(filename, ec))
+	{
+		WTSLogger::warn("Bar cache {} is older than {}, ignored", filename, dsbFile);
+		return BarCacheFilePtr();
+	}
+
+	BarCacheFilePtr cacheFile(new BarCacheFile);
+	if (!cacheFile->open(filename.c_str()) || cacheFile->count() == 0)
+	{
+		WTSLogger::warn("Bar cache {} is invalid, ignored", filename);
+		return BarCacheFilePtr();
+	}
+
+	return cacheFile;
+}
+
+bool HisDataReplayer::read_raw_bars(const char* exchg, const char* code, WTSKlinePeriod period, std::string& buffer)
+{
+	//有缓存文件的话，拷贝一次就可以了，不需要再解压
+	BarCacheFilePtr cacheFile = open_bar_cache(exchg, code, period);
+	if (cacheFile)
+	{
+		buffer.assign((const char*)cacheFile->bars(), (std::size_t)(sizeof(WTSBarStruct)*cacheFile->count()));
+		return true;
+	}
+
+	return _his_dt_mgr.load_raw_bars(exchg, code, period, [&buffer](std::string& data) {
+		buffer.swap(data);
+	});
+}
+
 bool HisDataReplayer::cacheRawBarsFromBin(const std::string& key, const char* stdCode, WTSKlinePeriod period, bool bSubbed/* = true*/)
 {
 	CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, &_hot_mgr);
@@ -4490,6 +4783,17 @@ bool HisDataReplayer::cacheRawBarsFromBin(const std::string& key, const char* st
 		//	proc_block_data(filename.c_str(), content, true, false);
 		//	buffer.swap(content);
 		//}
+
+		//有不压缩的K线缓存文件，直接映射到内存里切片，不需要解压和拷贝
+		BarCacheFilePtr cacheFile = open_bar_cache(cInfo._exchg, cInfo._code, period);
+		if (cacheFile)
+		{
+			barsList->_bars.attach(cacheFile);
+			barsList->_count = barsList->_bars.size();
+			WTSLogger::info("{} items of back {} data of {} mapped from bar cache", barsList->_count, PERIOD_NAME[period], stdCode);
+			return true;
+		}
+
 		bLoaded = _his_dt_mgr.load_raw_bars(cInfo._exchg, cInfo._code, period, [&buffer](std::string& data) {
 			buffer.swap(data);
 		});
@@ -4554,6 +4858,8 @@ void HisDataReplayer::check_cache_days()
 			continue;
 
 		BarsListPtr& barsList = (BarsListPtr&)v.second;
+		if (_bars_touched)
+			barsList->mark();
 		barsList->_untouch_days++;
 
 		if (barsList->_untouch_days >= _cache_clear_days)
@@ -4565,8 +4871,14 @@ void HisDataReplayer::check_cache_days()
 		}
 	}
 
+	_bars_touched = false;
+
 	for (const std::string& key : to_clear)
 		_bars_cache.erase(key);
 
+	//清理掉的K线不能再留在调度堆里，否则内存不会释放
+	if (!to_clear.empty())
+		purge_schedule(_bars_sched, _bars_cache);
+
 	WTSLogger::info("Cached bars of {} cleared due to outdated", codes);
 }
\ No newline at end of file
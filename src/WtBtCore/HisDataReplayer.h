@@ -10,7 +10,10 @@
 #pragma once
 #include <string>
 #include <set>
+#include <vector>
 #include "HisDataMgr.h"
+#include "SharedDataCache.h"
+#include "HftDataPrefetcher.h"
 #include "../WtDataStorage/DataDefine.h"
 
 #include "../Includes/FasterDefs.h"
@@ -192,11 +195,19 @@ private:
 		uint32_t		_count;
 		uint32_t		_times;
 
-		std::vector<WTSBarStruct>	_bars;
+		/*
+		 *	K线数据放在智能指针里，批量回测的时候多个回放器引用同一份数据
+		 *	_bars是_data的引用，原来直接使用_bars的地方都不需要修改
+		 */
+		SharedDataCache::BarArrayPtr	_data;
+		BarArray&						_bars;
 		double			_factor;	//最后一条复权因子
 
 		uint32_t		_untouch_days;	//未用到的天数
 
+		std::string		_key;			//在缓存中的键，调度时用
+		uint64_t		_sched_time;	//在调度堆中的下一根K线时间，0为不在堆中
+
 		inline void mark()
 		{
 			_untouch_days = 0;
@@ -207,7 +218,10 @@ private:
 			return sizeof(WTSBarStruct)*_bars.size();
 		}
 
-		_BarsList() :_cursor(UINT_MAX), _count(0), _times(1), _factor(1), _untouch_days(0){}
+		_BarsList(SharedDataCache::BarArrayPtr data = SharedDataCache::BarArrayPtr())
+			: _cursor(UINT_MAX), _count(0), _times(1)
+			, _data(data ? data : std::make_shared<SharedDataCache::BarArray>()), _bars(*_data)
+			, _factor(1), _untouch_days(0), _sched_time(0){}
 	} BarsList;
 
 	/*
@@ -223,6 +237,24 @@ private:
 	typedef std::shared_ptr<BarsList> BarsListPtr;
 	typedef wt_hashmap<std::string, BarsListPtr>	BarsCache;
 
+	/*
+	 *	分钟K线的回放调度
+	 *	按照每个K线序列下一根K线的时间维护一个最小堆，每分钟只处理到点的序列，不用遍历全部缓存
+	 *	堆中的项可能已经过期（游标被移动过，或者缓存被替换、清理），弹出的时候再校验
+	 *	日线序列只在交易日结束时处理，仍然直接遍历缓存
+	 */
+	typedef struct _BarsSchedItem
+	{
+		uint64_t	_time;
+		BarsListPtr	_bars;
+
+		_BarsSchedItem(uint64_t t, const BarsListPtr& bars) :_time(t), _bars(bars){}
+
+		bool operator>(const _BarsSchedItem& other) const { return _time > other._time; }
+	} BarsSchedItem;
+	typedef std::vector<BarsSchedItem>	BarsSchedHeap;
+	typedef std::vector<BarsListPtr>	BarsDueList;
+
 	typedef enum tagTaskPeriodType
 	{
 		TPT_None,		//不重复
@@ -262,6 +294,16 @@ private:
 	 */
 	bool		cacheRawBarsFromBin(const std::string& key, const char* stdCode, WTSKlinePeriod period, bool bForBars = true);
 
+	/*
+	 *	打开不压缩的K线缓存文件，没有配置缓存目录、文件不存在或者已经过期则返回空
+	 */
+	BarCacheFilePtr	open_bar_cache(const char* exchg, const char* code, WTSKlinePeriod period);
+
+	/*
+	 *	读取原始K线数据，有缓存文件则从缓存文件拷贝，否则通过HisDtMgr读取
+	 */
+	bool		read_raw_bars(const char* exchg, const char* code, WTSKlinePeriod period, std::string& buffer);
+
 	/*
 	 *	从csv文件缓存历史数据
 	 */
@@ -287,11 +329,37 @@ private:
 	 */
 	bool		cacheRawTransFromBin(const std::string& key, const char* stdCode, uint32_t uDate);
 
+	/*
+	 *	从自定义数据文件读取一天的高频数据，只读不写缓存，预读线程也会调用
+	 */
+	bool		loadHftDataFromBin(HftDataPrefetcher::HftDataType dType, const char* stdCode, uint32_t uDate, std::string& buffer);
+
+	/*
+	 *	获取一天的高频数据，先取预读好的，取不到再自己读，花费的时间计入IO等待
+	 */
+	bool		fetchHftData(HftDataPrefetcher::HftDataType dType, const char* stdCode, uint32_t uDate, std::string& buffer);
+
+	/*
+	 *	丢掉当前交易日之前没用上的预读数据，并把后面几个交易日的数据放到预读队列里
+	 */
+	void		prefetch_hft_datas(uint32_t curTDate);
+
 	/*
 	 *	从csv文件缓存历史tick数据
 	 */
 	bool		cacheRawTicksFromCSV(const std::string& key, const char* stdCode, uint32_t uDate);
 
+	/*
+	 *	缓存历史K线数据
+	 *	设置了共享缓存的话，先从共享缓存中取，取不到再从数据源加载并放入共享缓存
+	 */
+	bool		cacheBars(const std::string& key, const char* stdCode, WTSKlinePeriod period, bool bSubbed = true);
+
+	/*
+	 *	从数据源缓存历史K线数据，先从外部加载器加载，加载不到再从配置的存储引擎加载
+	 */
+	bool		cacheBarsFromSource(const std::string& key, const char* stdCode, WTSKlinePeriod period, bool bSubbed = true);
+
 	/*
 	 *	从外部加载器缓存历史数据
 	 */
@@ -334,6 +402,22 @@ private:
 
 	void		checkUnbars();
 
+	/*
+	 *	把K线序列按照下一根K线的时间放到调度堆里
+	 *	游标未初始化或者已经回放完的序列不会放进去
+	 */
+	void		schedule_bars(BarsSchedHeap& heap, const std::string& key, const BarsListPtr& barsList);
+
+	/*
+	 *	从调度堆里取出下一根K线时间不晚于nowTime的序列，放到待处理列表中
+	 */
+	void		collect_due_bars(BarsSchedHeap& heap, BarsCache& cache, BarsDueList& dueList, uint64_t nowTime);
+
+	/*
+	 *	清理调度堆里已经失效的项
+	 */
+	void		purge_schedule(BarsSchedHeap& heap, BarsCache& cache);
+
 	bool		loadStkAdjFactorsFromFile(const char* adjfile);
 
 	bool		loadStkAdjFactorsFromLoader();
@@ -398,6 +482,15 @@ public:
 		_end_time = etime;
 	}
 
+	/*
+	 *	设置共享的K线缓存，批量回测时使用，要在prepare之前设置
+	 *	缓存由调用方管理，生命周期要比回放器长
+	 */
+	inline void set_shared_cache(SharedDataCache* cache)
+	{
+		_shared_cache = cache;
+	}
+
 	inline void enable_tick(bool bEnabled = true)
 	{
 		_tick_enabled = bEnabled;
@@ -471,6 +564,11 @@ private:
 
 	BarsCache		_bars_cache;	//K线缓存
 	BarsCache		_unbars_cache;	//未订阅的K线缓存
+	BarsSchedHeap	_bars_sched;	//已订阅的分钟K线调度堆
+	BarsSchedHeap	_unbars_sched;	//未订阅的分钟K线调度堆
+	BarsDueList		_due_bars;		//当前分钟要处理的已订阅K线
+	BarsDueList		_due_unbars;	//当前分钟要处理的未订阅K线
+	bool			_bars_touched;	//上次检查缓存以后是否回放过K线
 	wt_hashset<std::string> _codes_in_subbed;
 	wt_hashset<std::string> _codes_in_unsubbed;
 
@@ -511,6 +609,7 @@ private:
 	WTSHotMgr		_hot_mgr;
 
 	std::string		_base_dir;
+	std::string		_bar_cache_dir;	//不压缩的K线缓存目录，为空则不使用
 	std::string		_mode;
 	uint64_t		_begin_time;
 	uint64_t		_end_time;
@@ -569,5 +668,12 @@ private:
 	EventNotifier*	_notifier;
 
 	HisDataMgr		_his_dt_mgr;
+
+	HftDataPrefetcher	_prefetcher;
+	uint32_t		_prefetch_days;		//预读的交易日数，0为不预读
+	uint64_t		_prefetch_bytes;	//预读数据的字节数上限
+	uint64_t		_io_wait_ns;		//回放线程读取高频数据花费的时间
+
+	SharedDataCache*	_shared_cache;
 };
 
@@ -0,0 +1,486 @@
+﻿#include "L2MatchEngine.h"
+#include "HisDataReplayer.h"
+
+#include "../Includes/WTSDataDef.hpp"
+#include "../Includes/WTSVariant.hpp"
+#include "../Includes/WTSContractInfo.hpp"
+
+#include "../Share/decimal.h"
+#include "../WTSTools/WTSLogger.h"
+
+#include <algorithm>
+#include <math.h>
+
+#define NO_BID_PRICE	INT64_MIN
+#define NO_ASK_PRICE	INT64_MAX
+
+L2MatchEngine::L2MatchEngine(HisDataReplayer* replayer)
+	: _replayer(replayer)
+	, _sink(NULL)
+	, _window(1024)
+	, _notifying(false)
+{
+}
+
+void L2MatchEngine::init(WTSVariant* cfg)
+{
+	if (cfg == NULL)
+		return;
+
+	if (cfg->has("window"))
+		_window = std::max(cfg->getUInt32("window"), (uint32_t)16);
+}
+
+void L2MatchEngine::clear()
+{
+	_books.clear();
+	_my_orders.clear();
+	_nodes.clear();
+	_free_nodes.clear();
+	_events.clear();
+}
+
+L2MatchEngine::OrderBook* L2MatchEngine::get_book(const char* stdCode, double refPx)
+{
+	auto it = _books.find(stdCode);
+	if (it != _books.end())
+		return it->second.get();
+
+	double tick = 0;
+	WTSCommodityInfo* commInfo = _replayer->get_commodity_info(stdCode);
+	if (commInfo)
+		tick = commInfo->getPriceTick();
+	if (decimal::le(tick, 0))
+		tick = 0.01;
+
+	OrderBookPtr book(new OrderBook);
+	book->_code = stdCode;
+	book->_tick = tick;
+	book->_base_idx = price_index(book.get(), refPx) - _window / 2;
+	book->_bids.resize(_window);
+	book->_asks.resize(_window);
+	book->_best_bid = NO_BID_PRICE;
+	book->_best_ask = NO_ASK_PRICE;
+	_books[stdCode] = book;
+
+	WTSLogger::debug("L2 order book of {} created, price tick: {}, reference price: {}", stdCode, tick, refPx);
+	return book.get();
+}
+
+inline int64_t L2MatchEngine::price_index(OrderBook* book, double price) const
+{
+	return (int64_t)llround(price / book->_tick);
+}
+
+L2MatchEngine::PriceLevel& L2MatchEngine::get_level(OrderBook* book, bool isBuy, int64_t pxIdx)
+{
+	//超出范围了，两边的数组同时扩展，每次至少扩展半个窗口
+	if (pxIdx < book->_base_idx)
+	{
+		std::size_t cnt = (std::size_t)std::max(book->_base_idx - pxIdx, (int64_t)_window / 2);
+		book->_bids.insert(book->_bids.begin(), cnt, PriceLevel());
+		book->_asks.insert(book->_asks.begin(), cnt, PriceLevel());
+		book->_base_idx -= cnt;
+	}
+	else if (pxIdx >= book->_base_idx + (int64_t)book->_bids.size())
+	{
+		std::size_t cnt = (std::size_t)std::max(pxIdx - book->_base_idx - (int64_t)book->_bids.size() + 1, (int64_t)_window / 2);
+		book->_bids.resize(book->_bids.size() + cnt);
+		book->_asks.resize(book->_asks.size() + cnt);
+	}
+
+	PriceLevels& levels = isBuy ? book->_bids : book->_asks;
+	return levels[pxIdx - book->_base_idx];
+}
+
+int32_t L2MatchEngine::alloc_node()
+{
+	if (!_free_nodes.empty())
+	{
+		int32_t idx = _free_nodes.back();
+		_free_nodes.pop_back();
+		return idx;
+	}
+
+	_nodes.emplace_back();
+	return (int32_t)_nodes.size() - 1;
+}
+
+void L2MatchEngine::free_node(int32_t idx)
+{
+	_free_nodes.emplace_back(idx);
+}
+
+void L2MatchEngine::link_node(OrderBook* book, int32_t idx)
+{
+	OrderNode& node = _nodes[idx];
+	PriceLevel& level = get_level(book, node._buy, node._px_idx);
+	node._prev = level._tail;
+	node._next = -1;
+	if (level._tail != -1)
+		_nodes[level._tail]._next = idx;
+	else
+		level._head = idx;
+	level._tail = idx;
+}
+
+void L2MatchEngine::unlink_node(OrderBook* book, int32_t idx)
+{
+	OrderNode& node = _nodes[idx];
+	PriceLevel& level = get_level(book, node._buy, node._px_idx);
+	if (node._prev != -1)
+		_nodes[node._prev]._next = node._next;
+	else
+		level._head = node._next;
+
+	if (node._next != -1)
+		_nodes[node._next]._prev = node._prev;
+	else
+		level._tail = node._prev;
+
+	node._prev = node._next = -1;
+}
+
+void L2MatchEngine::add_volume(OrderBook* book, bool isBuy, int64_t pxIdx, double qty)
+{
+	get_level(book, isBuy, pxIdx)._volume += qty;
+	if (isBuy && (book->_best_bid == NO_BID_PRICE || pxIdx > book->_best_bid))
+		book->_best_bid = pxIdx;
+	else if (!isBuy && (book->_best_ask == NO_ASK_PRICE || pxIdx < book->_best_ask))
+		book->_best_ask = pxIdx;
+}
+
+void L2MatchEngine::sub_volume(OrderBook* book, bool isBuy, int64_t pxIdx, double qty)
+{
+	PriceLevel& level = get_level(book, isBuy, pxIdx);
+	level._volume -= qty;
+	if (decimal::gt(level._volume, 0))
+		return;
+
+	level._volume = 0;
+
+	//最优价位被吃光了，往后找下一个有挂单的价位
+	PriceLevels& levels = isBuy ? book->_bids : book->_asks;
+	int64_t endIdx = book->_base_idx + (int64_t)levels.size();
+	if (isBuy && pxIdx == book->_best_bid)
+	{
+		int64_t idx = pxIdx - 1;
+		while (idx >= book->_base_idx && decimal::le(levels[idx - book->_base_idx]._volume, 0))
+			idx--;
+		book->_best_bid = (idx >= book->_base_idx) ? idx : NO_BID_PRICE;
+	}
+	else if (!isBuy && pxIdx == book->_best_ask)
+	{
+		int64_t idx = pxIdx + 1;
+		while (idx < endIdx && decimal::le(levels[idx - book->_base_idx]._volume, 0))
+			idx++;
+		book->_best_ask = (idx < endIdx) ? idx : NO_ASK_PRICE;
+	}
+}
+
+void L2MatchEngine::handle_order_detail(const char* stdCode, WTSOrdDtlData* curOrdDtl)
+{
+	WTSOrdDtlStruct& od = curOrdDtl->getOrdDtlStruct();
+
+	//市价委托不会挂在订单簿上，后面会直接体现在逐笔成交里
+	if (od.otype == ODT_AnyPrice || od.otype == ODT_BestPrice || decimal::le(od.price, 0) || od.volume == 0)
+		return;
+
+	if (od.side != BDT_Buy && od.side != BDT_Sell)
+		return;
+
+	OrderBook* book = get_book(stdCode, od.price);
+
+	int32_t idx = alloc_node();
+	OrderNode& node = _nodes[idx];
+	node._id = od.index;
+	node._localid = 0;
+	node._buy = (od.side == BDT_Buy);
+	node._px_idx = price_index(book, od.price);
+	node._price = od.price;
+	node._left = od.volume;
+	node._time = (uint64_t)od.action_date * 1000000000 + od.action_time;
+	link_node(book, idx);
+	add_volume(book, node._buy, node._px_idx, node._left);
+
+	book->_mkt_orders[od.index] = idx;
+}
+
+void L2MatchEngine::reduce_market_order(OrderBook* book, uint64_t ordId, double qty)
+{
+	if (ordId == 0)
+		return;
+
+	auto it = book->_mkt_orders.find(ordId);
+	if (it == book->_mkt_orders.end())
+		return;
+
+	int32_t idx = it->second;
+	OrderNode& node = _nodes[idx];
+	double realQty = std::min(qty, node._left);
+	node._left -= realQty;
+	sub_volume(book, node._buy, node._px_idx, realQty);
+
+	if (decimal::le(node._left, 0))
+	{
+		unlink_node(book, idx);
+		free_node(idx);
+		book->_mkt_orders.erase(it);
+	}
+}
+
+void L2MatchEngine::handle_transaction(const char* stdCode, WTSTransData* curTrans)
+{
+	WTSTransStruct& ts = curTrans->getTransStruct();
+	if (ts.volume == 0)
+		return;
+
+	auto it = _books.find(stdCode);
+	if (it == _books.end())
+		return;
+
+	OrderBook* book = it->second.get();
+	if (ts.ttype == TT_Cancel)
+	{
+		reduce_market_order(book, ts.bidorder != 0 ? ts.bidorder : ts.askorder, ts.volume);
+		return;
+	}
+
+	//先确定被动成交的一方，主动方不明确的时候，先到的委托为被动方
+	bool passiveBuy;
+	if (ts.side == BDT_Buy)
+		passiveBuy = false;
+	else if (ts.side == BDT_Sell)
+		passiveBuy = true;
+	else
+		passiveBuy = (ts.bidorder != 0 && (ts.askorder == 0 || ts.bidorder < ts.askorder));
+
+	if (!book->_my_orders.empty())
+	{
+		uint64_t passiveId = passiveBuy ? ts.bidorder : ts.askorder;
+		auto pit = book->_mkt_orders.find(passiveId);
+		int32_t passiveNode = (pit == book->_mkt_orders.end()) ? -1 : pit->second;
+		match_my_orders(book, passiveBuy, price_index(book, ts.price), passiveNode, ts.volume, ts.price);
+	}
+
+	reduce_market_order(book, ts.bidorder, ts.volume);
+	reduce_market_order(book, ts.askorder, ts.volume);
+
+	notify_events();
+}
+
+void L2MatchEngine::match_my_orders(OrderBook* book, bool passiveBuy, int64_t pxIdx, int32_t passiveNode, double qty, double price)
+{
+	//第一步，价格比成交价更优的订单，一定会先于这笔委托成交，按价格优先、时间优先排序
+	std::vector<int32_t> better;
+	for (uint32_t localid : book->_my_orders)
+	{
+		int32_t idx = _my_orders[localid]._node;
+		const OrderNode& node = _nodes[idx];
+		if (node._buy != passiveBuy)
+			continue;
+
+		if ((passiveBuy && node._px_idx > pxIdx) || (!passiveBuy && node._px_idx < pxIdx))
+			better.emplace_back(idx);
+	}
+
+	std::sort(better.begin(), better.end(), [this, passiveBuy](int32_t a, int32_t b) {
+		const OrderNode& na = _nodes[a];
+		const OrderNode& nb = _nodes[b];
+		if (na._px_idx != nb._px_idx)
+			return passiveBuy ? (na._px_idx > nb._px_idx) : (na._px_idx < nb._px_idx);
+		return na._time < nb._time;
+	});
+
+	for (int32_t idx : better)
+	{
+		if (decimal::le(qty, 0))
+			return;
+
+		//成交价按自己的委托价计算
+		qty -= fill_my_order(book, idx, qty, _nodes[idx]._price);
+	}
+
+	//第二步，同一价位上排在被动方前面的订单
+	//如果被动方不在订单簿里（如回放开始之前的委托），则只有排在队首的订单才成交
+	int32_t idx = get_level(book, passiveBuy, pxIdx)._head;
+	while (idx != -1 && idx != passiveNode && decimal::gt(qty, 0))
+	{
+		int32_t next = _nodes[idx]._next;
+		if (_nodes[idx]._localid != 0)
+			qty -= fill_my_order(book, idx, qty, price);
+		else if (passiveNode == -1)
+			break;
+
+		idx = next;
+	}
+}
+
+double L2MatchEngine::fill_my_order(OrderBook* book, int32_t idx, double qty, double price)
+{
+	OrderNode& node = _nodes[idx];
+	double curQty = std::min(qty, node._left);
+	if (decimal::le(curQty, 0))
+		return 0;
+
+	node._left -= curQty;
+
+	//回报放到队列里，节点释放之前先把需要的数据拷出来
+	uint32_t localid = node._localid;
+	push_event(localid, book->_code.c_str(), node._buy, curQty, node._price, price, node._left, false, node._time);
+	if (decimal::le(node._left, 0))
+		remove_my_order(book, localid);
+
+	return curQty;
+}
+
+void L2MatchEngine::push_event(uint32_t localid, const char* stdCode, bool isBuy, double qty, double ordPx, double trdPx, double left, bool bCanceled, uint64_t ordTime)
+{
+	if (_sink == NULL)
+		return;
+
+	_events.emplace_back();
+	MatchEvent& evt = _events.back();
+	evt._localid = localid;
+	evt._code = stdCode;
+	evt._buy = isBuy;
+	evt._qty = qty;
+	evt._ord_px = ordPx;
+	evt._trd_px = trdPx;
+	evt._left = left;
+	evt._canceled = bCanceled;
+	evt._time = ordTime;
+}
+
+void L2MatchEngine::notify_events()
+{
+	if (_notifying || _events.empty())
+		return;
+
+	_notifying = true;
+	//回调里可能追加新的回报，不能用迭代器遍历，每次都拷一份出来
+	for (std::size_t i = 0; i < _events.size(); i++)
+	{
+		MatchEvent evt = _events[i];
+		if (decimal::gt(evt._qty, 0))
+			_sink->handle_trade(evt._localid, evt._code.c_str(), evt._buy, evt._qty, evt._ord_px, evt._trd_px, evt._time);
+		_sink->handle_order(evt._localid, evt._code.c_str(), evt._buy, evt._left, evt._ord_px, evt._canceled, evt._time);
+	}
+	_events.clear();
+	_notifying = false;
+}
+
+void L2MatchEngine::remove_my_order(OrderBook* book, uint32_t localid)
+{
+	auto it = _my_orders.find(localid);
+	if (it == _my_orders.end())
+		return;
+
+	int32_t idx = it->second._node;
+	unlink_node(book, idx);
+	free_node(idx);
+	_my_orders.erase(it);
+
+	auto& ids = book->_my_orders;
+	ids.erase(std::remove(ids.begin(), ids.end(), localid), ids.end());
+}
+
+void L2MatchEngine::place(uint32_t localid, const char* stdCode, bool isBuy, double price, double qty, uint64_t curTime)
+{
+	bool isMarket = decimal::eq(price, 0);
+
+	auto it = _books.find(stdCode);
+	if (it == _books.end() && isMarket)
+	{
+		//还没有订单簿，市价单直接撤销
+		push_event(localid, stdCode, isBuy, 0, price, 0, qty, true, curTime);
+		notify_events();
+		return;
+	}
+
+	OrderBook* book = (it == _books.end()) ? get_book(stdCode, price) : it->second.get();
+	int64_t pxIdx = isMarket ? (isBuy ? NO_ASK_PRICE : NO_BID_PRICE) : price_index(book, price);
+
+	//先和对手盘的挂单成交，逐档往后吃，不扣减市场的挂单量
+	double left = qty;
+	PriceLevels& levels = isBuy ? book->_asks : book->_bids;
+	int64_t curIdx = isBuy ? book->_best_ask : book->_best_bid;
+	int64_t endIdx = book->_base_idx + (int64_t)levels.size();
+	while (decimal::gt(left, 0) && curIdx != NO_ASK_PRICE && curIdx != NO_BID_PRICE
+		&& curIdx >= book->_base_idx && curIdx < endIdx
+		&& (isBuy ? curIdx <= pxIdx : curIdx >= pxIdx))
+	{
+		double avail = levels[curIdx - book->_base_idx]._volume;
+		if (decimal::gt(avail, 0))
+		{
+			double curQty = std::min(left, avail);
+			left -= curQty;
+			push_event(localid, stdCode, isBuy, curQty, price, curIdx * book->_tick, left, false, curTime);
+		}
+
+		curIdx += isBuy ? 1 : -1;
+	}
+
+	if (decimal::le(left, 0))
+	{
+		notify_events();
+		return;
+	}
+
+	if (isMarket)
+	{
+		push_event(localid, stdCode, isBuy, 0, price, 0, left, true, curTime);
+		notify_events();
+		return;
+	}
+
+	//剩下的挂到本方价位的队尾
+	int32_t idx = alloc_node();
+	OrderNode& node = _nodes[idx];
+	node._id = 0;
+	node._localid = localid;
+	node._buy = isBuy;
+	node._px_idx = pxIdx;
+	node._price = price;
+	node._left = left;
+	node._time = curTime;
+	link_node(book, idx);
+
+	MyOrder& myOrd = _my_orders[localid];
+	myOrd._book = book;
+	myOrd._node = idx;
+	book->_my_orders.emplace_back(localid);
+
+	notify_events();
+}
+
+double L2MatchEngine::cancel(uint32_t localid)
+{
+	auto it = _my_orders.find(localid);
+	if (it == _my_orders.end())
+		return 0;
+
+	OrderBook* book = it->second._book;
+	double left = _nodes[it->second._node]._left;
+	remove_my_order(book, localid);
+	return left;
+}
+
+double L2MatchEngine::queue_ahead(uint32_t localid)
+{
+	auto it = _my_orders.find(localid);
+	if (it == _my_orders.end())
+		return 0;
+
+	double ret = 0;
+	int32_t idx = _nodes[it->second._node]._prev;
+	while (idx != -1)
+	{
+		const OrderNode& node = _nodes[idx];
+		if (node._localid == 0)
+			ret += node._left;
+		idx = node._prev;
+	}
+
+	return ret;
+}
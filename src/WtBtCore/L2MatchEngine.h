@@ -0,0 +1,183 @@
+﻿#pragma once
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <string>
+
+#include "MatchEngine.h"
+
+NS_WTP_BEGIN
+class WTSOrdDtlData;
+class WTSTransData;
+class WTSVariant;
+NS_WTP_END
+
+USING_NS_WTP;
+
+class HisDataReplayer;
+
+/*
+ *	基于逐笔委托和逐笔成交的撮合引擎
+ *
+ *	用逐笔委托和逐笔成交还原完整的价位档，每个价位上的委托按到达顺序挂成链表
+ *	价位档用数组存储，下标为价格相对基准价的跳数，超出范围时自动扩展
+ *	自己的订单也挂在对应价位的链表上，但是不计入市场的挂单量，只用来确定排队位置
+ *	逐笔成交吃掉排在自己前面的委托时，排队位置自然前移，轮到自己时才成交
+ *	每笔数据只处理涉及到的价位，不再逐tick扫描全部订单
+ *
+ *	自己的订单成交时不会从市场的挂单里扣减数量，即不考虑自己的订单对市场的冲击
+ *
+ *	撮合过程中产生的回报先放到队列里，订单簿处理完了再按顺序回调
+ *	策略在回调里撤单下单的时候，订单簿上没有正在遍历的节点，不会用到已经释放或者复用的节点
+ */
+class L2MatchEngine
+{
+public:
+	L2MatchEngine(HisDataReplayer* replayer);
+
+public:
+	void	init(WTSVariant* cfg);
+
+	void	regisSink(IMatchSink* sink) { _sink = sink; }
+
+	void	clear();
+
+	void	handle_order_detail(const char* stdCode, WTSOrdDtlData* curOrdDtl);
+
+	void	handle_transaction(const char* stdCode, WTSTransData* curTrans);
+
+	/*
+	 *	下单
+	 *	能和对手盘成交的部分立即成交，剩余的部分挂到对应价位的队尾
+	 *	价格为0视为市价单，不能立即成交的部分直接撤销
+	 */
+	void	place(uint32_t localid, const char* stdCode, bool isBuy, double price, double qty, uint64_t curTime);
+
+	/*
+	 *	撤单，返回撤销的数量，不会触发回报
+	 */
+	double	cancel(uint32_t localid);
+
+	/*
+	 *	排在订单前面的市场委托数量
+	 */
+	double	queue_ahead(uint32_t localid);
+
+private:
+	typedef struct _OrderNode
+	{
+		uint64_t	_id;		//交易所委托编号，自己的订单为0
+		uint32_t	_localid;	//本地订单号，市场委托为0
+		bool		_buy;
+		int64_t		_px_idx;	//价格序号，即价格除以最小变动价位
+		double		_price;
+		double		_left;
+		uint64_t	_time;
+		int32_t		_prev;
+		int32_t		_next;
+	} OrderNode;
+
+	typedef struct _PriceLevel
+	{
+		int32_t		_head;
+		int32_t		_tail;
+		double		_volume;	//市场委托的挂单量，不含自己的订单
+
+		_PriceLevel() :_head(-1), _tail(-1), _volume(0) {}
+	} PriceLevel;
+	typedef std::vector<PriceLevel>	PriceLevels;
+
+	typedef struct _OrderBook
+	{
+		std::string	_code;
+		double		_tick;
+		int64_t		_base_idx;	//价位数组第一个元素对应的价格序号
+		PriceLevels	_bids;
+		PriceLevels	_asks;
+		int64_t		_best_bid;
+		int64_t		_best_ask;
+
+		wt_hashmap<uint64_t, int32_t>	_mkt_orders;	//交易所委托编号到节点的映射
+		std::vector<uint32_t>			_my_orders;		//挂在这个订单簿上的自己的订单
+	} OrderBook;
+	typedef std::shared_ptr<OrderBook>	OrderBookPtr;
+	typedef wt_hashmap<std::string, OrderBookPtr>	OrderBooks;
+
+	typedef struct _MyOrder
+	{
+		OrderBook*	_book;
+		int32_t		_node;
+	} MyOrder;
+	typedef wt_hashmap<uint32_t, MyOrder>	MyOrders;
+
+	//待发送的回报，_qty为0的只有订单回报
+	typedef struct _MatchEvent
+	{
+		uint32_t	_localid;
+		std::string	_code;
+		bool		_buy;
+		double		_qty;
+		double		_ord_px;
+		double		_trd_px;
+		double		_left;
+		bool		_canceled;
+		uint64_t	_time;
+	} MatchEvent;
+	typedef std::vector<MatchEvent>	MatchEvents;
+
+private:
+	OrderBook*	get_book(const char* stdCode, double refPx);
+
+	inline int64_t	price_index(OrderBook* book, double price) const;
+
+	PriceLevel&	get_level(OrderBook* book, bool isBuy, int64_t pxIdx);
+
+	int32_t	alloc_node();
+	void	free_node(int32_t idx);
+
+	void	link_node(OrderBook* book, int32_t idx);
+	void	unlink_node(OrderBook* book, int32_t idx);
+
+	void	add_volume(OrderBook* book, bool isBuy, int64_t pxIdx, double qty);
+	void	sub_volume(OrderBook* book, bool isBuy, int64_t pxIdx, double qty);
+
+	/*
+	 *	市场委托成交或者撤销了qty的数量
+	 */
+	void	reduce_market_order(OrderBook* book, uint64_t ordId, double qty);
+
+	/*
+	 *	成交了一笔passive的委托，处理应该排在它前面成交的自己的订单
+	 */
+	void	match_my_orders(OrderBook* book, bool passiveBuy, int64_t pxIdx, int32_t passiveNode, double qty, double price);
+
+	/*
+	 *	自己的订单成交，返回实际成交的数量
+	 */
+	double	fill_my_order(OrderBook* book, int32_t idx, double qty, double price);
+
+	void	remove_my_order(OrderBook* book, uint32_t localid);
+
+	void	push_event(uint32_t localid, const char* stdCode, bool isBuy, double qty, double ordPx, double trdPx, double left, bool bCanceled, uint64_t ordTime);
+
+	/*
+	 *	按顺序发送队列里的回报
+	 *	回调里再次撮合产生的回报追加到队尾，由最外层统一发送
+	 */
+	void	notify_events();
+
+private:
+	HisDataReplayer*	_replayer;
+	IMatchSink*			_sink;
+
+	uint32_t			_window;	//初始的价位数组大小
+
+	std::vector<OrderNode>	_nodes;
+	std::vector<int32_t>	_free_nodes;
+
+	OrderBooks	_books;
+	MyOrders	_my_orders;
+
+	MatchEvents	_events;
+	bool		_notifying;
+};
@@ -0,0 +1,62 @@
+﻿/*!
+ * \file SharedDataCache.cpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief
+ */
+#include "SharedDataCache.h"
+
+bool SharedDataCache::get_bars(const std::string& key, BarsEntry& entry, FuncLoadBars loader)
+{
+	BarsSlotPtr slot;
+	{
+		StdUniqueLock lock(_mtx);
+		BarsSlotPtr& item = _bars_map[key];
+		if (item == NULL)
+			item.reset(new BarsSlot);
+		slot = item;
+	}
+
+	//只锁住当前这个key，不同的key可以同时加载
+	StdUniqueLock lock(slot->_mtx);
+	if (!slot->_loaded)
+	{
+		slot->_valid = loader(slot->_entry);
+		slot->_loaded = true;
+	}
+
+	if (!slot->_valid)
+		return false;
+
+	entry = slot->_entry;
+	return true;
+}
+
+std::size_t SharedDataCache::size()
+{
+	//先把槽位拷出来，避免等待正在加载的槽位时一直占着全局锁
+	std::vector<BarsSlotPtr> slots;
+	{
+		StdUniqueLock lock(_mtx);
+		for (auto& v : _bars_map)
+			slots.emplace_back(v.second);
+	}
+
+	std::size_t ret = 0;
+	for (BarsSlotPtr& slot : slots)
+	{
+		StdUniqueLock lck(slot->_mtx);
+		if (slot->_valid && slot->_entry._bars)
+			ret += slot->_entry._bars->size() * sizeof(WTSBarStruct);
+	}
+	return ret;
+}
+
+void SharedDataCache::clear()
+{
+	StdUniqueLock lock(_mtx);
+	_bars_map.clear();
+}
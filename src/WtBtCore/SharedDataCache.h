@@ -0,0 +1,153 @@
+﻿/*!
+ * \file SharedDataCache.h
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 批量回测时多个回放器共享的只读K线缓存
+ *
+ * 同一个K线数据只加载一次，后续的回放器直接引用同一份数据，不再重复读取文件和解压
+ * 数据一旦放入缓存就不再修改，回放器各自维护自己的游标
+ */
+#pragma once
+#include <memory>
+#include <vector>
+#include <functional>
+
+#include "../Includes/FasterDefs.h"
+#include "../Includes/WTSStruct.h"
+#include "../Share/StdUtils.hpp"
+#include "../Share/BarCacheFile.hpp"
+
+USING_NS_WTP;
+
+/*
+ *	K线数组，接口和std::vector<WTSBarStruct>一致
+ *	可以挂到只读映射的K线缓存文件上，这时数据直接在映射的内存上，不占用堆内存
+ *	映射的数据不能修改，需要修改的时候会先拷贝一份到自己的vector里
+ */
+class BarArray
+{
+public:
+	typedef WTSBarStruct*		iterator;
+	typedef const WTSBarStruct*	const_iterator;
+
+	BarArray() :_mapped(NULL), _mapped_cnt(0) {}
+
+	/*
+	 *	挂到映射的K线缓存文件上
+	 */
+	inline void attach(const BarCacheFilePtr& cacheFile)
+	{
+		_vec.clear();
+		_vec.shrink_to_fit();
+		_cache_file = cacheFile;
+		_mapped = cacheFile->bars();
+		_mapped_cnt = (std::size_t)cacheFile->count();
+	}
+
+	inline bool is_mapped() const { return _mapped != NULL; }
+
+	/*
+	 *	转成自己持有的数据，返回内部的vector
+	 */
+	inline std::vector<WTSBarStruct>& own()
+	{
+		if (_mapped != NULL)
+		{
+			_vec.assign(_mapped, _mapped + _mapped_cnt);
+			_mapped = NULL;
+			_mapped_cnt = 0;
+			_cache_file.reset();
+		}
+		return _vec;
+	}
+
+	inline std::size_t size() const { return _mapped ? _mapped_cnt : _vec.size(); }
+	inline bool empty() const { return size() == 0; }
+
+	/*
+	 *	映射的内存是只读的，调用方不能通过这里修改映射的数据
+	 */
+	inline WTSBarStruct* data() { return _mapped ? (WTSBarStruct*)_mapped : _vec.data(); }
+	inline const WTSBarStruct* data() const { return _mapped ? _mapped : _vec.data(); }
+
+	inline iterator begin() { return data(); }
+	inline iterator end() { return data() + size(); }
+	inline const_iterator begin() const { return data(); }
+	inline const_iterator end() const { return data() + size(); }
+
+	inline WTSBarStruct& operator[](std::size_t idx) { return data()[idx]; }
+	inline const WTSBarStruct& operator[](std::size_t idx) const { return data()[idx]; }
+
+	inline WTSBarStruct& back() { return data()[size() - 1]; }
+	inline const WTSBarStruct& back() const { return data()[size() - 1]; }
+
+	inline void resize(std::size_t cnt) { own().resize(cnt); }
+	inline void clear() { own().clear(); }
+	inline void emplace_back(const WTSBarStruct& bar) { own().emplace_back(bar); }
+	inline void swap(std::vector<WTSBarStruct>& other) { own().swap(other); }
+
+private:
+	std::vector<WTSBarStruct>	_vec;
+	BarCacheFilePtr			_cache_file;
+	const WTSBarStruct*		_mapped;
+	std::size_t				_mapped_cnt;
+};
+
+class SharedDataCache
+{
+public:
+	typedef ::BarArray					BarArray;
+	typedef std::shared_ptr<BarArray>	BarArrayPtr;
+
+	typedef struct _BarsEntry
+	{
+		BarArrayPtr		_bars;
+		uint32_t		_count;
+		double			_factor;
+
+		_BarsEntry() :_count(0), _factor(1) {}
+	} BarsEntry;
+
+	/*
+	 *	缓存未命中时的加载函数，加载成功则填充entry并返回true
+	 */
+	typedef std::function<bool(BarsEntry&)>	FuncLoadBars;
+
+public:
+	/*
+	 *	获取K线数据，缓存中没有则调用loader加载
+	 *	同一个key同时只会有一个线程加载，其他线程等待加载结果
+	 *	加载失败也会被记录下来，不会反复加载
+	 *
+	 *	@key	缓存键，和回放器K线缓存的键一致
+	 *	@entry	返回的数据
+	 */
+	bool	get_bars(const std::string& key, BarsEntry& entry, FuncLoadBars loader);
+
+	/*
+	 *	缓存的K线数据的总大小
+	 */
+	std::size_t	size();
+
+	void	clear();
+
+private:
+	typedef struct _BarsSlot
+	{
+		StdUniqueMutex	_mtx;
+		bool			_loaded;
+		bool			_valid;
+		BarsEntry		_entry;
+
+		_BarsSlot() :_loaded(false), _valid(false) {}
+	} BarsSlot;
+	typedef std::shared_ptr<BarsSlot>	BarsSlotPtr;
+	typedef wt_hashmap<std::string, BarsSlotPtr>	BarsSlotMap;
+
+	StdUniqueMutex	_mtx;
+	BarsSlotMap		_bars_map;
+};
+
@@ -49,6 +49,7 @@ UftMocker::UftMocker(HisDataReplayer* replayer, const char* name)
 	, _use_newpx(false)
 	, _error_rate(0)
 	, _match_this_tick(false)
+	, _l2_matcher(NULL)
 {
 	_context_id = makeUftCtxId();
 }
@@ -60,6 +61,9 @@ UftMocker::~UftMocker()
 	{
 		_factory._fact->deleteStrategy(_strategy);
 	}
+
+	if (_l2_matcher)
+		delete _l2_matcher;
 }
 
 void UftMocker::procTask()
@@ -138,6 +142,14 @@ bool UftMocker::init_uft_factory(WTSVariant* cfg)
 
 	log_info("UFT match params: use_newpx-{}, error_rate-{}, match_this_tick-{}", _use_newpx, _error_rate, _match_this_tick);
 
+	if (strcmp(cfg->getCString("matcher"), "l2") == 0)
+	{
+		_l2_matcher = new L2MatchEngine(_replayer);
+		_l2_matcher->init(cfg->get("l2matcher"));
+		_l2_matcher->regisSink(this);
+		log_info("Orders will be matched with order details and transactions");
+	}
+
 	DllHandle hInst = DLLHelper::load_library(module);
 	if (hInst == NULL)
 		return false;
@@ -171,7 +183,14 @@ void UftMocker::handle_tick(const char* stdCode, WTSTickData* curTick, uint32_t
 
 void UftMocker::handle_order_detail(const char* stdCode, WTSOrdDtlData* curOrdDtl)
 {
+	if (_l2_matcher)
+		_l2_matcher->handle_order_detail(stdCode, curOrdDtl);
+
 	on_order_detail(stdCode, curOrdDtl);
+
+	//逐笔撮合模式下，策略在逐笔数据里下的单也要及时处理
+	if (_l2_matcher)
+		procTask();
 }
 
 void UftMocker::handle_order_queue(const char* stdCode, WTSOrdQueData* curOrdQue)
@@ -181,7 +200,13 @@ void UftMocker::handle_order_queue(const char* stdCode, WTSOrdQueData* curOrdQue
 
 void UftMocker::handle_transaction(const char* stdCode, WTSTransData* curTrans)
 {
+	if (_l2_matcher)
+		_l2_matcher->handle_transaction(stdCode, curTrans);
+
 	on_transaction(stdCode, curTrans);
+
+	if (_l2_matcher)
+		procTask();
 }
 
 void UftMocker::handle_bar_close(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar)
@@ -231,6 +256,9 @@ void UftMocker::on_tick(const char* stdCode, WTSTickData* newTick)
 	}
 
 	update_dyn_profit(stdCode, newTick);
+
+	//逐笔撮合模式下，订单由撮合引擎处理，不再按tick撮合
+	bool bMatchByTick = (_l2_matcher == NULL);
 	
 	//如果开启了同tick撮合，则先触发策略的ontick，再处理订单
 	//如果没开启同tick撮合，则先处理订单，再触发策略的ontick
@@ -240,7 +268,7 @@ void UftMocker::on_tick(const char* stdCode, WTSTickData* newTick)
 
 		procTask();
 
-		if (!_orders.empty())
+		if (bMatchByTick && !_orders.empty())
 		{
 			OrderIDs ids;
 			for (auto it = _orders.begin(); it != _orders.end(); it++)
@@ -266,7 +294,7 @@ void UftMocker::on_tick(const char* stdCode, WTSTickData* newTick)
 	}
 	else
 	{
-		if (!_orders.empty())
+		if (bMatchByTick && !_orders.empty())
 		{
 			OrderIDs ids;
 			for (auto it = _orders.begin(); it != _orders.end(); it++)
@@ -441,6 +469,8 @@ bool UftMocker::stra_cancel(uint32_t localid)
 
 		log_debug("Order {} canceled, action: {} {} @ {}({})", ordInfo._localid, OFFSET_NAMES[ordInfo._offset], ordInfo._isLong?"long":"short", ordInfo._total, ordInfo._left);
 		ordInfo._left = 0;
+		if (_l2_matcher)
+			_l2_matcher->cancel(localid);
 		on_order(localid, ordInfo._code, ordInfo._isLong, ordInfo._offset, ordInfo._total, ordInfo._left, ordInfo._price, true);
 		_orders.erase(it);
 	});
@@ -625,6 +655,7 @@ uint32_t UftMocker::stra_enter_long(const char* stdCode, double price, double qt
 		const OrderInfo& ordInfo = _orders[localid];
 		log_debug("order placed: open long of {} @ {} by {}", ordInfo._code, ordInfo._price, ordInfo._total);
 		on_entrust(localid, ordInfo._code, true, "entrust success");
+		placeToL2(localid);
 	});
 
 	return localid;
@@ -666,6 +697,7 @@ uint32_t UftMocker::stra_enter_short(const char* stdCode, double price, double q
 		const OrderInfo& ordInfo = _orders[localid];
 		log_debug("order placed: open short of {} @ {} by {}", ordInfo._code, ordInfo._price, ordInfo._total);
 		on_entrust(localid, ordInfo._code, true, "entrust success");
+		placeToL2(localid);
 	});
 
 	return localid;
@@ -727,6 +759,7 @@ uint32_t UftMocker::stra_exit_long(const char* stdCode, double price, double qty
 		const OrderInfo& ordInfo = _orders[localid];
 		log_debug("order placed: {} long of {} @ {} by {}", OFFSET_NAMES[ordInfo._offset], ordInfo._code, ordInfo._price, ordInfo._total);
 		on_entrust(localid, ordInfo._code, true, "entrust success");
+		placeToL2(localid);
 	});
 
 	return localid;
@@ -788,11 +821,55 @@ uint32_t UftMocker::stra_exit_short(const char* stdCode, double price, double qt
 		const OrderInfo& ordInfo = _orders[localid];
 		log_debug("order placed: {} short of {} @ {} by {}", OFFSET_NAMES[ordInfo._offset], ordInfo._code, ordInfo._price, ordInfo._total);
 		on_entrust(localid, ordInfo._code, true, "entrust success");
+		placeToL2(localid);
 	});
 
 	return localid;
 }
 
+void UftMocker::placeToL2(uint32_t localid)
+{
+	if (_l2_matcher == NULL)
+		return;
+
+	auto it = _orders.find(localid);
+	if (it == _orders.end())
+		return;
+
+	//开多和平空是买，开空和平多是卖
+	const OrderInfo& ordInfo = it->second;
+	bool isBuy = (ordInfo._isLong == (ordInfo._offset == 0));
+	uint64_t curTime = (uint64_t)_replayer->get_date() * 1000000000 + (uint64_t)_replayer->get_raw_time() * 100000 + _replayer->get_secs();
+	_l2_matcher->place(localid, ordInfo._code, isBuy, ordInfo._price, ordInfo._left, curTime);
+}
+
+void UftMocker::handle_trade(uint32_t localid, const char* stdCode, bool isBuy, double vol, double fireprice, double price, uint64_t ordTime)
+{
+	auto it = _orders.find(localid);
+	if (it == _orders.end())
+		return;
+
+	const OrderInfo& ordInfo = it->second;
+	on_trade(localid, stdCode, ordInfo._isLong, ordInfo._offset, vol, price);
+}
+
+void UftMocker::handle_order(uint32_t localid, const char* stdCode, bool isBuy, double leftover, double price, bool isCanceled, uint64_t ordTime)
+{
+	auto it = _orders.find(localid);
+	if (it == _orders.end())
+		return;
+
+	it->second._left = leftover;
+	OrderInfo ordInfo = it->second;
+	if (isCanceled || decimal::eq(leftover, 0.0))
+	{
+		StdLocker<StdRecurMutex> lock(_mtx_ords);
+		_orders.erase(it);
+	}
+
+	on_order(localid, stdCode, ordInfo._isLong, ordInfo._offset, ordInfo._total, leftover, ordInfo._price, isCanceled);
+}
+
 void UftMocker::on_order(uint32_t localid, const char* stdCode, bool isLong, uint32_t offset, double totalQty, double leftQty, double price, bool isCanceled)
 {
 	if(_strategy)
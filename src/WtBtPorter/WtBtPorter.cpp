@@ -116,6 +116,11 @@ void run_backtest(bool bNeedDump, bool bAsync)
 	getRunner().run(bNeedDump, bAsync);
 }
 
+bool run_batch_backtest(const char* cfgfile, bool isFile)
+{
+	return getRunner().run_batch(cfgfile, isFile);
+}
+
 void stop_backtest()
 {
 	getRunner().stop();
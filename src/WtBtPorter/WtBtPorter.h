@@ -51,6 +51,12 @@ extern "C"
 
 	EXPORT_FLAG	void		run_backtest(bool bNeedDump, bool bAsync);
 
+	/*
+	 *	按配置文件里的batch段并行执行多个C++ CTA策略的回测，全部结束以后才返回
+	 *	不需要先调用config_backtest，但是要先调用init_backtest初始化日志和输出目录
+	 */
+	EXPORT_FLAG	bool		run_batch_backtest(const char* cfgfile, bool isFile);
+
 	EXPORT_FLAG	void		write_log(WtUInt32 level, const char* message, const char* catName);
 
 	EXPORT_FLAG	WtString	get_version();
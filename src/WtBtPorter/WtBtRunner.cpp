@@ -16,6 +16,7 @@
 
 #include "../WtBtCore/ExecMocker.h"
 #include "../WtBtCore/WtHelper.h"
+#include "../WtBtCore/BatchBacktester.h"
 
 #include "../Share/TimeUtils.hpp"
 #include "../Share/ModuleHelper.hpp"
@@ -508,6 +509,21 @@ void WtBtRunner::config(const char* cfgFile, bool isFile /* = true */)
 	}
 }
 
+bool WtBtRunner::run_batch(const char* cfgFile, bool isFile /* = true */)
+{
+	//批量回测每个策略都有自己的回放器，和config加载的回放器无关
+	WTSVariant* cfg = isFile ? WTSCfgLoader::load_from_file(cfgFile) : WTSCfgLoader::load_from_content(cfgFile, false);
+	if (cfg == NULL)
+	{
+		WTSLogger::error("Loading batch config failed");
+		return false;
+	}
+
+	bool bSucceed = BatchBacktester::run(cfg);
+	cfg->release();
+	return bSucceed;
+}
+
 void WtBtRunner::run(bool bNeedDump /* = false */, bool bAsync /* = false */)
 {
 	if (_running)
@@ -112,6 +112,7 @@ public:
 	void	init(const char* logProfile = "", bool isFile = true, const char* outDir = "./outputs_bt");
 	void	config(const char* cfgFile, bool isFile = true);
 	void	run(bool bNeedDump = false, bool bAsync = false);
+	bool	run_batch(const char* cfgFile, bool isFile = true);
 	void	release();
 	void	stop();
 
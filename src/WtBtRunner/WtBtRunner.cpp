@@ -14,6 +14,7 @@
 #include "../WtBtCore/SelMocker.h"
 #include "../WtBtCore/UftMocker.h"
 #include "../WtBtCore/WtHelper.h"
+#include "../WtBtCore/BatchBacktester.h"
 
 #include "../WTSTools/WTSLogger.h"
 #include "../WTSUtils/SignalHook.hpp"
@@ -74,6 +75,17 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
+	if (cfg->has("batch"))
+	{
+		BatchBacktester::run(cfg);
+
+		printf("press enter key to exit\r\n");
+		getchar();
+
+		WTSLogger::stop();
+		return 0;
+	}
+
 	HisDataReplayer replayer;
 	replayer.init(cfg->get("replayer"));
 
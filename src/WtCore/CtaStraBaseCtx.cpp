@@ -44,6 +44,59 @@ const char* ACTION_NAMES[] =
 	"SYN"
 };
 
+namespace
+{
+	//状态日志的记录类型
+	const uint16_t SJT_POSITION = 1;
+	const uint16_t SJT_SIGNAL = 2;
+	const uint16_t SJT_CONDITION = 3;
+	const uint16_t SJT_FUND = 4;
+	const uint16_t SJT_UTILS = 5;
+	const uint16_t SJT_USERDATA = 6;
+
+	//记录的格式有变化时要修改版本号，版本不一致的日志会被丢弃，然后重新从json文件导入
+	const uint32_t CTA_STATE_SCHEMA = 1;
+
+	//持仓记录，后面跟着_detail_cnt个DetailInfo
+	typedef struct _PosRecord
+	{
+		double		_volume;
+		double		_closeprofit;
+		double		_dynprofit;
+		uint64_t	_last_entertime;
+		uint64_t	_last_exittime;
+		double		_frozen;
+		uint32_t	_frozen_date;
+		uint32_t	_detail_cnt;
+	} PosRecord;
+
+	//信号记录，后面跟着usertag
+	typedef struct _SigRecord
+	{
+		double		_volume;
+		double		_sigprice;
+		uint64_t	_gentime;
+		uint32_t	_sigtype;
+		uint32_t	_triggered;
+	} SigRecord;
+
+	typedef struct _FundRecord
+	{
+		double		_total_profit;
+		double		_total_dynprofit;
+		double		_total_fees;
+		uint32_t	_tdate;
+		uint32_t	_reserved;
+	} FundRecord;
+
+	typedef struct _UtilsRecord
+	{
+		uint64_t	_last_cond_min;
+		uint32_t	_last_barno;
+		uint32_t	_reserved;
+	} UtilsRecord;
+}
+
 
 inline uint32_t makeCtaCtxId()
 {
@@ -219,6 +272,276 @@ void CtaStraBaseCtx::log_close(const char* stdCode, bool isLong, uint64_t openTi
 	}
 }
 void CtaStraBaseCtx::save_userdata()
+{
+	//状态日志打不开的时候还是写json文件
+	if (!_state_journal)
+	{
+		export_userdata();
+		return;
+	}
+
+	_state_journal->begin();
+	for (auto it = _user_datas.begin(); it != _user_datas.end(); it++)
+	{
+		_state_journal->put(SJT_USERDATA, it->first.c_str(), it->second.data(), (uint32_t)it->second.size());
+	}
+	_state_journal->sweep(SJT_USERDATA);
+	if (!_state_journal->commit())
+		drop_journal();
+}
+
+void CtaStraBaseCtx::save_data(uint32_t flag /* = 0xFFFFFFFF */)
+{
+	if (!_state_journal)
+	{
+		export_data();
+		return;
+	}
+
+	thread_local static std::string buffer;
+
+	_state_journal->begin();
+
+	{//持仓数据保存
+		for (auto it = _pos_map.begin(); it != _pos_map.end(); it++)
+		{
+			const PosInfo& pInfo = it->second;
+
+			PosRecord rec;
+			rec._volume = pInfo._volume;
+			rec._closeprofit = pInfo._closeprofit;
+			rec._dynprofit = pInfo._dynprofit;
+			rec._last_entertime = pInfo._last_entertime;
+			rec._last_exittime = pInfo._last_exittime;
+			rec._frozen = pInfo._frozen;
+			rec._frozen_date = pInfo._frozen_date;
+			rec._detail_cnt = (uint32_t)pInfo._details.size();
+
+			buffer.assign((const char*)&rec, sizeof(PosRecord));
+			if (!pInfo._details.empty())
+				buffer.append((const char*)pInfo._details.data(), sizeof(DetailInfo)*pInfo._details.size());
+
+			_state_journal->put(SJT_POSITION, it->first.c_str(), buffer.data(), (uint32_t)buffer.size());
+		}
+		_state_journal->sweep(SJT_POSITION);
+	}
+
+	{//资金保存
+		FundRecord rec;
+		rec._total_profit = _fund_info._total_profit;
+		rec._total_dynprofit = _fund_info._total_dynprofit;
+		rec._total_fees = _fund_info._total_fees;
+		rec._tdate = _engine->get_trading_date();
+		rec._reserved = 0;
+		_state_journal->put(SJT_FUND, "", &rec, sizeof(FundRecord));
+	}
+
+	{//信号保存
+		for (auto& m : _sig_map)
+		{
+			const SigInfo& sInfo = m.second;
+
+			SigRecord rec;
+			rec._volume = sInfo._volume;
+			rec._sigprice = sInfo._sigprice;
+			rec._gentime = sInfo._gentime;
+			rec._sigtype = sInfo._sigtype;
+			rec._triggered = sInfo._triggered ? 1 : 0;
+
+			buffer.assign((const char*)&rec, sizeof(SigRecord));
+			buffer.append(sInfo._usertag);
+
+			_state_journal->put(SJT_SIGNAL, m.first.c_str(), buffer.data(), (uint32_t)buffer.size());
+		}
+		_state_journal->sweep(SJT_SIGNAL);
+	}
+
+	{//条件单保存
+		for (auto it = _condtions.begin(); it != _condtions.end(); it++)
+		{
+			const CondList& condList = it->second;
+			_state_journal->put(SJT_CONDITION, it->first.c_str(), condList.data(), (uint32_t)(sizeof(CondEntrust)*condList.size()));
+		}
+		_state_journal->sweep(SJT_CONDITION);
+	}
+
+	{//杂项保存
+		UtilsRecord rec;
+		rec._last_cond_min = _last_cond_min;
+		rec._last_barno = _last_barno;
+		rec._reserved = 0;
+		_state_journal->put(SJT_UTILS, "", &rec, sizeof(UtilsRecord));
+	}
+
+	if (!_state_journal->commit())
+		drop_journal();
+}
+
+void CtaStraBaseCtx::drop_journal()
+{
+	log_error("Writing state journal failed, saving data to json files instead");
+	_state_journal.reset();
+	export_data();
+	export_userdata();
+}
+
+bool CtaStraBaseCtx::load_journal()
+{
+	if (!_state_journal || _state_journal->is_fresh())
+		return false;
+
+	double total_profit = 0;
+	double total_dynprofit = 0;
+	uint32_t condCnt = 0;
+	_state_journal->iterate([&](uint16_t type, const char* key, const char* data, uint32_t len) {
+		switch (type)
+		{
+		case SJT_POSITION:
+		{
+			PosRecord rec;
+			if (len < sizeof(PosRecord))
+				break;
+			memcpy(&rec, data, sizeof(PosRecord));
+			if (len != sizeof(PosRecord) + sizeof(DetailInfo)*rec._detail_cnt)
+			{
+				log_error("Position record of {} corrupted, ignored", key);
+				break;
+			}
+
+			const char* stdCode = key;
+			const char* ruleTag = _engine->get_hot_mgr()->getRuleTag(stdCode);
+			bool isExpired = (strlen(ruleTag) == 0 && _engine->get_contract_info(stdCode) == NULL);
+
+			if (isExpired)
+				log_info("{} not exists or expired, position ignored", stdCode);
+
+			PosInfo& pInfo = _pos_map[stdCode];
+			pInfo._closeprofit = rec._closeprofit;
+			pInfo._last_entertime = rec._last_entertime;
+			pInfo._last_exittime = rec._last_exittime;
+			pInfo._volume = isExpired ? 0 : rec._volume;
+			if (!isExpired)
+			{
+				pInfo._frozen = rec._frozen;
+				pInfo._frozen_date = rec._frozen_date;
+			}
+
+			if (pInfo._volume == 0 || isExpired)
+			{
+				pInfo._dynprofit = 0;
+				pInfo._frozen = 0;
+			}
+			else
+				pInfo._dynprofit = rec._dynprofit;
+
+			total_profit += pInfo._closeprofit;
+			total_dynprofit += pInfo._dynprofit;
+
+			if (isExpired)
+				break;
+
+			const DetailInfo* details = (const DetailInfo*)(data + sizeof(PosRecord));
+			for (uint32_t i = 0; i < rec._detail_cnt; i++)
+			{
+				DetailInfo dInfo;
+				memcpy(&dInfo, &details[i], sizeof(DetailInfo));
+				if (decimal::eq(dInfo._volume, 0))
+					continue;
+
+				pInfo._details.emplace_back(dInfo);
+			}
+
+			log_info("Position confirmed,{} -> {}", stdCode, pInfo._volume);
+			stra_sub_ticks(stdCode);
+			break;
+		}
+		case SJT_SIGNAL:
+		{
+			if (len < sizeof(SigRecord))
+				break;
+
+			const char* stdCode = key;
+			const char* ruleTag = _engine->get_hot_mgr()->getRuleTag(stdCode);
+			if (strlen(ruleTag) == 0 && _engine->get_contract_info(stdCode) == NULL)
+			{
+				log_info("{} not exists or expired, signal ignored", stdCode);
+				break;
+			}
+
+			SigRecord rec;
+			memcpy(&rec, data, sizeof(SigRecord));
+
+			SigInfo& sInfo = _sig_map[stdCode];
+			sInfo._usertag.assign(data + sizeof(SigRecord), len - sizeof(SigRecord));
+			sInfo._volume = rec._volume;
+			sInfo._sigprice = rec._sigprice;
+			sInfo._gentime = rec._gentime;
+			sInfo._sigtype = rec._sigtype;
+			sInfo._triggered = (rec._triggered != 0);
+
+			log_info("{} untouched signal recovered, target pos: {}", stdCode, sInfo._volume);
+			stra_sub_ticks(stdCode);
+			break;
+		}
+		case SJT_CONDITION:
+		{
+			if (len % sizeof(CondEntrust) != 0)
+				break;
+
+			const char* stdCode = key;
+			const char* ruleTag = _engine->get_hot_mgr()->getRuleTag(stdCode);
+			if (strlen(ruleTag) == 0 && _engine->get_contract_info(stdCode) == NULL)
+			{
+				log_info("{} not exists or expired, condition ignored", stdCode);
+				break;
+			}
+
+			CondList& condList = _condtions[stdCode];
+			condList.resize(len / sizeof(CondEntrust));
+			memcpy(condList.data(), data, len);
+			condCnt += (uint32_t)condList.size();
+			break;
+		}
+		case SJT_FUND:
+		{
+			if (len != sizeof(FundRecord))
+				break;
+
+			FundRecord rec;
+			memcpy(&rec, data, sizeof(FundRecord));
+			_fund_info._total_fees = rec._total_fees;
+			break;
+		}
+		case SJT_UTILS:
+		{
+			if (len != sizeof(UtilsRecord))
+				break;
+
+			UtilsRecord rec;
+			memcpy(&rec, data, sizeof(UtilsRecord));
+			_last_cond_min = rec._last_cond_min;
+			_last_barno = rec._last_barno;
+			break;
+		}
+		case SJT_USERDATA:
+			_user_datas[key] = std::string(data, len);
+			break;
+		default:
+			break;
+		}
+	});
+
+	_fund_info._total_profit = total_profit;
+	_fund_info._total_dynprofit = total_dynprofit;
+
+	if (condCnt > 0)
+		log_info("{} conditions recovered, setup time: {}", condCnt, _last_cond_min);
+
+	log_info("{} records recovered from state journal", _state_journal->record_count());
+	return true;
+}
+
+void CtaStraBaseCtx::export_userdata()
 {
 	rj::Document root(rj::kObjectType);
 	rj::Document::AllocatorType &allocator = root.GetAllocator();
@@ -494,7 +817,7 @@ void CtaStraBaseCtx::load_data(uint32_t flag /* = 0xFFFFFFFF */)
 	}
 }
 
-void CtaStraBaseCtx::save_data(uint32_t flag /* = 0xFFFFFFFF */)
+void CtaStraBaseCtx::export_data()
 {
 	rj::Document root(rj::kObjectType);
 
@@ -671,11 +994,34 @@ void CtaStraBaseCtx::on_init()
 {
 	init_outputs();
 
-	//读取数据
-	load_data();
+	std::string filename = WtHelper::getStraDataDir();
+	filename += _name;
+	filename += ".sdj";
+	_state_journal.reset(new StateJournal());
+	if (!_state_journal->open(filename.c_str(), CTA_STATE_SCHEMA))
+	{
+		log_error("Opening state journal {} failed, saving data to json files instead", filename);
+		_state_journal.reset();
+	}
 
-	//加载用户数据
-	load_userdata();
+	if (load_journal())
+	{
+		_state_journal->compact();
+		if (!_state_journal->is_valid())
+			drop_journal();
+	}
+	else
+	{
+		//状态日志是新建的，从原来的json文件导入
+		//读取数据
+		load_data();
+
+		//加载用户数据
+		load_userdata();
+
+		save_data();
+		save_userdata();
+	}
 }
 
 void CtaStraBaseCtx::dump_chart_info()
@@ -1108,6 +1454,16 @@ void CtaStraBaseCtx::on_session_end(uint32_t uTDate)
 		save_userdata();
 		_ud_modified = false;
 	}
+
+	//收盘以后导出一份json文件供外部工具查看，顺便整理状态日志
+	if (_state_journal)
+	{
+		export_data();
+		export_userdata();
+		_state_journal->compact();
+		if (!_state_journal->is_valid())
+			drop_journal();
+	}
 }
 
 CondList& CtaStraBaseCtx::get_cond_entrusts(const char* stdCode)
@@ -15,6 +15,7 @@
 #include "../Share/BoostFile.hpp"
 #include "../Share/fmtlib.h"
 #include "../Share/SpinMutex.hpp"
+#include "../Share/StateJournal.hpp"
 
 #include <unordered_map>
 
@@ -68,11 +69,25 @@ private:
 	inline void	log_close(const char* stdCode, bool isLong, uint64_t openTime, double openpx, uint64_t closeTime, double closepx, double qty,
 		double profit, double totalprofit = 0, const char* enterTag = "", const char* exitTag = "", uint32_t openBarNo = 0, uint32_t closeBarNo = 0);
 
+	//保存到状态日志里，只有发生变化的记录会被写入
 	void	save_data(uint32_t flag = 0xFFFFFFFF);
-	void	load_data(uint32_t flag = 0xFFFFFFFF);
+	void	save_userdata();
 
+	//从json文件读取，只在状态日志是新建的时候用来导入原有的数据
+	void	load_data(uint32_t flag = 0xFFFFFFFF);
 	void	load_userdata();
-	void	save_userdata();
+
+	//从状态日志恢复数据，日志是新建的则返回false
+	bool	load_journal();
+
+	/*
+	 *	状态日志写入或者整理失败，改回写json文件
+	 */
+	void	drop_journal();
+
+	//导出成json文件，收盘的时候调用
+	void	export_data();
+	void	export_userdata();
 
 	void	update_dyn_profit(const char* stdCode, double price);
 
@@ -327,6 +342,8 @@ protected:
 	StringHashMap	_user_datas;
 	bool			_ud_modified;
 
+	StateJournalPtr	_state_journal;	//策略状态日志
+
 	typedef struct _StraFundInfo
 	{
 		double	_total_profit;
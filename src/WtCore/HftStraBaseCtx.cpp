@@ -25,6 +25,15 @@
 #include <rapidjson/prettywriter.h>
 namespace rj = rapidjson;
 
+namespace
+{
+	//状态日志的记录类型，和CTA、SEL一致
+	const uint16_t SJT_USERDATA = 6;
+
+	//记录的格式有变化时要修改版本号，版本不一致的日志会被丢弃，然后重新从json文件导入
+	const uint32_t HFT_STATE_SCHEMA = 1;
+}
+
 USING_NS_WTP;
 
 inline uint32_t makeHftCtxId()
@@ -132,7 +141,28 @@ void HftStraBaseCtx::on_init()
 {
 	init_outputs();
 
-	load_userdata();
+	std::string filename = WtHelper::getStraDataDir();
+	filename += _name;
+	filename += ".sdj";
+	_state_journal.reset(new StateJournal());
+	if (!_state_journal->open(filename.c_str(), HFT_STATE_SCHEMA))
+	{
+		log_error("Opening state journal {} failed, saving data to json files instead", filename);
+		_state_journal.reset();
+	}
+
+	if (load_journal())
+	{
+		_state_journal->compact();
+		if (!_state_journal->is_valid())
+			drop_journal();
+	}
+	else
+	{
+		//状态日志是新建的，从原来的json文件导入
+		load_userdata();
+		save_userdata();
+	}
 }
 
 void HftStraBaseCtx::on_tick(const char* stdCode, WTSTickData* newTick)
@@ -719,6 +749,45 @@ void HftStraBaseCtx::stra_save_user_data(const char* key, const char* val)
 }
 
 void HftStraBaseCtx::save_userdata()
+{
+	//状态日志打不开的时候还是写json文件
+	if (!_state_journal)
+	{
+		export_userdata();
+		return;
+	}
+
+	_state_journal->begin();
+	for (auto it = _user_datas.begin(); it != _user_datas.end(); it++)
+	{
+		_state_journal->put(SJT_USERDATA, it->first.c_str(), it->second.data(), (uint32_t)it->second.size());
+	}
+	_state_journal->sweep(SJT_USERDATA);
+	if (!_state_journal->commit())
+		drop_journal();
+}
+
+void HftStraBaseCtx::drop_journal()
+{
+	log_error("Writing state journal failed, saving data to json files instead");
+	_state_journal.reset();
+	export_userdata();
+}
+
+bool HftStraBaseCtx::load_journal()
+{
+	if (!_state_journal || _state_journal->is_fresh())
+		return false;
+
+	_state_journal->iterate([this](uint16_t type, const char* key, const char* data, uint32_t len) {
+		if (type == SJT_USERDATA)
+			_user_datas[key] = std::string(data, len);
+	});
+
+	return true;
+}
+
+void HftStraBaseCtx::export_userdata()
 {
 	//ini.save(filename.c_str());
 	rj::Document root(rj::kObjectType);
@@ -959,6 +1028,21 @@ void HftStraBaseCtx::on_session_end(uint32_t uTDate)
 		_fund_logs->write_file(fmt::format("{},{:.2f},{:.2f},{:.2f},{:.2f}\n", curDate,
 			_fund_info._total_profit, _fund_info._total_dynprofit,
 			_fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees, _fund_info._total_fees));
+
+	if (_ud_modified)
+	{
+		save_userdata();
+		_ud_modified = false;
+	}
+
+	//收盘以后导出一份json文件供外部工具查看，顺便整理状态日志
+	if (_state_journal)
+	{
+		export_userdata();
+		_state_journal->compact();
+		if (!_state_journal->is_valid())
+			drop_journal();
+	}
 }
 
 void HftStraBaseCtx::log_trade(const char* stdCode, bool isLong, bool isOpen, uint64_t curTime, double price, double qty, double fee, const char* userTag/* = ""*/)
@@ -13,6 +13,7 @@
 #include "../Includes/IHftStraCtx.h"
 #include "../Share/BoostFile.hpp"
 #include "../Share/fmtlib.h"
+#include "../Share/StateJournal.hpp"
 
 #include <boost/circular_buffer.hpp>
 
@@ -199,8 +200,19 @@ protected:
 protected:
 	const char* get_inner_code(const char* stdCode);
 
-	void	load_userdata();
+	//用户数据保存到状态日志里，只有发生变化的键会被写入
 	void	save_userdata();
+	//从json文件读取，只在状态日志是新建的时候用来导入原有的数据
+	void	load_userdata();
+	//从状态日志恢复用户数据，日志是新建的则返回false
+	bool	load_journal();
+
+	/*
+	 *	状态日志写入或者整理失败，改回写json文件
+	 */
+	void	drop_journal();
+	//导出成json文件，收盘的时候调用
+	void	export_userdata();
 
 	void	init_outputs();
 
@@ -263,6 +275,8 @@ protected:
 	StringHashMap	_user_datas;
 	bool			_ud_modified;
 
+	StateJournalPtr	_state_journal;	//策略状态日志
+
 	bool			_data_agent;	//数据托管
 
 	//tick订阅列表
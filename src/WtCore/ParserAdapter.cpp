@@ -14,6 +14,7 @@
 
 #include "../Share/CodeHelper.hpp"
 #include "../Share/TimeUtils.hpp"
+#include "../Share/LatencyStats.hpp"
 
 #include "../Includes/WTSContractInfo.hpp"
 #include "../Includes/WTSDataDef.hpp"
@@ -286,6 +287,8 @@ void ParserAdapter::handleQuote(WTSTickData *quote, uint32_t procFlag)
 	if (quote == NULL || _stopped || quote->actiondate() == 0 || quote->tradingdate() == 0)
 		return;
 
+	quote->setRecvTime(LatencyStats::now());
+
 	if (!_exchg_filter.empty() && (_exchg_filter.find(quote->exchg()) == _exchg_filter.end()))
 		return;
 
@@ -31,6 +31,7 @@
 #include "../Share/decimal.h"
 #include "../Share/TimeUtils.hpp"
 #include "../Share/CodeHelper.hpp"
+#include "../Share/LatencyStats.hpp"
 
 #include <exception>
 #include <rapidjson/document.h>
@@ -241,34 +242,22 @@ void TraderAdapter::initSaveData()
 	std::string folder = ss.str();
 	BoostFile::create_directories(folder.c_str());
 
-	std::string filename = folder + "trades.csv";
-	_trades_log.reset(new BoostFile());
+	//订单和成交日志，journal可以配置为csv或bin，默认为csv
+	std::string format = "csv";
+	uint32_t capacity = 8192;
+	if (_cfg)
 	{
-		bool isNewFile = !BoostFile::exists(filename.c_str());
-		_trades_log->create_or_open_file(filename.c_str());
-		if (isNewFile)
-		{
-			_trades_log->write_file("localid,date,time,code,action,volume,price,tradeid,orderid\n");
-		}
-		else
-		{
-			_trades_log->seek_to_end();
-		}
+		if (strlen(_cfg->getCString("journal")) > 0)
+			format = _cfg->getCString("journal");
+		if (_cfg->has("journalsize"))
+			capacity = _cfg->getUInt32("journalsize");
 	}
 
-	filename = folder + "orders.csv";
-	_orders_log.reset(new BoostFile());
+	_journal.reset(new TradeJournal());
+	if (!_journal->init(folder.c_str(), format.c_str(), capacity))
 	{
-		bool isNewFile = !BoostFile::exists(filename.c_str());
-		_orders_log->create_or_open_file(filename.c_str());
-		if (isNewFile)
-		{
-			_orders_log->write_file("localid,date,inserttime,code,action,volume,traded,price,orderid,canceled,remark\n");
-		}
-		else
-		{
-			_orders_log->seek_to_end();
-		}
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, "[{}] Initializing trade journal in {} failed", _id.c_str(), folder.c_str());
+		_journal.reset();
 	}
 
 	_rt_data_file = folder + "rtdata.json";
@@ -276,25 +265,23 @@ void TraderAdapter::initSaveData()
 
 void TraderAdapter::logTrade(uint32_t localid, const char* stdCode, WTSTradeInfo* trdInfo)
 {
-	if (_trades_log == NULL || trdInfo == NULL)
+	if (_journal == NULL || trdInfo == NULL)
 		return;
 
-	_trades_log->write_file(fmt::format("{},{},{},{},{},{},{},{},{}\n",
-		localid, trdInfo->getTradeDate(), trdInfo->getTradeTime(), stdCode,
+	_journal->log_trade(localid, stdCode, trdInfo->getTradeDate(), trdInfo->getTradeTime(),
 		formatAction(trdInfo->getDirection(), trdInfo->getOffsetType()),
-		trdInfo->getVolume(), trdInfo->getPrice(), trdInfo->getTradeID(), trdInfo->getRefOrder()));
+		trdInfo->getVolume(), trdInfo->getPrice(), trdInfo->getTradeID(), trdInfo->getRefOrder());
 }
 
 void TraderAdapter::logOrder(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo)
 {
-	if (_orders_log == NULL || ordInfo == NULL)
+	if (_journal == NULL || ordInfo == NULL)
 		return;
 
-	_orders_log->write_file(fmt::format("{},{},{},{},{},{},{},{},{},{},{}\n",
-		localid, ordInfo->getOrderDate(), ordInfo->getOrderTime(), stdCode,
+	_journal->log_order(localid, stdCode, ordInfo->getOrderDate(), ordInfo->getOrderTime(),
 		formatAction(ordInfo->getDirection(), ordInfo->getOffsetType()),
-		ordInfo->getVolume(), ordInfo->getVolTraded(), ordInfo->getPrice(), 
-		ordInfo->getOrderID(), ordInfo->getOrderState()==WOS_Canceled?"TRUE":"FALSE", ordInfo->getStateMsg()));
+		ordInfo->getVolume(), ordInfo->getVolTraded(), ordInfo->getPrice(),
+		ordInfo->getOrderID(), ordInfo->getOrderState() == WOS_Canceled, ordInfo->getStateMsg());
 }
 
 void TraderAdapter::saveData(WTSArray* ayFunds /* = NULL */)
@@ -420,6 +407,10 @@ void TraderAdapter::release()
 		_trader_api->registerSpi(NULL);
 		_trader_api->release();
 	}
+
+	//通道释放以后不会再有回报了，把日志全部写完
+	if (_journal)
+		_journal->stop();
 }
 
 double TraderAdapter::getPosition(const char* stdCode, bool bValidOnly, int32_t flag /* = 3 */)
@@ -496,6 +487,12 @@ uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust)
 	wt_strcpy(usertag, _order_pattern.c_str(), _order_pattern.size());
 	usertag[_order_pattern.size()] =  '.';
 	fmtutil::format_to(usertag + _order_pattern.size() + 1, "{}", localid);
+
+	//策略在on_tick里下单的，统计从收到行情到下单的延迟
+	int64_t tickStamp = LatencyStats::get_tick_stamp();
+	if (tickStamp != 0)
+		LatencyStats::record(LatencyStats::LS_TICK2ORDER, LatencyStats::now() - tickStamp);
+	LatencyStats::mark_entrust(localid);
 	
 	int32_t ret = _trader_api->orderInsert(entrust);
 	if(ret < 0)
@@ -1441,6 +1438,9 @@ void TraderAdapter::onLogout()
 
 void TraderAdapter::onRspEntrust(WTSEntrust* entrust, WTSError *err)
 {
+	if (StrUtil::startsWith(entrust->getUserTag(), _order_pattern.c_str(), true))
+		LatencyStats::ack_entrust(strtoul(entrust->getUserTag() + _order_pattern.size() + 1, NULL, 10));
+
 	if (err && err->getErrorCode() != WEC_NONE)
 	{
 		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, err->getMessage());
@@ -1863,6 +1863,10 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 	if (orderInfo == NULL)
 		return;
 
+	//第一笔委托回报到达的时间，重复的回报不会重复统计
+	if (StrUtil::startsWith(orderInfo->getUserTag(), _order_pattern.c_str(), true))
+		LatencyStats::ack_entrust(strtoul(orderInfo->getUserTag() + _order_pattern.size() + 1, NULL, 10));
+
 
 	WTSContractInfo* cInfo = orderInfo->getContractInfo();
 	if (cInfo == NULL)
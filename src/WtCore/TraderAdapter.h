@@ -13,6 +13,7 @@
 #include "../Includes/FasterDefs.h"
 #include "../Includes/ITraderApi.h"
 #include "../Share/BoostFile.hpp"
+#include "../Share/TradeJournal.hpp"
 #include "../Share/StdUtils.hpp"
 #include "../Share/SpinMutex.hpp"
 
@@ -262,8 +263,7 @@ private:
 	bool			_risk_mon_enabled;
 
 	bool			_save_data;	//是否保存交易日志
-	BoostFilePtr	_trades_log;		//交易数据日志
-	BoostFilePtr	_orders_log;		//订单数据日志
+	TradeJournalPtr	_journal;			//订单和成交日志，后台线程异步写入
 	std::string		_rt_data_file;		//实时数据文件
 };
 
@@ -40,6 +40,9 @@ WtCtaEngine::WtCtaEngine()
 
 WtCtaEngine::~WtCtaEngine()
 {
+	if (_dispatcher)
+		_dispatcher->stop();
+
 	if (_tm_ticker)
 	{
 		delete _tm_ticker;
@@ -98,6 +101,9 @@ void WtCtaEngine::run()
 		StdFile::write_file_content(filename.c_str(), sb.GetString());
 	}
 
+	if (_dispatcher)
+		_dispatcher->start();
+
 	_tm_ticker->run();
 
 	if (_risk_mon)
@@ -117,7 +123,8 @@ void WtCtaEngine::init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, I
 	uint32_t poolsize = cfg->getUInt32("poolsize");
 	if (poolsize > 0)
 	{
-		_pool.reset(new boost::threadpool::pool(poolsize));
+		uint32_t inboxSize = cfg->has("inboxsize") ? cfg->getUInt32("inboxsize") : 1024;
+		_dispatcher.reset(new WtStraDispatcher(poolsize, inboxSize));
 	}
 	WTSLogger::info("Engine task poolsize is {}", poolsize);
 }
@@ -126,6 +133,9 @@ void WtCtaEngine::addContext(CtaContextPtr ctx)
 {
 	uint32_t sid = ctx->id();
 	_ctx_map[sid] = ctx;
+
+	if (_dispatcher)
+		_dispatcher->add_context(sid);
 }
 
 CtaContextPtr WtCtaEngine::getContext(uint32_t id)
@@ -210,6 +220,10 @@ void WtCtaEngine::on_init()
 
 void WtCtaEngine::on_session_begin()
 {
+	//还没处理完的行情事件要先处理完
+	if (_dispatcher)
+		_dispatcher->wait_all();
+
 	WTSLogger::info("Trading day {} begun", _cur_tdate);
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
@@ -225,6 +239,22 @@ void WtCtaEngine::on_session_begin()
 
 void WtCtaEngine::on_session_end()
 {
+	if (_dispatcher)
+	{
+		_dispatcher->wait_all();
+
+		_dispatcher->enum_metrics([this](uint32_t ctxid, const WtStraDispatcher::CtxMetrics& m) {
+			auto it = _ctx_map.find(ctxid);
+			if (it == _ctx_map.end() || m._handled == 0)
+				return;
+
+			WTSLogger::info("[Dispatcher] {}: {} events handled, {} stolen, max depth {}, wait avg {:.1f}us/max {:.1f}us, cost avg {:.1f}us/max {:.1f}us",
+				it->second->name(), m._handled, m._stolen, m._max_depth,
+				m._total_wait / 1000.0 / m._handled, m._max_wait / 1000.0,
+				m._total_cost / 1000.0 / m._handled, m._max_cost / 1000.0);
+		});
+	}
+
 	WtEngine::on_session_end();
 
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
@@ -244,7 +274,7 @@ void WtCtaEngine::on_schedule(uint32_t curDate, uint32_t curTime)
 	_filter_mgr.load_filters();
 	_exec_mgr.clear_cached_targets();
 	wt_hashmap<std::string, double> target_pos;
-	if(_pool)
+	if(_dispatcher)
 	{
 		/*
 		 *	By Wesley @ 2023.06.27
@@ -252,11 +282,12 @@ void WtCtaEngine::on_schedule(uint32_t curDate, uint32_t curTime)
 		 *	先并发所有的on_schedule
 		 *	然后再wait所有任务结束
 		 *	最后再统一读取全部持仓
+		 *	每个策略的收件箱是按顺序处理的，所以on_schedule一定在之前投递的行情事件之后执行
 		 */
 		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 		{
 			CtaContextPtr& ctx = (CtaContextPtr&)it->second;
-			_pool->schedule([ctx, curDate, curTime] (){
+			_dispatcher->post(ctx->id(), [ctx, curDate, curTime] (){
 				ctx->on_schedule(curDate, curTime);
 			});
 		}
@@ -265,7 +296,7 @@ void WtCtaEngine::on_schedule(uint32_t curDate, uint32_t curTime)
 		 *	By Wesley @ 2023.06.27
 		 *	等待全部on_schedule执行完成
 		 */
-		_pool->wait();
+		_dispatcher->wait_all();
 		
 		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 		{
@@ -524,11 +555,15 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 					/*
 					 *	By Wesley @ 2023.06.27
 					 *	如果使用线程池，则到线程池里去调度
+					 *	投递以后不再等待处理完成，所以代码要拷贝一份，tick要增加引用计数
 					 */
-					if(_pool)
+					if(_dispatcher)
 					{
-						_pool->schedule([ctx, stdCode, curTick]() {
-							ctx->on_tick(stdCode, curTick);
+						std::string code = stdCode;
+						curTick->retain();
+						_dispatcher->post(sid, [ctx, code, curTick]() {
+							ctx->on_tick(code.c_str(), curTick);
+							curTick->release();
 						});
 					}
 					else
@@ -540,10 +575,12 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 					wCode = fmt::format("{}{}", stdCode, opt == 1 ? SUFFIX_QFQ : SUFFIX_HFQ);
 					if (opt == 1)
 					{
-						if (_pool)
+						if (_dispatcher)
 						{
-							_pool->schedule([ctx, wCode, curTick]() {
+							curTick->retain();
+							_dispatcher->post(sid, [ctx, wCode, curTick]() {
 								ctx->on_tick(wCode.c_str(), curTick);
+								curTick->release();
 							});
 						}
 						else
@@ -553,7 +590,7 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 					{
 						if (adjTick == nullptr)
 						{
-							WTSTickData* adjTick = WTSTickData::create(curTick->getTickStruct());
+							adjTick = WTSTickData::create(curTick->getTickStruct());
 							WTSTickStruct& adjTS = adjTick->getTickStruct();
 							adjTick->setContractInfo(curTick->getContractInfo());
 
@@ -595,10 +632,12 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 							_price_map[wCode] = adjTS.price;
 						}
 
-						if (_pool)
+						if (_dispatcher)
 						{
-							_pool->schedule([ctx, wCode, adjTick]() {
+							adjTick->retain();
+							_dispatcher->post(sid, [ctx, wCode, adjTick]() {
 								ctx->on_tick(wCode.c_str(), adjTick);
+								adjTick->release();
 							});
 						}
 						else
@@ -611,12 +650,13 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 
 		if(nullptr != adjTick)
 			adjTick->release();
+
 		/*
-		 *	By Wesley @ 223.06.27
-		 *	这里一定要等待线程池全部调度完成
+		 *	策略线程会读写价格缓存、行情缓存和执行器的持仓，这些都没有加锁
+		 *	所以要等全部策略处理完，引擎线程才能继续处理下一个事件
 		 */
-		if (_pool)
-			_pool->wait();
+		if (_dispatcher)
+			_dispatcher->wait_all();
 	}
 	
 }
@@ -634,10 +674,14 @@ void WtCtaEngine::on_bar(const char* stdCode, const char* period, uint32_t times
 		if(cit != _ctx_map.end())
 		{
 			CtaContextPtr& ctx = (CtaContextPtr&)cit->second;
-			if (_pool)
+			if (_dispatcher)
 			{
-				_pool->schedule([ctx, stdCode, period, times, newBar]() {
-					ctx->on_bar(stdCode, period, times, newBar);
+				//K线数据可能会被后面的数据覆盖，所以拷贝一份
+				std::string code = stdCode;
+				std::string pname = period;
+				WTSBarStruct bar = *newBar;
+				_dispatcher->post(sid, [ctx, code, pname, times, bar]() mutable {
+					ctx->on_bar(code.c_str(), pname.c_str(), times, &bar);
 				});
 			}
 			else
@@ -645,12 +689,9 @@ void WtCtaEngine::on_bar(const char* stdCode, const char* period, uint32_t times
 		}
 	}
 
-	/*
-	 *	By Wesley @ 223.06.27
-	 *	这里一定要等待线程池全部调度完成
-	 */
-	if (_pool)
-		_pool->wait();
+	//同on_tick，等全部策略处理完
+	if (_dispatcher)
+		_dispatcher->wait_all();
 
 	WTSLogger::info("KBar [{}] @ {} closed", key, period[0] == 'd' ? newBar->date : newBar->time);
 }
@@ -9,7 +9,7 @@
  */
 #pragma once
 #include "../Includes/ICtaStraCtx.h"
-#include "../Share/threadpool.hpp"
+#include "WtStraDispatcher.h"
 #include "WtExecMgr.h"
 #include "WtEngine.h"
 
@@ -89,8 +89,12 @@ private:
 
 	WTSVariant*		_cfg;
 
-	typedef std::shared_ptr<boost::threadpool::pool> ThreadPoolPtr;
-	ThreadPoolPtr		_pool;
+	/*
+	 *	策略事件分发器，配置了poolsize才会创建
+	 *	策略在各自的工作线程里处理事件，每个事件都要等全部策略处理完
+	 */
+	typedef std::shared_ptr<WtStraDispatcher> DispatcherPtr;
+	DispatcherPtr		_dispatcher;
 };
 
 NS_WTP_END
@@ -27,7 +27,6 @@ WtDtMgr::WtDtMgr()
 	: _reader(NULL)
 	, _engine(NULL)
 	, _loader(NULL)
-	, _bars_cache(NULL)
 	, _ticks_adjusted(NULL)
 	, _rt_tick_map(NULL)
 	, _force_cache(false)
@@ -37,8 +36,11 @@ WtDtMgr::WtDtMgr()
 
 WtDtMgr::~WtDtMgr()
 {
-	if (_bars_cache)
-		_bars_cache->release();
+	for (auto& m : _bars_cache)
+	{
+		if (m.second->_data)
+			m.second->_data->release();
+	}
 
 	if (_ticks_adjusted)
 		_ticks_adjusted->release();
@@ -114,6 +116,18 @@ void WtDtMgr::on_all_bar_updated(uint32_t updateTime)
 	}
 
 	_bar_notifies.clear();
+
+	//通知完了再裁剪缓存，裁剪会让通知里的K线指针失效
+	for (auto& m : _bars_cache)
+	{
+		KlineCache* kc = m.second.get();
+		auto& bars = kc->_data->getDataRef();
+		if (kc->_capacity == 0 || bars.size() <= kc->_capacity * 2)
+			continue;
+
+		bars.erase(bars.begin(), bars.begin() + (bars.size() - kc->_capacity));
+		kc->_exhausted = false;
+	}
 }
 
 IBaseDataMgr* WtDtMgr::get_basedata_mgr()
@@ -177,18 +191,15 @@ void WtDtMgr::on_bar(const char* code, WTSKlinePeriod period, WTSBarStruct* newB
 	}
 
 	//然后再处理非基础周期
-	if (_bars_cache == NULL || _bars_cache->size() == 0)
+	auto iit = _bars_index.find(key_pattern);
+	if (iit == _bars_index.end())
 		return;
 	
 	WTSSessionInfo* sInfo = _engine->get_session_info(code, true);
 
-	for (auto it = _bars_cache->begin(); it != _bars_cache->end(); it++)
+	for (KlineCache* kc : iit->second)
 	{
-		const char* key = it->first.c_str();
-		if(memcmp(key, key_pattern.c_str(), key_pattern.size()) != 0)
-			continue;
-
-		WTSKlineData* kData = (WTSKlineData*)it->second;
+		WTSKlineData* kData = kc->_data;
 		if(kData->times() != 1)
 		{
 			g_dataFact.updateKlineData(kData, newBar, sInfo, _align_by_section);
@@ -413,19 +424,32 @@ WTSKlineSlice* WtDtMgr::get_kline_slice(const char* stdCode, WTSKlinePeriod peri
 	//只有非基础周期的会进到下面的步骤
 	WTSSessionInfo* sInfo = _engine->get_session_info(stdCode, true);
 
-	if (_bars_cache == NULL)
-		_bars_cache = DataCacheMap::create();
-
+	std::string basicKey = key;
 	fmtutil::format_to(key, "{}-{}-{}", stdCode, (uint32_t)period, times);
 
-	WTSKlineData* kData = (WTSKlineData*)_bars_cache->get(key);
-	//如果缓存里的K线条数大于请求的条数, 则直接返回
-	if (kData == NULL || kData->size() < count)
+	KlineCachePtr& kc = _bars_cache[key];
+	if (kc == NULL)
+		kc.reset(new KlineCache);
+
+	/*
+	 *	缓存里的K线条数不够, 才需要重新读取
+	 *	已经增量更新的缓存不会丢掉，只是用新读取的数据替换掉
+	 *	每次至少读取缓存条数的2倍，请求的条数逐渐增加时不会每次都重新读取和重采样
+	 *	如果历史数据已经全部读完了，就不用再读了
+	 */
+	if (kc->_data == NULL || (kc->_data->size() < count && !kc->_exhausted))
 	{
-		uint32_t realCount = times==1 ? count: (count*times + times);
+		uint32_t loadCount = count;
+		if (kc->_data != NULL)
+			loadCount = max(count, (uint32_t)kc->_data->size() * 2);
+
+		uint32_t realCount = times==1 ? loadCount: (loadCount*times + times);
+		WTSKlineData* kData = NULL;
+		bool bExhausted = false;
 		WTSKlineSlice* rawData = _reader->readKlineSlice(stdCode, period, realCount, etime);
 		if (rawData != NULL && rawData->size() > 0)
 		{
+			bExhausted = (rawData->size() < realCount);
 			if(times != 1)
 			{
 				kData = g_dataFact.extractKlineData(rawData, period, times, sInfo, true, _align_by_section);
@@ -442,23 +466,46 @@ WTSKlineSlice* WtDtMgr::get_kline_slice(const char* stdCode, WTSKlinePeriod peri
 					pBar += rawData->get_block_size(bIdx);
 				}
 			}
-			
-			rawData->release();
-		}
-		else
-		{
-			return NULL;
 		}
 
+		if (rawData)
+			rawData->release();
+
 		if (kData)
 		{
-			_bars_cache->add(key, kData, false);
+			if (kc->_data == NULL)
+			{
+				kc->_data = kData;
+				_bars_index[basicKey].emplace_back(kc.get());
+			}
+			else
+			{
+				//缓存对象不变，只替换数据
+				kc->_data->getDataRef().swap(kData->getDataRef());
+				kc->_data->setClosed(kData->isClosed());
+				kData->release();
+			}
+			kc->_exhausted = bExhausted;
+
 			if(times != 1)
 				WTSLogger::debug("{} bars of {} resampled every {} bars: {} -> {}", 
-					PERIOD_NAME[period], stdCode, times, realCount, kData->size());
+					PERIOD_NAME[period], stdCode, times, realCount, kc->_data->size());
+		}
+		else if (kc->_data == NULL)
+		{
+			_bars_cache.erase(key);
+			return NULL;
+		}
+		else
+		{
+			//读不到更多的数据了，用现有的缓存
+			kc->_exhausted = true;
 		}
 	}
 
+	kc->_capacity = max(kc->_capacity, count);
+	WTSKlineData* kData = kc->_data;
+
 	/*
 	 *	By Wesley @ 2023.03.03
 	 *	当多周期K线跨越小节时，如果重启了组合
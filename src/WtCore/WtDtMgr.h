@@ -19,6 +19,7 @@ NS_WTP_BEGIN
 class WTSVariant;
 class WTSTickData;
 class WTSKlineSlice;
+class WTSKlineData;
 class WTSTickSlice;
 class IBaseDataMgr;
 class IBaseDataMgr;
@@ -77,8 +78,27 @@ private:
 	bool			_force_cache;		//强制缓存K线
 
 	wt_hashset<std::string> _subed_basic_bars;
+
+	/*
+	 *	K线缓存，包括重采样的K线和强制缓存的基础周期K线
+	 *	同一个key的缓存所有策略共用，基础周期K线每次闭合时增量更新，读取时直接在缓存上切片
+	 *	缓存的条数超过策略请求过的最大条数的2倍时，会把前面多余的K线裁掉
+	 */
+	typedef struct _KlineCache
+	{
+		WTSKlineData*	_data;
+		uint32_t		_capacity;	//策略请求过的最大条数
+		bool			_exhausted;	//历史数据已经全部读取了，条数不够也不用再重新读取
+
+		_KlineCache() :_data(NULL), _capacity(0), _exhausted(false) {}
+	} KlineCache;
+	typedef std::shared_ptr<KlineCache>	KlineCachePtr;
+	typedef wt_hashmap<std::string, KlineCachePtr>	KlineCaches;
+	KlineCaches		_bars_cache;	//key为code-period-times
+	//基础周期到K线缓存的索引，key为code-period，on_bar的时候只需要更新相关的缓存
+	wt_hashmap<std::string, std::vector<KlineCache*>>	_bars_index;
+
 	typedef WTSHashMap<std::string> DataCacheMap;
-	DataCacheMap*	_bars_cache;	//K线缓存
 	DataCacheMap*	_rt_tick_map;	//实时tick缓存
 	//By Wesley @ 2022.02.11
 	//这个只有后复权tick数据
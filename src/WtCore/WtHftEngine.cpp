@@ -17,6 +17,7 @@
 
 #include "../Share/decimal.h"
 #include "../Share/CodeHelper.hpp"
+#include "../Share/LatencyStats.hpp"
 
 #include "../Includes/WTSVariant.hpp"
 #include "../Includes/WTSContractInfo.hpp"
@@ -32,6 +33,8 @@ USING_NS_WTP;
 WtHftEngine::WtHftEngine()
 	: _cfg(NULL)
 	, _tm_ticker(NULL)
+	, _latency_dump(0)
+	, _minutes(0)
 {
 }
 
@@ -55,6 +58,9 @@ void WtHftEngine::init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, I
 
 	_cfg = cfg;
 	_cfg->retain();
+
+	//延迟统计输出的间隔，单位分钟，为0则只在收盘时输出
+	_latency_dump = cfg->getUInt32("latencydump");
 }
 
 void WtHftEngine::run()
@@ -213,6 +219,11 @@ void WtHftEngine::sub_transaction(uint32_t sid, const char* stdCode)
 
 void WtHftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 {
+	int64_t tEngine = LatencyStats::now();
+	int64_t recvTime = curTick->getRecvTime();
+	if (recvTime != 0)
+		LatencyStats::record(LatencyStats::LS_PARSER, tEngine - recvTime);
+
 	WtEngine::on_tick(stdCode, curTick);
 
 	_data_mgr->handle_push_quote(stdCode, curTick);
@@ -226,6 +237,10 @@ void WtHftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 	 */
 	if(_ready)
 	{
+		//策略在on_tick里下单的时候，用这个时间戳计算tick到下单的延迟
+		LatencyStats::set_tick_stamp(recvTime);
+		int64_t straCost = 0;
+
 		auto sit = _tick_sub_map.find(stdCode);
 		if (sit != _tick_sub_map.end())
 		{
@@ -240,6 +255,10 @@ void WtHftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 					HftContextPtr& ctx = (HftContextPtr&)cit->second;
 					uint32_t opt = it->second.second;
 
+					//分发耗时要扣掉前面的策略的处理时间
+					int64_t tStra = LatencyStats::now();
+					LatencyStats::record(LatencyStats::LS_DISPATCH, tStra - tEngine - straCost);
+
 					if (opt == 0)
 					{
 						ctx->on_tick(stdCode, curTick);
@@ -271,9 +290,15 @@ void WtHftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 							newTick->release();
 						}
 					}
+
+					int64_t cost = LatencyStats::now() - tStra;
+					LatencyStats::record(LatencyStats::LS_STRATEGY, cost);
+					straCost += cost;
 				}
 			}
 		}
+
+		LatencyStats::set_tick_stamp(0);
 	}
 }
 
@@ -323,12 +348,17 @@ void WtHftEngine::on_session_end()
 	}
 
 	WTSLogger::info("Trading day {} ended", _cur_tdate);
+	WTSLogger::info("Latency stats of trading day {}: {}", _cur_tdate, LatencyStats::to_json());
 	if (_evt_listener)
 		_evt_listener->on_session_event(_cur_tdate, false);
 }
 
 void WtHftEngine::on_minute_end(uint32_t curDate, uint32_t curTime)
 {
+	_minutes++;
+	if (_latency_dump != 0 && _minutes % _latency_dump == 0)
+		WTSLogger::info("Latency stats @ {}.{}: {}", curDate, curTime, LatencyStats::to_json());
+
 	//已去掉高频策略的on_schedule
 	//for(auto& cit : _ctx_map)
 	//{
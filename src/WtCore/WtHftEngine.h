@@ -69,6 +69,9 @@ private:
 	WtHftRtTicker*	_tm_ticker;
 	WTSVariant*		_cfg;
 
+	uint32_t		_latency_dump;	//延迟统计输出间隔，单位分钟
+	uint32_t		_minutes;
+
 
 	StraSubMap		_ordque_sub_map;	//委托队列订阅表
 	StraSubMap		_orddtl_sub_map;	//委托明细订阅表
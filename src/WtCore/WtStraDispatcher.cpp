@@ -0,0 +1,274 @@
+﻿/*!
+ * \file WtStraDispatcher.cpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief
+ */
+#include "WtStraDispatcher.h"
+
+#include <algorithm>
+
+USING_NS_WTP;
+
+//每次处理一个收件箱最多处理的事件数，避免一个繁忙的策略长期占住工作线程
+static const uint32_t DRAIN_BATCH = 32;
+//空闲多少轮以后进入休眠
+static const uint32_t IDLE_ROUNDS = 64;
+
+WtStraDispatcher::WtStraDispatcher(uint32_t workers, uint32_t inboxSize /* = 1024 */)
+	: _inbox_size(inboxSize)
+	, _started(false)
+	, _stopped(false)
+	, _pending(0)
+	, _sleepers(0)
+{
+	if (workers == 0)
+		workers = 1;
+
+	for (uint32_t i = 0; i < workers; i++)
+	{
+		WorkerPtr worker(new Worker);
+		worker->_idx = i;
+		_workers.emplace_back(worker);
+	}
+}
+
+WtStraDispatcher::~WtStraDispatcher()
+{
+	stop();
+}
+
+void WtStraDispatcher::add_context(uint32_t ctxid)
+{
+	if (_started || find_slot(ctxid) != NULL)
+		return;
+
+	//按注册顺序轮流分配给工作线程
+	uint32_t owner = (uint32_t)(_slots.size() % _workers.size());
+	CtxSlotPtr slot(new CtxSlot(ctxid, owner, _inbox_size));
+	auto it = std::lower_bound(_slots.begin(), _slots.end(), ctxid, [](const CtxSlotPtr& a, uint32_t id) {
+		return a->_id < id;
+	});
+	_slots.insert(it, slot);
+	_workers[owner]->_slots.emplace_back(slot.get());
+}
+
+WtStraDispatcher::CtxSlot* WtStraDispatcher::find_slot(uint32_t ctxid)
+{
+	auto it = std::lower_bound(_slots.begin(), _slots.end(), ctxid, [](const CtxSlotPtr& a, uint32_t id) {
+		return a->_id < id;
+	});
+
+	if (it == _slots.end() || (*it)->_id != ctxid)
+		return NULL;
+
+	return it->get();
+}
+
+void WtStraDispatcher::start()
+{
+	if (_started)
+		return;
+
+	_started = true;
+	for (WorkerPtr& worker : _workers)
+	{
+		Worker* w = worker.get();
+		worker->_thrd.reset(new std::thread([this, w]() {
+			worker_loop(w);
+		}));
+	}
+}
+
+void WtStraDispatcher::stop()
+{
+	if (!_started || _stopped)
+		return;
+
+	_stopped = true;
+	{
+		std::unique_lock<std::mutex> lock(_mtx_idle);
+		_cond_idle.notify_all();
+	}
+
+	for (WorkerPtr& worker : _workers)
+	{
+		if (worker->_thrd)
+			worker->_thrd->join();
+	}
+
+	//工作线程退出以后还没处理的事件，在当前线程处理掉
+	for (CtxSlotPtr& slot : _slots)
+	{
+		while (drain(slot.get(), false) > 0);
+	}
+}
+
+void WtStraDispatcher::post(uint32_t ctxid, StraTask task)
+{
+	CtxSlot* slot = find_slot(ctxid);
+	if (slot == NULL || !_started || _stopped)
+	{
+		task();
+		return;
+	}
+
+	_pending.fetch_add(1);
+	int64_t now = _ticker.nano_seconds();
+	while (!slot->_inbox.try_emplace(std::move(task), now))
+	{
+		//收件箱满了，说明策略处理不过来，只能等待
+		{
+			std::unique_lock<std::mutex> lock(_mtx_idle);
+			_cond_idle.notify_all();
+		}
+		std::this_thread::yield();
+	}
+
+	uint64_t depth = slot->_inbox.size();
+	if (depth > slot->_max_depth.load(std::memory_order_relaxed))
+		slot->_max_depth.store(depth, std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_sleepers.load() > 0)
+	{
+		std::unique_lock<std::mutex> lock(_mtx_idle);
+		_cond_idle.notify_all();
+	}
+}
+
+void WtStraDispatcher::wait_all()
+{
+	if (!_started)
+		return;
+
+	uint32_t rounds = 0;
+	while (_pending.load() > 0)
+	{
+		if (++rounds < IDLE_ROUNDS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_mtx_done);
+		_cond_done.wait_for(lock, std::chrono::milliseconds(1));
+	}
+}
+
+uint32_t WtStraDispatcher::drain(CtxSlot* slot, bool isStolen)
+{
+	if (slot->_running.load(std::memory_order_relaxed) || slot->_running.exchange(true, std::memory_order_acquire))
+		return 0;
+
+	uint32_t cnt = (uint32_t)slot->_inbox.consume([this, slot](TaskItem& item) {
+		int64_t start = _ticker.nano_seconds();
+		item._task();
+		int64_t end = _ticker.nano_seconds();
+
+		uint64_t wait = (uint64_t)std::max(start - item._post_time, (int64_t)0);
+		uint64_t cost = (uint64_t)std::max(end - start, (int64_t)0);
+
+		//同一时刻只有一个线程在处理这个收件箱，所以统计数据不需要CAS
+		slot->_handled.fetch_add(1, std::memory_order_relaxed);
+		slot->_total_wait.fetch_add(wait, std::memory_order_relaxed);
+		slot->_total_cost.fetch_add(cost, std::memory_order_relaxed);
+		if (wait > slot->_max_wait.load(std::memory_order_relaxed))
+			slot->_max_wait.store(wait, std::memory_order_relaxed);
+		if (cost > slot->_max_cost.load(std::memory_order_relaxed))
+			slot->_max_cost.store(cost, std::memory_order_relaxed);
+
+		if (_pending.fetch_sub(1) == 1)
+		{
+			std::unique_lock<std::mutex> lock(_mtx_done);
+			_cond_done.notify_all();
+		}
+	}, DRAIN_BATCH);
+
+	if (isStolen && cnt > 0)
+		slot->_stolen.fetch_add(cnt, std::memory_order_relaxed);
+
+	slot->_running.store(false, std::memory_order_release);
+	return cnt;
+}
+
+bool WtStraDispatcher::has_work()
+{
+	for (CtxSlotPtr& slot : _slots)
+	{
+		if (!slot->_inbox.empty() && !slot->_running.load(std::memory_order_relaxed))
+			return true;
+	}
+
+	return false;
+}
+
+void WtStraDispatcher::worker_loop(Worker* worker)
+{
+	uint32_t workers = (uint32_t)_workers.size();
+	uint32_t idleRounds = 0;
+	while (!_stopped)
+	{
+		uint32_t cnt = 0;
+
+		//先处理分配给自己的上下文
+		for (CtxSlot* slot : worker->_slots)
+			cnt += drain(slot, false);
+
+		//自己没事做了，就去其他工作线程那里偷
+		if (cnt == 0)
+		{
+			for (uint32_t i = 1; i < workers && cnt == 0; i++)
+			{
+				Worker* other = _workers[(worker->_idx + i) % workers].get();
+				for (CtxSlot* slot : other->_slots)
+				{
+					if (slot->_inbox.empty())
+						continue;
+
+					cnt += drain(slot, true);
+				}
+			}
+		}
+
+		if (cnt > 0)
+		{
+			idleRounds = 0;
+			continue;
+		}
+
+		if (++idleRounds < IDLE_ROUNDS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		idleRounds = 0;
+		std::unique_lock<std::mutex> lock(_mtx_idle);
+		_sleepers.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!_stopped && !has_work())
+			_cond_idle.wait_for(lock, std::chrono::milliseconds(100));
+		_sleepers.fetch_sub(1);
+	}
+}
+
+void WtStraDispatcher::enum_metrics(EnumMetricsCb cb)
+{
+	for (CtxSlotPtr& slot : _slots)
+	{
+		CtxMetrics m;
+		m._handled = slot->_handled.load(std::memory_order_relaxed);
+		m._stolen = slot->_stolen.load(std::memory_order_relaxed);
+		m._depth = slot->_inbox.size();
+		m._max_depth = slot->_max_depth.load(std::memory_order_relaxed);
+		m._total_wait = slot->_total_wait.load(std::memory_order_relaxed);
+		m._max_wait = slot->_max_wait.load(std::memory_order_relaxed);
+		m._total_cost = slot->_total_cost.load(std::memory_order_relaxed);
+		m._max_cost = slot->_max_cost.load(std::memory_order_relaxed);
+		cb(slot->_id, m);
+	}
+}
@@ -0,0 +1,159 @@
+﻿/*!
+ * \file WtStraDispatcher.h
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 策略事件分发器
+ *
+ * 每个策略上下文固定分配给一个工作线程，并且有自己的单写单读收件箱
+ * 引擎线程只负责把事件投递到收件箱，不用等待策略处理完成
+ * 工作线程空闲时会从忙碌的工作线程那里偷取其他上下文的收件箱来处理
+ * 同一个上下文的收件箱同一时刻只有一个线程在处理，所以单个策略的事件仍然是按顺序串行处理的
+ */
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+#include "../Includes/WTSMarcos.h"
+#include "../Share/SpscQueue.hpp"
+#include "../Share/TimeUtils.hpp"
+
+NS_WTP_BEGIN
+
+class WtStraDispatcher
+{
+public:
+	typedef std::function<void()>	StraTask;
+
+	/*
+	 *	单个上下文的统计数据
+	 */
+	typedef struct _CtxMetrics
+	{
+		uint64_t	_handled;		//处理的事件数
+		uint64_t	_stolen;		//被其他工作线程偷取处理的事件数
+		uint64_t	_depth;			//当前队列深度
+		uint64_t	_max_depth;		//最大队列深度
+		uint64_t	_total_wait;	//事件从投递到开始处理的总耗时，单位纳秒
+		uint64_t	_max_wait;
+		uint64_t	_total_cost;	//事件处理的总耗时，单位纳秒
+		uint64_t	_max_cost;
+	} CtxMetrics;
+
+	typedef std::function<void(uint32_t ctxid, const CtxMetrics& metrics)>	EnumMetricsCb;
+
+public:
+	WtStraDispatcher(uint32_t workers, uint32_t inboxSize = 1024);
+	~WtStraDispatcher();
+
+public:
+	/*
+	 *	注册上下文，要在start之前调用
+	 */
+	void	add_context(uint32_t ctxid);
+
+	void	start();
+	void	stop();
+
+	/*
+	 *	投递事件，只能由引擎线程调用
+	 *	收件箱满了会自旋等待，未注册的上下文直接在当前线程执行
+	 */
+	void	post(uint32_t ctxid, StraTask task);
+
+	/*
+	 *	等待全部已投递的事件处理完成
+	 */
+	void	wait_all();
+
+	void	enum_metrics(EnumMetricsCb cb);
+
+	inline uint32_t	workers() const { return (uint32_t)_workers.size(); }
+
+private:
+	typedef struct _TaskItem
+	{
+		StraTask	_task;
+		int64_t		_post_time;
+
+		_TaskItem(StraTask&& task, int64_t postTime) :_task(std::move(task)), _post_time(postTime) {}
+	} TaskItem;
+
+	typedef struct _CtxSlot
+	{
+		uint32_t				_id;
+		uint32_t				_owner;
+		SpscQueue<TaskItem>		_inbox;
+		std::atomic<bool>		_running;	//是否有线程正在处理这个收件箱
+
+		//统计数据，只有处理收件箱的线程会修改
+		std::atomic<uint64_t>	_handled;
+		std::atomic<uint64_t>	_stolen;
+		std::atomic<uint64_t>	_total_wait;
+		std::atomic<uint64_t>	_max_wait;
+		std::atomic<uint64_t>	_total_cost;
+		std::atomic<uint64_t>	_max_cost;
+
+		//只有引擎线程会修改
+		std::atomic<uint64_t>	_max_depth;
+
+		_CtxSlot(uint32_t id, uint32_t owner, uint32_t inboxSize)
+			: _id(id), _owner(owner), _inbox(inboxSize), _running(false)
+			, _handled(0), _stolen(0), _total_wait(0), _max_wait(0)
+			, _total_cost(0), _max_cost(0), _max_depth(0)
+		{
+		}
+	} CtxSlot;
+	typedef std::shared_ptr<CtxSlot>	CtxSlotPtr;
+
+	typedef struct _Worker
+	{
+		uint32_t				_idx;
+		std::vector<CtxSlot*>	_slots;		//固定分配给这个工作线程的上下文
+		std::atomic<bool>		_busy;
+		std::shared_ptr<std::thread>	_thrd;
+
+		_Worker() :_idx(0), _busy(false) {}
+	} Worker;
+	typedef std::shared_ptr<Worker>	WorkerPtr;
+
+private:
+	void	worker_loop(Worker* worker);
+
+	/*
+	 *	处理一个收件箱，返回处理的事件数
+	 *	如果收件箱正在被其他线程处理，直接返回0
+	 */
+	uint32_t	drain(CtxSlot* slot, bool isStolen);
+
+	bool	has_work();
+
+	CtxSlot*	find_slot(uint32_t ctxid);
+
+private:
+	uint32_t				_inbox_size;
+	std::vector<WorkerPtr>	_workers;
+	std::vector<CtxSlotPtr>	_slots;		//按上下文id排序
+	bool					_started;
+	std::atomic<bool>		_stopped;
+
+	std::atomic<uint64_t>	_pending;	//已投递但还没处理完成的事件数
+	TimeUtils::Ticker		_ticker;	//计时基准
+
+	std::mutex				_mtx_idle;
+	std::condition_variable	_cond_idle;
+	std::atomic<uint32_t>	_sleepers;
+
+	std::mutex				_mtx_done;
+	std::condition_variable	_cond_done;
+};
+
+NS_WTP_END
@@ -0,0 +1,199 @@
+﻿/*!
+ * \file ChunkHelper.hpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ *
+ * \brief 分块压缩数据块的辅助类
+ *
+ * 分块压缩的数据块（BLOCK_VERSION_CHK_V2）把数据按固定条数切块，每块独立压缩
+ * 文件尾部带一个按时间排序的索引，读取最后N条或者某个时间段的数据时，只需要解压覆盖到的数据块
+ * 同时兼容单帧压缩的数据块（BLOCK_VERSION_CMP_V2），调用方不需要区分
+ */
+#pragma once
+#include "DataDefine.h"
+#include "../WTSUtils/WTSCmpHelper.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+class ChunkHelper
+{
+public:
+	static const uint32_t DEFAULT_CHUNK_ITEMS = 4096;
+
+	/*
+	 *	记录的索引时间
+	 *	tick类的数据为yyyyMMddhhmmssmmm，K线为yyyyMMddhhmm（日线的时间为0）
+	 */
+	static inline uint64_t item_time(const WTSTickStruct& item) { return (uint64_t)item.action_date * 1000000000 + item.action_time; }
+	static inline uint64_t item_time(const WTSTransStruct& item) { return (uint64_t)item.action_date * 1000000000 + item.action_time; }
+	static inline uint64_t item_time(const WTSOrdDtlStruct& item) { return (uint64_t)item.action_date * 1000000000 + item.action_time; }
+	static inline uint64_t item_time(const WTSOrdQueStruct& item) { return (uint64_t)item.action_date * 1000000000 + item.action_time; }
+	static inline uint64_t item_time(const WTSBarStruct& item)
+	{
+		if (item.time == 0)
+			return (uint64_t)item.date * 10000;
+
+		return (uint64_t)(item.time / 10000 + 19900000) * 10000 + item.time % 10000;
+	}
+
+public:
+	/*
+	 *	分块压缩，返回块头后面的全部数据（数据块+索引+尾部）
+	 *	块头的_version要设置为BLOCK_VERSION_CHK_V2，_size为返回数据的大小
+	 */
+	template<typename T>
+	static std::string compress_chunks(const T* items, std::size_t count, uint32_t chunkItems = DEFAULT_CHUNK_ITEMS, uint32_t uLevel = 1)
+	{
+		if (chunkItems == 0)
+			chunkItems = DEFAULT_CHUNK_ITEMS;
+
+		std::string ret;
+		std::vector<BlockChunkIndex> indice;
+		for (std::size_t sIdx = 0; sIdx < count; sIdx += chunkItems)
+		{
+			std::size_t cnt = std::min((std::size_t)chunkItems, count - sIdx);
+			std::string cmpData = WTSCmpHelper::compress_data(items + sIdx, sizeof(T)*cnt, uLevel);
+
+			BlockChunkIndex idx;
+			memset(&idx, 0, sizeof(idx));
+			idx._offset = ret.size();
+			idx._size = cmpData.size();
+			idx._count = (uint32_t)cnt;
+			idx._stime = item_time(items[sIdx]);
+			idx._etime = item_time(items[sIdx + cnt - 1]);
+			indice.emplace_back(idx);
+
+			ret.append(cmpData);
+		}
+
+		BlockChunkFooter footer;
+		memset(&footer, 0, sizeof(footer));
+		footer._index_offset = ret.size();
+		footer._total_count = count;
+		footer._chunk_count = (uint32_t)indice.size();
+		footer._chunk_items = chunkItems;
+		footer._item_size = sizeof(T);
+		memcpy(footer._flag, BLK_FLAG, FLAG_SIZE);
+
+		if (!indice.empty())
+			ret.append((const char*)indice.data(), sizeof(BlockChunkIndex)*indice.size());
+		ret.append((const char*)&footer, sizeof(footer));
+		return ret;
+	}
+
+	/*
+	 *	获取分块压缩数据块的尾部，格式不对返回NULL
+	 *	调用前要确保块头后面有blk->_size个字节
+	 */
+	static const BlockChunkFooter* footer(const BlockHeaderV2* blk)
+	{
+		if (!blk->is_chunked() || blk->_size < sizeof(BlockChunkFooter))
+			return NULL;
+
+		const char* data = (const char*)blk + BLOCK_HEADERV2_SIZE;
+		const BlockChunkFooter* ft = (const BlockChunkFooter*)(data + blk->_size - sizeof(BlockChunkFooter));
+		if (memcmp(ft->_flag, BLK_FLAG, FLAG_SIZE) != 0)
+			return NULL;
+
+		if (ft->_index_offset + sizeof(BlockChunkIndex)*ft->_chunk_count + sizeof(BlockChunkFooter) != blk->_size)
+			return NULL;
+
+		return ft;
+	}
+
+	static inline const BlockChunkIndex* chunk_indice(const BlockHeaderV2* blk, const BlockChunkFooter* ft)
+	{
+		return (const BlockChunkIndex*)((const char*)blk + BLOCK_HEADERV2_SIZE + ft->_index_offset);
+	}
+
+	/*
+	 *	定位最后一个起始时间小于etime的数据块
+	 *	etime之前的数据都在这个块以及它前面的块里，没有则返回-1
+	 */
+	static int32_t locate_chunk(const BlockHeaderV2* blk, uint64_t etime)
+	{
+		const BlockChunkFooter* ft = footer(blk);
+		if (ft == NULL || ft->_chunk_count == 0)
+			return -1;
+
+		const BlockChunkIndex* indice = chunk_indice(blk, ft);
+		const BlockChunkIndex* pIdx = std::lower_bound(indice, indice + ft->_chunk_count, etime, [](const BlockChunkIndex& a, uint64_t t) {
+			return a._stime < t;
+		});
+
+		return (int32_t)(pIdx - indice) - 1;
+	}
+
+	/*
+	 *	解压单个数据块，结果写到out中（会覆盖原有内容）
+	 */
+	static bool uncompress_chunk(const BlockHeaderV2* blk, uint32_t chunkIdx, std::string& out)
+	{
+		const BlockChunkFooter* ft = footer(blk);
+		if (ft == NULL || chunkIdx >= ft->_chunk_count)
+			return false;
+
+		const BlockChunkIndex& idx = chunk_indice(blk, ft)[chunkIdx];
+		const char* data = (const char*)blk + BLOCK_HEADERV2_SIZE;
+		out.clear();
+		WTSCmpHelper::uncompress_append(out, data + idx._offset, (std::size_t)idx._size);
+		return (out.size() == (std::size_t)idx._count * ft->_item_size);
+	}
+
+	/*
+	 *	解压后的数据大小，兼容单帧压缩和分块压缩
+	 */
+	static std::size_t uncompressed_size(const BlockHeaderV2* blk)
+	{
+		if (!blk->is_chunked())
+			return WTSCmpHelper::uncompressed_size((const char*)blk + BLOCK_HEADERV2_SIZE, (std::size_t)blk->_size);
+
+		const BlockChunkFooter* ft = footer(blk);
+		if (ft == NULL)
+			throw std::runtime_error("invalid chunked data block");
+
+		return (std::size_t)(ft->_total_count * ft->_item_size);
+	}
+
+	/*
+	 *	解压全部数据到调用方提供的缓存中，兼容单帧压缩和分块压缩
+	 */
+	static std::size_t uncompress_to(void* dst, std::size_t dstCap, const BlockHeaderV2* blk)
+	{
+		const char* data = (const char*)blk + BLOCK_HEADERV2_SIZE;
+		if (!blk->is_chunked())
+			return WTSCmpHelper::uncompress_to(dst, dstCap, data, (std::size_t)blk->_size);
+
+		const BlockChunkFooter* ft = footer(blk);
+		if (ft == NULL)
+			throw std::runtime_error("invalid chunked data block");
+
+		const BlockChunkIndex* indice = chunk_indice(blk, ft);
+		std::size_t total = 0;
+		for (uint32_t i = 0; i < ft->_chunk_count; i++)
+		{
+			const BlockChunkIndex& idx = indice[i];
+			total += WTSCmpHelper::uncompress_to((char*)dst + total, dstCap - total, data + idx._offset, (std::size_t)idx._size);
+		}
+
+		return total;
+	}
+
+	/*
+	 *	解压全部数据并追加到dst尾部，兼容单帧压缩和分块压缩
+	 */
+	static std::size_t uncompress_append(std::string& dst, const BlockHeaderV2* blk)
+	{
+		std::size_t const desLen = uncompressed_size(blk);
+		std::size_t const oldLen = dst.size();
+		dst.resize(oldLen + desLen);
+		std::size_t const dSize = uncompress_to((char*)dst.data() + oldLen, desLen, blk);
+		if (dSize != desLen)
+			throw std::runtime_error("uncompressed data size does not match calculated data size");
+		return dSize;
+	}
+};
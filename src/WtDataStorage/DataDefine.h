@@ -32,6 +32,7 @@ typedef enum tagBlockType
 #define BLOCK_VERSION_CMP		0x02	//老结构体压缩
 #define BLOCK_VERSION_RAW_V2	0x03	//新结构体未压缩
 #define BLOCK_VERSION_CMP_V2	0x04	//新结构体压缩
+#define BLOCK_VERSION_CHK_V2	0x05	//新结构体分块压缩，带时间索引，可以只解压需要的数据块
 
 typedef struct _BlockHeader
 {
@@ -44,7 +45,11 @@ typedef struct _BlockHeader
 	}
 
 	inline bool is_compressed() const {
-		return (_version == BLOCK_VERSION_CMP || _version == BLOCK_VERSION_CMP_V2);
+		return (_version == BLOCK_VERSION_CMP || _version == BLOCK_VERSION_CMP_V2 || _version == BLOCK_VERSION_CHK_V2);
+	}
+
+	inline bool is_chunked() const {
+		return (_version == BLOCK_VERSION_CHK_V2);
 	}
 } BlockHeader;
 
@@ -61,13 +66,44 @@ typedef struct _BlockHeaderV2
 	}
 
 	inline bool is_compressed() const {
-		return (_version == BLOCK_VERSION_CMP || _version == BLOCK_VERSION_CMP_V2);
+		return (_version == BLOCK_VERSION_CMP || _version == BLOCK_VERSION_CMP_V2 || _version == BLOCK_VERSION_CHK_V2);
+	}
+
+	inline bool is_chunked() const {
+		return (_version == BLOCK_VERSION_CHK_V2);
 	}
 } BlockHeaderV2;
 
 #define BLOCK_HEADER_SIZE	sizeof(BlockHeader)
 #define BLOCK_HEADERV2_SIZE sizeof(BlockHeaderV2)
 
+/*
+ *	分块压缩的数据块（BLOCK_VERSION_CHK_V2）
+ *	布局为：BlockHeaderV2 + 若干独立压缩的数据块 + 索引(BlockChunkIndex*n) + 尾部(BlockChunkFooter)
+ *	BlockHeaderV2._size为块头后面所有数据的大小，包括索引和尾部
+ *	读取的时候先通过尾部找到索引，再按时间二分查找，只解压需要的数据块
+ */
+typedef struct _BlockChunkIndex
+{
+	uint64_t	_offset;	//压缩数据相对于数据区起始位置的偏移
+	uint64_t	_size;		//压缩后的大小
+	uint32_t	_count;		//记录条数
+	uint32_t	_reserve;
+	uint64_t	_stime;		//第一条记录的时间，tick类为yyyyMMddhhmmssmmm，K线为yyyyMMddhhmm
+	uint64_t	_etime;		//最后一条记录的时间
+} BlockChunkIndex;
+
+typedef struct _BlockChunkFooter
+{
+	uint64_t	_index_offset;	//索引相对于数据区起始位置的偏移
+	uint64_t	_total_count;	//总记录条数
+	uint32_t	_chunk_count;	//数据块个数
+	uint32_t	_chunk_items;	//每个数据块的记录条数，最后一块可能不满
+	uint32_t	_item_size;		//单条记录的大小
+	uint32_t	_reserve;
+	char		_flag[FLAG_SIZE];
+} BlockChunkFooter;
+
 typedef struct _RTBlockHeader : BlockHeader
 {
 	uint32_t _size;
@@ -11,6 +11,7 @@
 #include "../Includes/WTSDataDef.hpp"
 
 #include "../WTSUtils/WTSCmpHelper.hpp"
+#include "ChunkHelper.hpp"
 #include "../WTSUtils/WTSCfgLoader.h"
 
 #include <rapidjson/document.h>
@@ -72,8 +73,20 @@ bool proc_block_data(std::string& content, bool isBar, bool bKeepHead /* = true
 			return false;
 		}
 
+		//新版本结构体不需要转换，块头和解压的数据直接写到最终的缓存里
+		if (!bOldVer)
+		{
+			if (bKeepHead)
+				buffer.append(content.data(), BLOCK_HEADER_SIZE);
+			ChunkHelper::uncompress_append(buffer, blkV2);
+			if (bKeepHead)
+				((BlockHeader*)buffer.data())->_version = BLOCK_VERSION_RAW_V2;
+			content.swap(buffer);
+			return true;
+		}
+
 		//将文件头后面的数据进行解压
-		buffer = WTSCmpHelper::uncompress_data(content.data() + BLOCK_HEADERV2_SIZE, (std::size_t)blkV2->_size);
+		ChunkHelper::uncompress_append(buffer, blkV2);
 	}
 	else
 	{
@@ -135,6 +148,36 @@ bool proc_block_data(std::string& content, bool isBar, bool bKeepHead /* = true
 	return true;
 }
 
+/*
+ *	处理K线块数据，直接解码到bars中
+ *	新版本的压缩数据直接解压到bars的内存里，不再经过中间缓存
+ */
+bool proc_block_data(std::string& content, std::vector<WTSBarStruct>& bars)
+{
+	BlockHeader* header = (BlockHeader*)content.data();
+	if (header->is_compressed() && !header->is_old_version())
+	{
+		BlockHeaderV2* blkV2 = (BlockHeaderV2*)content.c_str();
+		if (content.size() != (sizeof(BlockHeaderV2) + blkV2->_size))
+			return false;
+
+		std::size_t rawSize = ChunkHelper::uncompressed_size(blkV2);
+		if (rawSize % sizeof(WTSBarStruct) != 0)
+			return false;
+
+		bars.resize(rawSize / sizeof(WTSBarStruct));
+		ChunkHelper::uncompress_to(bars.data(), rawSize, blkV2);
+		return true;
+	}
+
+	if (!proc_block_data(content, true, false))
+		return false;
+
+	bars.resize(content.size() / sizeof(WTSBarStruct));
+	memcpy(bars.data(), content.data(), bars.size() * sizeof(WTSBarStruct));
+	return true;
+}
+
 
 WtDataReader::WtDataReader()
 	: _last_time(0)
@@ -382,11 +425,24 @@ WTSTickSlice* WtDataReader::readTickSlice(const char* stdCode, uint32_t count, u
 				return NULL;
 			}
 
-			proc_block_data(tBlkPair._buffer, false, true);			
-			tBlkPair._block = (HisTickBlock*)tBlkPair._buffer.c_str();
+			//分块压缩的文件不整体解压，读取的时候再按需解压
+			const BlockHeaderV2* blkV2 = (const BlockHeaderV2*)tBlkPair._buffer.c_str();
+			if (blkV2->is_chunked() && tBlkPair._buffer.size() == sizeof(BlockHeaderV2) + blkV2->_size && ChunkHelper::footer(blkV2) != NULL)
+			{
+				tBlkPair._chunked = true;
+				tBlkPair._chunks.resize(ChunkHelper::footer(blkV2)->_chunk_count);
+			}
+			else
+			{
+				proc_block_data(tBlkPair._buffer, false, true);
+				tBlkPair._block = (HisTickBlock*)tBlkPair._buffer.c_str();
+			}
 		}
 		
 		HisTBlockPair& tBlkPair = _his_tick_map[key];
+		if (tBlkPair._chunked)
+			return readChunkedTicks(stdCode, tBlkPair, ChunkHelper::item_time(eTick), count);
+
 		if (tBlkPair._block == NULL)
 			return NULL;
 
@@ -417,6 +473,56 @@ WTSTickSlice* WtDataReader::readTickSlice(const char* stdCode, uint32_t count, u
 	}
 }
 
+WTSTickSlice* WtDataReader::readChunkedTicks(const char* stdCode, HisTBlockPair& tBlkPair, uint64_t etime, uint32_t count)
+{
+	const BlockHeaderV2* blkV2 = (const BlockHeaderV2*)tBlkPair._buffer.c_str();
+
+	//从最后一个起始时间小于etime的数据块开始往前读，直到凑够count条
+	typedef std::pair<WTSTickStruct*, uint32_t> TickBlock;
+	std::vector<TickBlock> blocks;
+	uint32_t left = count;
+	bool bLast = true;
+	for (int32_t chunkIdx = ChunkHelper::locate_chunk(blkV2, etime); chunkIdx >= 0 && left > 0; chunkIdx--)
+	{
+		std::string& chunk = tBlkPair._chunks[chunkIdx];
+		if (chunk.empty() && !ChunkHelper::uncompress_chunk(blkV2, chunkIdx, chunk))
+		{
+			pipe_reader_log(_sink, LL_ERROR, "Uncompressing chunk {} of his ticks of {} failed", chunkIdx, stdCode);
+			chunk.clear();
+			break;
+		}
+
+		WTSTickStruct* ticks = (WTSTickStruct*)chunk.data();
+		uint32_t tcnt = (uint32_t)(chunk.size() / sizeof(WTSTickStruct));
+
+		//只有最后一块需要按时间定位，前面的块都在etime之前
+		uint32_t eIdx = tcnt;
+		if (bLast)
+		{
+			eIdx = (uint32_t)(std::lower_bound(ticks, ticks + tcnt, etime, [](const WTSTickStruct& a, uint64_t t) {
+				return ChunkHelper::item_time(a) < t;
+			}) - ticks);
+			bLast = false;
+		}
+
+		uint32_t thisCnt = min(eIdx, left);
+		if (thisCnt == 0)
+			continue;
+
+		blocks.emplace_back(TickBlock(ticks + eIdx - thisCnt, thisCnt));
+		left -= thisCnt;
+	}
+
+	if (blocks.empty())
+		return NULL;
+
+	//blocks是从后往前的，要反过来拼到slice里
+	WTSTickSlice* slice = WTSTickSlice::create(stdCode, blocks.back().first, blocks.back().second);
+	for (auto it = blocks.rbegin() + 1; it != blocks.rend(); it++)
+		slice->appendBlock(it->first, it->second);
+	return slice;
+}
+
 WTSOrdQueSlice* WtDataReader::readOrdQueSlice(const char* stdCode, uint32_t count, uint64_t etime /* = 0 */)
 {
 	CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, _hot_mgr);
@@ -518,13 +624,12 @@ WTSOrdQueSlice* WtDataReader::readOrdQueSlice(const char* stdCode, uint32_t coun
 				return NULL;
 			}
 
-			//需要解压
-			std::string buf = WTSCmpHelper::uncompress_data(tBlockV2->_data, (std::size_t)tBlockV2->_size);
-
-			//将原来的buffer只保留一个头部,并将所有tick数据追加到尾部
-			hisBlkPair._buffer.resize(sizeof(HisOrdQueBlock));
-			hisBlkPair._buffer.append(buf);
-			tBlockV2->_version = BLOCK_VERSION_RAW_V2;
+			//需要解压，先拷贝块头，再直接解压到块头后面，省掉中间缓存和一次拷贝
+			std::string rawBuf;
+			rawBuf.append(hisBlkPair._buffer.data(), sizeof(HisOrdQueBlock));
+			ChunkHelper::uncompress_append(rawBuf, tBlockV2);
+			((HisOrdQueBlock*)rawBuf.data())->_version = BLOCK_VERSION_RAW_V2;
+			hisBlkPair._buffer.swap(rawBuf);
 
 			hisBlkPair._block = (HisOrdQueBlock*)hisBlkPair._buffer.c_str();
 		}
@@ -661,13 +766,12 @@ WTSOrdDtlSlice* WtDataReader::readOrdDtlSlice(const char* stdCode, uint32_t coun
 				return NULL;
 			}
 
-			//需要解压
-			std::string buf = WTSCmpHelper::uncompress_data(tBlockV2->_data, (std::size_t)tBlockV2->_size);
-
-			//将原来的buffer只保留一个头部,并将所有tick数据追加到尾部
-			hisBlkPair._buffer.resize(sizeof(HisOrdDtlBlock));
-			hisBlkPair._buffer.append(buf);
-			tBlockV2->_version = BLOCK_VERSION_RAW_V2;
+			//需要解压，先拷贝块头，再直接解压到块头后面，省掉中间缓存和一次拷贝
+			std::string rawBuf;
+			rawBuf.append(hisBlkPair._buffer.data(), sizeof(HisOrdDtlBlock));
+			ChunkHelper::uncompress_append(rawBuf, tBlockV2);
+			((HisOrdDtlBlock*)rawBuf.data())->_version = BLOCK_VERSION_RAW_V2;
+			hisBlkPair._buffer.swap(rawBuf);
 
 			hisBlkPair._block = (HisOrdDtlBlock*)hisBlkPair._buffer.c_str();
 		}
@@ -804,13 +908,12 @@ WTSTransSlice* WtDataReader::readTransSlice(const char* stdCode, uint32_t count,
 				return NULL;
 			}
 
-			//需要解压
-			std::string buf = WTSCmpHelper::uncompress_data(tBlockV2->_data, (std::size_t)tBlockV2->_size);
-
-			//将原来的buffer只保留一个头部,并将所有tick数据追加到尾部
-			hisBlkPair._buffer.resize(sizeof(HisTransBlock));
-			hisBlkPair._buffer.append(buf);
-			tBlockV2->_version = BLOCK_VERSION_RAW_V2;
+			//需要解压，先拷贝块头，再直接解压到块头后面，省掉中间缓存和一次拷贝
+			std::string rawBuf;
+			rawBuf.append(hisBlkPair._buffer.data(), sizeof(HisTransBlock));
+			ChunkHelper::uncompress_append(rawBuf, tBlockV2);
+			((HisTransBlock*)rawBuf.data())->_version = BLOCK_VERSION_RAW_V2;
+			hisBlkPair._buffer.swap(rawBuf);
 
 			hisBlkPair._block = (HisTransBlock*)hisBlkPair._buffer.c_str();
 		}
@@ -941,16 +1044,16 @@ bool WtDataReader::cacheIntegratedBars(void* codeInfo, const std::string& key, c
 			pipe_reader_log(_sink, LL_ERROR, "历史K线数据文件{}大小校验失败", filename);
 			break;
 		}
-		proc_block_data(content, true, false);
 
-		if (content.empty())
+		hotAy = new std::vector<WTSBarStruct>();
+		if (!proc_block_data(content, *hotAy) || hotAy->empty())
+		{
+			delete hotAy;
+			hotAy = NULL;
 			break;
+		}
 
-		uint32_t barcnt = content.size() / sizeof(WTSBarStruct);
-
-		hotAy = new std::vector<WTSBarStruct>();
-		hotAy->resize(barcnt);
-		memcpy(hotAy->data(), content.data(), content.size());
+		uint32_t barcnt = (uint32_t)hotAy->size();
 
 		if (period != KP_DAY)
 			lastHotTime = hotAy->at(barcnt - 1).time;
@@ -1220,13 +1323,15 @@ bool WtDataReader::cacheAdjustedStkBars(void* codeInfo, const std::string& key,
 			break;
 		}
 
-		proc_block_data(content, true, false);
-
-		uint32_t barcnt = content.size() / sizeof(WTSBarStruct);
-
 		ayAdjusted = new std::vector<WTSBarStruct>();
-		ayAdjusted->resize(barcnt);
-		memcpy(ayAdjusted->data(), content.data(), content.size());
+		if (!proc_block_data(content, *ayAdjusted) || ayAdjusted->empty())
+		{
+			delete ayAdjusted;
+			ayAdjusted = NULL;
+			break;
+		}
+
+		uint32_t barcnt = (uint32_t)ayAdjusted->size();
 
 		if (period != KP_DAY)
 			lastQTime = ayAdjusted->at(barcnt - 1).time;
@@ -116,11 +116,16 @@ private:
 		uint64_t		_date;
 		std::string		_buffer;
 
+		//分块压缩的文件，_buffer保存原始的文件内容，数据块按需解压到_chunks里
+		bool			_chunked;
+		std::vector<std::string>	_chunks;
+
 		_HisTBlockPair()
 		{
 			_block = NULL;
 			_date = 0;
 			_buffer.clear();
+			_chunked = false;
 		}
 	} HisTBlockPair;
 
@@ -199,6 +204,11 @@ private:
 	bool	loadStkAdjFactorsFromFile(const char* adjfile);
 	bool	loadStkAdjFactorsFromLoader();
 
+	/*
+	 *	从分块压缩的历史tick中读取etime之前的count条数据，只解压覆盖到的数据块
+	 */
+	WTSTickSlice*	readChunkedTicks(const char* stdCode, HisTBlockPair& tBlkPair, uint64_t etime, uint32_t count);
+
 public:
 	virtual void init(WTSVariant* cfg, IDataReaderSink* sink, IHisDataLoader* loader = NULL) override;
 
@@ -12,8 +12,10 @@
 
 #include "../Includes/IBaseDataMgr.h"
 #include "../WTSUtils/WTSCmpHelper.hpp"
+#include "ChunkHelper.hpp"
 
 #include <set>
+#include <unordered_map>
 #include <algorithm>
 
 //By Wesley @ 2022.01.05
@@ -72,9 +74,17 @@ WtDataWriter::_TaskInfo::_TaskInfo(const _TaskInfo& rhs)
 	_obj->retain();
 }
 
+WtDataWriter::_TaskInfo::_TaskInfo(_TaskInfo&& rhs)
+	: _type(rhs._type), _flag(rhs._flag)
+{
+	_obj = rhs._obj;
+	rhs._obj = NULL;
+}
+
 WtDataWriter::_TaskInfo::~_TaskInfo() 
 { 
-	_obj->release(); 
+	if (_obj)
+		_obj->release(); 
 }
 
 
@@ -92,6 +102,10 @@ WtDataWriter::WtDataWriter()
 	, _disable_his(false)
 	, _skip_notrade_tick(false)
 	, _skip_notrade_bar(false)
+	, _task_threads(1)
+	, _task_qsize(16384)
+	, _task_spins(10000)
+	, _chunk_items(0)
 {
 }
 
@@ -127,6 +141,14 @@ bool WtDataWriter::init(WTSVariant* params, IDataWriterSink* sink)
 	_async_proc = params->getBoolean("async");
 	_log_group_size = params->getUInt32("groupsize");
 
+	//异步模式的工作线程数，大于1时按合约分片，同一个合约始终由同一个线程处理
+	if (params->has("asyncthreads"))
+		_task_threads = max(params->getUInt32("asyncthreads"), 1U);
+	if (params->has("queuesize"))
+		_task_qsize = max(params->getUInt32("queuesize"), 1024U);
+	if (params->has("spincount"))
+		_task_spins = params->getUInt32("spincount");
+
 	// 没有成交的tick在有些数据源中不会用于更新bar,这里做一下细分
 	// 即便没有成交的tick，但仍然会产生一个bar，价格延续前一个bar，参考快期，万德
 	_skip_notrade_tick = params->getBoolean("skip_notrade_tick");
@@ -147,6 +169,9 @@ bool WtDataWriter::init(WTSVariant* params, IDataWriterSink* sink)
 
 	_min_price_mode = params->getUInt32("minbar_price_mode");
 
+	//历史tick分块压缩的每块条数，0为不分块
+	_chunk_items = params->getUInt32("chunkitems");
+
 	{
 		std::string filename = _base_dir + MARKER_FILE;
 		IniHelper iniHelper;
@@ -159,13 +184,28 @@ bool WtDataWriter::init(WTSVariant* params, IDataWriterSink* sink)
 		}
 	}
 
+	//异步模式下每个工作线程一个分区，同步模式下只有一个分区
+	uint32_t partCnt = _async_proc ? _task_threads : 1;
+	for (uint32_t i = 0; i < partCnt; i++)
+		_partitions.emplace_back(PartitionPtr(new Partition));
+
 	loadCache();
 
 	_proc_chk.reset(new StdThread(boost::bind(&WtDataWriter::check_loop, this)));
 
-	pipe_writer_log(sink, LL_INFO, "WtDataWriter initialized, root dir: {}, save_csv_tick: {}, async_mode: {}, log_group_size: {}, disable_history: {}, "
+	if (_async_proc)
+	{
+		for (uint32_t i = 0; i < _task_threads; i++)
+		{
+			TaskWorkerPtr worker(new TaskWorker(_task_qsize));
+			_task_workers.emplace_back(worker);
+			worker->_thrd.reset(new StdThread(boost::bind(&WtDataWriter::task_loop, this, worker.get())));
+		}
+	}
+
+	pipe_writer_log(sink, LL_INFO, "WtDataWriter initialized, root dir: {}, save_csv_tick: {}, async_mode: {}, async_threads: {}, log_group_size: {}, disable_history: {}, "
 		"disable_tick: {}, disable_min1: {}, disable_min5: {}, disable_day: {}, disable_trans: {}, disable_ordque: {}, disable_orders: {}, min_price_mode: {}", 
-		_base_dir, _save_tick_log, _async_proc, _log_group_size, _disable_his, _disable_tick, 
+		_base_dir, _save_tick_log, _async_proc, _async_proc ? _task_threads : 0, _log_group_size, _disable_his, _disable_tick, 
 		_disable_min1, _disable_min5, _disable_day, _disable_trans, _disable_ordque, _disable_orddtl, _min_price_mode);
 	return true;
 }
@@ -173,40 +213,48 @@ bool WtDataWriter::init(WTSVariant* params, IDataWriterSink* sink)
 void WtDataWriter::release()
 {
 	_terminated = true;
+	for (TaskWorkerPtr& worker : _task_workers)
+	{
+		{
+			StdUniqueLock lock(worker->_mtx);
+			worker->_cond.notify_all();
+		}
+		worker->_thrd->join();
+
+		//工作线程退出以后，把队列里剩下的数据处理完
+		worker->_queue.consume([this](TaskInfo& curTask) { proc_task(curTask); });
+
+		uint64_t fullTimes = worker->_full_times.load(std::memory_order_relaxed);
+		if (fullTimes > 0)
+			pipe_writer_log(_sink, LL_WARN, "Task queue of async worker is full for {} times, consider to enlarge queuesize or asyncthreads", fullTimes);
+	}
+	_task_workers.clear();
+
 	if (_proc_thrd)
 	{
 		_proc_cond.notify_all();
 		_proc_thrd->join();
 	}
 
-	for(auto& v : _rt_ticks_blocks)
+	for (PartitionPtr& part : _partitions)
 	{
-		delete v.second;
-	}
+		for (auto& v : part->_rt_ticks_blocks)
+			delete v.second;
 
-	for (auto& v : _rt_trans_blocks)
-	{
-		delete v.second;
-	}
+		for (auto& v : part->_rt_trans_blocks)
+			delete v.second;
 
-	for (auto& v : _rt_orddtl_blocks)
-	{
-		delete v.second;
-	}
+		for (auto& v : part->_rt_orddtl_blocks)
+			delete v.second;
 
-	for (auto& v : _rt_ordque_blocks)
-	{
-		delete v.second;
-	}
+		for (auto& v : part->_rt_ordque_blocks)
+			delete v.second;
 
-	for (auto& v : _rt_min1_blocks)
-	{
-		delete v.second;
-	}
+		for (auto& v : part->_rt_min1_blocks)
+			delete v.second;
 
-	for (auto& v : _rt_min5_blocks)
-	{
-		delete v.second;
+		for (auto& v : part->_rt_min5_blocks)
+			delete v.second;
 	}
 }
 
@@ -399,8 +447,24 @@ void WtDataWriter::procTick(WTSTickData* curTick, uint32_t procFlag)
 
 		_sink->broadcastTick(curTick);
 
-		static wt_hashmap<std::string, uint64_t> _tcnt_map;
-		uint64_t& cnt = _tcnt_map[curTick->exchg()];
+		//计数器按交易所统计，但是按合约全局索引缓存计数器的地址，每笔tick不用再按交易所代码查找
+		//std::unordered_map的节点地址不会因为插入而变化，所以可以缓存
+		thread_local static std::unordered_map<std::string, uint64_t> _tcnt_map;
+		thread_local static std::vector<uint64_t*> _tcnt_ids;
+		uint32_t cidx = ct->getTotalIndex();
+		uint64_t* pCnt = (cidx < _tcnt_ids.size()) ? _tcnt_ids[cidx] : NULL;
+		if (pCnt == NULL)
+		{
+			pCnt = &_tcnt_map[curTick->exchg()];
+			if (cidx != UINT_MAX)
+			{
+				if (cidx >= _tcnt_ids.size())
+					_tcnt_ids.resize(cidx + 1, NULL);
+				_tcnt_ids[cidx] = pCnt;
+			}
+		}
+
+		uint64_t& cnt = *pCnt;
 		cnt++;
 		if (cnt % _log_group_size == 0)
 		{
@@ -453,7 +517,7 @@ void WtDataWriter::procQueue(WTSOrdQueData* curOrdQue)
 
 		_sink->broadcastOrdQue(curOrdQue);
 
-		static wt_hashmap<std::string, uint64_t> _tcnt_map;
+		thread_local static wt_hashmap<std::string, uint64_t> _tcnt_map;
 		uint64_t& cnt = _tcnt_map[curOrdQue->exchg()];
 		cnt++;
 		if (cnt % _log_group_size == 0)
@@ -507,7 +571,7 @@ void WtDataWriter::procOrder(WTSOrdDtlData* curOrdDtl)
 
 		_sink->broadcastOrdDtl(curOrdDtl);
 
-		static wt_hashmap<std::string, uint64_t> _tcnt_map;
+		thread_local static wt_hashmap<std::string, uint64_t> _tcnt_map;
 		uint64_t& cnt = _tcnt_map[curOrdDtl->exchg()];
 		cnt++;
 		if (cnt % _log_group_size == 0)
@@ -561,7 +625,7 @@ void WtDataWriter::procTrans(WTSTransData* curTrans)
 
 		_sink->broadcastTrans(curTrans);
 
-		static wt_hashmap<std::string, uint64_t> _tcnt_map;
+		thread_local static wt_hashmap<std::string, uint64_t> _tcnt_map;
 		uint64_t& cnt = _tcnt_map[curTrans->exchg()];
 		cnt++;
 		if (cnt % _log_group_size == 0)
@@ -573,47 +637,121 @@ void WtDataWriter::procTrans(WTSTransData* curTrans)
 
 void WtDataWriter::pushTask(const TaskInfo& task)
 {
-	if (!_async_proc)
+	if (!_async_proc || _task_workers.empty())
 		return;
 
-	StdUniqueLock lck(_task_mtx);
-	_tasks.emplace(task);
-	_task_cond.notify_all();
+	//分片模式下按合约分区，保证同一个合约的数据由同一个线程按顺序处理
+	TaskWorker* worker = _task_workers[0].get();
+	if (_task_workers.size() > 1)
+	{
+		WTSContractInfo* ct = NULL;
+		switch (task._type)
+		{
+		case 0: ct = ((WTSTickData*)task._obj)->getContractInfo(); break;
+		case 1: ct = ((WTSOrdQueData*)task._obj)->getContractInfo(); break;
+		case 2: ct = ((WTSOrdDtlData*)task._obj)->getContractInfo(); break;
+		case 3: ct = ((WTSTransData*)task._obj)->getContractInfo(); break;
+		default: break;
+		}
+
+		worker = _task_workers[partition_of(ct)].get();
+	}
 
-	if (_task_thrd == NULL)
+	//队列满了就等工作线程消费，行情数据不能丢
+	if (!worker->_queue.try_emplace(task))
 	{
-		_task_thrd.reset(new StdThread([this]() {
-			while (!_terminated)
-			{
-				if (_tasks.empty())
-				{
-					StdUniqueLock lck(_task_mtx);
-					_task_cond.wait(_task_mtx);
-					continue;
-				}
+		worker->_full_times.fetch_add(1, std::memory_order_relaxed);
+		uint32_t tries = 0;
+		while (!worker->_queue.try_emplace(task))
+		{
+			if (++tries < 64)
+				mpsc_cpu_relax();
+			else
+				std::this_thread::yield();
+		}
+	}
 
-				std::queue<TaskInfo> tempQueue;
-				{
-					StdUniqueLock lck(_task_mtx);
-					tempQueue.swap(_tasks);
-				}
+	//只有工作线程已经挂起了才需要唤醒，正常情况下不碰锁
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (worker->_parked.load(std::memory_order_relaxed))
+	{
+		StdUniqueLock lock(worker->_mtx);
+		worker->_cond.notify_one();
+	}
+}
 
-				while (!tempQueue.empty())
-				{
-					TaskInfo& curTask = tempQueue.front();
-					switch (curTask._type)
-					{
-					case 0: procTick((WTSTickData*)curTask._obj, curTask._flag); break;
-					case 1: procQueue((WTSOrdQueData*)curTask._obj); break;
-					case 2: procOrder((WTSOrdDtlData*)curTask._obj); break;
-					case 3: procTrans((WTSTransData*)curTask._obj); break;
-					default:
-						break;
-					}
-					tempQueue.pop();
-				}
-			}
-		}));
+uint32_t WtDataWriter::partition_of(WTSContractInfo* ct) const
+{
+	if (_partitions.size() <= 1 || ct == NULL)
+		return 0;
+
+	//全局索引是连续分配的，取模以后同一个交易所的合约会均匀分散到各个分区
+	uint32_t cidx = ct->getTotalIndex();
+	if (cidx != UINT_MAX)
+		return cidx % (uint32_t)_partitions.size();
+
+	//BKDRHash，和string_hash一致
+	std::size_t hash = 0;
+	const char* str = ct->getFullCode();
+	while (*str)
+		hash = hash * 131 + (*str++);
+	return (uint32_t)(hash % _partitions.size());
+}
+
+void WtDataWriter::lock_all_caches()
+{
+	for (PartitionPtr& part : _partitions)
+		part->_mtx_cache.lock();
+}
+
+void WtDataWriter::unlock_all_caches()
+{
+	for (auto it = _partitions.rbegin(); it != _partitions.rend(); it++)
+		(*it)->_mtx_cache.unlock();
+}
+
+void WtDataWriter::proc_task(TaskInfo& curTask)
+{
+	switch (curTask._type)
+	{
+	case 0: procTick((WTSTickData*)curTask._obj, curTask._flag); break;
+	case 1: procQueue((WTSOrdQueData*)curTask._obj); break;
+	case 2: procOrder((WTSOrdDtlData*)curTask._obj); break;
+	case 3: procTrans((WTSTransData*)curTask._obj); break;
+	default:
+		break;
+	}
+}
+
+void WtDataWriter::task_loop(TaskWorker* worker)
+{
+	uint32_t idles = 0;
+	while (!_terminated)
+	{
+		uint64_t cnt = worker->_queue.consume([this](TaskInfo& curTask) { proc_task(curTask); }, 1024);
+		if (cnt > 0)
+		{
+			worker->_proc_cnt += cnt;
+			idles = 0;
+			continue;
+		}
+
+		//先自旋一段时间，行情密集的时候可以避免频繁挂起和唤醒
+		if (idles < _task_spins)
+		{
+			idles++;
+			mpsc_cpu_relax();
+			continue;
+		}
+
+		//挂起前要再检查一次队列，和pushTask里的检查配合，避免漏掉唤醒
+		StdUniqueLock lock(worker->_mtx);
+		worker->_parked.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (worker->_queue.empty() && !_terminated)
+			worker->_cond.wait_for(lock, std::chrono::milliseconds(100));
+		worker->_parked.store(false, std::memory_order_relaxed);
+		idles = 0;
 	}
 }
 
@@ -668,11 +806,15 @@ WtDataWriter::OrdQueBlockPair* WtDataWriter::getOrdQueBlock(WTSContractInfo* ct,
 
 	OrdQueBlockPair* pBlock = NULL;
 	const char* key = ct->getFullCode();
-	pBlock = _rt_ordque_blocks[key];
-	if(pBlock == NULL)
 	{
-		pBlock = new OrdQueBlockPair();
-		_rt_ordque_blocks[key] = pBlock;
+		Partition* part = _partitions[partition_of(ct)].get();
+		SpinLock lock(part->_mtx_blocks);
+		pBlock = part->_rt_ordque_blocks[key];
+		if (pBlock == NULL)
+		{
+			pBlock = new OrdQueBlockPair();
+			part->_rt_ordque_blocks[key] = pBlock;
+		}
 	}
 
 	if (pBlock->_block == NULL)
@@ -762,11 +904,15 @@ WtDataWriter::OrdDtlBlockPair* WtDataWriter::getOrdDtlBlock(WTSContractInfo* ct,
 
 	OrdDtlBlockPair* pBlock = NULL;
 	const char* key = ct->getFullCode();
-	pBlock = _rt_orddtl_blocks[key];
-	if (pBlock == NULL)
 	{
-		pBlock = new OrdDtlBlockPair();
-		_rt_orddtl_blocks[key] = pBlock;
+		Partition* part = _partitions[partition_of(ct)].get();
+		SpinLock lock(part->_mtx_blocks);
+		pBlock = part->_rt_orddtl_blocks[key];
+		if (pBlock == NULL)
+		{
+			pBlock = new OrdDtlBlockPair();
+			part->_rt_orddtl_blocks[key] = pBlock;
+		}
 	}
 
 	if (pBlock->_block == NULL)
@@ -857,11 +1003,15 @@ WtDataWriter::TransBlockPair* WtDataWriter::getTransBlock(WTSContractInfo* ct, u
 
 	TransBlockPair* pBlock = NULL;
 	const char* key = ct->getFullCode();
-	pBlock = _rt_trans_blocks[key];
-	if (pBlock == NULL)
 	{
-		pBlock = new TransBlockPair();
-		_rt_trans_blocks[key] = pBlock;
+		Partition* part = _partitions[partition_of(ct)].get();
+		SpinLock lock(part->_mtx_blocks);
+		pBlock = part->_rt_trans_blocks[key];
+		if (pBlock == NULL)
+		{
+			pBlock = new TransBlockPair();
+			part->_rt_trans_blocks[key] = pBlock;
+		}
 	}
 
 	if (pBlock->_block == NULL)
@@ -952,11 +1102,15 @@ WtDataWriter::TickBlockPair* WtDataWriter::getTickBlock(WTSContractInfo* ct, uin
 
 	TickBlockPair* pBlock = NULL;
 	const char* key = ct->getFullCode();
-	pBlock = _rt_ticks_blocks[key];
-	if (pBlock == NULL)
 	{
-		pBlock = new TickBlockPair();
-		_rt_ticks_blocks[key] = pBlock;
+		Partition* part = _partitions[partition_of(ct)].get();
+		SpinLock lock(part->_mtx_blocks);
+		pBlock = part->_rt_ticks_blocks[key];
+		if (pBlock == NULL)
+		{
+			pBlock = new TickBlockPair();
+			part->_rt_ticks_blocks[key] = pBlock;
+		}
 	}
 
 	if(pBlock->_block == NULL)
@@ -1315,18 +1469,19 @@ WtDataWriter::KBlockPair* WtDataWriter::getKlineBlock(WTSContractInfo* ct, WTSKl
 	//读取交易的分钟数
 	uint32_t totalMins = ct->getCommInfo()->getSessionInfo()->getTradingMins();
 
+	Partition* part = _partitions[partition_of(ct)].get();
 	KBlockFilesMap* cache_map = NULL;
 	std::string subdir = "";
 	BlockType bType;
 	switch(period)
 	{
 	case KP_Minute1: 
-		cache_map = &_rt_min1_blocks; 
+		cache_map = &part->_rt_min1_blocks; 
 		subdir = "min1";
 		bType = BT_RT_Minute1;
 		break;
 	case KP_Minute5: 
-		cache_map = &_rt_min5_blocks;
+		cache_map = &part->_rt_min5_blocks;
 		subdir = "min5";
 		bType = BT_RT_Minute5;
 		totalMins /= 5;	//如果是5分钟线，要除以5
@@ -1337,11 +1492,14 @@ WtDataWriter::KBlockPair* WtDataWriter::getKlineBlock(WTSContractInfo* ct, WTSKl
 	if (cache_map == NULL)
 		return NULL;
 
-	pBlock = (*cache_map)[key];
-	if (pBlock == NULL)
 	{
-		pBlock = new KBlockPair();
-		(*cache_map)[key] = pBlock;
+		SpinLock lock(part->_mtx_blocks);
+		pBlock = (*cache_map)[key];
+		if (pBlock == NULL)
+		{
+			pBlock = new KBlockPair();
+			(*cache_map)[key] = pBlock;
+		}
 	}
 
 	if (pBlock->_block == NULL)
@@ -1421,7 +1579,8 @@ WTSTickData* WtDataWriter::getCurTick(const char* code, const char* exchg/* = ""
 		return NULL;
 
 	const char* key = ct->getFullCode();
-	SpinLock lock(_lck_tick_cache);
+	//只读索引，锁住本分区就够了，修改索引的时候会锁住所有分区
+	SpinLock lock(_partitions[partition_of(ct)]->_mtx_cache);
 	auto it = _tick_cache_idx.find(key);
 	if (it == _tick_cache_idx.end())
 		return NULL;
@@ -1439,27 +1598,53 @@ bool WtDataWriter::updateCache(WTSContractInfo* ct, WTSTickData* curTick, uint32
 		return false;
 	}
 
-	SpinLock lock(_lck_tick_cache);
-	const char* key = ct->getFullCode();
-	uint32_t idx = 0;
-	auto it = _tick_cache_idx.find(key);
-	if (it == _tick_cache_idx.end())
+	//先按合约全局索引找，已经分配过槽位的只锁本分区，槽位只会被本分区的线程修改
+	uint32_t cidx = ct->getTotalIndex();
 	{
-		idx = _tick_cache_block->_size;
-		_tick_cache_idx[key] = _tick_cache_block->_size;
-		_tick_cache_block->_size += 1;
-		if(_tick_cache_block->_size >= _tick_cache_block->_capacity)
-		{
-			_tick_cache_block = (RTTickCache*)resizeRTBlock<RTTickCache, TickCacheItem>(_tick_cache_file, _tick_cache_block->_capacity + CACHE_SIZE_STEP);
-			pipe_writer_log(_sink, LL_INFO, "Tick Cache resized to {} items", _tick_cache_block->_capacity);
-		}
+		SpinLock lock(_partitions[partition_of(ct)]->_mtx_cache);
+		uint32_t idx = (cidx < _tick_cache_ids.size()) ? _tick_cache_ids[cidx] : UINT_MAX;
+		if (idx != UINT_MAX)
+			return updateCacheItem(ct, curTick, procFlag, idx);
 	}
-	else
+
+	//找不到再按代码找，找到以后记到平铺数组里
+	//分配新槽位可能会扩容重新映射缓存文件，要锁住所有分区
+	lock_all_caches();
+	uint32_t idx = UINT_MAX;
 	{
-		idx = it->second;
+		const char* key = ct->getFullCode();
+		auto it = _tick_cache_idx.find(key);
+		if (it == _tick_cache_idx.end())
+		{
+			idx = _tick_cache_block->_size;
+			_tick_cache_idx[key] = _tick_cache_block->_size;
+			_tick_cache_block->_size += 1;
+			if (_tick_cache_block->_size >= _tick_cache_block->_capacity)
+			{
+				_tick_cache_block = (RTTickCache*)resizeRTBlock<RTTickCache, TickCacheItem>(_tick_cache_file, _tick_cache_block->_capacity + CACHE_SIZE_STEP);
+				pipe_writer_log(_sink, LL_INFO, "Tick Cache resized to {} items", _tick_cache_block->_capacity);
+			}
+		}
+		else
+		{
+			idx = it->second;
+		}
+
+		if (cidx != UINT_MAX)
+		{
+			if (cidx >= _tick_cache_ids.size())
+				_tick_cache_ids.resize(std::max(cidx + 1, _bd_mgr->getIndexedContracts()), UINT_MAX);
+			_tick_cache_ids[cidx] = idx;
+		}
 	}
 
+	bool bRet = updateCacheItem(ct, curTick, procFlag, idx);
+	unlock_all_caches();
+	return bRet;
+}
 
+bool WtDataWriter::updateCacheItem(WTSContractInfo* ct, WTSTickData* curTick, uint32_t procFlag, uint32_t idx)
+{
 	TickCacheItem& item = _tick_cache_block->_ticks[idx];
 	if (curTick->tradingdate() < item._date)
 	{
@@ -1599,69 +1784,74 @@ void WtDataWriter::check_loop()
 			break;
 
 		uint64_t now = TimeUtils::getLocalTimeNow() / 1000;
-		for (auto it = _rt_ticks_blocks.begin(); it != _rt_ticks_blocks.end(); it++)
+		for (PartitionPtr& part : _partitions)
 		{
-			const char* key = it->first.c_str();
-			TickBlockPair* tBlk = (TickBlockPair*)it->second;
-			if (tBlk->_lasttime != 0 && (now - tBlk->_lasttime > expire_secs))
+			//只会和本分区的工作线程争锁
+			SpinLock lock(part->_mtx_blocks);
+			for (auto it = part->_rt_ticks_blocks.begin(); it != part->_rt_ticks_blocks.end(); it++)
 			{
-				pipe_writer_log(_sink, LL_INFO, "tick cache of {} mapping expired, automatically closed", key);
-				releaseBlock<TickBlockPair>(tBlk);
+				const char* key = it->first.c_str();
+				TickBlockPair* tBlk = (TickBlockPair*)it->second;
+				if (tBlk->_lasttime != 0 && (now - tBlk->_lasttime > expire_secs))
+				{
+					pipe_writer_log(_sink, LL_INFO, "tick cache of {} mapping expired, automatically closed", key);
+					releaseBlock<TickBlockPair>(tBlk);
+				}
 			}
-		}
 
-		for (auto it = _rt_trans_blocks.begin(); it != _rt_trans_blocks.end(); it++)
-		{
-			const char* key = it->first.c_str();
-			TransBlockPair* tBlk = (TransBlockPair*)it->second;
-			if (tBlk->_lasttime != 0 && (now - tBlk->_lasttime > expire_secs))
+			for (auto it = part->_rt_trans_blocks.begin(); it != part->_rt_trans_blocks.end(); it++)
 			{
-				pipe_writer_log(_sink, LL_INFO, "trans cache o {} mapping expired, automatically closed", key);
-				releaseBlock<TransBlockPair>(tBlk);
+				const char* key = it->first.c_str();
+				TransBlockPair* tBlk = (TransBlockPair*)it->second;
+				if (tBlk->_lasttime != 0 && (now - tBlk->_lasttime > expire_secs))
+				{
+					pipe_writer_log(_sink, LL_INFO, "trans cache o {} mapping expired, automatically closed", key);
+					releaseBlock<TransBlockPair>(tBlk);
+				}
 			}
-		}
 
-		for (auto it = _rt_orddtl_blocks.begin(); it != _rt_orddtl_blocks.end(); it++)
-		{
-			const char* key = it->first.c_str();
-			OrdDtlBlockPair* tBlk = (OrdDtlBlockPair*)it->second;
-			if (tBlk->_lasttime != 0 && (now - tBlk->_lasttime > expire_secs))
+			for (auto it = part->_rt_orddtl_blocks.begin(); it != part->_rt_orddtl_blocks.end(); it++)
 			{
-				pipe_writer_log(_sink, LL_INFO, "order cache of {} mapping expired, automatically closed", key);
-				releaseBlock<OrdDtlBlockPair>(tBlk);
+				const char* key = it->first.c_str();
+				OrdDtlBlockPair* tBlk = (OrdDtlBlockPair*)it->second;
+				if (tBlk->_lasttime != 0 && (now - tBlk->_lasttime > expire_secs))
+				{
+					pipe_writer_log(_sink, LL_INFO, "order cache of {} mapping expired, automatically closed", key);
+					releaseBlock<OrdDtlBlockPair>(tBlk);
+				}
 			}
-		}
 
-		for (auto& v : _rt_ordque_blocks)
-		{
-			const char* key = v.first.c_str();
-			OrdQueBlockPair* tBlk = (OrdQueBlockPair*)v.second;
-			if (tBlk->_lasttime != 0 && (now - tBlk->_lasttime > expire_secs))
+			for (auto& v : part->_rt_ordque_blocks)
 			{
-				pipe_writer_log(_sink, LL_INFO, "queue cache of {} mapping expired, automatically closed", key);
-				releaseBlock<OrdQueBlockPair>(tBlk);
+				const char* key = v.first.c_str();
+				OrdQueBlockPair* tBlk = (OrdQueBlockPair*)v.second;
+				if (tBlk->_lasttime != 0 && (now - tBlk->_lasttime > expire_secs))
+				{
+					pipe_writer_log(_sink, LL_INFO, "queue cache of {} mapping expired, automatically closed", key);
+					releaseBlock<OrdQueBlockPair>(tBlk);
+				}
 			}
-		}
 
-		for (auto it = _rt_min1_blocks.begin(); it != _rt_min1_blocks.end(); it++)
-		{
-			const char* key = it->first.c_str();
-			KBlockPair* kBlk = (KBlockPair*)it->second;
-			if (kBlk->_lasttime != 0 && (now - kBlk->_lasttime > expire_secs))
+			for (auto it = part->_rt_min1_blocks.begin(); it != part->_rt_min1_blocks.end(); it++)
 			{
-				pipe_writer_log(_sink, LL_INFO, "min1 cache of {} mapping expired, automatically closed", key);
-				releaseBlock<KBlockPair>(kBlk);
+				const char* key = it->first.c_str();
+				KBlockPair* kBlk = (KBlockPair*)it->second;
+				if (kBlk->_lasttime != 0 && (now - kBlk->_lasttime > expire_secs))
+				{
+					pipe_writer_log(_sink, LL_INFO, "min1 cache of {} mapping expired, automatically closed", key);
+					releaseBlock<KBlockPair>(kBlk);
+				}
 			}
-		}
 
-		for (auto it = _rt_min5_blocks.begin(); it != _rt_min5_blocks.end(); it++)
-		{
-			const char* key = it->first.c_str();
-			KBlockPair* kBlk = (KBlockPair*)it->second;
-			if (kBlk->_lasttime != 0 && (now - kBlk->_lasttime > expire_secs))
+			for (auto it = part->_rt_min5_blocks.begin(); it != part->_rt_min5_blocks.end(); it++)
 			{
-				pipe_writer_log(_sink, LL_INFO, "min5 cache of {} mapping expired, automatically closed", key);
-				releaseBlock<KBlockPair>(kBlk);
+				const char* key = it->first.c_str();
+				KBlockPair* kBlk = (KBlockPair*)it->second;
+				if (kBlk->_lasttime != 0 && (now - kBlk->_lasttime > expire_secs))
+				{
+					pipe_writer_log(_sink, LL_INFO, "min5 cache of {} mapping expired, automatically closed", key);
+					releaseBlock<KBlockPair>(kBlk);
+				}
 			}
 		}
 	}
@@ -1801,7 +1991,7 @@ bool WtDataWriter::proc_block_data(const char* tag, std::string& content, bool i
 		}
 
 		//将文件头后面的数据进行解压
-		buffer = WTSCmpHelper::uncompress_data(content.data() + BLOCK_HEADERV2_SIZE, (std::size_t)blkV2->_size);
+		ChunkHelper::uncompress_append(buffer, blkV2);
 	}
 	else
 	{
@@ -2163,8 +2353,8 @@ void WtDataWriter::proc_loop()
 
 		if (fullcode.compare(CMD_CLEAR_CACHE) == 0)
 		{
-			//清理缓存
-			SpinLock lock(_lck_tick_cache);
+			//清理缓存，要重建索引和缓存文件，锁住所有分区
+			lock_all_caches();
 
 			std::set<std::string> setCodes;
 			std::stringstream ss_snapshot;
@@ -2242,8 +2432,9 @@ void WtDataWriter::proc_loop()
 					newIdx++;
 				}
 
-				//索引替换
+				//索引替换，平铺数组里的位置都失效了，清空以后按需重建
 				_tick_cache_idx = newIdxMap;
+				_tick_cache_ids.clear();
 				_tick_cache_file->close();
 				_tick_cache_block = NULL;
 
@@ -2260,6 +2451,7 @@ void WtDataWriter::proc_loop()
 				
 				pipe_writer_log(_sink, LL_INFO, "{} expired cache cleared totally", diff);
 			}
+			unlock_all_caches();
 
 			//将当日的日线快照落地到一个快照文件
 			{
@@ -2381,13 +2573,17 @@ void WtDataWriter::proc_loop()
 							BoostFile f;
 							if (f.create_new_file(filename.c_str()))
 							{
-								//先压缩数据
-								std::string cmp_data = WTSCmpHelper::compress_data(tBlkPair->_block->_ticks, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
+								//先压缩数据，设置了分块大小则按分块格式压缩，读取时可以只解压需要的数据块
+								std::string cmp_data;
+								if (_chunk_items > 0)
+									cmp_data = ChunkHelper::compress_chunks(tBlkPair->_block->_ticks, tBlkPair->_block->_size, _chunk_items);
+								else
+									cmp_data = WTSCmpHelper::compress_data(tBlkPair->_block->_ticks, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
 
 								BlockHeaderV2 header;
 								strcpy(header._blk_flag, BLK_FLAG);
 								header._type = BT_HIS_Ticks;
-								header._version = BLOCK_VERSION_CMP_V2;
+								header._version = (_chunk_items > 0) ? BLOCK_VERSION_CHK_V2 : BLOCK_VERSION_CMP_V2;
 								header._size = cmp_data.size();
 								f.write_file(&header, sizeof(header));
 
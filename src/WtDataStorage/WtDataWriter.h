@@ -6,9 +6,11 @@
 #include "../Share/StdUtils.hpp"
 #include "../Share/BoostMappingFile.hpp"
 #include "../Share/SpinMutex.hpp"
+#include "../Share/MpscQueue.hpp"
 
 #include <queue>
 #include <map>
+#include <atomic>
 
 typedef std::shared_ptr<BoostMappingFile> BoostMFPtr;
 
@@ -153,16 +155,28 @@ private:
 	typedef wt_hashmap<std::string, OrdQueBlockPair*>	OrdQueBlockFilesMap;
 	
 
-	KBlockFilesMap	_rt_min1_blocks;
-	KBlockFilesMap	_rt_min5_blocks;
+	/*
+	 *	按合约分区，每个分区有自己的数据块索引和tick缓存锁
+	 *	异步模式下分区数和工作线程数相同，一个分区只由一个工作线程处理，各个分区的锁之间没有竞争
+	 */
+	typedef struct alignas(64) _Partition
+	{
+		SpinMutex		_mtx_blocks;	//保护本分区的数据块索引，只有本分区和检查线程会用到
+		SpinMutex		_mtx_cache;		//tick缓存锁，分配新槽位、扩容或者重建缓存时要锁住所有分区
 
-	TickBlockFilesMap	_rt_ticks_blocks;
-	TransBlockFilesMap	_rt_trans_blocks;
-	OrdDtlBlockFilesMap _rt_orddtl_blocks;
-	OrdQueBlockFilesMap _rt_ordque_blocks;
+		KBlockFilesMap	_rt_min1_blocks;
+		KBlockFilesMap	_rt_min5_blocks;
+
+		TickBlockFilesMap	_rt_ticks_blocks;
+		TransBlockFilesMap	_rt_trans_blocks;
+		OrdDtlBlockFilesMap _rt_orddtl_blocks;
+		OrdQueBlockFilesMap _rt_ordque_blocks;
+	} Partition;
+	typedef std::shared_ptr<Partition> PartitionPtr;
+	std::vector<PartitionPtr>	_partitions;
 
-	SpinMutex		_lck_tick_cache;
 	wt_hashmap<std::string, uint32_t> _tick_cache_idx;
+	std::vector<uint32_t>	_tick_cache_ids;	//按合约全局索引平铺的缓存位置，UINT_MAX表示还没有查过
 	BoostMFPtr		_tick_cache_file;
 	RTTickCache*	_tick_cache_block;
 
@@ -177,13 +191,35 @@ private:
 
 		_TaskInfo(const _TaskInfo& rhs);
 
+		_TaskInfo(_TaskInfo&& rhs);
+
 		~_TaskInfo();
 
 	} TaskInfo;
-	std::queue<TaskInfo>	_tasks;
-	StdThreadPtr			_task_thrd;
-	StdUniqueMutex			_task_mtx;
-	StdCondVariable			_task_cond;
+
+	/*
+	 *	异步处理的工作线程
+	 *	每个工作线程一个无锁多写单读队列，解析器线程直接写队列不再争锁
+	 *	工作线程先自旋，一段时间没有数据再挂起，挂起以后写线程才需要唤醒
+	 */
+	typedef MpscQueue<TaskInfo> TaskQueue;
+	typedef struct _TaskWorker
+	{
+		TaskQueue			_queue;
+		StdThreadPtr		_thrd;
+		StdUniqueMutex		_mtx;
+		StdCondVariable		_cond;
+		std::atomic<bool>	_parked;
+		std::atomic<uint64_t>	_full_times;	//队列满的次数
+		uint64_t			_proc_cnt;
+
+		_TaskWorker(uint64_t qSize) :_queue(qSize), _parked(false), _full_times(0), _proc_cnt(0){}
+	} TaskWorker;
+	typedef std::shared_ptr<TaskWorker> TaskWorkerPtr;
+	std::vector<TaskWorkerPtr>	_task_workers;
+	uint32_t		_task_threads;		//异步处理的线程数，大于1时按合约分片
+	uint32_t		_task_qsize;		//每个工作线程的队列大小
+	uint32_t		_task_spins;		//工作线程挂起前的空转次数
 
 	std::string		_base_dir;
 	std::string		_cache_file;
@@ -216,6 +252,8 @@ private:
 	 *	分钟线价格模式，0-常规模式，1-将买卖价也记录下来，这个设计时只针对期权这种不活跃的品种
 	 */
 	uint32_t		_min_price_mode;
+
+	uint32_t		_chunk_items;	//历史tick分块压缩的每块条数，0为不分块
 	
 	std::map<std::string, uint32_t> _proc_date;
 
@@ -224,6 +262,19 @@ private:
 
 	bool updateCache(WTSContractInfo* ct, WTSTickData* curTick, uint32_t procFlag);
 
+	bool updateCacheItem(WTSContractInfo* ct, WTSTickData* curTick, uint32_t procFlag, uint32_t idx);
+
+	/*
+	 *	合约所在的分区，有全局索引的按索引取模，没有的按代码做hash
+	 */
+	uint32_t partition_of(WTSContractInfo* ct) const;
+
+	/*
+	 *	按顺序锁住所有分区的tick缓存锁
+	 */
+	void lock_all_caches();
+	void unlock_all_caches();
+
 	void pipeToTicks(WTSContractInfo* ct, WTSTickData* curTick);
 
 	void pipeToKlines(WTSContractInfo* ct, WTSTickData* curTick);
@@ -239,5 +290,9 @@ private:
 	void	releaseBlock(T* block);
 
 	void pushTask(const TaskInfo& task);
+
+	void task_loop(TaskWorker* worker);
+
+	void proc_task(TaskInfo& curTask);
 };
 
@@ -12,6 +12,7 @@
 #include "../Includes/WTSSessionInfo.hpp"
 
 #include "../WTSUtils/WTSCmpHelper.hpp"
+#include "ChunkHelper.hpp"
 #include "../WTSUtils/WTSCfgLoader.h"
 
 #include <rapidjson/document.h>
@@ -50,6 +51,7 @@ extern "C"
  *	处理块数据
  */
 extern bool proc_block_data(std::string& content, bool isBar, bool bKeepHead = true);
+extern bool proc_block_data(std::string& content, std::vector<WTSBarStruct>& bars);
 
 WtRdmDtReader::WtRdmDtReader()
 	: _base_data_mgr(NULL)
@@ -84,6 +86,14 @@ void WtRdmDtReader::init(WTSVariant* cfg, IRdmDtReaderSink* sink)
 	if (!bAdjLoaded && cfg->has("adjfactor"))
 		loadStkAdjFactorsFromFile(cfg->getCString("adjfactor"));
 
+	//历史数据缓存的容量，单位MB，0为不限制
+	uint32_t cacheSize = cfg->getUInt32("cachesize");
+	if (cacheSize > 0)
+	{
+		_data_cache.set_budget((uint64_t)cacheSize * 1024 * 1024);
+		pipe_rdmreader_log(_sink, LL_INFO, "Cache size of history data limited to {} MB", cacheSize);
+	}
+
 	_thrd_check.reset(new StdThread([this]() {
 		while(!_stopped)
 		{
@@ -264,10 +274,10 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByDate(const char* stdCode, uint32_t u
 			}
 		}
 
-		std::string key = fmt::format("{}-{}", stdCode, uDate);
+		std::string key = fmt::format("ticks/{}-{}", stdCode, uDate);
 
-		auto it = _his_tick_map.find(key);
-		bool bHasHisTick = (it != _his_tick_map.end());
+		HisTBlockPtr tBlkPair = _data_cache.get<HisTBlockPair>(key);
+		bool bHasHisTick = (tBlkPair != NULL);
 		if (!bHasHisTick)
 		{
 			for (;;)
@@ -296,17 +306,18 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByDate(const char* stdCode, uint32_t u
 					}
 				}
 
-				HisTBlockPair& tBlkPair = _his_tick_map[key];
-				StdFile::read_file_content(filename.c_str(), tBlkPair._buffer);
-				if (tBlkPair._buffer.size() < sizeof(HisTickBlock))
+				tBlkPair.reset(new HisTBlockPair());
+				StdFile::read_file_content(filename.c_str(), tBlkPair->_buffer);
+				if (tBlkPair->_buffer.size() < sizeof(HisTickBlock))
 				{
 					pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of tick data file {} failed", filename.c_str());
-					tBlkPair._buffer.clear();
+					tBlkPair.reset();
 					break;
 				}
 
-				proc_block_data(tBlkPair._buffer, false, true);
-				tBlkPair._block = (HisTickBlock*)tBlkPair._buffer.c_str();
+				proc_block_data(tBlkPair->_buffer, false, true);
+				tBlkPair->_block = (HisTickBlock*)tBlkPair->_buffer.c_str();
+				_data_cache.put(key, tBlkPair, tBlkPair->_buffer.size());
 				bHasHisTick = true;
 				break;
 			}
@@ -314,17 +325,17 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByDate(const char* stdCode, uint32_t u
 
 		while (bHasHisTick)
 		{
-			HisTBlockPair& tBlkPair = _his_tick_map[key];
-			if (tBlkPair._block == NULL)
+			if (tBlkPair->_block == NULL)
 				break;
 
-			HisTickBlock* tBlock = tBlkPair._block;
+			HisTickBlock* tBlock = tBlkPair->_block;
 
-			uint32_t tcnt = (tBlkPair._buffer.size() - sizeof(HisTickBlock)) / sizeof(WTSTickStruct);
+			uint32_t tcnt = (tBlkPair->_buffer.size() - sizeof(HisTickBlock)) / sizeof(WTSTickStruct);
 			if (tcnt <= 0)
 				break;
 
 			WTSTickSlice* slice = WTSTickSlice::create(stdCode, tBlock->_ticks, tcnt);
+			slice->holdBuffer(tBlkPair);
 			return slice;
 
 			break;
@@ -413,10 +424,10 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByRange(const char* stdCode, uint64_t
 			}
 		}
 		
-		std::string key = fmt::format("{}-{}", stdCode, nowTDate);
+		std::string key = fmt::format("ticks/{}-{}", stdCode, nowTDate);
 
-		auto it = _his_tick_map.find(key);
-		bool bHasHisTick = (it != _his_tick_map.end());
+		HisTBlockPtr tBlkPair = _data_cache.get<HisTBlockPair>(key);
+		bool bHasHisTick = (tBlkPair != NULL);
 		if(!bHasHisTick)
 		{
 			for(;;)
@@ -446,17 +457,18 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByRange(const char* stdCode, uint64_t
 					}
 				}
 
-				HisTBlockPair& tBlkPair = _his_tick_map[key];
-				StdFile::read_file_content(filename.c_str(), tBlkPair._buffer);
-				if (tBlkPair._buffer.size() < sizeof(HisTickBlock))
+				tBlkPair.reset(new HisTBlockPair());
+				StdFile::read_file_content(filename.c_str(), tBlkPair->_buffer);
+				if (tBlkPair->_buffer.size() < sizeof(HisTickBlock))
 				{
 					pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of tick data file {} failed", filename.c_str());
-					tBlkPair._buffer.clear();
+					tBlkPair.reset();
 					break;
 				}
 
-				proc_block_data(tBlkPair._buffer, false, true);
-				tBlkPair._block = (HisTickBlock*)tBlkPair._buffer.c_str();
+				proc_block_data(tBlkPair->_buffer, false, true);
+				tBlkPair->_block = (HisTickBlock*)tBlkPair->_buffer.c_str();
+				_data_cache.put(key, tBlkPair, tBlkPair->_buffer.size());
 				bHasHisTick = true;
 				break;
 			}
@@ -477,13 +489,12 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByRange(const char* stdCode, uint64_t
 				eTick.action_time = sInfo->getCloseTime() * 100000 + 59999;
 			}
 
-			HisTBlockPair& tBlkPair = _his_tick_map[key];
-			if (tBlkPair._block == NULL)
+			if (tBlkPair->_block == NULL)
 				break;
 
-			HisTickBlock* tBlock = tBlkPair._block;
+			HisTickBlock* tBlock = tBlkPair->_block;
 
-			uint32_t tcnt = (tBlkPair._buffer.size() - sizeof(HisTickBlock)) / sizeof(WTSTickStruct);
+			uint32_t tcnt = (tBlkPair->_buffer.size() - sizeof(HisTickBlock)) / sizeof(WTSTickStruct);
 			if (tcnt <= 0)
 				break;
 
@@ -501,6 +512,8 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByRange(const char* stdCode, uint64_t
 				eIdx--;
 			}
 
+			slice->holdBuffer(tBlkPair);
+
 			if (beginTDate != nowTDate)
 			{
 				//如果开始的交易日和当前的交易日不一致，则返回全部的tick数据
@@ -690,10 +703,10 @@ WTSOrdQueSlice* WtRdmDtReader::readOrdQueSliceByRange(const char* stdCode, uint6
 	}
 	else
 	{
-		std::string key = fmt::format("{}-{}", stdCode, endTDate);
+		std::string key = fmt::format("queue/{}-{}", stdCode, endTDate);
 
-		auto it = _his_ordque_map.find(key);
-		if (it == _his_ordque_map.end())
+		HisOrdQueBlockPtr tBlkPair = _data_cache.get<HisOrdQueBlockPair>(key);
+		if (tBlkPair == NULL)
 		{
 			std::stringstream ss;
 			ss << _base_dir << "his/queue/" << cInfo._exchg << "/" << endTDate << "/" << curCode << ".dsb";
@@ -701,41 +714,40 @@ WTSOrdQueSlice* WtRdmDtReader::readOrdQueSliceByRange(const char* stdCode, uint6
 			if (!StdFile::exists(filename.c_str()))
 				return NULL;
 
-			HisOrdQueBlockPair& hisBlkPair = _his_ordque_map[key];
-			StdFile::read_file_content(filename.c_str(), hisBlkPair._buffer);
-			if (hisBlkPair._buffer.size() < sizeof(HisOrdQueBlockV2))
+			HisOrdQueBlockPtr hisBlkPair(new HisOrdQueBlockPair());
+			StdFile::read_file_content(filename.c_str(), hisBlkPair->_buffer);
+			if (hisBlkPair->_buffer.size() < sizeof(HisOrdQueBlockV2))
 			{
 				pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of orderqueue data file {} failed", filename.c_str());
-				hisBlkPair._buffer.clear();
 				return NULL;
 			}
 
-			HisOrdQueBlockV2* tBlockV2 = (HisOrdQueBlockV2*)hisBlkPair._buffer.c_str();
+			HisOrdQueBlockV2* tBlockV2 = (HisOrdQueBlockV2*)hisBlkPair->_buffer.c_str();
 
-			if (hisBlkPair._buffer.size() != (sizeof(HisOrdQueBlockV2) + tBlockV2->_size))
+			if (hisBlkPair->_buffer.size() != (sizeof(HisOrdQueBlockV2) + tBlockV2->_size))
 			{
 				pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of orderqueue data file {} failed", filename.c_str());
 				return NULL;
 			}
 
-			//需要解压
-			std::string buf = WTSCmpHelper::uncompress_data(tBlockV2->_data, (std::size_t)tBlockV2->_size);
+			//需要解压，先拷贝块头，再直接解压到块头后面，省掉中间缓存和一次拷贝
+			std::string rawBuf;
+			rawBuf.append(hisBlkPair->_buffer.data(), sizeof(HisOrdQueBlock));
+			ChunkHelper::uncompress_append(rawBuf, tBlockV2);
+			((HisOrdQueBlock*)rawBuf.data())->_version = BLOCK_VERSION_RAW_V2;
+			hisBlkPair->_buffer.swap(rawBuf);
 
-			//将原来的buffer只保留一个头部,并将所有tick数据追加到尾部
-			hisBlkPair._buffer.resize(sizeof(HisOrdQueBlock));
-			hisBlkPair._buffer.append(buf);
-			tBlockV2->_version = BLOCK_VERSION_RAW;
-
-			hisBlkPair._block = (HisOrdQueBlock*)hisBlkPair._buffer.c_str();
+			hisBlkPair->_block = (HisOrdQueBlock*)hisBlkPair->_buffer.c_str();
+			_data_cache.put(key, hisBlkPair, hisBlkPair->_buffer.size());
+			tBlkPair = hisBlkPair;
 		}
 
-		HisOrdQueBlockPair& tBlkPair = _his_ordque_map[key];
-		if (tBlkPair._block == NULL)
+		if (tBlkPair->_block == NULL)
 			return NULL;
 
-		HisOrdQueBlock* tBlock = tBlkPair._block;
+		HisOrdQueBlock* tBlock = tBlkPair->_block;
 
-		uint32_t tcnt = (tBlkPair._buffer.size() - sizeof(HisOrdQueBlock)) / sizeof(WTSOrdQueStruct);
+		uint32_t tcnt = (tBlkPair->_buffer.size() - sizeof(HisOrdQueBlock)) / sizeof(WTSOrdQueStruct);
 		if (tcnt <= 0)
 			return NULL;
 
@@ -758,6 +770,8 @@ WTSOrdQueSlice* WtRdmDtReader::readOrdQueSliceByRange(const char* stdCode, uint6
 		{
 			//如果开始的交易日和当前的交易日不一致，则返回全部的tick数据
 			WTSOrdQueSlice* slice = WTSOrdQueSlice::create(stdCode, tBlock->_items, eIdx + 1);
+			if (slice != NULL)
+				slice->holdBuffer(tBlkPair);
 			return slice;
 		}
 		else
@@ -772,6 +786,8 @@ WTSOrdQueSlice* WtRdmDtReader::readOrdQueSliceByRange(const char* stdCode, uint6
 
 			std::size_t sIdx = pItem - tBlock->_items;
 			WTSOrdQueSlice* slice = WTSOrdQueSlice::create(stdCode, tBlock->_items + sIdx, eIdx - sIdx + 1);
+			if (slice != NULL)
+				slice->holdBuffer(tBlkPair);
 			return slice;
 		}
 	}
@@ -865,10 +881,10 @@ WTSOrdDtlSlice* WtRdmDtReader::readOrdDtlSliceByRange(const char* stdCode, uint6
 	}
 	else
 	{
-		std::string key = fmt::format("{}-{}", stdCode, endTDate);
+		std::string key = fmt::format("orders/{}-{}", stdCode, endTDate);
 
-		auto it = _his_ordque_map.find(key);
-		if (it == _his_ordque_map.end())
+		HisOrdDtlBlockPtr tBlkPair = _data_cache.get<HisOrdDtlBlockPair>(key);
+		if (tBlkPair == NULL)
 		{
 			std::stringstream ss;
 			ss << _base_dir << "his/orders/" << cInfo._exchg << "/" << endTDate << "/" << curCode << ".dsb";
@@ -876,41 +892,40 @@ WTSOrdDtlSlice* WtRdmDtReader::readOrdDtlSliceByRange(const char* stdCode, uint6
 			if (!StdFile::exists(filename.c_str()))
 				return NULL;
 
-			HisOrdDtlBlockPair& hisBlkPair = _his_orddtl_map[key];
-			StdFile::read_file_content(filename.c_str(), hisBlkPair._buffer);
-			if (hisBlkPair._buffer.size() < sizeof(HisOrdDtlBlockV2))
+			HisOrdDtlBlockPtr hisBlkPair(new HisOrdDtlBlockPair());
+			StdFile::read_file_content(filename.c_str(), hisBlkPair->_buffer);
+			if (hisBlkPair->_buffer.size() < sizeof(HisOrdDtlBlockV2))
 			{
 				pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of orderdetail data file {} failed", filename.c_str());
-				hisBlkPair._buffer.clear();
 				return NULL;
 			}
 
-			HisOrdDtlBlockV2* tBlockV2 = (HisOrdDtlBlockV2*)hisBlkPair._buffer.c_str();
+			HisOrdDtlBlockV2* tBlockV2 = (HisOrdDtlBlockV2*)hisBlkPair->_buffer.c_str();
 
-			if (hisBlkPair._buffer.size() != (sizeof(HisOrdDtlBlockV2) + tBlockV2->_size))
+			if (hisBlkPair->_buffer.size() != (sizeof(HisOrdDtlBlockV2) + tBlockV2->_size))
 			{
 				pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of orderdetail data file {} failed", filename.c_str());
 				return NULL;
 			}
 
-			//需要解压
-			std::string buf = WTSCmpHelper::uncompress_data(tBlockV2->_data, (std::size_t)tBlockV2->_size);
-
-			//将原来的buffer只保留一个头部,并将所有tick数据追加到尾部
-			hisBlkPair._buffer.resize(sizeof(HisOrdDtlBlock));
-			hisBlkPair._buffer.append(buf);
-			tBlockV2->_version = BLOCK_VERSION_RAW;
+			//需要解压，先拷贝块头，再直接解压到块头后面，省掉中间缓存和一次拷贝
+			std::string rawBuf;
+			rawBuf.append(hisBlkPair->_buffer.data(), sizeof(HisOrdDtlBlock));
+			ChunkHelper::uncompress_append(rawBuf, tBlockV2);
+			((HisOrdDtlBlock*)rawBuf.data())->_version = BLOCK_VERSION_RAW_V2;
+			hisBlkPair->_buffer.swap(rawBuf);
 
-			hisBlkPair._block = (HisOrdDtlBlock*)hisBlkPair._buffer.c_str();
+			hisBlkPair->_block = (HisOrdDtlBlock*)hisBlkPair->_buffer.c_str();
+			_data_cache.put(key, hisBlkPair, hisBlkPair->_buffer.size());
+			tBlkPair = hisBlkPair;
 		}
 
-		HisOrdDtlBlockPair& tBlkPair = _his_orddtl_map[key];
-		if (tBlkPair._block == NULL)
+		if (tBlkPair->_block == NULL)
 			return NULL;
 
-		HisOrdDtlBlock* tBlock = tBlkPair._block;
+		HisOrdDtlBlock* tBlock = tBlkPair->_block;
 
-		uint32_t tcnt = (tBlkPair._buffer.size() - sizeof(HisOrdDtlBlock)) / sizeof(WTSOrdDtlStruct);
+		uint32_t tcnt = (tBlkPair->_buffer.size() - sizeof(HisOrdDtlBlock)) / sizeof(WTSOrdDtlStruct);
 		if (tcnt <= 0)
 			return NULL;
 
@@ -932,6 +947,8 @@ WTSOrdDtlSlice* WtRdmDtReader::readOrdDtlSliceByRange(const char* stdCode, uint6
 		{
 			//如果开始的交易日和当前的交易日不一致，则返回全部的tick数据
 			WTSOrdDtlSlice* slice = WTSOrdDtlSlice::create(stdCode, tBlock->_items, eIdx + 1);
+			if (slice != NULL)
+				slice->holdBuffer(tBlkPair);
 			return slice;
 		}
 		else
@@ -946,6 +963,8 @@ WTSOrdDtlSlice* WtRdmDtReader::readOrdDtlSliceByRange(const char* stdCode, uint6
 
 			std::size_t sIdx = pItem - tBlock->_items;
 			WTSOrdDtlSlice* slice = WTSOrdDtlSlice::create(stdCode, tBlock->_items + sIdx, eIdx - sIdx + 1);
+			if (slice != NULL)
+				slice->holdBuffer(tBlkPair);
 			return slice;
 		}
 	}
@@ -1039,10 +1058,10 @@ WTSTransSlice* WtRdmDtReader::readTransSliceByRange(const char* stdCode, uint64_
 	}
 	else
 	{
-		std::string key = fmt::format("{}-{}", stdCode, endTDate);
+		std::string key = fmt::format("trans/{}-{}", stdCode, endTDate);
 
-		auto it = _his_ordque_map.find(key);
-		if (it == _his_ordque_map.end())
+		HisTransBlockPtr tBlkPair = _data_cache.get<HisTransBlockPair>(key);
+		if (tBlkPair == NULL)
 		{
 			std::stringstream ss;
 			ss << _base_dir << "his/trans/" << cInfo._exchg << "/" << endTDate << "/" << curCode << ".dsb";
@@ -1050,41 +1069,40 @@ WTSTransSlice* WtRdmDtReader::readTransSliceByRange(const char* stdCode, uint64_
 			if (!StdFile::exists(filename.c_str()))
 				return NULL;
 
-			HisTransBlockPair& hisBlkPair = _his_trans_map[key];
-			StdFile::read_file_content(filename.c_str(), hisBlkPair._buffer);
-			if (hisBlkPair._buffer.size() < sizeof(HisTransBlockV2))
+			HisTransBlockPtr hisBlkPair(new HisTransBlockPair());
+			StdFile::read_file_content(filename.c_str(), hisBlkPair->_buffer);
+			if (hisBlkPair->_buffer.size() < sizeof(HisTransBlockV2))
 			{
 				pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of transaction data file {} failed", filename.c_str());
-				hisBlkPair._buffer.clear();
 				return NULL;
 			}
 
-			HisTransBlockV2* tBlockV2 = (HisTransBlockV2*)hisBlkPair._buffer.c_str();
+			HisTransBlockV2* tBlockV2 = (HisTransBlockV2*)hisBlkPair->_buffer.c_str();
 
-			if (hisBlkPair._buffer.size() != (sizeof(HisTransBlockV2) + tBlockV2->_size))
+			if (hisBlkPair->_buffer.size() != (sizeof(HisTransBlockV2) + tBlockV2->_size))
 			{
 				pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of transaction data file {} failed", filename.c_str());
 				return NULL;
 			}
 
-			//需要解压
-			std::string buf = WTSCmpHelper::uncompress_data(tBlockV2->_data, (std::size_t)tBlockV2->_size);
+			//需要解压，先拷贝块头，再直接解压到块头后面，省掉中间缓存和一次拷贝
+			std::string rawBuf;
+			rawBuf.append(hisBlkPair->_buffer.data(), sizeof(HisTransBlock));
+			ChunkHelper::uncompress_append(rawBuf, tBlockV2);
+			((HisTransBlock*)rawBuf.data())->_version = BLOCK_VERSION_RAW_V2;
+			hisBlkPair->_buffer.swap(rawBuf);
 
-			//将原来的buffer只保留一个头部,并将所有tick数据追加到尾部
-			hisBlkPair._buffer.resize(sizeof(HisTransBlock));
-			hisBlkPair._buffer.append(buf);
-			tBlockV2->_version = BLOCK_VERSION_RAW;
-
-			hisBlkPair._block = (HisTransBlock*)hisBlkPair._buffer.c_str();
+			hisBlkPair->_block = (HisTransBlock*)hisBlkPair->_buffer.c_str();
+			_data_cache.put(key, hisBlkPair, hisBlkPair->_buffer.size());
+			tBlkPair = hisBlkPair;
 		}
 
-		HisTransBlockPair& tBlkPair = _his_trans_map[key];
-		if (tBlkPair._block == NULL)
+		if (tBlkPair->_block == NULL)
 			return NULL;
 
-		HisTransBlock* tBlock = tBlkPair._block;
+		HisTransBlock* tBlock = tBlkPair->_block;
 
-		uint32_t tcnt = (tBlkPair._buffer.size() - sizeof(HisTransBlock)) / sizeof(WTSTransStruct);
+		uint32_t tcnt = (tBlkPair->_buffer.size() - sizeof(HisTransBlock)) / sizeof(WTSTransStruct);
 		if (tcnt <= 0)
 			return NULL;
 
@@ -1106,6 +1124,8 @@ WTSTransSlice* WtRdmDtReader::readTransSliceByRange(const char* stdCode, uint64_
 		{
 			//如果开始的交易日和当前的交易日不一致，则返回全部的tick数据
 			WTSTransSlice* slice = WTSTransSlice::create(stdCode, tBlock->_items, eIdx + 1);
+			if (slice != NULL)
+				slice->holdBuffer(tBlkPair);
 			return slice;
 		}
 		else
@@ -1120,12 +1140,70 @@ WTSTransSlice* WtRdmDtReader::readTransSliceByRange(const char* stdCode, uint64_
 
 			std::size_t sIdx = pItem - tBlock->_items;
 			WTSTransSlice* slice = WTSTransSlice::create(stdCode, tBlock->_items + sIdx, eIdx - sIdx + 1);
+			if (slice != NULL)
+				slice->holdBuffer(tBlkPair);
 			return slice;
 		}
 	}
 }
 
-bool WtRdmDtReader::cacheHisBarsFromFile(void* codeInfo, const std::string& key, const char* stdCode, WTSKlinePeriod period)
+WtRdmDtReader::BarsListPtr WtRdmDtReader::getHisBars(void* codeInfo, const std::string& key, const char* stdCode, WTSKlinePeriod period)
+{
+	BarsListPtr barsList = _data_cache.get<BarsList>(key);
+	if (barsList)
+		return barsList;
+
+	//读取失败也要放入缓存，避免每次都去读文件
+	barsList.reset(new BarsList());
+	cacheHisBarsFromFile(codeInfo, *barsList, stdCode, period);
+	_data_cache.put(key, barsList, barsList->bytes());
+	return barsList;
+}
+
+WtRdmDtReader::RTBarsPtr WtRdmDtReader::syncRTBars(const std::string& key, BarsList& barsList, RTKlineBlockPair* kPair)
+{
+	StdUniqueLock lock(barsList._mtx);
+
+	//1、先检查缓存中有多少实时数据
+	std::size_t oldSize = barsList._rt_bars ? barsList._rt_bars->size() : 0;
+
+	StdUniqueLock rtLock(*kPair->_mtx);
+	std::size_t newSize = kPair->_block->_size;
+
+	//2、再看看原始实时数据有多少，如果不够，就要补充进来
+	if (newSize <= oldSize)
+		return barsList._rt_bars;
+
+	//不在原来的数组上追加，已经交出去的切片还指向原来的数组
+	RTBarsPtr rtBars(new std::vector<WTSBarStruct>(newSize));
+	std::size_t idx = oldSize;
+	if (oldSize != 0)
+	{
+		idx--;
+		memcpy(rtBars->data(), barsList._rt_bars->data(), sizeof(WTSBarStruct)*idx);
+	}
+
+	//因为每次拷贝，最后一条K线都有可能是未闭合的，所以需要把最后一条K线覆盖
+	memcpy(rtBars->data() + idx, &kPair->_block->_bars[idx], sizeof(WTSBarStruct)*(newSize - idx));
+	rtLock.unlock();
+
+	//最后做复权处理
+	double factor = barsList._factor;
+	for (; idx < newSize; idx++)
+	{
+		WTSBarStruct& curBar = (*rtBars)[idx];
+		curBar.open *= factor;
+		curBar.high *= factor;
+		curBar.low *= factor;
+		curBar.close *= factor;
+	}
+
+	barsList._rt_bars = rtBars;
+	_data_cache.update_size(key, barsList.bytes());
+	return rtBars;
+}
+
+bool WtRdmDtReader::cacheHisBarsFromFile(void* codeInfo, BarsList& barList, const char* stdCode, WTSKlinePeriod period)
 {
 	CodeHelper::CodeInfo* cInfo = (CodeHelper::CodeInfo*)codeInfo;
 	WTSCommodityInfo* commInfo = _base_data_mgr->getCommodity(cInfo->_exchg, cInfo->_product);
@@ -1144,7 +1222,6 @@ bool WtRdmDtReader::cacheHisBarsFromFile(void* codeInfo, const std::string& key,
 	default: pname = "day"; break;
 	}
 
-	BarsList& barList = _bars_cache[key];
 	barList._code = stdCode;
 	barList._period = period;
 	barList._exchg = cInfo->_exchg;
@@ -1177,12 +1254,15 @@ bool WtRdmDtReader::cacheHisBarsFromFile(void* codeInfo, const std::string& key,
 				break;
 			}
 
-			proc_block_data(content, true, false);
-			uint32_t barcnt = content.size() / sizeof(WTSBarStruct);
-
 			hotAy = new std::vector<WTSBarStruct>();
-			hotAy->resize(barcnt);
-			memcpy(hotAy->data(), content.data(), content.size());
+			if (!proc_block_data(content, *hotAy) || hotAy->empty())
+			{
+				delete hotAy;
+				hotAy = NULL;
+				break;
+			}
+
+			uint32_t barcnt = (uint32_t)hotAy->size();
 
 			if (period != KP_DAY)
 				lastHotTime = hotAy->at(barcnt - 1).time;
@@ -1616,7 +1696,7 @@ bool WtRdmDtReader::cacheHisBarsFromFile(void* codeInfo, const std::string& key,
 	return true;
 }
 
-WTSBarStruct* WtRdmDtReader::indexBarFromCacheByRange(const std::string& key, uint64_t stime, uint64_t etime, uint32_t& count, bool isDay /* = false */)
+WTSBarStruct* WtRdmDtReader::indexBarFromCacheByRange(BarsList& barsList, uint64_t stime, uint64_t etime, uint32_t& count, bool isDay /* = false */)
 {
 	uint32_t rDate, rTime, lDate, lTime;
 	rDate = (uint32_t)(etime / 10000);
@@ -1624,7 +1704,6 @@ WTSBarStruct* WtRdmDtReader::indexBarFromCacheByRange(const std::string& key, ui
 	lDate = (uint32_t)(stime / 10000);
 	lTime = (uint32_t)(stime % 10000);
 
-	BarsList& barsList = _bars_cache[key];
 	if (barsList._bars.empty())
 		return NULL;
 	
@@ -1675,13 +1754,12 @@ WTSBarStruct* WtRdmDtReader::indexBarFromCacheByRange(const std::string& key, ui
 	return &barsList._bars[sIdx];
 }
 
-WTSBarStruct* WtRdmDtReader::indexBarFromCacheByCount(const std::string& key, uint64_t etime, uint32_t& count, bool isDay /* = false */)
+WTSBarStruct* WtRdmDtReader::indexBarFromCacheByCount(BarsList& barsList, uint64_t etime, uint32_t& count, bool isDay /* = false */)
 {
 	uint32_t rDate, rTime;
 	rDate = (uint32_t)(etime / 10000);
 	rTime = (uint32_t)(etime % 10000);
 
-	BarsList& barsList = _bars_cache[key];
 	if (barsList._bars.empty())
 		return NULL;
 
@@ -1716,7 +1794,7 @@ WTSBarStruct* WtRdmDtReader::indexBarFromCacheByCount(const std::string& key, ui
 	return &barsList._bars[sIdx];
 }
 
-uint32_t WtRdmDtReader::readBarsFromCacheByRange(const std::string& key, uint64_t stime, uint64_t etime, std::vector<WTSBarStruct>& ayBars, bool isDay /* = false */)
+uint32_t WtRdmDtReader::readBarsFromCacheByRange(BarsList& barsList, uint64_t stime, uint64_t etime, std::vector<WTSBarStruct>& ayBars, bool isDay /* = false */)
 {
 	uint32_t rDate, rTime, lDate, lTime;
 	rDate = (uint32_t)(etime / 10000);
@@ -1724,7 +1802,6 @@ uint32_t WtRdmDtReader::readBarsFromCacheByRange(const std::string& key, uint64_
 	lDate = (uint32_t)(stime / 10000);
 	lTime = (uint32_t)(stime % 10000);
 
-	BarsList& barsList = _bars_cache[key];
 	std::size_t eIdx,sIdx;
 	{
 		WTSBarStruct eBar;
@@ -1782,17 +1859,8 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByRange(const char* stdCode, WTSKlin
 	WTSCommodityInfo* commInfo = _base_data_mgr->getCommodity(cInfo._exchg, cInfo._product);
 	const char* stdPID = commInfo->getFullPid();
 
-	std::string key = fmt::format("{}#{}", stdCode, period);
-	auto it = _bars_cache.find(key);
-	bool bHasHisData = false;
-	if (it == _bars_cache.end())
-	{
-		bHasHisData = cacheHisBarsFromFile(&cInfo, key, stdCode, period);
-	}
-	else
-	{
-		bHasHisData = true;
-	}
+	std::string key = fmt::format("bars/{}#{}", stdCode, period);
+	BarsListPtr barsList = getHisBars(&cInfo, key, stdCode, period);
 
 	if (etime == 0)
 		etime = 203012312359;
@@ -1810,6 +1878,7 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByRange(const char* stdCode, WTSKlin
 	WTSBarStruct* rtHead = NULL;
 	uint32_t hisCnt = 0;
 	uint32_t rtCnt = 0;
+	RTBarsPtr rtBars;
 
 	std::string pname;
 	switch (period)
@@ -1902,68 +1971,47 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByRange(const char* stdCode, WTSKlin
 			if (kPair != NULL)
 			{
 				//如果是后复权，实时数据是需要单独缓存的，所以这里处理会很复杂
-				BarsList& barsList = _bars_cache[key];
-
-				//1、先检查缓存中有多少实时数据
-				std::size_t oldSize = barsList._rt_bars.size();
-				std::size_t newSize = kPair->_block->_size;
-
-				//2、再看看原始实时数据有多少，如果不够，就要补充进来
-				if (newSize > oldSize)
-				{
-					barsList._rt_bars.resize(newSize);
-					auto idx = oldSize;
-					if (oldSize != 0)
-						idx--;
-
-					//因为每次拷贝，最后一条K线都有可能是未闭合的，所以需要把最后一条K线覆盖
-					memcpy(&barsList._rt_bars[idx], &kPair->_block->_bars[idx], sizeof(WTSBarStruct)*(newSize - oldSize + 1));
+				//切片引用的是同步时的那份实时K线，之后再同步也不会影响已经交出去的切片
+				rtBars = syncRTBars(key, *barsList, kPair);
+			}
 
-					//最后做复权处理
-					double factor = barsList._factor;
-					for (; idx < newSize; idx++)
-					{
-						WTSBarStruct* pBar = &barsList._rt_bars[idx];
-						pBar->open *= factor;
-						pBar->high *= factor;
-						pBar->low *= factor;
-						pBar->close *= factor;
-					}
-				}
+			if (rtBars && !rtBars->empty())
+			{
+				std::vector<WTSBarStruct>& rtList = *rtBars;
 
 				//最后做一个定位
-				auto it = std::lower_bound(barsList._rt_bars.begin(), barsList._rt_bars.end(), eBar, [isDay](const WTSBarStruct& a, const WTSBarStruct& b) {
+				auto it = std::lower_bound(rtList.begin(), rtList.end() - 1, eBar, [isDay](const WTSBarStruct& a, const WTSBarStruct& b) {
 					if (isDay)
 						return a.date < b.date;
 					else
 						return a.time < b.time;
 				});
-				std::size_t idx = it - barsList._rt_bars.begin();
-				WTSBarStruct* pBar = &barsList._rt_bars[idx];
+				std::size_t idx = it - rtList.begin();
+				WTSBarStruct* pBar = &rtList[idx];
 				if ((isDay && pBar->date > eBar.date) || (!isDay && pBar->time > eBar.time))
 				{
 					pBar--;
 					idx--;
 				}
 
-				pBar = &barsList._rt_bars[0];
+				pBar = &rtList[0];
 				//如果第一条实时K线的时间大于开始日期，则实时K线要全部包含进去
 				if ((isDay && pBar->date > sBar.date) || (!isDay && pBar->time > sBar.time))
 				{
-					rtHead = &barsList._rt_bars[0];
+					rtHead = &rtList[0];
 					rtCnt = idx + 1;
 				}
 				else
 				{
-					it = std::lower_bound(barsList._rt_bars.begin(), barsList._rt_bars.begin() + idx, sBar, [isDay](const WTSBarStruct& a, const WTSBarStruct& b) {
+					it = std::lower_bound(rtList.begin(), rtList.begin() + idx, sBar, [isDay](const WTSBarStruct& a, const WTSBarStruct& b) {
 						if (isDay)
 							return a.date < b.date;
 						else
 							return a.time < b.time;
 					});
 
-					std::size_t sIdx = it - barsList._rt_bars.begin();
-					rtHead = &barsList._rt_bars[sIdx];
+					std::size_t sIdx = it - rtList.begin();
+					rtHead = &rtList[sIdx];
 					rtCnt = idx - sIdx + 1;
 					bNeedHisData = false;
 				}
@@ -1974,12 +2022,14 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByRange(const char* stdCode, WTSKlin
 
 	if (bNeedHisData)
 	{
-		hisHead = indexBarFromCacheByRange(key, stime, etime, hisCnt, period == KP_DAY);
+		hisHead = indexBarFromCacheByRange(*barsList, stime, etime, hisCnt, period == KP_DAY);
 	}
 
 	if (hisCnt + rtCnt > 0)
 	{
 		WTSKlineSlice* slice = WTSKlineSlice::create(stdCode, period, 1, hisHead, hisCnt);
+		slice->holdBuffer(barsList);
+		slice->holdBuffer(rtBars);
 		if (rtCnt > 0)
 			slice->appendBlock(rtHead, rtCnt);
 		return slice;
@@ -2213,17 +2263,8 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByCount(const char* stdCode, WTSKlin
 	WTSCommodityInfo* commInfo = _base_data_mgr->getCommodity(cInfo._exchg, cInfo._product);
 	const char* stdPID = commInfo->getFullPid();
 
-	std::string key = fmtutil::format("{}#{}", stdCode, period);
-	auto it = _bars_cache.find(key);
-	bool bHasHisData = false;
-	if (it == _bars_cache.end())
-	{
-		bHasHisData = cacheHisBarsFromFile(&cInfo, key, stdCode, period);
-	}
-	else
-	{
-		bHasHisData = true;
-	}
+	std::string key = fmtutil::format("bars/{}#{}", stdCode, period);
+	BarsListPtr barsList = getHisBars(&cInfo, key, stdCode, period);
 
 	if (etime == 0)
 		etime = 203012312359;
@@ -2239,6 +2280,7 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByCount(const char* stdCode, WTSKlin
 	WTSBarStruct* rtHead = NULL;
 	uint32_t hisCnt = 0;
 	uint32_t rtCnt = 0;
+	RTBarsPtr rtBars;
 
 	std::string pname;
 	switch (period)
@@ -2309,44 +2351,23 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByCount(const char* stdCode, WTSKlin
 			if (kPair != NULL)
 			{
 				//如果是后复权，实时数据是需要单独缓存的，所以这里处理会很复杂
-				BarsList& barsList = _bars_cache[key];
-
-				//1、先检查缓存中有多少实时数据
-				std::size_t oldSize = barsList._rt_bars.size();
-				std::size_t newSize = kPair->_block->_size;
-
-				//2、再看看原始实时数据有多少，如果不够，就要补充进来
-				if(newSize > oldSize)
-				{
-					barsList._rt_bars.resize(newSize);
-					auto idx = oldSize;
-					if (oldSize != 0)
-						idx--;
-
-					//因为每次拷贝，最后一条K线都有可能是未闭合的，所以需要把最后一条K线覆盖
-					memcpy(&barsList._rt_bars[idx], &kPair->_block->_bars[idx], sizeof(WTSBarStruct)*(newSize - idx));
+				//切片引用的是同步时的那份实时K线，之后再同步也不会影响已经交出去的切片
+				rtBars = syncRTBars(key, *barsList, kPair);
+			}
 
-					//最后做复权处理
-					double factor = barsList._factor;
-					for(; idx < newSize; idx++)
-					{
-						WTSBarStruct* pBar = &barsList._rt_bars[idx];
-						pBar->open *= factor;
-						pBar->high *= factor;
-						pBar->low *= factor;
-						pBar->close *= factor;
-					}
-				}
+			if (rtBars && !rtBars->empty())
+			{
+				std::vector<WTSBarStruct>& rtList = *rtBars;
 
 				//最后做一个定位
-				auto it = std::lower_bound(barsList._rt_bars.begin(), barsList._rt_bars.end(), eBar, [isDay](const WTSBarStruct& a, const WTSBarStruct& b) {
+				auto it = std::lower_bound(rtList.begin(), rtList.end() - 1, eBar, [isDay](const WTSBarStruct& a, const WTSBarStruct& b) {
 					if (isDay)
 						return a.date < b.date;
 					else
 						return a.time < b.time;
 				});
-				std::size_t idx = it - barsList._rt_bars.begin();
-				WTSBarStruct* pBar = &barsList._rt_bars[idx];
+				std::size_t idx = it - rtList.begin();
+				WTSBarStruct* pBar = &rtList[idx];
 				if ((isDay && pBar->date > eBar.date) || (!isDay && pBar->time > eBar.time))
 				{
 					pBar--;
@@ -2356,7 +2377,7 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByCount(const char* stdCode, WTSKlin
 				//如果第一条实时K线的时间大于开始日期，则实时K线要全部包含进去
 				rtCnt = min((uint32_t)idx + 1, count);
 				std::size_t sIdx = idx + 1 - rtCnt;
-				rtHead = &barsList._rt_bars[sIdx];
+				rtHead = &rtList[sIdx];
 				bNeedHisData = (rtCnt < count);
 			}
 		}
@@ -2366,7 +2387,7 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByCount(const char* stdCode, WTSKlin
 	if (bNeedHisData)
 	{
 		hisCnt = count - rtCnt;
-		hisHead = indexBarFromCacheByCount(key, etime, hisCnt, period == KP_DAY);
+		hisHead = indexBarFromCacheByCount(*barsList, etime, hisCnt, period == KP_DAY);
 	}
 
 	pipe_rdmreader_log(_sink, LL_DEBUG, "His {} bars of {} loaded, {} from history, {} from realtime", PERIOD_NAME[period], stdCode, hisCnt, rtCnt);
@@ -2374,6 +2395,8 @@ WTSKlineSlice* WtRdmDtReader::readKlineSliceByCount(const char* stdCode, WTSKlin
 	if (hisCnt + rtCnt > 0)
 	{
 		WTSKlineSlice* slice = WTSKlineSlice::create(stdCode, period, 1, hisHead, hisCnt);
+		slice->holdBuffer(barsList);
+		slice->holdBuffer(rtBars);
 		if (rtCnt > 0)
 			slice->appendBlock(rtHead, rtCnt);
 		return slice;
@@ -2499,10 +2522,10 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByCount(const char* stdCode, uint32_t
 		}
 		
 
-		std::string key = fmt::format("{}-{}", stdCode, nowTDate);
+		std::string key = fmt::format("ticks/{}-{}", stdCode, nowTDate);
 
-		auto it = _his_tick_map.find(key);
-		bool bHasHisTick = (it != _his_tick_map.end());
+		HisTBlockPtr tBlkPair = _data_cache.get<HisTBlockPair>(key);
+		bool bHasHisTick = (tBlkPair != NULL);
 		if (!bHasHisTick)
 		{
 			for (;;)
@@ -2534,17 +2557,18 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByCount(const char* stdCode, uint32_t
 
 				missingCnt = 0;
 
-				HisTBlockPair& tBlkPair = _his_tick_map[key];
-				StdFile::read_file_content(filename.c_str(), tBlkPair._buffer);
-				if (tBlkPair._buffer.size() < sizeof(HisTickBlock))
+				tBlkPair.reset(new HisTBlockPair());
+				StdFile::read_file_content(filename.c_str(), tBlkPair->_buffer);
+				if (tBlkPair->_buffer.size() < sizeof(HisTickBlock))
 				{
 					pipe_rdmreader_log(_sink, LL_ERROR, "Sizechecking of his tick data file {} failed", filename.c_str());
-					tBlkPair._buffer.clear();
+					tBlkPair.reset();
 					break;
 				}
 
-				proc_block_data(tBlkPair._buffer, false, true);				
-				tBlkPair._block = (HisTickBlock*)tBlkPair._buffer.c_str();
+				proc_block_data(tBlkPair->_buffer, false, true);
+				tBlkPair->_block = (HisTickBlock*)tBlkPair->_buffer.c_str();
+				_data_cache.put(key, tBlkPair, tBlkPair->_buffer.size());
 				bHasHisTick = true;
 				break;
 			}
@@ -2565,13 +2589,12 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByCount(const char* stdCode, uint32_t
 				eTick.action_time = sInfo->getCloseTime() * 100000 + 59999;
 			}
 
-			HisTBlockPair& tBlkPair = _his_tick_map[key];
-			if (tBlkPair._block == NULL)
+			if (tBlkPair->_block == NULL)
 				break;
 
-			HisTickBlock* tBlock = tBlkPair._block;
+			HisTickBlock* tBlock = tBlkPair->_block;
 
-			uint32_t tcnt = (tBlkPair._buffer.size() - sizeof(HisTickBlock)) / sizeof(WTSTickStruct);
+			uint32_t tcnt = (tBlkPair->_buffer.size() - sizeof(HisTickBlock)) / sizeof(WTSTickStruct);
 			if (tcnt <= 0)
 				break;
 
@@ -2591,6 +2614,7 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByCount(const char* stdCode, uint32_t
 
 			uint32_t thisCnt = min((uint32_t)eIdx + 1, left);
 			uint32_t sIdx = eIdx + 1 - thisCnt;
+			slice->holdBuffer(tBlkPair);
 			slice->insertBlock(0, tBlock->_ticks + sIdx, thisCnt);
 			left -= thisCnt;
 			break;
@@ -2640,7 +2664,7 @@ double WtRdmDtReader::getAdjFactorByDate(const char* stdCode, uint32_t date /* =
 
 void WtRdmDtReader::clearCache()
 {
-	_bars_cache.clear();
+	_data_cache.clear();
 
 	_rt_min1_map.clear();
 	_rt_min5_map.clear();
@@ -2649,4 +2673,16 @@ void WtRdmDtReader::clearCache()
 	_rt_trans_map.clear();
 	_rt_orddtl_map.clear();
 	_rt_ordque_map.clear();
-}
\ No newline at end of file
+}
+
+bool WtRdmDtReader::getCacheStats(WTSCacheStats& stats)
+{
+	WtLruCache::CacheStats cs = _data_cache.stats();
+	stats._hits = cs._hits;
+	stats._misses = cs._misses;
+	stats._evictions = cs._evictions;
+	stats._bytes = cs._bytes;
+	stats._budget = cs._budget;
+	stats._entries = cs._entries;
+	return true;
+}
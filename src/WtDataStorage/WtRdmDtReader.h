@@ -10,6 +10,7 @@
 
 #include "../Share/BoostMappingFile.hpp"
 #include "../Share/StdUtils.hpp"
+#include "../Share/WtLruCache.hpp"
 #include "../Share/fmtlib.h"
 
 NS_WTP_BEGIN
@@ -155,7 +156,7 @@ private:
 		}
 	} HisTBlockPair;
 
-	typedef std::unordered_map<std::string, HisTBlockPair>	HisTickBlockMap;
+	typedef std::shared_ptr<HisTBlockPair>	HisTBlockPtr;
 
 	typedef struct _HisTransBlockPair
 	{
@@ -171,7 +172,7 @@ private:
 		}
 	} HisTransBlockPair;
 
-	typedef std::unordered_map<std::string, HisTransBlockPair>	HisTransBlockMap;
+	typedef std::shared_ptr<HisTransBlockPair>	HisTransBlockPtr;
 
 	typedef struct _HisOrdDtlBlockPair
 	{
@@ -187,7 +188,7 @@ private:
 		}
 	} HisOrdDtlBlockPair;
 
-	typedef std::unordered_map<std::string, HisOrdDtlBlockPair>	HisOrdDtlBlockMap;
+	typedef std::shared_ptr<HisOrdDtlBlockPair>	HisOrdDtlBlockPtr;
 
 	typedef struct _HisOrdQueBlockPair
 	{
@@ -203,12 +204,34 @@ private:
 		}
 	} HisOrdQueBlockPair;
 
-	typedef std::unordered_map<std::string, HisOrdQueBlockPair>	HisOrdQueBlockMap;
+	typedef std::shared_ptr<HisOrdQueBlockPair>	HisOrdQueBlockPtr;
 
-	HisTickBlockMap		_his_tick_map;
-	HisOrdDtlBlockMap	_his_orddtl_map;
-	HisOrdQueBlockMap	_his_ordque_map;
-	HisTransBlockMap	_his_trans_map;
+	//后复权的实时K线，每次更新都新建一个数组，已经交出去的切片继续引用旧的数组
+	typedef std::shared_ptr<std::vector<WTSBarStruct>>	RTBarsPtr;
+
+	typedef struct _BarsList
+	{
+		std::string		_exchg;
+		std::string		_code;
+		WTSKlinePeriod	_period;
+		std::string		_raw_code;
+		double			_factor;
+
+		_BarsList():_factor(1.0){}
+
+		std::vector<WTSBarStruct>	_bars;		//放入缓存以后不再修改
+		RTBarsPtr					_rt_bars;	//如果是后复权，就需要把实时数据拷贝到这里来
+		StdUniqueMutex				_mtx;		//保护_rt_bars的替换
+
+		inline uint64_t bytes() const
+		{
+			return (_bars.capacity() + (_rt_bars ? _rt_bars->capacity() : 0)) * sizeof(WTSBarStruct);
+		}
+	} BarsList;
+	typedef std::shared_ptr<BarsList>	BarsListPtr;
+
+	//历史数据块和K线都放在一个按字节数限制容量的LRU缓存里
+	WtLruCache	_data_cache;
 
 private:
 	RTKlineBlockPair* getRTKilneBlock(const char* exchg, const char* code, WTSKlinePeriod period);
@@ -218,14 +241,24 @@ private:
 	TransBlockPair* getRTTransBlock(const char* exchg, const char* code);
 
 	/*
-	 *	将历史数据放入缓存
+	 *	从缓存中读取历史K线，缓存中没有则从文件读取并放入缓存
+	 */
+	BarsListPtr	getHisBars(void* codeInfo, const std::string& key, const char* stdCode, WTSKlinePeriod period);
+
+	/*
+	 *	从文件读取历史K线
 	 */
-	bool		cacheHisBarsFromFile(void* codeInfo, const std::string& key, const char* stdCode, WTSKlinePeriod period);
+	bool		cacheHisBarsFromFile(void* codeInfo, BarsList& barList, const char* stdCode, WTSKlinePeriod period);
 
-	uint32_t		readBarsFromCacheByRange(const std::string& key, uint64_t stime, uint64_t etime, std::vector<WTSBarStruct>& ayBars, bool isDay = false);
-	WTSBarStruct*	indexBarFromCacheByRange(const std::string& key, uint64_t stime, uint64_t etime, uint32_t& count, bool isDay = false);
+	/*
+	 *	把实时K线同步到后复权的缓存里，返回最新的实时K线数组
+	 */
+	RTBarsPtr	syncRTBars(const std::string& key, BarsList& barsList, RTKlineBlockPair* kPair);
 
-	WTSBarStruct*	indexBarFromCacheByCount(const std::string& key, uint64_t etime, uint32_t& count, bool isDay = false);
+	uint32_t		readBarsFromCacheByRange(BarsList& barsList, uint64_t stime, uint64_t etime, std::vector<WTSBarStruct>& ayBars, bool isDay = false);
+	WTSBarStruct*	indexBarFromCacheByRange(BarsList& barsList, uint64_t stime, uint64_t etime, uint32_t& count, bool isDay = false);
+
+	WTSBarStruct*	indexBarFromCacheByCount(BarsList& barsList, uint64_t etime, uint32_t& count, bool isDay = false);
 
 	bool	loadStkAdjFactorsFromFile(const char* adjfile);
 	
@@ -251,6 +284,8 @@ public:
 
 	virtual void		clearCache() override;
 
+	virtual bool		getCacheStats(WTSCacheStats& stats) override;
+
 private:
 	std::string		_base_dir;
 	IBaseDataMgr*	_base_data_mgr;
@@ -258,23 +293,6 @@ private:
 	StdThreadPtr	_thrd_check;
 	bool			_stopped;
 
-	typedef struct _BarsList
-	{
-		std::string		_exchg;
-		std::string		_code;
-		WTSKlinePeriod	_period;
-		std::string		_raw_code;
-		double			_factor;
-
-		_BarsList():_factor(1.0){}
-
-		std::vector<WTSBarStruct>	_bars;
-		std::vector<WTSBarStruct>	_rt_bars;	//如果是后复权，就需要把实时数据拷贝到这里来
-	} BarsList;
-
-	typedef std::unordered_map<std::string, BarsList> BarsCache;
-	BarsCache	_bars_cache;
-
 	//除权因子
 	typedef struct _AdjFactor
 	{
@@ -8,6 +8,7 @@
 #include "../Share/BoostFile.hpp"
 #include "../Share/StrUtil.hpp"
 #include "../Share/decimal.h"
+#include "../Share/TimeUtils.hpp"
 
 #include "../Includes/IBaseDataMgr.h"
 
@@ -48,6 +49,11 @@ extern "C"
 
 static const uint32_t CACHE_SIZE_STEP_AD = 400;
 
+inline int64_t now_micro_seconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 
 WtDataWriterAD::WtDataWriterAD()
 	: _terminated(false)
@@ -59,6 +65,10 @@ WtDataWriterAD::WtDataWriterAD()
 	, _tick_cache_block(nullptr)
 	, _tick_mapsize(16*1024*1024)
 	, _kline_mapsize(8*1024*1024)
+	, _async_task(false)
+	, _commit_size(1)
+	, _commit_span(1000)
+	, _env_flags(0)
 {
 }
 
@@ -95,6 +105,38 @@ bool WtDataWriterAD::init(WTSVariant* params, IDataWriterSink* sink)
 	if (params->has("klinemapsize"))
 		_kline_mapsize = params->getUInt32("klinemapsize");
 
+	_async_task = params->getBoolean("async");
+
+	//批量提交的设置，commitsize为每批最多的记录条数，commitspan为最长的暂存时间（微秒）
+	if (params->has("commitsize"))
+		_commit_size = max(params->getUInt32("commitsize"), (uint32_t)1);
+
+	if (params->has("commitspan"))
+		_commit_span = max(params->getUInt32("commitspan"), (uint32_t)100);
+
+	//落盘方式：sync-每次提交都落盘，nosync-提交不落盘由系统决定，mapasync-写映射并异步落盘
+	std::string durability = params->getCString("durability");
+	if (durability == "nosync")
+		_env_flags = MDB_NOSYNC;
+	else if (durability == "mapasync")
+		_env_flags = MDB_WRITEMAP | MDB_MAPASYNC;
+	else
+		durability = "sync";
+
+	if (_commit_size > 1)
+	{
+		_commit_thrd.reset(new StdThread([this]() {
+			while (!_terminated)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(_commit_span));
+				commit_batches(false);
+			}
+		}));
+	}
+
+	pipe_writer_log(_sink, LL_INFO, "WtDataWriterAD commit mode: {}, commitsize: {}, commitspan: {}us, durability: {}",
+		_commit_size > 1 ? "batch" : "immediate", _commit_size, _commit_span, durability);
+
 	loadCache();
 
 	return true;
@@ -108,6 +150,132 @@ void WtDataWriterAD::release()
 		_task_cond.notify_all();
 		_task_thrd->join();
 	}
+
+	if (_commit_thrd)
+		_commit_thrd->join();
+
+	//退出前把暂存的记录全部提交
+	commit_batches(true);
+
+	if (_commit_stat._commits > 0)
+	{
+		pipe_writer_log(_sink, LL_INFO, "{} records committed in {} transactions, avg batch: {:.1f}, max batch: {}, avg latency: {:.1f}us, max latency: {:.1f}us",
+			_commit_stat._records, _commit_stat._commits, _commit_stat._records*1.0 / _commit_stat._commits, _commit_stat._max_batch,
+			_commit_stat._total_ns / 1000.0 / _commit_stat._commits, _commit_stat._max_ns / 1000.0);
+	}
+}
+
+bool WtDataWriterAD::put_record(const WtLMDBPtr& db, void* key, std::size_t klen, void* val, std::size_t vlen)
+{
+	//逐条提交的时候不加锁也不做统计，和原来的写法保持一致
+	if (_commit_size <= 1)
+	{
+		WtLMDBQuery query(*db);
+		return query.put_and_commit(key, klen, val, vlen);
+	}
+
+	StdUniqueLock lock(_batch_mtx);
+	LMDBBatch& batch = _batches[db.get()];
+	if (batch._count == 0)
+		batch._first_stamp = now_micro_seconds();
+
+	uint32_t lens[2] = { (uint32_t)klen, (uint32_t)vlen };
+	batch._buffer.append((const char*)lens, sizeof(lens));
+	batch._buffer.append((const char*)key, klen);
+	batch._buffer.append((const char*)val, vlen);
+	batch._count++;
+
+	if (batch._count >= _commit_size)
+		return commit_batch(db.get(), batch);
+
+	return true;
+}
+
+bool WtDataWriterAD::commit_batch(WtLMDB* db, LMDBBatch& batch)
+{
+	if (batch._count == 0)
+		return true;
+
+	TimeUtils::Ticker ticker;
+	bool bSucc = true;
+	{
+		WtLMDBQuery query(*db);
+		const char* p = batch._buffer.data();
+		const char* end = p + batch._buffer.size();
+		while (p < end)
+		{
+			const uint32_t* lens = (const uint32_t*)p;
+			p += sizeof(uint32_t) * 2;
+			void* key = (void*)p;
+			void* val = (void*)(p + lens[0]);
+			p += lens[0] + lens[1];
+
+			if (!query.put(key, lens[0], val, lens[1]))
+			{
+				bSucc = false;
+				break;
+			}
+		}
+
+		//有一条写入失败，这个事务就不能再提交了，只能回滚
+		if (bSucc)
+		{
+			query.commit();
+			bSucc = !db->has_error();
+		}
+		else
+		{
+			query.rollback();
+		}
+	}
+
+	if (!bSucc)
+	{
+		pipe_writer_log(_sink, LL_ERROR, "Committing {} records to db failed: {}", batch._count, db->errmsg());
+	}
+	else
+	{
+		uint64_t ns = ticker.nano_seconds();
+		_commit_stat._commits++;
+		_commit_stat._records += batch._count;
+		_commit_stat._max_batch = max(_commit_stat._max_batch, batch._count);
+		_commit_stat._total_ns += ns;
+		_commit_stat._max_ns = max(_commit_stat._max_ns, ns);
+
+		if (_log_group_size != 0 && _commit_stat._commits % _log_group_size == 0)
+		{
+			pipe_writer_log(_sink, LL_INFO, "{} records committed in {} transactions, avg batch: {:.1f}, avg latency: {:.1f}us, max latency: {:.1f}us",
+				_commit_stat._records, _commit_stat._commits, _commit_stat._records*1.0 / _commit_stat._commits,
+				_commit_stat._total_ns / 1000.0 / _commit_stat._commits, _commit_stat._max_ns / 1000.0);
+		}
+	}
+
+	batch._buffer.clear();
+	batch._count = 0;
+	batch._first_stamp = 0;
+	return bSucc;
+}
+
+void WtDataWriterAD::commit_batches(bool bForce)
+{
+	StdUniqueLock lock(_batch_mtx);
+	int64_t now = now_micro_seconds();
+	for (auto& v : _batches)
+	{
+		LMDBBatch& batch = v.second;
+		if (batch._count == 0)
+			continue;
+
+		if (bForce || now - batch._first_stamp >= _commit_span)
+			commit_batch(v.first, batch);
+	}
+
+	//不是每次提交都落盘的，强制提交的时候要主动落盘一次
+	if (bForce && _env_flags != 0)
+	{
+		for (auto& v : _batches)
+			v.first->sync(true);
+	}
 }
 
 void WtDataWriterAD::loadCache()
@@ -422,8 +590,7 @@ void WtDataWriterAD::pipeToTicks(WTSContractInfo* ct, WTSTickData* curTick)
 		uint32_t offTime = ct->getCommInfo()->getSessionInfo()->offsetTime(actTime / 100000, true) + actTime % 100000;
 
 		LMDBHftKey key(ct->getExchg(), ct->getCode(), curTick->tradingdate(), offTime);
-		WtLMDBQuery query(*db);
-		if (!query.put_and_commit((void*)&key, sizeof(key), &curTick->getTickStruct(), sizeof(WTSTickStruct)))
+		if (!put_record(db, (void*)&key, sizeof(key), &curTick->getTickStruct(), sizeof(WTSTickStruct)))
 		{
 			pipe_writer_log(_sink, LL_ERROR, "pipe tick of {} to db failed: {}", ct->getFullCode(), db->errmsg());
 		}
@@ -451,8 +618,7 @@ void WtDataWriterAD::pipeToDayBars(WTSContractInfo* ct, const WTSBarStruct& bar)
 	if (db)
 	{
 		LMDBBarKey key(ct->getExchg(), ct->getCode(), bar.date);
-		WtLMDBQuery query(*db);
-		if (!query.put_and_commit((void*)&key, sizeof(key), (void*)&bar, sizeof(WTSBarStruct)))
+		if (!put_record(db, (void*)&key, sizeof(key), (void*)&bar, sizeof(WTSBarStruct)))
 		{
 			pipe_writer_log(_sink, LL_ERROR, "pipe day bar @ {} of {} to db failed", bar.date, ct->getFullCode());
 		}
@@ -484,8 +650,7 @@ void WtDataWriterAD::pipeToM1Bars(WTSContractInfo* ct, const WTSBarStruct& bar)
 	if(db)
 	{
 		LMDBBarKey key(ct->getExchg(), ct->getCode(), (uint32_t)bar.time);
-		WtLMDBQuery query(*db);
-		if(!query.put_and_commit((void*)&key, sizeof(key), (void*)&bar, sizeof(WTSBarStruct)))
+		if(!put_record(db, (void*)&key, sizeof(key), (void*)&bar, sizeof(WTSBarStruct)))
 		{
 			pipe_writer_log(_sink, LL_ERROR, "pipe m1 bar @ {} of {} to db failed", bar.time, ct->getFullCode());
 		}
@@ -517,8 +682,7 @@ void WtDataWriterAD::pipeToM5Bars(WTSContractInfo* ct, const WTSBarStruct& bar)
 	if (db)
 	{
 		LMDBBarKey key(ct->getExchg(), ct->getCode(), (uint32_t)bar.time);
-		WtLMDBQuery query(*db);
-		if (!query.put_and_commit((void*)&key, sizeof(key), (void*)&bar, sizeof(bar)))
+		if (!put_record(db, (void*)&key, sizeof(key), (void*)&bar, sizeof(bar)))
 		{
 			pipe_writer_log(_sink, LL_ERROR, "pipe m5 bar @ {} of {} to db failed", bar.time, ct->getFullCode());
 		}
@@ -1034,12 +1198,12 @@ WtDataWriterAD::WtLMDBPtr WtDataWriterAD::get_k_db(const char* exchg, WTSKlinePe
 
 	auto it = the_map->find(exchg);
 	if (it != the_map->end())
-		return std::move(it->second);
+		return it->second;
 
 	WtLMDBPtr dbPtr(new WtLMDB(false));
 	std::string path = StrUtil::printf("%s%s/%s/", _base_dir.c_str(), subdir.c_str(), exchg);
 	boost::filesystem::create_directories(path);
-	if(!dbPtr->open(path.c_str(), _kline_mapsize))
+	if(!dbPtr->open(path.c_str(), _kline_mapsize, _env_flags))
 	{
 		if (_sink) pipe_writer_log(_sink, LL_ERROR, "Opening {} db at {} failed: {}", subdir, path, dbPtr->errmsg());
 		return std::move(WtLMDBPtr());
@@ -1054,12 +1218,12 @@ WtDataWriterAD::WtLMDBPtr WtDataWriterAD::get_t_db(const char* exchg, const char
 	std::string key = StrUtil::printf("%s.%s", exchg, code);
 	auto it = _tick_dbs.find(key);
 	if (it != _tick_dbs.end())
-		return std::move(it->second);
+		return it->second;
 
 	WtLMDBPtr dbPtr(new WtLMDB(false));
 	std::string path = StrUtil::printf("%sticks/%s/%s", _base_dir.c_str(), exchg, code);
 	boost::filesystem::create_directories(path);
-	if (!dbPtr->open(path.c_str(), _tick_mapsize))
+	if (!dbPtr->open(path.c_str(), _tick_mapsize, _env_flags))
 	{
 		if (_sink) pipe_writer_log(_sink, LL_ERROR, "Opening tick db at {} failed: %s", path, dbPtr->errmsg());
 		return std::move(WtLMDBPtr());
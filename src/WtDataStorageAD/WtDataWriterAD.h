@@ -84,6 +84,41 @@ private:
 	uint32_t		_tick_mapsize;
 	uint32_t		_kline_mapsize;
 
+	//////////////////////////////////////////////////////////////////////////
+	/*
+	 *	批量提交（group commit）
+	 *	tick和K线先暂存到每个数据库各自的缓冲里，攒够_commit_size条或者第一条暂存超过_commit_span微秒
+	 *	就在一个写事务里一次性提交，这样就不用每来一笔数据就开一个写事务并落盘一次
+	 *	_commit_size为1时，退化为原来的逐条提交
+	 */
+	typedef struct _LMDBBatch
+	{
+		std::string		_buffer;		//暂存的记录，每条记录为[klen][vlen][key][val]
+		uint32_t		_count;
+		int64_t			_first_stamp;	//第一条暂存记录的时间，微秒
+
+		_LMDBBatch() :_count(0), _first_stamp(0) {}
+	} LMDBBatch;
+
+	//提交统计，只在批量提交的时候记录
+	typedef struct _CommitStat
+	{
+		uint64_t	_commits;		//提交次数
+		uint64_t	_records;		//提交的记录条数
+		uint32_t	_max_batch;		//最大的单次提交条数
+		uint64_t	_total_ns;		//提交总耗时
+		uint64_t	_max_ns;		//单次提交最大耗时
+
+		_CommitStat() { memset(this, 0, sizeof(_CommitStat)); }
+	} CommitStat;
+
+	uint32_t		_commit_size;
+	uint32_t		_commit_span;
+	unsigned int	_env_flags;		//LMDB环境标记，由durability配置项决定
+	StdUniqueMutex	_batch_mtx;
+	StdThreadPtr	_commit_thrd;
+	CommitStat		_commit_stat;
+
 private:
 	//////////////////////////////////////////////////////////////////////////
 	/*
@@ -105,6 +140,25 @@ private:
 
 	WtLMDBPtr	get_t_db(const char* exchg, const char* code);
 
+	typedef wt_hashmap<WtLMDB*, LMDBBatch> LMDBBatchMap;
+	LMDBBatchMap	_batches;
+
+	/*
+	 *	写入一条记录，根据批量提交的设置，直接提交或者暂存
+	 */
+	bool		put_record(const WtLMDBPtr& db, void* key, std::size_t klen, void* val, std::size_t vlen);
+
+	/*
+	 *	提交一个数据库的暂存记录，调用前要先锁住_batch_mtx
+	 */
+	bool		commit_batch(WtLMDB* db, LMDBBatch& batch);
+
+	/*
+	 *	提交暂存记录
+	 *	@bForce	为true则提交全部的暂存记录，否则只提交暂存超时的
+	 */
+	void		commit_batches(bool bForce);
+
 private:
 	void loadCache();
 
@@ -35,6 +35,9 @@ bool IndexFactory::init(WTSVariant* config, IHotMgr* hotMgr, IBaseDataMgr* bdMgr
 			continue;
 
 		_workers.emplace_back(worker);
+
+		for (const std::string& fullCode : worker->get_consists())
+			_consist_workers[fullCode].emplace_back(worker);
 	}
 
 	return true;
@@ -46,17 +49,19 @@ void IndexFactory::handle_quote(WTSTickData* newTick)
 		return;
 
 	const char* fullCode = newTick->getContractInfo()->getFullCode();
-	auto it = _subbed.find(fullCode);
-	if (it == _subbed.end())
+	auto it = _consist_workers.find(fullCode);
+	if (it == _consist_workers.end())
 		return;
 
-	newTick->retain();
+	//初始化以后反向索引不会再修改，可以直接引用
+	const IndexWorkers* workers = &it->second;
 
 	if(_pool)
 	{	
-		_pool->schedule([this, newTick, fullCode]() {
+		newTick->retain();
+		_pool->schedule([workers, newTick]() {
 
-			for(IndexWorkerPtr& worker : _workers)
+			for(const IndexWorkerPtr& worker : *workers)
 			{
 				worker->handle_quote(newTick);
 			}
@@ -66,7 +71,7 @@ void IndexFactory::handle_quote(WTSTickData* newTick)
 	}
 	else
 	{
-		for (IndexWorkerPtr& worker : _workers)
+		for (const IndexWorkerPtr& worker : *workers)
 		{
 			worker->handle_quote(newTick);
 		}
@@ -80,8 +85,6 @@ void IndexFactory::push_tick(WTSTickData* newTick)
 
 WTSTickData* IndexFactory::sub_ticks(const char* fullCode)
 {
-	_subbed.insert(fullCode);
-	
 	auto ay = StrUtil::split(fullCode, ".");
 	return _data_mgr->getCurTick(ay[1].c_str(), ay[0].c_str());
 }
\ No newline at end of file
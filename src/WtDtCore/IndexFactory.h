@@ -32,6 +32,8 @@ private:
 	typedef std::shared_ptr<boost::threadpool::pool> ThreadPoolPtr;
 	ThreadPoolPtr	_pool;
 
-	wt_hashset<std::string>	_subbed;
+	//成分合约到指数的反向索引，一笔行情只分发给包含它的指数
+	typedef wt_hashmap<std::string, IndexWorkers>	ConsistWorkers;
+	ConsistWorkers	_consist_workers;
 };
 
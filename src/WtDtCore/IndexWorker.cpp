@@ -19,6 +19,49 @@ const char* WEIGHT_ALGS[] =
 	"DynamicVolume"
 };
 
+IndexWorker::IndexWorker(IndexFactory* factor)
+	: _factor(factor)
+	, _timeout(0)
+	, _stand_scale(1.0)
+	, _cInfo(NULL)
+	, _weight_alg(0)
+	, _total_base(0)
+	, _total_value(0)
+	, _total_vol(0)
+	, _total_amt(0)
+	, _total_hold(0)
+	, _total_weight(0)
+	, _max_time(0)
+	, _trading_date(0)
+	, _ready_cnt(0)
+	, _update_cnt(0)
+	, _recalc_ticks(1000)
+	, _stopped(false)
+	, _process(false)
+{
+}
+
+IndexWorker::~IndexWorker()
+{
+	{
+		StdUniqueLock lck(_mtx_trigger);
+		_stopped = true;
+		_cond_trigger.notify_all();
+	}
+
+	if (_thrd_trigger)
+		_thrd_trigger->join();
+}
+
+std::vector<std::string> IndexWorker::get_consists() const
+{
+	std::vector<std::string> ret;
+	ret.reserve(_weight_scales.size());
+	for (const auto& v : _weight_scales)
+		ret.emplace_back(v.first);
+	return ret;
+}
+
 bool IndexWorker::init(WTSVariant* config)
 {
 	if (config == NULL)
@@ -49,6 +92,11 @@ bool IndexWorker::init(WTSVariant* config)
 	//权重算法
 	_weight_alg = config->getUInt32("weight_alg");
 
+	//增量更新多少次以后全量重算一次，默认1000次
+	_recalc_ticks = config->getUInt32("recalc_ticks");
+	if (_recalc_ticks == 0)
+		_recalc_ticks = 1000;
+
 	WTSVariant* cfgComms = config->get("commodities");
 	WTSVariant* cfgCodes = config->get("codes");
 	if (cfgComms != NULL && cfgComms->size() > 0)
@@ -171,11 +219,103 @@ bool IndexWorker::init(WTSVariant* config)
 		}
 	}
 
+	{
+		SpinLock lock(_mtx_data);
+		recalc_all();
+	}
+
+	//有超时时间的，由触发线程等到重算时间再生成指数
+	if (_timeout != 0)
+	{
+		_thrd_trigger.reset(new StdThread([this]() {
+			StdUniqueLock lck(_mtx_trigger);
+			while (!_stopped)
+			{
+				if (!_process)
+				{
+					_cond_trigger.wait(lck);
+					continue;
+				}
+
+				//等到重算时间，被唤醒只可能是要退出了
+				if (_cond_trigger.wait_until(lck, _recalc_time, [this]() { return _stopped; }))
+					break;
+
+				//生成指数的时候不占用触发锁
+				lck.unlock();
+				generate_tick();
+				lck.lock();
+				_process = false;
+			}
+		}));
+	}
+
 	WTSLogger::info("Block index {}.{} initialized，weight algorithm: {}, trigger: {}, timeout: {}", _exchg, _code, WEIGHT_ALGS[_weight_alg], _trigger, _timeout);
 
 	return true;
 }
 
+void IndexWorker::apply_factor(const WTSTickStruct& curTick, double weight, double sign)
+{
+	//没有行情的成分合约，数据都是0，加减都不影响累加值
+	if (curTick.action_date == 0)
+		return;
+
+	_total_vol += sign * curTick.total_volume;
+	_total_amt += sign * curTick.total_turnover;
+	_total_hold += sign * curTick.open_interest;
+
+	switch (_weight_alg)
+	{
+	case 0://固定权重，只看本身的weight
+		_total_value += sign * curTick.price * weight;
+		break;
+	case 1:	//动态总持
+		_total_base += sign * curTick.open_interest;	//动态总持为当前总持
+		_total_value += sign * curTick.open_interest * curTick.price * weight;
+		break;
+	case 2:	//动态成交量
+		_total_base += sign * curTick.total_volume;	//动态成交量
+		_total_value += sign * curTick.total_volume * curTick.price * weight;
+		break;
+	default:
+		break;
+	}
+
+	//时间和交易日只会往后走，新的数据取最大值就可以了
+	if (sign > 0)
+	{
+		uint64_t curTime = TimeUtils::makeTime(curTick.action_date, curTick.action_time);
+		_max_time = std::max(_max_time, curTime);
+		_trading_date = std::max(_trading_date, curTick.trading_date);
+	}
+}
+
+void IndexWorker::recalc_all()
+{
+	_total_base = 0;
+	_total_value = 0;
+	_total_vol = 0;
+	_total_amt = 0;
+	_total_hold = 0;
+	_total_weight = 0;
+	_max_time = 0;
+	_trading_date = 0;
+	_ready_cnt = 0;
+	_update_cnt = 0;
+
+	for (const auto& v : _weight_scales)
+	{
+		const WeightFactor& wFactor = v.second;
+		_total_weight += wFactor._weight;
+		if (wFactor._tick.action_date == 0)
+			continue;
+
+		_ready_cnt++;
+		apply_factor(wFactor._tick, wFactor._weight, 1);
+	}
+}
+
 void IndexWorker::handle_quote(WTSTickData* newTick)
 {
 	const char* fullCode = newTick->getContractInfo()->getFullCode();
@@ -187,7 +327,18 @@ void IndexWorker::handle_quote(WTSTickData* newTick)
 			return;
 
 		WeightFactor& wFactor = (WeightFactor&)it->second;
-		memcpy(&wFactor._tick, &newTick->getTickStruct(), sizeof(WTSTickStruct));
+		const WTSTickStruct& curTick = newTick->getTickStruct();
+		if (wFactor._tick.action_date == 0 && curTick.action_date != 0)
+			_ready_cnt++;
+
+		//先减掉旧行情的贡献，再加上新行情的贡献
+		apply_factor(wFactor._tick, wFactor._weight, -1);
+		memcpy(&wFactor._tick, &curTick, sizeof(WTSTickStruct));
+		apply_factor(wFactor._tick, wFactor._weight, 1);
+
+		_update_cnt++;
+		if (_update_cnt >= _recalc_ticks)
+			recalc_all();
 	}
 
 	//如果使用time，那么当第一个成分合约的行情进来以后，会去更新指数重算时间
@@ -202,38 +353,11 @@ void IndexWorker::handle_quote(WTSTickData* newTick)
 	}
 	else
 	{
-		if(_thrd_trigger == NULL)
-		{
-			_thrd_trigger.reset(new StdThread([this]() {
-				while(!_stopped)
-				{
-					while(!_process)
-					{
-						StdUniqueLock lck(_mtx_trigger);
-						_cond_trigger.wait(_mtx_trigger);
-					}
-
-					//等待一段时间
-					do
-					{
-						uint64_t now = TimeUtils::getLocalTimeNow();
-						if(now >= _recalc_time)
-							break;
-
-						std::this_thread::sleep_for(std::chrono::milliseconds(5));
-					} while (true);
-
-					//开始生成指数
-					generate_tick();
-					_process = false;
-				}
-			}));
-		}
-
+		StdUniqueLock lck(_mtx_trigger);
 		if(!_process)
 		{
 			_process = true;
-			_recalc_time = TimeUtils::getLocalTimeNow() + _timeout;
+			_recalc_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(_timeout);
 			_cond_trigger.notify_all();
 		}
 	}
@@ -241,7 +365,6 @@ void IndexWorker::handle_quote(WTSTickData* newTick)
 
 void IndexWorker::generate_tick()
 {
-	//然后开始计算指数
 	double total_base = 0.0;	//权重基数
 	double total_value = 0.0;	//数值累加
 	double total_vol = 0.0;		//指数总成交量
@@ -249,47 +372,23 @@ void IndexWorker::generate_tick()
 	double total_hold = 0.0;	//指数总持
 	uint64_t maxTime = 0;		//最后一笔tick的时间
 	uint32_t tDate = 0;			//交易日
-
 	double total_weight = 0;
 
 	{
-		//先把数据锁住
+		//累加值是增量维护的，这里只需要读出来
 		SpinLock lock(_mtx_data);
-		for (const auto& v : _weight_scales)
-		{
-			//如果数据不全，直接退出
-			const WeightFactor& wFactor = v.second;
-			if (wFactor._tick.action_date == 0)
-				return;
-
-			uint64_t curTime = TimeUtils::makeTime(wFactor._tick.action_date, wFactor._tick.action_time);
-			maxTime = std::max(maxTime, curTime);
-			tDate = std::max(tDate, wFactor._tick.trading_date);
-
-			total_vol += wFactor._tick.total_volume;
-			total_amt += wFactor._tick.total_turnover;
-			total_hold += wFactor._tick.open_interest;
-
-			total_weight += wFactor._weight;
+		//如果数据不全，直接退出
+		if (_ready_cnt < _weight_scales.size())
+			return;
 
-			switch (_weight_alg)
-			{
-			case 0://固定权重，只看本身的weight
-				total_base = 1;	//因为只看本身weight，所以权重基数为1
-				total_value += wFactor._tick.price * wFactor._weight;
-				break;
-			case 1:	//动态总持
-				total_base += wFactor._tick.open_interest;	//动态总持为当前总持
-				total_value += wFactor._tick.open_interest * wFactor._tick.price * wFactor._weight;
-				break;
-			case 2:	//动态成交量
-				total_base += wFactor._tick.total_volume;	//动态成交量
-				total_value += wFactor._tick.total_volume * wFactor._tick.price * wFactor._weight;
-				break;
-			default:
-				break;
-			}
-		}
+		total_base = (_weight_alg == 0) ? 1 : _total_base;	//固定权重只看本身weight，所以权重基数为1
+		total_value = _total_value;
+		total_vol = _total_vol;
+		total_amt = _total_amt;
+		total_hold = _total_hold;
+		total_weight = _total_weight;
+		maxTime = _max_time;
+		tDate = _trading_date;
 	}
 
 	//数据做标准化
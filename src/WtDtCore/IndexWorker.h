@@ -22,22 +22,38 @@ class IndexFactory;
 class IndexWorker
 {
 public:
-	IndexWorker(IndexFactory* factor):_factor(factor), _stopped(false), _process(false) {}
+	IndexWorker(IndexFactory* factor);
+	~IndexWorker();
 
 public:
 	bool	init(WTSVariant* config);
 	void	handle_quote(WTSTickData* newTick);
 
+	/*
+	 *	获取全部成分合约代码
+	 */
+	std::vector<std::string>	get_consists() const;
+
 private:
 	void	generate_tick();
 
+	/*
+	 *	把一个成分合约的贡献加到累加值上，sign为-1时从累加值中减掉
+	 */
+	void	apply_factor(const WTSTickStruct& curTick, double weight, double sign);
+
+	/*
+	 *	全量重算累加值，消除增量计算的浮点误差
+	 */
+	void	recalc_all();
+
 protected:
 	IndexFactory*	_factor;
 	std::string		_exchg;
 	std::string		_code;
 	std::string		_trigger;
 	uint32_t		_timeout;
-	uint64_t		_recalc_time;
+	std::chrono::steady_clock::time_point	_recalc_time;
 	double			_stand_scale;
 	WTSTickStruct	_cache;
 	WTSContractInfo*	_cInfo;
@@ -55,6 +71,19 @@ protected:
 	wt_hashmap<std::string, WeightFactor>	_weight_scales;
 	uint32_t	_weight_alg;
 
+	//增量维护的累加值，都在_mtx_data的保护下
+	double		_total_base;	//权重基数
+	double		_total_value;	//数值累加
+	double		_total_vol;		//指数总成交量
+	double		_total_amt;		//指数总成交额
+	double		_total_hold;	//指数总持
+	double		_total_weight;	//权重累加
+	uint64_t	_max_time;		//最后一笔tick的时间
+	uint32_t	_trading_date;	//交易日
+	uint32_t	_ready_cnt;		//已经有行情的成分合约数
+	uint32_t	_update_cnt;	//上次全量重算以后的增量更新次数
+	uint32_t	_recalc_ticks;	//增量更新多少次以后全量重算一次
+
 	StdThreadPtr	_thrd_trigger;
 	StdUniqueMutex	_mtx_trigger;
 	StdCondVariable	_cond_trigger;
@@ -0,0 +1,168 @@
+﻿/*!
+ * \file ShmBusCaster.cpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ * 
+ * \brief 
+ */
+#include "ShmBusCaster.h"
+#include "../Includes/WTSVariant.hpp"
+#include "../Includes/WTSDataDef.hpp"
+#include "../Share/StdUtils.hpp"
+#include "../Share/BoostFile.hpp"
+#include "../Share/TimeUtils.hpp"
+#include "../Share/fmtlib.h"
+#include "../WTSTools/WTSLogger.h"
+
+bool ShmBusCaster::init(WTSVariant* cfg)
+{
+	if (cfg == NULL)
+		return false;
+
+	if (!cfg->getBoolean("active"))
+		return false;
+
+	_path = cfg->getCString("path");
+
+	//事件队列容量，会向上取整到2的幂，默认8K
+	if (cfg->has("capacity"))
+		_capacity = cfg->getUInt64("capacity");
+	if (_capacity == 0)
+		_capacity = 8 * 1024;
+	_capacity = ShmQuoteBus::EventRing::round_capacity(_capacity);
+
+	//快照槽位数，即最多能发布的合约数，默认4096
+	if (cfg->has("maxslots"))
+		_max_slots = cfg->getUInt32("maxslots");
+	if (_max_slots == 0)
+		_max_slots = 4096;
+
+	std::size_t fsize = ShmQuoteBus::calc_size(_max_slots, _capacity);
+
+	//每次启动都重置总线
+	{
+		BoostFile bf;
+		bf.create_or_open_file(_path.c_str());
+		bf.truncate_file(fsize);
+		bf.close_file();
+	}
+
+	_mapfile.reset(new BoostMappingFile);
+	_mapfile->map(_path.c_str());
+
+#ifdef _MSC_VER
+	uint32_t pid = _getpid();
+#else
+	uint32_t pid = getpid();
+#endif
+
+	if (!_writer.init(_mapfile->addr(), _max_slots, _capacity, pid, (uint64_t)TimeUtils::getLocalTimeNow()))
+	{
+		WTSLogger::error("ShmBusCaster initializing failed @ {}", _path.c_str());
+		return false;
+	}
+
+	_inited = true;
+	WTSLogger::info("ShmBusCaster initialized @ {}, slots: {}, capacity: {}, size: {} bytes", _path.c_str(), _max_slots, _capacity, fsize);
+
+	return true;
+}
+
+uint32_t ShmBusCaster::get_slot(const char* exchg, const char* code)
+{
+	const char* fullCode = fmtutil::format("{}.{}", exchg, code);
+	auto it = _slots.find(fullCode);
+	if (it != _slots.end())
+		return it->second;
+
+	uint32_t slot = _writer.add_slot(fullCode);
+	if (slot == UINT32_MAX)
+		WTSLogger::error("ShmBusCaster slots exhausted, {} will not be published", fullCode);
+
+	//分配失败也记下来，避免每次都打日志
+	_slots[fullCode] = slot;
+	return slot;
+}
+
+void ShmBusCaster::broadcast(WTSTickData* curTick)
+{
+	if (curTick == NULL || !_inited)
+		return;
+
+	/*
+	 *	同步模式下可能有多个parser线程同时广播，所以写端要加一个自旋锁
+	 */
+	SpinLock lock(_mtx);
+	uint32_t idx = curTick->getContractIndex();
+	uint32_t slot = UINT32_MAX;
+	if (idx != UINT_MAX && idx < _tick_slots.size() && _tick_slots[idx] != UINT32_MAX)
+	{
+		slot = _tick_slots[idx];
+	}
+	else
+	{
+		const WTSTickStruct& ts = curTick->getTickStruct();
+		slot = get_slot(ts.exchg, ts.code);
+		if (idx != UINT_MAX)
+		{
+			if (idx >= _tick_slots.size())
+				_tick_slots.resize(idx + 1, UINT32_MAX);
+			_tick_slots[idx] = slot;
+		}
+	}
+
+	if (slot == UINT32_MAX)
+		return;
+
+	_writer.publish_tick(slot, curTick->getTickStruct());
+}
+
+void ShmBusCaster::broadcast(WTSOrdQueData* curOrdQue)
+{
+	if (curOrdQue == NULL || !_inited)
+		return;
+
+	SpinLock lock(_mtx);
+	const WTSOrdQueStruct& oqs = curOrdQue->getOrdQueStruct();
+	uint32_t slot = get_slot(oqs.exchg, oqs.code);
+	if (slot == UINT32_MAX)
+		return;
+
+	_writer.publish_event(1, slot, [&oqs](ShmQuoteBus::BusEvent& evt) {
+		memcpy(&evt._queue, &oqs, sizeof(WTSOrdQueStruct));
+	});
+}
+
+void ShmBusCaster::broadcast(WTSOrdDtlData* curOrdDtl)
+{
+	if (curOrdDtl == NULL || !_inited)
+		return;
+
+	SpinLock lock(_mtx);
+	const WTSOrdDtlStruct& ods = curOrdDtl->getOrdDtlStruct();
+	uint32_t slot = get_slot(ods.exchg, ods.code);
+	if (slot == UINT32_MAX)
+		return;
+
+	_writer.publish_event(2, slot, [&ods](ShmQuoteBus::BusEvent& evt) {
+		memcpy(&evt._order, &ods, sizeof(WTSOrdDtlStruct));
+	});
+}
+
+void ShmBusCaster::broadcast(WTSTransData* curTrans)
+{
+	if (curTrans == NULL || !_inited)
+		return;
+
+	SpinLock lock(_mtx);
+	const WTSTransStruct& tss = curTrans->getTransStruct();
+	uint32_t slot = get_slot(tss.exchg, tss.code);
+	if (slot == UINT32_MAX)
+		return;
+
+	_writer.publish_event(3, slot, [&tss](ShmQuoteBus::BusEvent& evt) {
+		memcpy(&evt._trans, &tss, sizeof(WTSTransStruct));
+	});
+}
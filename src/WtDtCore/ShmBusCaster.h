@@ -0,0 +1,56 @@
+﻿/*!
+ * \file ShmBusCaster.h
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ * 
+ * \brief 共享内存行情总线的写端
+ */
+#pragma once
+#include "IDataCaster.h"
+#include <stdint.h>
+#include <vector>
+#include "../Includes/FasterDefs.h"
+#include "../Share/BoostMappingFile.hpp"
+#include "../Share/ShmQuoteBus.hpp"
+#include "../Share/SpinMutex.hpp"
+
+NS_WTP_BEGIN
+class WTSVariant;
+NS_WTP_END
+
+USING_NS_WTP;
+
+class ShmBusCaster : public IDataCaster
+{
+public:
+	ShmBusCaster() :_capacity(8 * 1024), _max_slots(4096), _inited(false) {}
+
+	bool	init(WTSVariant* cfg);
+
+	virtual void	broadcast(WTSTickData* curTick) override;
+	virtual void	broadcast(WTSOrdQueData* curOrdQue) override;
+	virtual void	broadcast(WTSOrdDtlData* curOrdDtl) override;
+	virtual void	broadcast(WTSTransData* curTrans) override;
+
+private:
+	/*
+	 *	获取合约的快照槽位，没有则分配一个，槽位用完了返回UINT32_MAX
+	 */
+	uint32_t	get_slot(const char* exchg, const char* code);
+
+private:
+	std::string		_path;
+	typedef std::shared_ptr<BoostMappingFile> MappedFilePtr;
+	MappedFilePtr	_mapfile;
+	ShmQuoteBusWriter	_writer;
+	SpinMutex		_mtx;
+	uint64_t		_capacity;
+	uint32_t		_max_slots;
+	bool			_inited;
+
+	wt_hashmap<std::string, uint32_t>	_slots;
+	std::vector<uint32_t>	_tick_slots;	//合约序号到槽位的映射，tick走这里可以省掉拼代码和查表
+};
+
@@ -3,6 +3,7 @@
 #include "../Includes/WTSDataDef.hpp"
 #include "../Share/StdUtils.hpp"
 #include "../Share/BoostFile.hpp"
+#include "../Share/TimeUtils.hpp"
 #include "../WTSTools/WTSLogger.h"
 
 bool ShmCaster::init(WTSVariant* cfg)
@@ -15,91 +16,89 @@ bool ShmCaster::init(WTSVariant* cfg)
 
 	_path = cfg->getCString("path");
 
+	//队列容量，会向上取整到2的幂，默认8K
+	if (cfg->has("capacity"))
+		_capacity = cfg->getUInt64("capacity");
+	if (_capacity == 0)
+		_capacity = 8 * 1024;
+	_capacity = CastRing::round_capacity(_capacity);
+
+	std::size_t fsize = CastRing::calc_size(_capacity);
+
 	//每次启动都重置该队列
 	{
 		BoostFile bf;
 		bf.create_or_open_file(_path.c_str());
-		bf.truncate_file(sizeof(CastQueue));
+		bf.truncate_file(fsize);
 		bf.close_file();
 	}
 
 	_mapfile.reset(new BoostMappingFile);
 	_mapfile->map(_path.c_str());
-	_queue = (CastQueue*)_mapfile->addr();
-	new(_mapfile->addr()) CastQueue();
 
 #ifdef _MSC_VER
-	_queue->_pid = _getpid();
+	uint32_t pid = _getpid();
 #else
-	_queue->_pid = getpid();
+	uint32_t pid = getpid();
 #endif
 
+	_writer.init(_mapfile->addr(), _capacity, pid, (uint64_t)TimeUtils::getLocalTimeNow());
+
 	_inited = true;
-	WTSLogger::info("ShmCaste initialized @ {}", _path.c_str());
+	WTSLogger::info("ShmCaster initialized @ {}, capacity: {}, size: {} bytes", _path.c_str(), _capacity, fsize);
 
 	return true;
 }
 
 void ShmCaster::broadcast(WTSTickData* curTick)
 {
-	if (curTick == NULL || _queue == NULL || !_inited)
+	if (curTick == NULL || !_inited)
 		return;
 
 	/*
-	 *	先移动写的下标，然后写入数据
-	 *	写完了以后，再移动读的下标
+	 *	先标记槽位正在写，然后写入数据
+	 *	写完了以后，再更新槽位的戳和写游标
+	 *	同步模式下可能有多个parser线程同时广播，所以写端要加一个自旋锁
 	 */
-	uint64_t wIdx = _queue->_writable++;
-	uint64_t realIdx = wIdx % _queue->_capacity;
-	_queue->_items[realIdx]._type = 0;
-	memcpy(&_queue->_items[realIdx]._tick, &curTick->getTickStruct(), sizeof(WTSTickStruct));
-	_queue->_readable = wIdx;
+	SpinLock lock(_mtx);
+	_writer.push([curTick](DataItem& item) {
+		item._type = 0;
+		memcpy(&item._tick, &curTick->getTickStruct(), sizeof(WTSTickStruct));
+	});
 }
 
 void ShmCaster::broadcast(WTSOrdQueData* curOrdQue)
 {
-	if (curOrdQue == NULL || _queue == NULL || !_inited)
+	if (curOrdQue == NULL || !_inited)
 		return;
 
-	/*
-	 *	先移动写的下标，然后写入数据
-	 *	写完了以后，再移动读的下标
-	 */
-	uint64_t wIdx = _queue->_writable++;
-	uint64_t realIdx = wIdx % _queue->_capacity;
-	_queue->_items[realIdx]._type = 1;
-	memcpy(&_queue->_items[realIdx]._queue, &curOrdQue->getOrdQueStruct(), sizeof(WTSOrdQueStruct));
-	_queue->_readable = wIdx;
+	SpinLock lock(_mtx);
+	_writer.push([curOrdQue](DataItem& item) {
+		item._type = 1;
+		memcpy(&item._queue, &curOrdQue->getOrdQueStruct(), sizeof(WTSOrdQueStruct));
+	});
 }
 
 void ShmCaster::broadcast(WTSOrdDtlData* curOrdDtl)
 {
-	if (curOrdDtl == NULL || _queue == NULL || !_inited)
+	if (curOrdDtl == NULL || !_inited)
 		return;
 
-	/*
-	 *	先移动写的下标，然后写入数据
-	 *	写完了以后，再移动读的下标
-	 */
-	uint64_t wIdx = _queue->_writable++;
-	uint64_t realIdx = wIdx % _queue->_capacity;
-	_queue->_items[realIdx]._type = 2;
-	memcpy(&_queue->_items[realIdx]._order, &curOrdDtl->getOrdDtlStruct(), sizeof(WTSOrdDtlStruct));
-	_queue->_readable = wIdx;
+	SpinLock lock(_mtx);
+	_writer.push([curOrdDtl](DataItem& item) {
+		item._type = 2;
+		memcpy(&item._order, &curOrdDtl->getOrdDtlStruct(), sizeof(WTSOrdDtlStruct));
+	});
 }
 
 void ShmCaster::broadcast(WTSTransData* curTrans)
 {
-	if (curTrans == NULL || _queue == NULL || !_inited)
+	if (curTrans == NULL || !_inited)
 		return;
 
-	/*
-	 *	先移动写的下标，然后写入数据
-	 *	写完了以后，再移动读的下标
-	 */
-	uint64_t wIdx = _queue->_writable++;
-	uint64_t realIdx = wIdx % _queue->_capacity;
-	_queue->_items[realIdx]._type = 3;
-	memcpy(&_queue->_items[realIdx]._trans, &curTrans->getTransStruct(), sizeof(WTSTransStruct));
-	_queue->_readable = wIdx;
+	SpinLock lock(_mtx);
+	_writer.push([curTrans](DataItem& item) {
+		item._type = 3;
+		memcpy(&item._trans, &curTrans->getTransStruct(), sizeof(WTSTransStruct));
+	});
 }
\ No newline at end of file
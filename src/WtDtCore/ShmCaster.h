@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include "../Includes/WTSStruct.h"
 #include "../Share/BoostMappingFile.hpp"
+#include "../Share/SpmcRing.hpp"
+#include "../Share/SpinMutex.hpp"
 
 NS_WTP_BEGIN
 class WTSVariant;
@@ -27,25 +29,13 @@ public:
 
 		_DataItem() { memset(this, 0, sizeof(_DataItem)); }
 	} DataItem;
-
-	template <int N = 8*1024>
-	struct _DataQueue
-	{
-		uint64_t	_capacity = N;
-		volatile uint64_t	_readable;
-		volatile uint64_t	_writable;
-		uint32_t	_pid;
-		DataItem	_items[N];
-
-		_DataQueue() :_readable(UINT64_MAX), _writable(0), _pid(0) {}
-	};
-
-	typedef _DataQueue<8*1024>	CastQueue;
-
 #pragma pack(pop)
 
+	typedef SpmcRing<DataItem>		CastRing;
+	typedef SpmcRingWriter<DataItem>	CastWriter;
+
 public:
-	ShmCaster():_queue(NULL), _inited(false){}
+	ShmCaster():_capacity(8*1024), _inited(false){}
 
 	bool	init(WTSVariant* cfg);
 
@@ -58,7 +48,9 @@ private:
 	std::string		_path;
 	typedef std::shared_ptr<BoostMappingFile> MappedFilePtr;
 	MappedFilePtr	_mapfile;
-	CastQueue*		_queue;
+	CastWriter		_writer;
+	SpinMutex		_mtx;
+	uint64_t		_capacity;
 	bool			_inited;
 };
 
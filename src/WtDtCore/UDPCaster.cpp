@@ -18,6 +18,11 @@
 #include "../WTSTools/WTSBaseDataMgr.h"
 #include "../WTSTools/WTSLogger.h"
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <errno.h>
+#endif
+
 
 #define UDP_MSG_SUBSCRIBE	0x100
 #define UDP_MSG_PUSHTICK	0x200
@@ -46,12 +51,24 @@ typedef UDPDataPacket<WTSOrdQueStruct>	UDPOrdQuePacket;
 typedef UDPDataPacket<WTSOrdDtlStruct>	UDPOrdDtlPacket;
 typedef UDPDataPacket<WTSTransStruct>	UDPTransPacket;
 
+inline int64_t now_us()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 UDPCaster::UDPCaster()
 	: m_bTerminated(false)
 	, m_bdMgr(NULL)
 	, m_dtMgr(NULL)
+	, m_uProtocol(1)
+	, m_uMTU(1400)
+	, m_uFlushUs(200)
+	, m_bUseMmsg(false)
+	, m_uEpoch(0)
+	, m_uReplayPort(0)
+	, m_uReplayCap(65536)
 {
-	
+	memset(m_tmPending, 0, sizeof(m_tmPending));
 }
 
 
@@ -87,6 +104,38 @@ bool UDPCaster::init(WTSVariant* cfg, WTSBaseDataMgr* bdMgr, DataManager* dtMgr)
 		}
 	}
 
+	//v2协议：批量打包、带序号，接收端可以检测丢包并通过TCP补发
+	m_uProtocol = cfg->getUInt32("protocol");
+	if (m_uProtocol != 2)
+		m_uProtocol = 1;
+
+	if (m_uProtocol == 2)
+	{
+		if (cfg->has("mtu"))
+			m_uMTU = cfg->getUInt32("mtu");
+		if (cfg->has("flushus"))
+			m_uFlushUs = cfg->getUInt32("flushus");
+		if (cfg->has("replaycap"))
+			m_uReplayCap = cfg->getUInt32("replaycap");
+		m_bUseMmsg = cfg->getBoolean("mmsg");
+		m_uReplayPort = cfg->getUInt32("rport");
+
+		m_uEpoch = (uint32_t)time(NULL);
+		for (uint32_t chnl = 0; chnl < UDP_CHNL_COUNT; chnl++)
+			m_packers[chnl].init((uint16_t)chnl, m_uEpoch, m_uMTU);
+
+		if (m_uReplayPort != 0 && m_uReplayCap != 0)
+		{
+			m_replayRings[UDP_CHNL_TICK].init(sizeof(WTSTickStruct), m_uReplayCap);
+			m_replayRings[UDP_CHNL_ORDQUE].init(sizeof(WTSOrdQueStruct), m_uReplayCap);
+			m_replayRings[UDP_CHNL_ORDDTL].init(sizeof(WTSOrdDtlStruct), m_uReplayCap);
+			m_replayRings[UDP_CHNL_TRANS].init(sizeof(WTSTransStruct), m_uReplayCap);
+		}
+
+		WTSLogger::info("UDP caster works in protocol v2, mtu: {}, flush interval: {}us, replay port: {}, sendmmsg: {}",
+			m_uMTU, m_uFlushUs, m_uReplayPort, m_bUseMmsg ? "on" : "off");
+	}
+
 	//By Wesley @ 2022.01.11
 	//这是订阅端口，但是以前全部用的bport，属于笔误
 	//只能写一个兼容了
@@ -118,6 +167,19 @@ void UDPCaster::start(int sport)
 
 	do_receive();
 
+	if (m_uProtocol == 2 && m_uReplayPort != 0)
+	{
+		try
+		{
+			m_acptReplay.reset(new TCPAcceptor(m_ioservice, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), m_uReplayPort)));
+			do_accept_replay();
+		}
+		catch (...)
+		{
+			WTSLogger::error("Exception raised while start replaying service @ port {}", m_uReplayPort);
+		}
+	}
+
 	m_thrdIO.reset(new StdThread([this](){
 		try
 		{
@@ -298,105 +360,327 @@ void UDPCaster::do_broadcast(WTSObject* data, uint32_t dataType)
 	if(m_thrdCast == NULL)
 	{
 		m_thrdCast.reset(new StdThread([this](){
+			cast_loop();
+		}));
+	}
+	else
+	{
+		m_condCast.notify_all();
+	}
+}
 
-			while (!m_bTerminated)
+void UDPCaster::cast_loop()
+{
+	while (!m_bTerminated)
+	{
+		if (m_dataQue.empty())
+		{
+			//v2还有没发出去的数据报，最多等一个刷新周期
+			if (m_uProtocol == 2 && has_pending())
 			{
-				if(m_dataQue.empty())
-				{
-					StdUniqueLock lock(m_mtxCast);
-					m_condCast.wait(lock);
-					continue;
-				}	
-
-				std::queue<CastData> tmpQue;
 				{
 					StdUniqueLock lock(m_mtxCast);
-					tmpQue.swap(m_dataQue);
+					if (m_dataQue.empty())
+						m_condCast.wait_for(lock, std::chrono::microseconds(m_uFlushUs));
 				}
-				
-				while(!tmpQue.empty())
-				{
-					const CastData& castData = tmpQue.front();
 
-					if (castData._data == NULL)
-						break;
+				flush_batches(false);
+				send_datagrams();
+				continue;
+			}
 
-					//直接广播
-					if (!m_listRawGroup.empty() || !m_listRawRecver.empty())
-					{
-						std::string buf_raw;
-						if (castData._datatype == UDP_MSG_PUSHTICK)
-						{
-							buf_raw.resize(sizeof(UDPTickPacket));
-							UDPTickPacket* pack = (UDPTickPacket*)buf_raw.data();
-							pack->_type = castData._datatype;
-							WTSTickData* curObj = (WTSTickData*)castData._data;
-							memcpy(&pack->_data, &curObj->getTickStruct(), sizeof(WTSTickStruct));
-						}
-						else if (castData._datatype == UDP_MSG_PUSHORDDTL)
-						{
-							buf_raw.resize(sizeof(UDPOrdDtlPacket));
-							UDPOrdDtlPacket* pack = (UDPOrdDtlPacket*)buf_raw.data();
-							pack->_type = castData._datatype;
-							WTSOrdDtlData* curObj = (WTSOrdDtlData*)castData._data;
-							memcpy(&pack->_data, &curObj->getOrdDtlStruct(), sizeof(WTSOrdDtlStruct));
-						}
-						else if (castData._datatype == UDP_MSG_PUSHORDQUE)
-						{
-							buf_raw.resize(sizeof(UDPOrdQuePacket));
-							UDPOrdQuePacket* pack = (UDPOrdQuePacket*)buf_raw.data();
-							pack->_type = castData._datatype;
-							WTSOrdQueData* curObj = (WTSOrdQueData*)castData._data;
-							memcpy(&pack->_data, &curObj->getOrdQueStruct(), sizeof(WTSOrdQueStruct));
-						}
-						else if (castData._datatype == UDP_MSG_PUSHTRANS)
-						{
-							buf_raw.resize(sizeof(UDPTransPacket));
-							UDPTransPacket* pack = (UDPTransPacket*)buf_raw.data();
-							pack->_type = castData._datatype;
-							WTSTransData* curObj = (WTSTransData*)castData._data;
-							memcpy(&pack->_data, &curObj->getTransStruct(), sizeof(WTSTransStruct));
-						}
-						else
-						{
-							break;
-						}
+			StdUniqueLock lock(m_mtxCast);
+			if (m_dataQue.empty())
+				m_condCast.wait(lock);
+			continue;
+		}
 
-						//广播
-						boost::system::error_code ec;
-						for (auto it = m_listRawRecver.begin(); it != m_listRawRecver.end(); it++)
-						{
-							const UDPReceiverPtr& receiver = (*it);
-							m_sktBroadcast->send_to(boost::asio::buffer(buf_raw), receiver->_ep, 0, ec);
-							if (ec)
-							{
-								WTSLogger::error("Error occured while sending to ({}:{}): {}({})", 
-									receiver->_ep.address().to_string(), receiver->_ep.port(), ec.value(), ec.message());
-							}
-						}
+		std::queue<CastData> tmpQue;
+		{
+			StdUniqueLock lock(m_mtxCast);
+			tmpQue.swap(m_dataQue);
+		}
 
-						//组播
-						for (auto it = m_listRawGroup.begin(); it != m_listRawGroup.end(); it++)
-						{
-							const MulticastPair& item = *it;
-							it->first->send_to(boost::asio::buffer(buf_raw), item.second->_ep, 0, ec);
-							if (ec)
-							{
-								WTSLogger::error("Error occured while sending to ({}:{}): {}({})",
-									item.second->_ep.address().to_string(), item.second->_ep.port(), ec.value(), ec.message());
-							}
-						}
-					}
+		while (!tmpQue.empty())
+		{
+			const CastData& castData = tmpQue.front();
 
-					tmpQue.pop();
-				} 
-			}
-		}));
+			if (castData._data == NULL)
+				break;
+
+			if (m_uProtocol == 2)
+				pack_data(castData);
+			else if (!send_raw(castData))
+				break;
+
+			tmpQue.pop();
+		}
+
+		if (m_uProtocol == 2)
+		{
+			flush_batches(m_uFlushUs == 0);
+			send_datagrams();
+		}
+	}
+}
+
+bool UDPCaster::send_raw(const CastData& castData)
+{
+	//直接广播
+	if (m_listRawGroup.empty() && m_listRawRecver.empty())
+		return true;
+
+	std::string buf_raw;
+	if (castData._datatype == UDP_MSG_PUSHTICK)
+	{
+		buf_raw.resize(sizeof(UDPTickPacket));
+		UDPTickPacket* pack = (UDPTickPacket*)buf_raw.data();
+		pack->_type = castData._datatype;
+		WTSTickData* curObj = (WTSTickData*)castData._data;
+		memcpy(&pack->_data, &curObj->getTickStruct(), sizeof(WTSTickStruct));
+	}
+	else if (castData._datatype == UDP_MSG_PUSHORDDTL)
+	{
+		buf_raw.resize(sizeof(UDPOrdDtlPacket));
+		UDPOrdDtlPacket* pack = (UDPOrdDtlPacket*)buf_raw.data();
+		pack->_type = castData._datatype;
+		WTSOrdDtlData* curObj = (WTSOrdDtlData*)castData._data;
+		memcpy(&pack->_data, &curObj->getOrdDtlStruct(), sizeof(WTSOrdDtlStruct));
+	}
+	else if (castData._datatype == UDP_MSG_PUSHORDQUE)
+	{
+		buf_raw.resize(sizeof(UDPOrdQuePacket));
+		UDPOrdQuePacket* pack = (UDPOrdQuePacket*)buf_raw.data();
+		pack->_type = castData._datatype;
+		WTSOrdQueData* curObj = (WTSOrdQueData*)castData._data;
+		memcpy(&pack->_data, &curObj->getOrdQueStruct(), sizeof(WTSOrdQueStruct));
+	}
+	else if (castData._datatype == UDP_MSG_PUSHTRANS)
+	{
+		buf_raw.resize(sizeof(UDPTransPacket));
+		UDPTransPacket* pack = (UDPTransPacket*)buf_raw.data();
+		pack->_type = castData._datatype;
+		WTSTransData* curObj = (WTSTransData*)castData._data;
+		memcpy(&pack->_data, &curObj->getTransStruct(), sizeof(WTSTransStruct));
 	}
 	else
 	{
-		m_condCast.notify_all();
+		return false;
 	}
+
+	//广播
+	boost::system::error_code ec;
+	for (auto it = m_listRawRecver.begin(); it != m_listRawRecver.end(); it++)
+	{
+		const UDPReceiverPtr& receiver = (*it);
+		m_sktBroadcast->send_to(boost::asio::buffer(buf_raw), receiver->_ep, 0, ec);
+		if (ec)
+		{
+			WTSLogger::error("Error occured while sending to ({}:{}): {}({})", 
+				receiver->_ep.address().to_string(), receiver->_ep.port(), ec.value(), ec.message());
+		}
+	}
+
+	//组播
+	for (auto it = m_listRawGroup.begin(); it != m_listRawGroup.end(); it++)
+	{
+		const MulticastPair& item = *it;
+		it->first->send_to(boost::asio::buffer(buf_raw), item.second->_ep, 0, ec);
+		if (ec)
+		{
+			WTSLogger::error("Error occured while sending to ({}:{}): {}({})",
+				item.second->_ep.address().to_string(), item.second->_ep.port(), ec.value(), ec.message());
+		}
+	}
+
+	return true;
+}
+
+void UDPCaster::pack_data(const CastData& castData)
+{
+	uint32_t chnl = 0;
+	const void* data = NULL;
+	uint16_t len = 0;
+	switch (castData._datatype)
+	{
+	case UDP_MSG_PUSHTICK:
+		chnl = UDP_CHNL_TICK;
+		data = &((WTSTickData*)castData._data)->getTickStruct();
+		len = sizeof(WTSTickStruct);
+		break;
+	case UDP_MSG_PUSHORDQUE:
+		chnl = UDP_CHNL_ORDQUE;
+		data = &((WTSOrdQueData*)castData._data)->getOrdQueStruct();
+		len = sizeof(WTSOrdQueStruct);
+		break;
+	case UDP_MSG_PUSHORDDTL:
+		chnl = UDP_CHNL_ORDDTL;
+		data = &((WTSOrdDtlData*)castData._data)->getOrdDtlStruct();
+		len = sizeof(WTSOrdDtlStruct);
+		break;
+	case UDP_MSG_PUSHTRANS:
+		chnl = UDP_CHNL_TRANS;
+		data = &((WTSTransData*)castData._data)->getTransStruct();
+		len = sizeof(WTSTransStruct);
+		break;
+	default:
+		return;
+	}
+
+	UDPBatchPacker& packer = m_packers[chnl];
+	if (packer.empty())
+		m_tmPending[chnl] = now_us();
+
+	uint64_t seq = packer.append((uint16_t)castData._datatype, data, len);
+	if (seq == 0)
+	{
+		//放不下了，先把当前的数据报发出去
+		flush_channel(chnl);
+		m_tmPending[chnl] = now_us();
+		seq = packer.append((uint16_t)castData._datatype, data, len);
+	}
+
+	m_replayRings[chnl].push(seq, (uint16_t)castData._datatype, data, len);
+}
+
+void UDPCaster::flush_channel(uint32_t chnl)
+{
+	UDPBatchPacker& packer = m_packers[chnl];
+	if (packer.empty())
+		return;
+
+	m_vecDatagrams.emplace_back(std::string(packer.data(), packer.size()));
+	packer.reset(packer.next_seq());
+}
+
+void UDPCaster::flush_batches(bool bForce)
+{
+	int64_t now = now_us();
+	for (uint32_t chnl = 0; chnl < UDP_CHNL_COUNT; chnl++)
+	{
+		if (m_packers[chnl].empty())
+			continue;
+
+		if (bForce || now - m_tmPending[chnl] >= (int64_t)m_uFlushUs)
+			flush_channel(chnl);
+	}
+}
+
+bool UDPCaster::has_pending() const
+{
+	for (uint32_t chnl = 0; chnl < UDP_CHNL_COUNT; chnl++)
+	{
+		if (!m_packers[chnl].empty())
+			return true;
+	}
+
+	return false;
+}
+
+void UDPCaster::send_datagrams()
+{
+	if (m_vecDatagrams.empty())
+		return;
+
+	for (const UDPReceiverPtr& receiver : m_listRawRecver)
+		send_datagrams(m_sktBroadcast, receiver->_ep);
+
+	for (MulticastPair& item : m_listRawGroup)
+		send_datagrams(item.first, item.second->_ep);
+
+	m_vecDatagrams.clear();
+}
+
+void UDPCaster::send_datagrams(UDPSocketPtr& sock, const EndPoint& ep)
+{
+#ifndef _WIN32
+	if (m_bUseMmsg)
+	{
+		//一次系统调用发送多个数据报
+		std::size_t cnt = m_vecDatagrams.size();
+		std::vector<struct iovec> iovs(cnt);
+		std::vector<struct mmsghdr> msgs(cnt);
+		memset(msgs.data(), 0, sizeof(struct mmsghdr)*cnt);
+		for (std::size_t i = 0; i < cnt; i++)
+		{
+			iovs[i].iov_base = (void*)m_vecDatagrams[i].data();
+			iovs[i].iov_len = m_vecDatagrams[i].size();
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = (void*)ep.data();
+			msgs[i].msg_hdr.msg_namelen = (socklen_t)ep.size();
+		}
+
+		std::size_t sent = 0;
+		while (sent < cnt)
+		{
+			int ret = sendmmsg(sock->native_handle(), msgs.data() + sent, (unsigned int)(cnt - sent), 0);
+			if (ret < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				WTSLogger::error("Error occured while sending to ({}:{}): {}", ep.address().to_string(), ep.port(), strerror(errno));
+				break;
+			}
+			sent += ret;
+		}
+		return;
+	}
+#endif
+
+	boost::system::error_code ec;
+	for (const std::string& buf : m_vecDatagrams)
+	{
+		sock->send_to(boost::asio::buffer(buf), ep, 0, ec);
+		if (ec)
+		{
+			WTSLogger::error("Error occured while sending to ({}:{}): {}({})",
+				ep.address().to_string(), ep.port(), ec.value(), ec.message());
+		}
+	}
+}
+
+void UDPCaster::do_accept_replay()
+{
+	TCPSocketPtr sock(new TCPSocket(m_ioservice));
+	m_acptReplay->async_accept(*sock, [this, sock](const boost::system::error_code& ec) {
+		if (ec)
+		{
+			if (!m_bTerminated)
+				do_accept_replay();
+			return;
+		}
+
+		boost::system::error_code ecPeer;
+		std::string peer = sock->remote_endpoint(ecPeer).address().to_string();
+
+		std::shared_ptr<UDPReplayReq> req(new UDPReplayReq);
+		boost::asio::async_read(*sock, boost::asio::buffer(req.get(), sizeof(UDPReplayReq)),
+			[this, sock, req, peer](const boost::system::error_code& ec, std::size_t /*bytes_read*/) {
+			if (ec)
+				return;
+
+			if (req->_type != UDP_MSG_REPLAY || req->_channel >= UDP_CHNL_COUNT)
+			{
+				WTSLogger::warn("Invalid replay request from {}", peer);
+				return;
+			}
+
+			UDPBatchPacker packer;
+			packer.init((uint16_t)req->_channel, m_uEpoch, m_uMTU);
+
+			std::shared_ptr<std::string> resp(new std::string);
+			uint64_t cnt = m_replayRings[req->_channel].make_replay(req->_from, req->_to, packer, *resp);
+			WTSLogger::info("{} of [{}, {}) on channel {} replayed to {}", cnt, req->_from, req->_to, req->_channel, peer);
+
+			boost::asio::async_write(*sock, boost::asio::buffer(*resp),
+				[sock, resp](const boost::system::error_code& /*ec*/, std::size_t /*bytes_sent*/) {
+			});
+		});
+
+		do_accept_replay();
+	});
 }
 
 void UDPCaster::handle_send_broad(const EndPoint& ep, const boost::system::error_code& error, std::size_t bytes_transferred)
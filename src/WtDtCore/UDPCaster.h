@@ -11,6 +11,7 @@
 #include "IDataCaster.h"
 #include "../Includes/WTSObject.hpp"
 #include "../Share/StdUtils.hpp"
+#include "../Share/UDPBatchProto.hpp"
 
 #include <boost/asio.hpp>
 #include <queue>
@@ -72,6 +73,10 @@ public:
 private:
 	typedef boost::asio::ip::udp::socket	UDPSocket;
 	typedef std::shared_ptr<UDPSocket>		UDPSocketPtr;
+	typedef boost::asio::ip::tcp::acceptor	TCPAcceptor;
+	typedef std::shared_ptr<TCPAcceptor>	TCPAcceptorPtr;
+	typedef boost::asio::ip::tcp::socket	TCPSocket;
+	typedef std::shared_ptr<TCPSocket>		TCPSocketPtr;
 
 	enum 
 	{ 
@@ -134,4 +139,40 @@ private:
 	} CastData;
 
 	std::queue<CastData>		m_dataQue;
+
+private:
+	void	cast_loop();
+
+	/*
+	 *	v1协议，一条数据一个数据报
+	 */
+	bool	send_raw(const CastData& castData);
+
+	/*
+	 *	v2协议，数据打包到所属通道的数据报里
+	 */
+	void	pack_data(const CastData& castData);
+	void	flush_channel(uint32_t chnl);
+	void	flush_batches(bool bForce);
+	bool	has_pending() const;
+	void	send_datagrams();
+	void	send_datagrams(UDPSocketPtr& sock, const EndPoint& ep);
+
+	void	do_accept_replay();
+
+private:
+	uint32_t		m_uProtocol;	//1为一条数据一个数据报，2为批量打包带序号
+	uint32_t		m_uMTU;			//v2数据报的最大长度
+	uint32_t		m_uFlushUs;		//v2数据报最多等待多少微秒就发出去
+	bool			m_bUseMmsg;		//linux下用sendmmsg批量发送
+	uint32_t		m_uEpoch;
+
+	UDPBatchPacker	m_packers[UDP_CHNL_COUNT];
+	int64_t			m_tmPending[UDP_CHNL_COUNT];	//数据报里第一条数据打包的时间
+	UDPReplayRing	m_replayRings[UDP_CHNL_COUNT];
+	std::vector<std::string>	m_vecDatagrams;	//待发送的数据报
+
+	uint32_t		m_uReplayPort;
+	uint32_t		m_uReplayCap;
+	TCPAcceptorPtr	m_acptReplay;
 };
\ No newline at end of file
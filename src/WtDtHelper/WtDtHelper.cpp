@@ -11,9 +11,14 @@
 #include "../Share/StrUtil.hpp"
 #include "../Share/TimeUtils.hpp"
 #include "../Share/BoostFile.hpp"
+#include "../Share/TradeJournal.hpp"
+#include "../Share/BarCacheFile.hpp"
+#include "../Share/FastCsvReader.hpp"
+#include "../Share/fmtlib.h"
 
 #include "../WtDataStorage/DataDefine.h"
 #include "../WTSUtils/WTSCmpHelper.hpp"
+#include "../WtDataStorage/ChunkHelper.hpp"
 #include "../WTSTools/CsvHelper.h"
 #include "../WTSTools/WTSDataFactory.h"
 
@@ -22,6 +27,11 @@
 
 #include <rapidjson/document.h>
 
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+
 namespace rj = rapidjson;
 
 USING_NS_WTP;
@@ -55,7 +65,7 @@ bool proc_block_data(std::string& content, bool isBar, bool bKeepHead /* = true
 		}
 
 		//将文件头后面的数据进行解压
-		buffer = WTSCmpHelper::uncompress_data(content.data() + BLOCK_HEADERV2_SIZE, blkV2->_size);
+		ChunkHelper::uncompress_append(buffer, blkV2);
 	}
 	else
 	{
@@ -157,314 +167,670 @@ uint32_t strToDate(const char* strDate)
 	return strtoul(ss.str().c_str(), NULL, 10);
 }
 
-void dump_bars(WtString binFolder, WtString csvFolder, WtString strFilter /* = "" */, FuncLogCallback cbLogger /* = NULL */)
+/*
+ *	日志回调可能被多个线程同时调用，加锁以后再回调
+ */
+static void safe_log(FuncLogCallback cbLogger, const char* message)
 {
-	std::string srcFolder = StrUtil::standardisePath(binFolder);
-	if (!BoostFile::exists(srcFolder.c_str()))
-	{
-		if (cbLogger)
-			cbLogger(StrUtil::printf("目录%s不存在", binFolder).c_str());
+	if (cbLogger == NULL)
 		return;
-	}
 
-	if (!BoostFile::exists(csvFolder))
-		BoostFile::create_directories(csvFolder);
+	static std::mutex mtx;
+	std::unique_lock<std::mutex> lock(mtx);
+	cbLogger(message);
+}
 
-	boost::filesystem::path myPath(srcFolder);
-	boost::filesystem::directory_iterator endIter;
-	for (boost::filesystem::directory_iterator iter(myPath); iter != endIter; iter++)
+/*
+ *	分段写入的csv文件，缓冲区超过阈值就写到文件里，导出大文件的时候内存占用不会随文件大小增长
+ */
+class ChunkedCsvWriter
+{
+public:
+	ChunkedCsvWriter(std::size_t threshold = 4 * 1024 * 1024) :_threshold(threshold), _bytes(0)
 	{
-		if (boost::filesystem::is_directory(iter->path()))
-			continue;
-
-		if (iter->path().extension() != ".dsb")
-			continue;
-
-		const std::string& path = iter->path().string();
+		_buffer.reserve(threshold + 4096);
+	}
 
-		std::string fileCode = iter->path().stem().string();
+	~ChunkedCsvWriter() { close(); }
 
-		if (cbLogger)
-			cbLogger(StrUtil::printf("正在读取数据文件%s...", path.c_str()).c_str());
+	bool open(const char* filename) { return _file.create_new_file(filename); }
 
-		std::string buffer;
-		BoostFile::read_file_contents(path.c_str(), buffer);
-		if (buffer.size() < sizeof(HisKlineBlock))
-		{
-			if (cbLogger)
-				cbLogger(StrUtil::printf("文件%s头部校验失败", binFolder).c_str());
-			continue;
-		}
+	inline void append(const char* str) { _buffer.append(str); }
 
-		BlockHeader* bHeader = (BlockHeader*)buffer.data();
+	//浮点数和std::fixed输出的格式一样，保留6位小数
+	template<typename T>
+	inline typename std::enable_if<std::is_floating_point<T>::value>::type put(T val, char tail = ',')
+	{
+		fmt::format_to(std::back_inserter(_buffer), "{:.6f}", val);
+		_buffer.push_back(tail);
+	}
 
-		if(bHeader->_type < BT_HIS_Minute1 || bHeader->_type > BT_HIS_Day)
-		{
-			if (cbLogger)
-				cbLogger(StrUtil::printf("文件%s不是K线数据，跳过转换", binFolder).c_str());
-			continue;
-		}
+	template<typename T>
+	inline typename std::enable_if<!std::is_floating_point<T>::value>::type put(const T& val, char tail = ',')
+	{
+		fmt::format_to(std::back_inserter(_buffer), "{}", val);
+		_buffer.push_back(tail);
+	}
 
-		bool isDay = (bHeader->_type == BT_HIS_Day);
+	/*
+	 *	一行写完以后调用，缓冲区满了就写到文件里
+	 */
+	inline void end_row()
+	{
+		_buffer.back() = '\n';
+		if (_buffer.size() >= _threshold)
+			flush();
+	}
 
-		proc_block_data(buffer, true, false);		
+	void flush()
+	{
+		if (_buffer.empty())
+			return;
 
-		auto kcnt = buffer.size() / sizeof(WTSBarStruct);
-		if (kcnt <= 0)
-			continue;
+		_file.write_file(_buffer.data(), _buffer.size());
+		_bytes += _buffer.size();
+		_buffer.clear();
+	}
 
-		std::string filename = StrUtil::standardisePath(csvFolder);
-		filename += fileCode;
-		filename += ".csv";
+	void close()
+	{
+		flush();
+		_file.close_file();
+	}
 
-		if (cbLogger)
-			cbLogger(StrUtil::printf("正在写入%s...", filename.c_str()).c_str());
+	inline uint64_t bytes() const { return _bytes + _buffer.size(); }
 
-		WTSBarStruct* bars = (WTSBarStruct*)buffer.data();
+private:
+	BoostFile	_file;
+	std::string	_buffer;
+	std::size_t	_threshold;
+	uint64_t	_bytes;
+};
 
-		std::stringstream ss;
-		ss << "date,time,open,high,low,close,settle,volume,turnover,open_interest,diff_interest" << std::endl;
-		ss.setf(std::ios::fixed);
+/*
+ *	K线写成csv，列和dump_bars一致
+ */
+static bool write_bars_csv(const char* filename, const WTSBarStruct* bars, std::size_t count, bool isDay)
+{
+	ChunkedCsvWriter writer;
+	if (!writer.open(filename))
+		return false;
 
-		for (uint32_t i = 0; i < kcnt; i++)
+	writer.append("date,time,open,high,low,close,settle,volume,turnover,open_interest,diff_interest\n");
+	for (std::size_t i = 0; i < count; i++)
+	{
+		const WTSBarStruct& curBar = bars[i];
+		if (isDay)
 		{
-			const WTSBarStruct& curBar = bars[i];
-			if(isDay)
-			{
-				ss << curBar.date << ",0,";
-			}
-			else
-			{
-				uint32_t barTime = (uint32_t)(curBar.time % 10000 * 100);
-				uint32_t barDate = (uint32_t)(curBar.time / 10000 + 19900000);
-				ss << barDate << ","
-					<< barTime << ",";
-			}
-			
-			ss << curBar.open << ","
-				<< curBar.high << ","
-				<< curBar.low << ","
-				<< curBar.close << ","
-				<< curBar.settle << ","
-				<< curBar.vol << ","
-				<< curBar.money << ","
-				<< curBar.hold << ","
-				<< curBar.add << std::endl;
+			writer.put(curBar.date);
+			writer.put(0);
+		}
+		else
+		{
+			writer.put((uint32_t)(curBar.time / 10000 + 19900000));
+			writer.put((uint32_t)(curBar.time % 10000 * 100));
 		}
 
-		BoostFile::write_file_contents(filename.c_str(), ss.str().c_str(), (uint32_t)ss.str().size());
-
-		if (cbLogger)
-			cbLogger(StrUtil::printf("%s写入完成,共%u条bar", filename.c_str(), kcnt).c_str());
+		writer.put(curBar.open);
+		writer.put(curBar.high);
+		writer.put(curBar.low);
+		writer.put(curBar.close);
+		writer.put(curBar.settle);
+		writer.put(curBar.vol);
+		writer.put(curBar.money);
+		writer.put(curBar.hold);
+		writer.put(curBar.add);
+		writer.end_row();
 	}
-
-	if (cbLogger)
-		cbLogger(StrUtil::printf("目录%s全部导出完成...", binFolder).c_str());
+	writer.close();
+	return true;
 }
 
-void dump_ticks(WtString binFolder, WtString csvFolder, WtString strFilter /* = "" */, FuncLogCallback cbLogger /* = NULL */)
+/*
+ *	单个文件的处理结果，批量处理时用来统计吞吐量
+ */
+typedef struct _FileStat
 {
-	std::string srcFolder = StrUtil::standardisePath(binFolder);
-	if (!BoostFile::exists(srcFolder.c_str()))
+	uint64_t	_records;
+	uint64_t	_bytes;		//读取的原始数据字节数
+
+	_FileStat() :_records(0), _bytes(0) {}
+} FileStat;
+
+/*
+ *	将一个dsb格式的K线文件导出为csv
+ *	bVerbose为false时只输出错误信息，批量处理的时候用
+ */
+static bool dump_bar_file(const boost::filesystem::path& srcPath, const std::string& csvFolder, FileStat& stat, FuncLogCallback cbLogger, bool bVerbose)
+{
+	const std::string& path = srcPath.string();
+	std::string fileCode = srcPath.stem().string();
+
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("正在读取数据文件%s...", path.c_str()).c_str());
+
+	std::string buffer;
+	BoostFile::read_file_contents(path.c_str(), buffer);
+	stat._bytes += buffer.size();
+	if (buffer.size() < sizeof(HisKlineBlock))
 	{
-		if (cbLogger)
-			cbLogger(StrUtil::printf("目录%s不存在", binFolder).c_str());
-		return;
+		safe_log(cbLogger, StrUtil::printf("文件%s头部校验失败", path.c_str()).c_str());
+		return false;
 	}
 
-	if (!BoostFile::exists(csvFolder))
-		BoostFile::create_directories(csvFolder);
+	BlockHeader* bHeader = (BlockHeader*)buffer.data();
+	if (bHeader->_type < BT_HIS_Minute1 || bHeader->_type > BT_HIS_Day)
+	{
+		safe_log(cbLogger, StrUtil::printf("文件%s不是K线数据，跳过转换", path.c_str()).c_str());
+		return false;
+	}
 
-	boost::filesystem::path myPath(srcFolder);
-	boost::filesystem::directory_iterator endIter;
-	for (boost::filesystem::directory_iterator iter(myPath); iter != endIter; iter++)
+	bool isDay = (bHeader->_type == BT_HIS_Day);
+
+	proc_block_data(buffer, true, false);
+
+	auto kcnt = buffer.size() / sizeof(WTSBarStruct);
+	if (kcnt <= 0)
+		return false;
+
+	std::string filename = csvFolder;
+	filename += fileCode;
+	filename += ".csv";
+
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("正在写入%s...", filename.c_str()).c_str());
+
+	if (!write_bars_csv(filename.c_str(), (const WTSBarStruct*)buffer.data(), kcnt, isDay))
 	{
-		if (boost::filesystem::is_directory(iter->path()))
-			continue;
+		safe_log(cbLogger, StrUtil::printf("文件%s创建失败", filename.c_str()).c_str());
+		return false;
+	}
+	stat._records += kcnt;
 
-		if (iter->path().extension() != ".dsb")
-			continue;
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("%s写入完成,共%u条bar", filename.c_str(), kcnt).c_str());
+	return true;
+}
 
-		const std::string& path = iter->path().string();
+/*
+ *	将一个dsb格式的tick文件导出为csv
+ */
+static bool dump_tick_file(const boost::filesystem::path& srcPath, const std::string& csvFolder, FileStat& stat, FuncLogCallback cbLogger, bool bVerbose)
+{
+	const std::string& path = srcPath.string();
+	std::string fileCode = srcPath.stem().string();
 
-		std::string fileCode = iter->path().stem().string();
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("正在读取数据文件%s...", path.c_str()).c_str());
 
-		if (cbLogger)
-			cbLogger(StrUtil::printf("正在读取数据文件%s...", path.c_str()).c_str());
+	std::string buffer;
+	BoostFile::read_file_contents(path.c_str(), buffer);
+	stat._bytes += buffer.size();
+	if (buffer.size() < sizeof(HisTickBlock))
+	{
+		safe_log(cbLogger, StrUtil::printf("文件%s头部校验失败", path.c_str()).c_str());
+		return false;
+	}
 
-		std::string buffer;
-		BoostFile::read_file_contents(path.c_str(), buffer);
-		if (buffer.size() < sizeof(HisTickBlock))
-		{
-			if (cbLogger)
-				cbLogger(StrUtil::printf("文件%s头部校验失败", binFolder).c_str());
-			continue;
-		}
+	//单帧压缩的新版本数据边解压边写，不需要把整个文件解压到内存里
+	BlockHeader* header = (BlockHeader*)buffer.data();
+	BlockHeaderV2* blkV2 = (BlockHeaderV2*)buffer.data();
+	bool bStream = header->is_compressed() && !header->is_old_version() && buffer.size() >= sizeof(BlockHeaderV2)
+		&& !blkV2->is_chunked() && buffer.size() == (sizeof(BlockHeaderV2) + blkV2->_size);
 
+	std::size_t tcnt = 0;
+	if (bStream)
+	{
+		tcnt = WTSCmpHelper::uncompressed_size(buffer.data() + sizeof(BlockHeaderV2), (std::size_t)blkV2->_size) / sizeof(WTSTickStruct);
+	}
+	else
+	{
 		proc_block_data(buffer, false, false);
+		tcnt = buffer.size() / sizeof(WTSTickStruct);
+	}
 
-		auto tcnt = buffer.size() / sizeof(WTSTickStruct);
-		if (tcnt <= 0)
-			continue;
+	if (tcnt == 0)
+		return false;
 
-		std::string filename = StrUtil::standardisePath(csvFolder);
-		filename += fileCode;
-		filename += ".csv";
+	std::string filename = csvFolder;
+	filename += fileCode;
+	filename += ".csv";
 
-		if (cbLogger)
-			cbLogger(StrUtil::printf("正在写入%s...", filename.c_str()).c_str());
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("正在写入%s...", filename.c_str()).c_str());
 
-		WTSTickStruct* ticks = (WTSTickStruct*)buffer.data();
+	ChunkedCsvWriter writer;
+	if (!writer.open(filename.c_str()))
+	{
+		safe_log(cbLogger, StrUtil::printf("文件%s创建失败", filename.c_str()).c_str());
+		return false;
+	}
 
-		std::stringstream ss;
-		ss.setf(std::ios::fixed, std::ios::floatfield);
-		ss.precision(6);
-		ss << "exchg,code,tradingdate,actiondate,actiontime,price,open,high,low,settle,preclose,"
-			<< "presettle,preinterest,total_volume,total_turnover,open_interest,volume,turnover,additional,";
-		for (int i = 0; i < 10; i++)
-		{
-			bool hasTail = (i != 9);
-			ss << "bidprice" << i + 1 << "," << "bidqty" << i + 1 << "," << "askprice" << i + 1 << "," << "askqty" << i + 1 << (hasTail ? "," : "");
-		}
-		ss << std::endl;
+	writer.append("exchg,code,tradingdate,actiondate,actiontime,price,open,high,low,settle,preclose,"
+		"presettle,preinterest,total_volume,total_turnover,open_interest,volume,turnover,additional,");
+	for (int i = 0; i < 10; i++)
+	{
+		bool hasTail = (i != 9);
+		writer.append(StrUtil::printf("bidprice%d,bidqty%d,askprice%d,askqty%d%s", i + 1, i + 1, i + 1, i + 1, hasTail ? "," : "\n").c_str());
+	}
 
-		for (uint32_t i = 0; i < tcnt; i++)
+	auto write_ticks = [&writer](const WTSTickStruct* ticks, std::size_t cnt) {
+		for (std::size_t i = 0; i < cnt; i++)
 		{
 			const WTSTickStruct& curTick = ticks[i];
-			ss << curTick.exchg << "," << curTick.code << ","
-				<< curTick.trading_date << ","
-				<< curTick.action_date << ","
-				<< curTick.action_time << ","
-				<< curTick.price << ","
-				<< curTick.open << ","
-				<< curTick.high << ","
-				<< curTick.low << ","
-				<< curTick.settle_price << ","
-				<< curTick.pre_close << ","
-				<< curTick.pre_settle << ","
-				<< curTick.pre_interest << ","
-				<< curTick.total_volume << ","
-				<< curTick.total_turnover << ","
-				<< curTick.open_interest << ","
-				<< curTick.volume << ","
-				<< curTick.turn_over << ","
-				<< curTick.diff_interest << ",";
+			writer.put(curTick.exchg);
+			writer.put(curTick.code);
+			writer.put(curTick.trading_date);
+			writer.put(curTick.action_date);
+			writer.put(curTick.action_time);
+			writer.put(curTick.price);
+			writer.put(curTick.open);
+			writer.put(curTick.high);
+			writer.put(curTick.low);
+			writer.put(curTick.settle_price);
+			writer.put(curTick.pre_close);
+			writer.put(curTick.pre_settle);
+			writer.put(curTick.pre_interest);
+			writer.put(curTick.total_volume);
+			writer.put(curTick.total_turnover);
+			writer.put(curTick.open_interest);
+			writer.put(curTick.volume);
+			writer.put(curTick.turn_over);
+			writer.put(curTick.diff_interest);
 
 			for (int j = 0; j < 10; j++)
 			{
-				bool hasTail = (j != 9);
-				ss << curTick.bid_prices[j] << "," << curTick.bid_qty[j] << "," << curTick.ask_prices[j] << "," << curTick.ask_qty[j] << (hasTail ? "," : "");
+				writer.put(curTick.bid_prices[j]);
+				writer.put(curTick.bid_qty[j]);
+				writer.put(curTick.ask_prices[j]);
+				writer.put(curTick.ask_qty[j]);
 			}
-			ss << std::endl;
+			writer.end_row();
 		}
+	};
 
-		BoostFile::write_file_contents(filename.c_str(), ss.str().c_str(), (uint32_t)ss.str().size());
+	if (bStream)
+	{
+		//每次解压一小块，解压出来的数据还在缓存里的时候就写掉
+		std::vector<WTSTickStruct> chunk(256);
+		WTSCmpStream stream;
+		stream.reset(buffer.data() + sizeof(BlockHeaderV2), (std::size_t)blkV2->_size);
+		stream.for_each_chunk(chunk.data(), chunk.size(), write_ticks);
+	}
+	else
+	{
+		write_ticks((const WTSTickStruct*)buffer.data(), tcnt);
+	}
+	writer.close();
+	stat._records += tcnt;
 
-		if (cbLogger)
-			cbLogger(StrUtil::printf("%s写入完成,共%u条tick数据", filename.c_str(), tcnt).c_str());
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("%s写入完成,共%u条tick数据", filename.c_str(), tcnt).c_str());
+	return true;
+}
+
+/*
+ *	将一个csv格式的K线文件转成dsb
+ */
+static bool trans_csv_bar_file(const boost::filesystem::path& srcPath, const std::string& binFolder, WTSKlinePeriod kp, FileStat& stat, FuncLogCallback cbLogger, bool bVerbose)
+{
+	const std::string& path = srcPath.string();
+
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("正在读取数据文件%s...", path.c_str()).c_str());
+
+	FastCsvReader reader;
+	if (!reader.load_from_file(path.c_str()))
+	{
+		safe_log(cbLogger, StrUtil::printf("读取数据文件%s失败...", path.c_str()).c_str());
+		return false;
+	}
+	stat._bytes += boost::filesystem::file_size(srcPath);
+
+	//先查好列号，逐行读取的时候不再按字段名查找
+	int32_t colDate = reader.col_of("date");
+	int32_t colTime = reader.col_of("time");
+	int32_t colOpen = reader.col_of("open");
+	int32_t colHigh = reader.col_of("high");
+	int32_t colLow = reader.col_of("low");
+	int32_t colClose = reader.col_of("close");
+	int32_t colVol = reader.col_of("volume");
+	int32_t colMoney = reader.col_of("turnover");
+	int32_t colHold = reader.col_of("open_interest");
+	int32_t colAdd = reader.col_of("diff_interest");
+	int32_t colSettle = reader.col_of("settle");
+
+	std::vector<WTSBarStruct> bars;
+	while (reader.next_row())
+	{
+		WTSBarStruct bs;
+		bs.date = reader.get_date(colDate);
+		if (kp != KP_DAY)
+			bs.time = TimeUtils::timeToMinBar(bs.date, reader.get_time(colTime));
+		bs.open = reader.get_double(colOpen);
+		bs.high = reader.get_double(colHigh);
+		bs.low = reader.get_double(colLow);
+		bs.close = reader.get_double(colClose);
+		bs.vol = reader.get_double(colVol);
+		bs.money = reader.get_double(colMoney);
+		bs.hold = reader.get_double(colHold);
+		bs.add = reader.get_double(colAdd);
+		bs.settle = reader.get_double(colSettle);
+		bars.emplace_back(bs);
 	}
 
-	if (cbLogger)
-		cbLogger(StrUtil::printf("目录%s全部导出完成...", binFolder).c_str());
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("数据文件%s全部读取完成,共%u条", path.c_str(), bars.size()).c_str());
+
+	BlockType btype;
+	switch (kp)
+	{
+	case KP_Minute1: btype = BT_HIS_Minute1; break;
+	case KP_Minute5: btype = BT_HIS_Minute5; break;
+	default: btype = BT_HIS_Day; break;
+	}
+
+	std::string filename = binFolder;
+	filename += srcPath.stem().string();
+	filename += ".dsb";
+
+	HisKlineBlockV2 kBlock;
+	strcpy(kBlock._blk_flag, BLK_FLAG);
+	kBlock._type = btype;
+	kBlock._version = BLOCK_VERSION_CMP_V2;
+
+	std::string cmprsData = WTSCmpHelper::compress_data(bars.data(), sizeof(WTSBarStruct)*bars.size());
+	kBlock._size = cmprsData.size();
+
+	BoostFile bf;
+	if (!bf.create_new_file(filename.c_str()))
+	{
+		safe_log(cbLogger, StrUtil::printf("文件%s创建失败", filename.c_str()).c_str());
+		return false;
+	}
+	bf.write_file(&kBlock, sizeof(HisKlineBlockV2));
+	bf.write_file(cmprsData);
+	bf.close_file();
+	stat._records += bars.size();
+
+	if (bVerbose)
+		safe_log(cbLogger, StrUtil::printf("数据已转储至%s", filename.c_str()).c_str());
+	return true;
 }
 
-void trans_csv_bars(WtString csvFolder, WtString binFolder, WtString period, FuncLogCallback cbLogger /* = NULL */)
+/*
+ *	解析交易时间模板，失败返回NULL
+ */
+static WTSSessionInfo* parse_session(WtString sessInfo, FuncLogCallback cbLogger)
 {
-	if (!BoostFile::exists(csvFolder))
-		return;
+	rj::Document root;
+	if (root.Parse(sessInfo).HasParseError())
+	{
+		safe_log(cbLogger, "交易时间模板解析失败");
+		return NULL;
+	}
 
-	if (!BoostFile::exists(binFolder))
-		BoostFile::create_directories(binFolder);
+	int32_t offset = root["offset"].GetInt();
 
-	WTSKlinePeriod kp = KP_DAY;
-	if (wt_stricmp(period, "m1") == 0)
-		kp = KP_Minute1;
-	else if (wt_stricmp(period, "m5") == 0)
-		kp = KP_Minute5;
+	WTSSessionInfo* sInfo = WTSSessionInfo::create("tmp", "tmp", offset);
+
+	if (!root["auction"].IsNull())
+	{
+		const rj::Value& jAuc = root["auction"];
+		sInfo->setAuctionTime(jAuc["from"].GetUint(), jAuc["to"].GetUint());
+	}
+
+	const rj::Value& jSecs = root["sections"];
+	if (jSecs.IsNull() || !jSecs.IsArray())
+	{
+		safe_log(cbLogger, "交易时间模板格式错误");
+		sInfo->release();
+		return NULL;
+	}
+
+	for (const rj::Value& jSec : jSecs.GetArray())
+	{
+		sInfo->addTradingSection(jSec["from"].GetUint(), jSec["to"].GetUint());
+	}
+
+	return sInfo;
+}
+
+/*
+ *	将一个dsb格式的K线文件整体重采样，结果写成csv
+ *	重采样以后的周期不一定有对应的数据块类型，所以不写回dsb
+ */
+static bool resample_bar_file(const boost::filesystem::path& srcPath, const std::string& destFolder, WTSKlinePeriod kp, uint32_t times,
+	WTSSessionInfo* sInfo, bool bAlignSec, FileStat& stat, FuncLogCallback cbLogger)
+{
+	const std::string& path = srcPath.string();
+
+	std::string buffer;
+	BoostFile::read_file_contents(path.c_str(), buffer);
+	stat._bytes += buffer.size();
+	if (buffer.size() < sizeof(HisKlineBlock))
+	{
+		safe_log(cbLogger, StrUtil::printf("文件%s头部校验失败", path.c_str()).c_str());
+		return false;
+	}
+
+	proc_block_data(buffer, true, false);
+
+	auto kcnt = buffer.size() / sizeof(WTSBarStruct);
+	if (kcnt <= 0)
+		return false;
+
+	WTSKlineSlice* slice = WTSKlineSlice::create("", kp, 1, (WTSBarStruct*)buffer.data(), (int32_t)kcnt);
+	WTSDataFactory fact;
+	WTSKlineData* kline = fact.extractKlineData(slice, kp, times, sInfo, true, bAlignSec);
+	slice->release();
+	if (kline == NULL || kline->size() == 0)
+	{
+		safe_log(cbLogger, StrUtil::printf("%s重采样失败", path.c_str()).c_str());
+		if (kline)
+			kline->release();
+		return false;
+	}
+
+	std::string filename = destFolder;
+	filename += srcPath.stem().string();
+	filename += ".csv";
+
+	bool bSucc = write_bars_csv(filename.c_str(), &kline->getDataRef().at(0), kline->size(), kp == KP_DAY);
+	if (bSucc)
+		stat._records += kcnt;
 	else
-		kp = KP_DAY;
+		safe_log(cbLogger, StrUtil::printf("文件%s创建失败", filename.c_str()).c_str());
 
-	boost::filesystem::path myPath(csvFolder);
+	kline->release();
+	return bSucc;
+}
+
+/*
+ *	列出目录下指定扩展名的文件
+ *	strFilter为空则不过滤，否则为逗号分隔的多个代码前缀，文件名以其中任意一个开头就会被处理
+ */
+static void collect_files(const std::string& folder, const char* ext, WtString strFilter, std::vector<boost::filesystem::path>& files)
+{
+	StringVector filters;
+	if (strFilter != NULL && strlen(strFilter) > 0)
+		filters = StrUtil::split(strFilter, ",");
+
+	typedef std::pair<uintmax_t, boost::filesystem::path> SizedPath;
+	std::vector<SizedPath> items;
+
+	boost::filesystem::path myPath(folder);
 	boost::filesystem::directory_iterator endIter;
 	for (boost::filesystem::directory_iterator iter(myPath); iter != endIter; iter++)
 	{
 		if (boost::filesystem::is_directory(iter->path()))
 			continue;
 
-		if (iter->path().extension() != ".csv")
-			continue;
-
-		const std::string& path = iter->path().string();
-
-		if(cbLogger)
-			cbLogger(StrUtil::printf("正在读取数据文件%s...", path.c_str()).c_str());
-
-		CsvReader reader(",");
-		if(!reader.load_from_file(path.c_str()))
-		{
-			if (cbLogger)
-				cbLogger(StrUtil::printf("读取数据文件%s失败...", path.c_str()).c_str());
+		if (iter->path().extension() != ext)
 			continue;
-		}
-
-		std::vector<WTSBarStruct> bars;
 
-		while(reader.next_row())
+		if (!filters.empty())
 		{
-			//逐行读取
-			WTSBarStruct bs;
-			bs.date = strToDate(reader.get_string("date"));
-			if(kp != KP_DAY)
-				bs.time = TimeUtils::timeToMinBar(bs.date, strToTime(reader.get_string("time")));
-			bs.open = reader.get_double("open");
-			bs.high = reader.get_double("high");
-			bs.low = reader.get_double("low");
-			bs.close = reader.get_double("close");
-			bs.vol = reader.get_double("volume");
-			bs.money = reader.get_double("turnover");
-			bs.hold = reader.get_double("open_interest");
-			bs.add = reader.get_double("diff_interest");
-			bs.settle = reader.get_double("settle");
-			bars.emplace_back(bs);
-
-			if (bars.size() % 1000 == 0)
+			std::string fileCode = iter->path().stem().string();
+			bool bMatched = false;
+			for (const std::string& item : filters)
 			{
-				if (cbLogger)
-					cbLogger(StrUtil::printf("已读取数据%u条", bars.size()).c_str());
+				if (StrUtil::startsWith(fileCode.c_str(), item.c_str(), false))
+				{
+					bMatched = true;
+					break;
+				}
 			}
-		}
-		if (cbLogger)
-			cbLogger(StrUtil::printf("数据文件%s全部读取完成,共%u条", path.c_str(), bars.size()).c_str());
 
-		BlockType btype;
-		switch (kp)
-		{
-		case KP_Minute1: btype = BT_HIS_Minute1; break;
-		case KP_Minute5: btype = BT_HIS_Minute5; break;
-		default: btype = BT_HIS_Day; break;
+			if (!bMatched)
+				continue;
 		}
 
-		HisKlineBlockV2 kBlock;
-		strcpy(kBlock._blk_flag, BLK_FLAG);
-		kBlock._type = btype;
-		kBlock._version = BLOCK_VERSION_CMP_V2;
+		items.emplace_back(boost::filesystem::file_size(iter->path()), iter->path());
+	}
 
-		std::string cmprsData = WTSCmpHelper::compress_data(bars.data(), sizeof(WTSBarStruct)*bars.size());
-		kBlock._size = cmprsData.size();
+	//按文件大小从大到小排，大文件先开始处理，最后几个线程不会因为一个大文件拖得太久
+	std::stable_sort(items.begin(), items.end(), [](const SizedPath& a, const SizedPath& b) {
+		return a.first > b.first;
+	});
 
-		std::string filename = StrUtil::standardisePath(binFolder);
-		filename += iter->path().stem().string();
-		filename += ".dsb";
+	for (SizedPath& item : items)
+		files.emplace_back(std::move(item.second));
+}
 
-		BoostFile bf;
-		if (bf.create_new_file(filename.c_str()))
+/*
+ *	多线程批量处理文件
+ *	每个线程每次从列表里取一个文件处理完再取下一个，同时在内存里的数据最多只有threads个文件
+ *	处理完以后输出文件数、记录数、耗时和吞吐量
+ */
+template<typename Func>
+static WtUInt32 run_batch(const std::vector<boost::filesystem::path>& files, WtUInt32 threads, const char* action, FuncLogCallback cbLogger, Func func)
+{
+	if (threads == 0)
+		threads = std::max(std::thread::hardware_concurrency(), 1U);
+	if (threads > files.size())
+		threads = (WtUInt32)std::max(files.size(), (std::size_t)1);
+
+	safe_log(cbLogger, StrUtil::printf("开始%s，共%u个文件，线程数%u", action, (uint32_t)files.size(), threads).c_str());
+
+	std::atomic<std::size_t> nextIdx(0);
+	std::atomic<uint32_t> succCnt(0);
+	std::atomic<uint64_t> records(0);
+	std::atomic<uint64_t> bytes(0);
+	std::size_t step = std::max(files.size() / 20, (std::size_t)1);
+
+	TimeUtils::Ticker ticker;
+	auto worker = [&]() {
+		for (;;)
 		{
-			bf.write_file(&kBlock, sizeof(HisKlineBlockV2));
+			std::size_t idx = nextIdx.fetch_add(1);
+			if (idx >= files.size())
+				break;
+
+			FileStat stat;
+			if (func(files[idx], stat))
+				succCnt.fetch_add(1);
+			records.fetch_add(stat._records);
+			bytes.fetch_add(stat._bytes);
+
+			if ((idx + 1) % step == 0)
+				safe_log(cbLogger, StrUtil::printf("%s进度%u/%u", action, (uint32_t)(idx + 1), (uint32_t)files.size()).c_str());
 		}
-		bf.write_file(cmprsData);
-		bf.close_file();
+	};
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threads; i++)
+		workers.emplace_back(worker);
+	worker();
+	for (std::thread& t : workers)
+		t.join();
+
+	double secs = std::max(ticker.milli_seconds(), (int64_t)1) / 1000.0;
+	safe_log(cbLogger, StrUtil::printf("%s完成，成功%u/%u个文件，共%llu条记录，读取%.2fMB，耗时%.3f秒，%.0f条/秒，%.2fMB/秒",
+		action, succCnt.load(), (uint32_t)files.size(), (unsigned long long)records.load(), bytes.load() / 1048576.0,
+		secs, records.load() / secs, bytes.load() / 1048576.0 / secs).c_str());
+
+	return succCnt.load();
+}
+
+static WTSKlinePeriod csv_period(WtString period)
+{
+	if (wt_stricmp(period, "m1") == 0)
+		return KP_Minute1;
+	else if (wt_stricmp(period, "m5") == 0)
+		return KP_Minute5;
+	else
+		return KP_DAY;
+}
+
+void dump_bars(WtString binFolder, WtString csvFolder, WtString strFilter /* = "" */, FuncLogCallback cbLogger /* = NULL */)
+{
+	std::string srcFolder = StrUtil::standardisePath(binFolder);
+	if (!BoostFile::exists(srcFolder.c_str()))
+	{
 		if (cbLogger)
-			cbLogger(StrUtil::printf("数据已转储至%s", filename.c_str()).c_str());
+			cbLogger(StrUtil::printf("目录%s不存在", binFolder).c_str());
+		return;
+	}
+
+	if (!BoostFile::exists(csvFolder))
+		BoostFile::create_directories(csvFolder);
+
+	std::string destFolder = StrUtil::standardisePath(csvFolder);
+	std::vector<boost::filesystem::path> files;
+	collect_files(srcFolder, ".dsb", strFilter, files);
+	for (const boost::filesystem::path& path : files)
+	{
+		FileStat stat;
+		dump_bar_file(path, destFolder, stat, cbLogger, true);
+	}
+
+	if (cbLogger)
+		cbLogger(StrUtil::printf("目录%s全部导出完成...", binFolder).c_str());
+}
+
+void dump_ticks(WtString binFolder, WtString csvFolder, WtString strFilter /* = "" */, FuncLogCallback cbLogger /* = NULL */)
+{
+	std::string srcFolder = StrUtil::standardisePath(binFolder);
+	if (!BoostFile::exists(srcFolder.c_str()))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("目录%s不存在", binFolder).c_str());
+		return;
+	}
+
+	if (!BoostFile::exists(csvFolder))
+		BoostFile::create_directories(csvFolder);
+
+	std::string destFolder = StrUtil::standardisePath(csvFolder);
+	std::vector<boost::filesystem::path> files;
+	collect_files(srcFolder, ".dsb", strFilter, files);
+	for (const boost::filesystem::path& path : files)
+	{
+		FileStat stat;
+		dump_tick_file(path, destFolder, stat, cbLogger, true);
+	}
+
+	if (cbLogger)
+		cbLogger(StrUtil::printf("目录%s全部导出完成...", binFolder).c_str());
+}
+
+void trans_csv_bars(WtString csvFolder, WtString binFolder, WtString period, FuncLogCallback cbLogger /* = NULL */)
+{
+	if (!BoostFile::exists(csvFolder))
+		return;
+
+	if (!BoostFile::exists(binFolder))
+		BoostFile::create_directories(binFolder);
+
+	WTSKlinePeriod kp = csv_period(period);
+	std::string destFolder = StrUtil::standardisePath(binFolder);
+	std::vector<boost::filesystem::path> files;
+	collect_files(csvFolder, ".csv", "", files);
+	for (const boost::filesystem::path& path : files)
+	{
+		FileStat stat;
+		trans_csv_bar_file(path, destFolder, kp, stat, cbLogger, true);
 	}
 }
 
@@ -874,39 +1240,9 @@ WtUInt32 resample_bars(WtString barFile, FuncGetBarsCallback cb, FuncCountDataCa
 		std::swap(fromTime, endTime);
 	}
 
-	WTSSessionInfo* sInfo = NULL;
-	{
-		rj::Document root;
-		if (root.Parse(sessInfo).HasParseError())
-		{
-			if (cbLogger)
-				cbLogger("交易时间模板解析失败");
-			return 0;
-		}
-
-		int32_t offset = root["offset"].GetInt();
-
-		sInfo = WTSSessionInfo::create("tmp", "tmp", offset);
-
-		if (!root["auction"].IsNull())
-		{
-			const rj::Value& jAuc = root["auction"];
-			sInfo->setAuctionTime(jAuc["from"].GetUint(), jAuc["to"].GetUint());
-		}
-
-		const rj::Value& jSecs = root["sections"];
-		if (jSecs.IsNull() || !jSecs.IsArray())
-		{
-			if (cbLogger)
-				cbLogger("交易时间模板格式错误");
-			return 0;
-		}
-
-		for (const rj::Value& jSec : jSecs.GetArray())
-		{
-			sInfo->addTradingSection(jSec["from"].GetUint(), jSec["to"].GetUint());
-		}
-	}
+	WTSSessionInfo* sInfo = parse_session(sessInfo, cbLogger);
+	if (sInfo == NULL)
+		return 0;
 
 	std::string path = barFile;
 	if (cbLogger)
@@ -1229,4 +1565,245 @@ bool store_transactions(WtString tickFile, WTSTransStruct* firstItem, int count,
 		cbLogger("Write transactions to file succeedd");
 
 	return true;
-}
\ No newline at end of file
+}
+
+template<typename T>
+static std::string chunk_items(const std::string& content, uint32_t chunkItems)
+{
+	return ChunkHelper::compress_chunks((const T*)content.data(), content.size() / sizeof(T), chunkItems);
+}
+
+bool trans_dsb_to_chunked(WtString srcFile, WtString destFile, WtUInt32 chunkItems /* = 0 */, FuncLogCallback cbLogger /* = NULL */)
+{
+	std::string content;
+	BoostFile::read_file_contents(srcFile, content);
+	if (content.size() < sizeof(BlockHeader))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s头部校验失败", srcFile).c_str());
+		return false;
+	}
+
+	BlockHeader* header = (BlockHeader*)content.data();
+	uint16_t blkType = header->_type;
+	bool isBar = (blkType == BT_HIS_Minute1 || blkType == BT_HIS_Minute5 || blkType == BT_HIS_Day);
+	if (!proc_block_data(content, isBar, false))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s数据校验失败", srcFile).c_str());
+		return false;
+	}
+
+	std::string cmpData;
+	switch (blkType)
+	{
+	case BT_HIS_Minute1:
+	case BT_HIS_Minute5:
+	case BT_HIS_Day:
+		cmpData = chunk_items<WTSBarStruct>(content, chunkItems); break;
+	case BT_HIS_Ticks:
+		cmpData = chunk_items<WTSTickStruct>(content, chunkItems); break;
+	case BT_HIS_Trnsctn:
+		cmpData = chunk_items<WTSTransStruct>(content, chunkItems); break;
+	case BT_HIS_OrdDetail:
+		cmpData = chunk_items<WTSOrdDtlStruct>(content, chunkItems); break;
+	case BT_HIS_OrdQueue:
+		cmpData = chunk_items<WTSOrdQueStruct>(content, chunkItems); break;
+	default:
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s的数据类型%u不支持分块压缩", srcFile, blkType).c_str());
+		return false;
+	}
+
+	std::string buffer;
+	buffer.resize(sizeof(BlockHeaderV2));
+	BlockHeaderV2* block = (BlockHeaderV2*)buffer.data();
+	strcpy(block->_blk_flag, BLK_FLAG);
+	block->_version = BLOCK_VERSION_CHK_V2;
+	block->_type = blkType;
+	block->_size = cmpData.size();
+	buffer.append(cmpData);
+
+	BoostFile bf;
+	if (!bf.create_new_file(destFile))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s创建失败", destFile).c_str());
+		return false;
+	}
+	bf.write_file(buffer);
+	bf.close_file();
+
+	if (cbLogger)
+		cbLogger(StrUtil::printf("%s已转换为分块压缩格式，写入%s", srcFile, destFile).c_str());
+
+	return true;
+}
+
+bool trans_journal_to_csv(WtString binFile, WtString csvFile, FuncLogCallback cbLogger /* = NULL */)
+{
+	if (!BoostFile::exists(binFile))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s不存在", binFile).c_str());
+		return false;
+	}
+
+	if (!TradeJournal::bin_to_csv(binFile, csvFile))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s不是有效的交易日志", binFile).c_str());
+		return false;
+	}
+
+	if (cbLogger)
+		cbLogger(StrUtil::printf("交易日志%s已转换为csv，写入%s", binFile, csvFile).c_str());
+
+	return true;
+}
+
+bool build_bar_cache(WtString barFile, WtString cacheFile, FuncLogCallback cbLogger /* = NULL */)
+{
+	std::string content;
+	BoostFile::read_file_contents(barFile, content);
+	if (content.size() < sizeof(BlockHeader))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s头部校验失败", barFile).c_str());
+		return false;
+	}
+
+	BlockHeader* header = (BlockHeader*)content.data();
+	if (header->_type < BT_HIS_Minute1 || header->_type > BT_HIS_Day)
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s不是K线数据", barFile).c_str());
+		return false;
+	}
+
+	if (!proc_block_data(content, true, false))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s数据校验失败", barFile).c_str());
+		return false;
+	}
+
+	std::string folder = StrUtil::standardisePath(boost::filesystem::path(cacheFile).parent_path().string());
+	if (!folder.empty() && !BoostFile::exists(folder.c_str()))
+		BoostFile::create_directories(folder.c_str());
+
+	uint64_t kcnt = content.size() / sizeof(WTSBarStruct);
+	if (!BarCacheFile::write(cacheFile, (const WTSBarStruct*)content.data(), kcnt))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s写入失败", cacheFile).c_str());
+		return false;
+	}
+
+	if (cbLogger)
+		cbLogger(StrUtil::printf("%s已生成K线缓存%s，共%u条bar", barFile, cacheFile, (uint32_t)kcnt).c_str());
+
+	return true;
+}
+
+WtUInt32 batch_dump_bars(WtString binFolder, WtString csvFolder, WtString strFilter /* = "" */, WtUInt32 threads /* = 0 */, FuncLogCallback cbLogger /* = NULL */)
+{
+	std::string srcFolder = StrUtil::standardisePath(binFolder);
+	if (!BoostFile::exists(srcFolder.c_str()))
+	{
+		safe_log(cbLogger, StrUtil::printf("目录%s不存在", binFolder).c_str());
+		return 0;
+	}
+
+	if (!BoostFile::exists(csvFolder))
+		BoostFile::create_directories(csvFolder);
+
+	std::string destFolder = StrUtil::standardisePath(csvFolder);
+	std::vector<boost::filesystem::path> files;
+	collect_files(srcFolder, ".dsb", strFilter, files);
+	return run_batch(files, threads, "导出K线", cbLogger, [&](const boost::filesystem::path& path, FileStat& stat) {
+		return dump_bar_file(path, destFolder, stat, cbLogger, false);
+	});
+}
+
+WtUInt32 batch_dump_ticks(WtString binFolder, WtString csvFolder, WtString strFilter /* = "" */, WtUInt32 threads /* = 0 */, FuncLogCallback cbLogger /* = NULL */)
+{
+	std::string srcFolder = StrUtil::standardisePath(binFolder);
+	if (!BoostFile::exists(srcFolder.c_str()))
+	{
+		safe_log(cbLogger, StrUtil::printf("目录%s不存在", binFolder).c_str());
+		return 0;
+	}
+
+	if (!BoostFile::exists(csvFolder))
+		BoostFile::create_directories(csvFolder);
+
+	std::string destFolder = StrUtil::standardisePath(csvFolder);
+	std::vector<boost::filesystem::path> files;
+	collect_files(srcFolder, ".dsb", strFilter, files);
+	return run_batch(files, threads, "导出tick", cbLogger, [&](const boost::filesystem::path& path, FileStat& stat) {
+		return dump_tick_file(path, destFolder, stat, cbLogger, false);
+	});
+}
+
+WtUInt32 batch_trans_csv_bars(WtString csvFolder, WtString binFolder, WtString period, WtString strFilter /* = "" */, WtUInt32 threads /* = 0 */, FuncLogCallback cbLogger /* = NULL */)
+{
+	if (!BoostFile::exists(csvFolder))
+	{
+		safe_log(cbLogger, StrUtil::printf("目录%s不存在", csvFolder).c_str());
+		return 0;
+	}
+
+	if (!BoostFile::exists(binFolder))
+		BoostFile::create_directories(binFolder);
+
+	WTSKlinePeriod kp = csv_period(period);
+	std::string destFolder = StrUtil::standardisePath(binFolder);
+	std::vector<boost::filesystem::path> files;
+	collect_files(csvFolder, ".csv", strFilter, files);
+	return run_batch(files, threads, "转换csv", cbLogger, [&](const boost::filesystem::path& path, FileStat& stat) {
+		return trans_csv_bar_file(path, destFolder, kp, stat, cbLogger, false);
+	});
+}
+
+WtUInt32 batch_resample_bars(WtString binFolder, WtString csvFolder, WtString period, WtUInt32 times, WtString sessInfo,
+	WtString strFilter /* = "" */, WtUInt32 threads /* = 0 */, FuncLogCallback cbLogger /* = NULL */, bool bAlignSec /* = false */)
+{
+	WTSKlinePeriod kp;
+	if (wt_stricmp(period, "m1") == 0)
+		kp = KP_Minute1;
+	else if (wt_stricmp(period, "m5") == 0)
+		kp = KP_Minute5;
+	else if (wt_stricmp(period, "d") == 0)
+		kp = KP_DAY;
+	else
+	{
+		safe_log(cbLogger, StrUtil::printf("周期%s不是基础周期...", period).c_str());
+		return 0;
+	}
+
+	std::string srcFolder = StrUtil::standardisePath(binFolder);
+	if (!BoostFile::exists(srcFolder.c_str()))
+	{
+		safe_log(cbLogger, StrUtil::printf("目录%s不存在", binFolder).c_str());
+		return 0;
+	}
+
+	//交易时间模板只解析一次，重采样的时候只读，各个线程共用
+	WTSSessionInfo* sInfo = parse_session(sessInfo, cbLogger);
+	if (sInfo == NULL)
+		return 0;
+
+	if (!BoostFile::exists(csvFolder))
+		BoostFile::create_directories(csvFolder);
+
+	std::string destFolder = StrUtil::standardisePath(csvFolder);
+	std::vector<boost::filesystem::path> files;
+	collect_files(srcFolder, ".dsb", strFilter, files);
+	WtUInt32 ret = run_batch(files, threads, "重采样K线", cbLogger, [&](const boost::filesystem::path& path, FileStat& stat) {
+		return resample_bar_file(path, destFolder, kp, times, sInfo, bAlignSec, stat, cbLogger);
+	});
+
+	sInfo->release();
+	return ret;
+}
@@ -41,6 +41,15 @@ extern "C"
 	EXPORT_FLAG	void		dump_ticks(WtString binFolder, WtString csvFolder, WtString strFilter = "", FuncLogCallback cbLogger = NULL);
 	EXPORT_FLAG	void		trans_csv_bars(WtString csvFolder, WtString binFolder, WtString period, FuncLogCallback cbLogger = NULL);
 
+	//多线程批量处理目录下的文件，strFilter为逗号分隔的代码前缀，为空则处理全部文件，threads为0则使用CPU核数
+	//返回处理成功的文件数，处理完成以后通过cbLogger输出记录数、耗时和吞吐量
+	EXPORT_FLAG	WtUInt32	batch_dump_bars(WtString binFolder, WtString csvFolder, WtString strFilter = "", WtUInt32 threads = 0, FuncLogCallback cbLogger = NULL);
+	EXPORT_FLAG	WtUInt32	batch_dump_ticks(WtString binFolder, WtString csvFolder, WtString strFilter = "", WtUInt32 threads = 0, FuncLogCallback cbLogger = NULL);
+	EXPORT_FLAG	WtUInt32	batch_trans_csv_bars(WtString csvFolder, WtString binFolder, WtString period, WtString strFilter = "", WtUInt32 threads = 0, FuncLogCallback cbLogger = NULL);
+	//整个文件重采样，结果按dump_bars的格式写成csv
+	EXPORT_FLAG	WtUInt32	batch_resample_bars(WtString binFolder, WtString csvFolder, WtString period, WtUInt32 times, WtString sessInfo,
+		WtString strFilter = "", WtUInt32 threads = 0, FuncLogCallback cbLogger = NULL, bool bAlignSec = false);
+
 	EXPORT_FLAG	WtUInt32	read_dsb_ticks(WtString tickFile, FuncGetTicksCallback cb, FuncCountDataCallback cbCnt, FuncLogCallback cbLogger = NULL);
 	EXPORT_FLAG	WtUInt32	read_dsb_order_details(WtString dataFile, FuncGetOrdDtlCallback cb, FuncCountDataCallback cbCnt, FuncLogCallback cbLogger = NULL);
 	EXPORT_FLAG	WtUInt32	read_dsb_order_queues(WtString dataFile, FuncGetOrdQueCallback cb, FuncCountDataCallback cbCnt, FuncLogCallback cbLogger = NULL);
@@ -62,6 +71,15 @@ extern "C"
 	EXPORT_FLAG bool		store_order_queues(WtString tickFile, WTSOrdQueStruct* firstItem, int count, FuncLogCallback cbLogger = NULL);
 	EXPORT_FLAG bool		store_transactions(WtString tickFile, WTSTransStruct* firstItem, int count, FuncLogCallback cbLogger = NULL);
 
+	//将dsb文件转成分块压缩的格式，chunkItems为每块的条数，0则用默认值
+	EXPORT_FLAG bool		trans_dsb_to_chunked(WtString srcFile, WtString destFile, WtUInt32 chunkItems = 0, FuncLogCallback cbLogger = NULL);
+
+	//将交易通道的二进制订单/成交日志（orders.dat/trades.dat）转成csv
+	EXPORT_FLAG bool		trans_journal_to_csv(WtString binFile, WtString csvFile, FuncLogCallback cbLogger = NULL);
+
+	//将dsb格式的K线文件解压成不压缩的K线缓存文件，回测的时候直接映射到内存
+	EXPORT_FLAG bool		build_bar_cache(WtString barFile, WtString cacheFile, FuncLogCallback cbLogger = NULL);
+
 	EXPORT_FLAG WtUInt32	resample_bars(WtString barFile, FuncGetBarsCallback cb, FuncCountDataCallback cbCnt, 
 		WtUInt64 fromTime, WtUInt64 endTime, WtString period, WtUInt32 times, WtString sessInfo, FuncLogCallback cbLogger = NULL, bool bAlignSec = false);
 #ifdef __cplusplus
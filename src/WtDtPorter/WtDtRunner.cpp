@@ -176,6 +176,12 @@ void WtDtRunner::initialize(const char* cfgFile, const char* logCfg, const char*
 		_data_mgr.add_caster(&_shm_caster);
 	}
 
+	if (config->has("shmbus"))
+	{
+		_shm_bus_caster.init(config->get("shmbus"));
+		_data_mgr.add_caster(&_shm_bus_caster);
+	}
+
 	if(config->has("broadcaster"))
 	{
 		_udp_caster.init(config->get("broadcaster"), &_bd_mgr, &_data_mgr);
@@ -17,6 +17,7 @@
 #include "../WtDtCore/UDPCaster.h"
 #include "../WtDtCore/IndexFactory.h"
 #include "../WtDtCore/ShmCaster.h"
+#include "../WtDtCore/ShmBusCaster.h"
 
 #include "../WTSTools/WTSHotMgr.h"
 #include "../WTSTools/WTSBaseDataMgr.h"
@@ -85,6 +86,7 @@ private:
 	StateMonitor	_state_mon;
 	UDPCaster		_udp_caster;
 	ShmCaster		_shm_caster;
+	ShmBusCaster	_shm_bus_caster;
 	DataManager		_data_mgr;
 	IndexFactory	_idx_factory;
 	ParserAdapterMgr	_parsers;
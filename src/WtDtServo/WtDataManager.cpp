@@ -614,4 +614,12 @@ void WtDataManager::clear_cache()
 
 	_reader->clearCache();
 	WTSLogger::warn("All cache cleared");
-}
\ No newline at end of file
+}
+
+bool WtDataManager::get_cache_stats(WTSCacheStats& stats)
+{
+	if (_reader == NULL)
+		return false;
+
+	return _reader->getCacheStats(stats);
+}
\ No newline at end of file
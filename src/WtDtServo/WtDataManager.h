@@ -91,6 +91,11 @@ public:
 
 	void	clear_cache();
 
+	/*
+	 *	获取数据读取模块的缓存统计
+	 */
+	bool	get_cache_stats(WTSCacheStats& stats);
+
 private:
 	IRdmDtReader*			_reader;
 	FuncDeleteRdmDtReader	_remover;
@@ -655,4 +655,9 @@ void WtDtRunner::trigger_bar(const char* stdCode, const char* period, WTSBarStru
 void WtDtRunner::clear_cache()
 {
 	_data_mgr.clear_cache();
-}
\ No newline at end of file
+}
+
+bool WtDtRunner::get_cache_stats(WTSCacheStats& stats)
+{
+	return _data_mgr.get_cache_stats(stats);
+}
\ No newline at end of file
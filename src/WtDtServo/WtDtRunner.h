@@ -45,6 +45,7 @@ public:
 	void	sub_bar(const char* stdCode, const char* period);
 
 	void	clear_cache();
+	bool	get_cache_stats(WTSCacheStats& stats);
 
 public:
 	WTSKlineSlice*	get_bars_by_range(const char* stdCode, const char* period, uint64_t beginTime, uint64_t endTime = 0);
@@ -237,4 +237,23 @@ void subscribe_bar(const char* stdCode, const char* period)
 void clear_cache()
 {
 	getRunner().clear_cache();
+}
+
+WtString get_cache_stats()
+{
+	static thread_local std::string ret;
+
+	WTSCacheStats stats;
+	if (!getRunner().get_cache_stats(stats))
+		return "{}";
+
+	std::stringstream ss;
+	ss << "{\"hits\":" << stats._hits
+		<< ",\"misses\":" << stats._misses
+		<< ",\"evictions\":" << stats._evictions
+		<< ",\"bytes\":" << stats._bytes
+		<< ",\"budget\":" << stats._budget
+		<< ",\"entries\":" << stats._entries << "}";
+	ret = ss.str();
+	return ret.c_str();
 }
\ No newline at end of file
@@ -40,6 +40,8 @@ extern "C"
 
 	EXPORT_FLAG void		clear_cache();
 
+	EXPORT_FLAG	WtString	get_cache_stats();
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
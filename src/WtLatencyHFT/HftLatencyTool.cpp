@@ -21,6 +21,7 @@
 #include "../Share/StrUtil.hpp"
 #include "../Share/TimeUtils.hpp"
 #include "../Share/CpuHelper.hpp"
+#include "../Share/LatencyStats.hpp"
 
 
 USING_NS_WTP;
@@ -142,6 +143,44 @@ namespace hft
 			WTSLogger::warn("{} ticks simulated in {:.0f} ns, HftEngine Innner Latency: {:.3f} ns", times, total*1.0, t2t);
 		}
 
+		/*
+		 *	对比按代码查找和按合约全局索引查找的耗时
+		 *	按代码查找模拟的是引擎里先查合约、再按代码查订阅表的流程，按索引查找用的是平铺数组
+		 */
+		void	bench_lookup(uint32_t times)
+		{
+			WTSContractInfo* contract = _bd_mgr->getContract("rb2205", "SHFE");
+			if (contract == NULL || contract->getTotalIndex() == UINT_MAX)
+				return;
+
+			wt_hashmap<std::string, uint32_t> codeTable;
+			std::vector<uint32_t> idxTable(_bd_mgr->getIndexedContracts(), 0);
+			codeTable[contract->getFullCode()] = 1;
+			idxTable[contract->getTotalIndex()] = 1;
+
+			uint64_t hits = 0;
+			TimeUtils::Ticker ticker;
+			for (uint32_t i = 0; i < times; i++)
+			{
+				WTSContractInfo* cInfo = _bd_mgr->getContract("rb2205", "SHFE");
+				auto it = codeTable.find(cInfo->getFullCode());
+				if (it != codeTable.end())
+					hits += it->second;
+			}
+			double byCode = ticker.nano_seconds() * 1.0 / times;
+
+			uint32_t idx = contract->getTotalIndex();
+			ticker.reset();
+			for (uint32_t i = 0; i < times; i++)
+			{
+				WTSContractInfo* cInfo = _bd_mgr->getContractByIndex(idx);
+				hits += idxTable[cInfo->getTotalIndex()];
+			}
+			double byIdx = ticker.nano_seconds() * 1.0 / times;
+
+			WTSLogger::warn("Contract lookup latency: {:.3f} ns by code, {:.3f} ns by index, {} hits", byCode, byIdx, hits);
+		}
+
 	public:
 		virtual void registerSpi(IParserSpi* listener) override
 		{
@@ -349,7 +388,20 @@ namespace hft
 
 			_engine.run();
 
+			theParser->bench_lookup(_times);
 			theParser->run(_times);
+
+			//输出各个阶段的延迟分布
+			for (uint32_t s = 0; s < LatencyStats::LS_COUNT; s++)
+			{
+				LatencyStats::StageSummary summary;
+				LatencyStats::summarize((LatencyStats::Stage)s, summary);
+				if (summary._count == 0)
+					continue;
+
+				WTSLogger::info("Latency of {}: count {}, mean {:.1f}ns, p50 {}ns, p99 {}ns, p99.9 {}ns, max {}ns",
+					LatencyStats::stage_name((LatencyStats::Stage)s), summary._count, summary._mean, summary._p50, summary._p99, summary._p999, summary._max);
+			}
 		}
 		catch (...)
 		{
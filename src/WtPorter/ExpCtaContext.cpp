@@ -59,6 +59,22 @@ void ExpCtaContext::on_tick_updated(const char* stdCode, WTSTickData* newTick)
 	getRunner().ctx_on_tick(_context_id, stdCode, newTick, ET_CTA);
 }
 
+void ExpCtaContext::on_bar(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar)
+{
+	/*
+	 *	on_bar_close只有订阅了K线闭合事件才会触发
+	 *	K线缓冲区不管有没有订阅闭合事件都要更新，所以在这里写
+	 */
+	if (newBar != NULL)
+	{
+		thread_local static char realPeriod[8] = { 0 };
+		fmtutil::format_to(realPeriod, "{}{}", period, times);
+		getRunner().append_bar_ring(_context_id, stdCode, realPeriod, newBar);
+	}
+
+	CtaStraBaseCtx::on_bar(stdCode, period, times, newBar);
+}
+
 void ExpCtaContext::on_bar_close(const char* stdCode, const char* period, WTSBarStruct* newBar)
 {
 	//要向外部回调
@@ -27,6 +27,8 @@ public:
 
 	virtual void on_tick_updated(const char* stdCode, WTSTickData* newTick) override;
 
+	virtual void on_bar(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar) override;
+
 	virtual void on_bar_close(const char* stdCode, const char* period, WTSBarStruct* newBar) override;
 
 	virtual void on_calculate(uint32_t curDate, uint32_t curTime) override;
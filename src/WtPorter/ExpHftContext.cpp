@@ -12,6 +12,7 @@ void ExpHftContext::on_bar(const char* code, const char* period, uint32_t times,
 	thread_local static char realPeriod[8] = { 0 };
 	fmtutil::format_to(realPeriod, "{}{}", period, times);
 
+	getRunner().append_bar_ring(_context_id, code, realPeriod, newBar);
 	getRunner().ctx_on_bar(_context_id, code, realPeriod, newBar, ET_HFT);
 
 	HftStraBaseCtx::on_bar(code, period, times, newBar);
@@ -43,6 +43,7 @@ void ExpSelContext::on_strategy_schedule(uint32_t curDate, uint32_t curTime)
 
 void ExpSelContext::on_bar_close(const char* stdCode, const char* period, WTSBarStruct* newBar)
 {
+	getRunner().append_bar_ring(_context_id, stdCode, period, newBar);
 	getRunner().ctx_on_bar(_context_id, stdCode, period, newBar, ET_SEL);
 }
 
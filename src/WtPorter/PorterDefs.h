@@ -22,6 +22,8 @@ NS_WTP_END
 
 USING_NS_WTP;
 
+typedef struct _WTSBarRing	WTSBarRing;
+
 typedef unsigned long		CtxHandler;
 
 static const WtUInt32	EVENT_ENGINE_INIT	= 1;	//框架初始化
@@ -14,6 +14,7 @@
 #include "../WTSTools/WTSLogger.h"
 #include "../Includes/WTSTradeDef.hpp"
 #include "../Includes/WTSVersion.h"
+#include "../Share/LatencyStats.hpp"
 
 #ifdef _WIN32
 #   ifdef _WIN64
@@ -145,6 +146,18 @@ const char* get_raw_stdcode(const char* stdCode)
 	return getRunner().get_raw_stdcode(stdCode);
 }
 
+const char* get_latency_stats()
+{
+	static thread_local std::string ret;
+	ret = LatencyStats::to_json();
+	return ret.c_str();
+}
+
+void reset_latency_stats()
+{
+	LatencyStats::reset();
+}
+
 void write_log(WtUInt32 level, const char* message, const char* catName)
 {
 	if (strlen(catName) > 0)
@@ -254,6 +267,37 @@ WtUInt32 cta_get_bars(CtxHandler cHandle, const char* stdCode, const char* perio
 	}
 }
 
+/*
+ *	订阅K线缓冲区，返回的地址一直有效，之后K线闭合会自动追加到缓冲区
+ *	首次订阅的时候会拉取capacity条历史K线，同时也订阅了K线
+ */
+WTSBarRing* cta_sub_bar_ring(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 capacity, bool isMain)
+{
+	CtaContextPtr ctx = getRunner().getCtaContext(cHandle);
+	if (ctx == NULL)
+		return NULL;
+
+	try
+	{
+		return getRunner().sub_bar_ring(cHandle, stdCode, period, capacity, [&](WTSBarRing* ring) {
+			WTSKlineSlice* kData = ctx->stra_get_bars(stdCode, period, capacity, isMain);
+			if (kData == NULL)
+				return;
+
+			for (uint32_t i = 0; i < kData->get_block_counts(); i++)
+			{
+				if (kData->get_block_addr(i) != NULL)
+					BarRingMgr::push(ring, kData->get_block_addr(i), kData->get_block_size(i));
+			}
+			kData->release();
+		});
+	}
+	catch (...)
+	{
+		return NULL;
+	}
+}
+
 WtUInt32	cta_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt, FuncGetTicksCallback cb)
 {
 	CtaContextPtr ctx = getRunner().getCtaContext(cHandle);
@@ -676,6 +720,33 @@ WtUInt32 sel_get_bars(CtxHandler cHandle, const char* stdCode, const char* perio
 	}
 }
 
+WTSBarRing* sel_sub_bar_ring(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 capacity)
+{
+	SelContextPtr ctx = getRunner().getSelContext(cHandle);
+	if (ctx == NULL)
+		return NULL;
+
+	try
+	{
+		return getRunner().sub_bar_ring(cHandle, stdCode, period, capacity, [&](WTSBarRing* ring) {
+			WTSKlineSlice* kData = ctx->stra_get_bars(stdCode, period, capacity);
+			if (kData == NULL)
+				return;
+
+			for (uint32_t i = 0; i < kData->get_block_counts(); i++)
+			{
+				if (kData->get_block_addr(i) != NULL)
+					BarRingMgr::push(ring, kData->get_block_addr(i), kData->get_block_size(i));
+			}
+			kData->release();
+		});
+	}
+	catch (...)
+	{
+		return NULL;
+	}
+}
+
 void sel_set_position(CtxHandler cHandle, const char* stdCode, double qty, const char* userTag)
 {
 	SelContextPtr ctx = getRunner().getSelContext(cHandle);
@@ -926,6 +997,33 @@ WtUInt32 hft_get_bars(CtxHandler cHandle, const char* stdCode, const char* perio
 	}
 }
 
+WTSBarRing* hft_sub_bar_ring(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 capacity)
+{
+	HftContextPtr ctx = getRunner().getHftContext(cHandle);
+	if (ctx == NULL)
+		return NULL;
+
+	try
+	{
+		return getRunner().sub_bar_ring(cHandle, stdCode, period, capacity, [&](WTSBarRing* ring) {
+			WTSKlineSlice* kData = ctx->stra_get_bars(stdCode, period, capacity);
+			if (kData == NULL)
+				return;
+
+			for (uint32_t i = 0; i < kData->get_block_counts(); i++)
+			{
+				if (kData->get_block_addr(i) != NULL)
+					BarRingMgr::push(ring, kData->get_block_addr(i), kData->get_block_size(i));
+			}
+			kData->release();
+		});
+	}
+	catch (...)
+	{
+		return NULL;
+	}
+}
+
 WtUInt32 hft_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt, FuncGetTicksCallback cb)
 {
 	HftContextPtr ctx = getRunner().getHftContext(cHandle);
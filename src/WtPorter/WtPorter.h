@@ -63,6 +63,10 @@ extern "C"
 
 	EXPORT_FLAG	WtString	get_raw_stdcode(const char* stdCode);
 
+	EXPORT_FLAG	WtString	get_latency_stats();
+
+	EXPORT_FLAG	void		reset_latency_stats();
+
 	//////////////////////////////////////////////////////////////////////////
 	//CTA策略接口
 #pragma region "CTA接口"
@@ -104,6 +108,8 @@ extern "C"
 
 	EXPORT_FLAG	WtUInt32	cta_get_bars(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 barCnt, bool isMain, FuncGetBarsCallback cb);
 
+	EXPORT_FLAG	WTSBarRing*	cta_sub_bar_ring(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 capacity, bool isMain);
+
 	EXPORT_FLAG	WtUInt32	cta_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt, FuncGetTicksCallback cb);
 
 	EXPORT_FLAG	void		cta_get_all_position(CtxHandler cHandle, FuncGetPositionCallback cb);
@@ -187,6 +193,8 @@ extern "C"
 
 	EXPORT_FLAG	WtUInt32	sel_get_bars(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 barCnt, FuncGetBarsCallback cb);
 
+	EXPORT_FLAG	WTSBarRing*	sel_sub_bar_ring(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 capacity);
+
 	EXPORT_FLAG	WtUInt32	sel_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt, FuncGetTicksCallback cb);
 
 	EXPORT_FLAG	void		sel_get_all_position(CtxHandler cHandle, FuncGetPositionCallback cb);
@@ -251,6 +259,8 @@ extern "C"
 
 	EXPORT_FLAG	WtUInt32	hft_get_bars(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 barCnt, FuncGetBarsCallback cb);
 
+	EXPORT_FLAG	WTSBarRing*	hft_sub_bar_ring(CtxHandler cHandle, const char* stdCode, const char* period, WtUInt32 capacity);
+
 	EXPORT_FLAG	WtUInt32	hft_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt, FuncGetTicksCallback cb);
 
 	EXPORT_FLAG	WtUInt32	hft_get_ordque(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt, FuncGetOrdQueCallback cb);
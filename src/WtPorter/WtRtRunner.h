@@ -34,6 +34,8 @@
 #include "../WTSTools/WTSHotMgr.h"
 #include "../WTSTools/WTSBaseDataMgr.h"
 
+#include "../Share/BarRing.hpp"
+
 NS_WTP_BEGIN
 class WTSVariant;
 class WtDataStorage;
@@ -114,6 +116,23 @@ public:
 
 	const char*	get_raw_stdcode(const char* stdCode);
 
+	/*
+	 *	订阅K线缓冲区，fill用于新建的缓冲区灌入历史K线
+	 */
+	template<typename Fn>
+	WTSBarRing*	sub_bar_ring(uint32_t id, const char* stdCode, const char* period, uint32_t capacity, Fn fill)
+	{
+		return _bar_rings.subscribe(id, stdCode, period, capacity, fill);
+	}
+
+	/*
+	 *	K线闭合的时候写缓冲区，要在ctx_on_bar之前调用，回调里读缓冲区就能读到这根K线
+	 */
+	inline void	append_bar_ring(uint32_t id, const char* stdCode, const char* period, WTSBarStruct* newBar)
+	{
+		_bar_rings.append(id, stdCode, period, newBar);
+	}
+
 //////////////////////////////////////////////////////////////////////////
 //ILogHandler
 public:
@@ -255,6 +274,8 @@ private:
 	SelStrategyMgr		_sel_mgr;
 	ActionPolicyMgr		_act_policy;
 
+	BarRingMgr			_bar_rings;
+
 	bool				_is_hft;
 	bool				_is_sel;
 	bool				_to_exit;
@@ -17,6 +17,7 @@
 #include "../Includes/IBaseDataMgr.h"
 
 #include "../Share/StrUtil.hpp"
+#include "../Share/LatencyStats.hpp"
 
 #include "../WTSTools/WTSLogger.h"
 
@@ -274,6 +275,8 @@ void ParserAdapter::handleQuote(WTSTickData *quote, uint32_t procFlag)
 	if (quote == NULL || _stopped || quote->actiondate() == 0)
 		return;
 
+	quote->setRecvTime(LatencyStats::now());
+
 	WTSContractInfo* cInfo = quote->getContractInfo();
 	if (cInfo == NULL) cInfo = _bd_mgr->getContract(quote->code(), quote->exchg());
 	if (cInfo == NULL)
@@ -27,6 +27,7 @@
 #include "../Share/decimal.h"
 #include "../Share/DLLHelper.hpp"
 #include "../Share/StrUtil.hpp"
+#include "../Share/LatencyStats.hpp"
 
 #include <exception>
 #include <rapidjson/document.h>
@@ -77,6 +78,7 @@ TraderAdapter::TraderAdapter()
 	, _orders(NULL)
 	, _risk_mon_enabled(false)
 	, _stat_map(NULL)
+	, _save_data(false)
 {
 }
 
@@ -117,6 +119,10 @@ bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr
 	_cfg = params;
 	_cfg->retain();
 
+	_save_data = _cfg->getBoolean("savedata");
+	if (_save_data)
+		initSaveData();
+
 	//这里解析流量风控参数
 	WTSVariant* cfgRisk = params->get("riskmon");
 	if (cfgRisk)
@@ -205,6 +211,45 @@ bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr
 	return true;
 }
 
+void TraderAdapter::initSaveData()
+{
+	std::string folder = fmt::format("{}traders/{}/", WtHelper::getBaseDir(), _id);
+
+	//订单和成交日志，journal可以配置为csv或bin，默认为csv
+	std::string format = "csv";
+	if (strlen(_cfg->getCString("journal")) > 0)
+		format = _cfg->getCString("journal");
+	uint32_t capacity = _cfg->has("journalsize") ? _cfg->getUInt32("journalsize") : 8192;
+
+	_journal.reset(new TradeJournal());
+	if (!_journal->init(folder.c_str(), format.c_str(), capacity))
+	{
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, "[{}] Initializing trade journal in {} failed", _id.c_str(), folder.c_str());
+		_journal.reset();
+	}
+}
+
+void TraderAdapter::logTrade(uint32_t localid, const char* stdCode, WTSTradeInfo* trdInfo)
+{
+	if (_journal == NULL || trdInfo == NULL)
+		return;
+
+	_journal->log_trade(localid, stdCode, trdInfo->getTradeDate(), trdInfo->getTradeTime(),
+		formatAction(trdInfo->getDirection(), trdInfo->getOffsetType()),
+		trdInfo->getVolume(), trdInfo->getPrice(), trdInfo->getTradeID(), trdInfo->getRefOrder());
+}
+
+void TraderAdapter::logOrder(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo)
+{
+	if (_journal == NULL || ordInfo == NULL)
+		return;
+
+	_journal->log_order(localid, stdCode, ordInfo->getOrderDate(), ordInfo->getOrderTime(),
+		formatAction(ordInfo->getDirection(), ordInfo->getOffsetType()),
+		ordInfo->getVolume(), ordInfo->getVolTraded(), ordInfo->getPrice(),
+		ordInfo->getOrderID(), ordInfo->getOrderState() == WOS_Canceled, ordInfo->getStateMsg());
+}
+
 bool TraderAdapter::run()
 {
 	if (_trader_api == NULL)
@@ -227,6 +272,10 @@ void TraderAdapter::release()
 		_trader_api->registerSpi(NULL);
 		_trader_api->release();
 	}
+
+	//通道释放以后不会再有回报了，把日志全部写完
+	if (_journal)
+		_journal->stop();
 }
 
 double TraderAdapter::enumPosition(const char* stdCode /* = "" */)
@@ -327,6 +376,12 @@ uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust)
 	wt_strcpy(usertag, _order_pattern.c_str(), _order_pattern.size());
 	usertag[_order_pattern.size()] = '.';
 	fmtutil::format_to(usertag + _order_pattern.size() + 1, "{}", localid);
+
+	//策略在on_tick里下单的，统计从收到行情到下单的延迟
+	int64_t tickStamp = LatencyStats::get_tick_stamp();
+	if (tickStamp != 0)
+		LatencyStats::record(LatencyStats::LS_TICK2ORDER, LatencyStats::now() - tickStamp);
+	LatencyStats::mark_entrust(localid);
 	
 	int32_t ret = _trader_api->orderInsert(entrust);
 	if(ret < 0)
@@ -1153,6 +1208,9 @@ void TraderAdapter::onLogout()
 
 void TraderAdapter::onRspEntrust(WTSEntrust* entrust, WTSError *err)
 {
+	if (StrUtil::startsWith(entrust->getUserTag(), _order_pattern.c_str(), true))
+		LatencyStats::ack_entrust(strtoul(entrust->getUserTag() + _order_pattern.size() + 1, NULL, 10));
+
 	if (err && err->getErrorCode() != WEC_NONE)
 	{
 		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR,err->getMessage());
@@ -1491,6 +1549,10 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 	if (orderInfo == NULL)
 		return;
 
+	//第一笔委托回报到达的时间，重复的回报不会重复统计
+	if (StrUtil::startsWith(orderInfo->getUserTag(), _order_pattern.c_str(), true))
+		LatencyStats::ack_entrust(strtoul(orderInfo->getUserTag() + _order_pattern.size() + 1, NULL, 10));
+
 
 	WTSContractInfo* cInfo = _bd_mgr->getContract(orderInfo->getCode(), orderInfo->getExchg());
 	if (cInfo == NULL)
@@ -1729,6 +1791,10 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 			sink->on_order(localid, stdCode.c_str(), orderInfo->getDirection()==WDT_LONG, offset, 
 				orderInfo->getVolume(), orderInfo->getVolLeft(), orderInfo->getPrice(), orderInfo->getOrderState() == WOS_Canceled);
 	}
+
+	//不管是不是内部订单,订单结束了,都要写到日志里
+	if (_save_data && !orderInfo->isAlive())
+		logOrder(localid, stdCode.c_str(), orderInfo);
 }
 
 void TraderAdapter::onPushTrade(WTSTradeInfo* tradeRecord)
@@ -1832,6 +1898,9 @@ void TraderAdapter::onPushTrade(WTSTradeInfo* tradeRecord)
 	for (auto sink : _sinks)
 		sink->on_trade(localid, stdCode.c_str(), isLong, offset, vol, tradeRecord->getPrice());
 
+	if (_save_data)
+		logTrade(localid, stdCode.c_str(), tradeRecord);
+
 	_trader_api->queryAccount();
 }
 
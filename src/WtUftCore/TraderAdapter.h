@@ -12,6 +12,7 @@
 #include "../Includes/FasterDefs.h"
 #include "../Includes/ITraderApi.h"
 #include "../Share/BoostFile.hpp"
+#include "../Share/TradeJournal.hpp"
 #include "../Share/StdUtils.hpp"
 #include "../Includes/WTSCollection.hpp"
 #include "../Share/SpinMutex.hpp"
@@ -195,6 +196,12 @@ public:
 	bool	checkCancelLimits(const char* stdCode);
 	bool	checkOrderLimits(const char* stdCode);
 
+private:
+	void	initSaveData();
+
+	inline void	logTrade(uint32_t localid, const char* stdCode, WTSTradeInfo* trdInfo);
+	inline void	logOrder(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo);
+
 public:
 	//////////////////////////////////////////////////////////////////////////
 	//ITraderSpi接口
@@ -263,6 +270,9 @@ private:
 	typedef wt_hashmap<std::string, RiskParams>	RiskParamsMap;
 	RiskParamsMap	_risk_params_map;
 	bool			_risk_mon_enabled;
+
+	bool			_save_data;	//是否保存交易日志
+	TradeJournalPtr	_journal;	//订单和成交日志，后台线程异步写入
 };
 
 typedef std::shared_ptr<TraderAdapter>					TraderAdapterPtr;
@@ -18,6 +18,7 @@
 #include "../Share/decimal.h"
 #include "../Share/StrUtil.hpp"
 #include "../Share/TimeUtils.hpp"
+#include "../Share/LatencyStats.hpp"
 
 #include "../Includes/WTSVariant.hpp"
 #include "../Includes/IBaseDataMgr.h"
@@ -31,6 +32,9 @@ WtUftEngine::WtUftEngine()
 	: _cfg(NULL)
 	, _tm_ticker(NULL)
 	, _notifier(NULL)
+	, _latency_dump(0)
+	, _minutes(0)
+	, _tick_dispatching(false)
 {
 	TimeUtils::getDateTime(_cur_date, _cur_time);
 	_cur_secs = _cur_time % 100000;
@@ -151,8 +155,51 @@ WTSKlineSlice* WtUftEngine::get_kline_slice(uint32_t sid, const char* stdCode, c
 
 void WtUftEngine::sub_tick(uint32_t sid, const char* stdCode)
 {
-	SubList& sids = _tick_sub_map[stdCode];
-	sids.insert(sid);
+	_tick_sub_map[stdCode].insert(sid);
+
+	if (_tick_dispatching)
+		_tick_idx_dirty.emplace_back(stdCode);
+	else
+		update_tick_idx(stdCode);
+}
+
+void WtUftEngine::update_tick_idx(const char* stdCode)
+{
+	auto sit = _tick_sub_map.find(stdCode);
+	if (sit == _tick_sub_map.end())
+		return;
+
+	const SubList& sids = sit->second;
+
+	//合约代码里也可能有点，所以只按第一个点拆出交易所
+	WTSContractInfo* cInfo = NULL;
+	const char* pos = strchr(stdCode, '.');
+	if (pos != NULL)
+	{
+		std::string exchg(stdCode, pos - stdCode);
+		cInfo = _base_data_mgr->getContract(pos + 1, exchg.c_str());
+	}
+
+	if (cInfo == NULL || cInfo->getTotalIndex() == UINT_MAX)
+	{
+		_tick_unindexed.insert(stdCode);
+		return;
+	}
+	_tick_unindexed.erase(stdCode);
+
+	//订阅的时候把平铺表里对应的项按字符串订阅表重建一次，保证两张表一致
+	uint32_t idx = cInfo->getTotalIndex();
+	if (idx >= _tick_sub_idx.size())
+		_tick_sub_idx.resize(std::max(idx + 1, _base_data_mgr->getIndexedContracts()));
+
+	CtxList& ctxs = _tick_sub_idx[idx];
+	ctxs.clear();
+	for (uint32_t id : sids)
+	{
+		auto cit = _ctx_map.find(id);
+		if (cit != _ctx_map.end())
+			ctxs.emplace_back(cit->second);
+	}
 }
 
 double WtUftEngine::get_cur_price(const char* stdCode)
@@ -187,6 +234,10 @@ void WtUftEngine::init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtUftDtMgr* dataMgr
 
 	_cfg = cfg;
 	if(_cfg) _cfg->retain();
+
+	//延迟统计输出的间隔，单位分钟，为0则只在收盘时输出
+	if (_cfg)
+		_latency_dump = _cfg->getUInt32("latencydump");
 }
 
 void WtUftEngine::run()
@@ -324,18 +375,49 @@ void WtUftEngine::on_session_end()
 	}
 
 	WTSLogger::info("Trading day {} ended", _cur_tdate);
+	WTSLogger::info("Latency stats of trading day {}: {}", _cur_tdate, LatencyStats::to_json());
 }
 
 void WtUftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 {
+	int64_t tEngine = LatencyStats::now();
+	int64_t recvTime = curTick->getRecvTime();
+	if (recvTime != 0)
+		LatencyStats::record(LatencyStats::LS_PARSER, tEngine - recvTime);
+
+	//策略在on_tick里下单的时候，用这个时间戳计算tick到下单的延迟
+	LatencyStats::set_tick_stamp(recvTime);
+
 	if(_data_mgr)
 		_data_mgr->handle_push_quote(stdCode, curTick);
 
+	//分发耗时要扣掉前面的策略的处理时间
+	int64_t straCost = 0;
+	auto dispatch = [&](const UftContextPtr& ctx) {
+		int64_t tStra = LatencyStats::now();
+		LatencyStats::record(LatencyStats::LS_DISPATCH, tStra - tEngine - straCost);
+		ctx->on_tick(stdCode, curTick);
+		int64_t cost = LatencyStats::now() - tStra;
+		LatencyStats::record(LatencyStats::LS_STRATEGY, cost);
+		straCost += cost;
+	};
+
+	_tick_dispatching = true;
+	uint32_t idx = curTick->getContractIndex();
+	bool bIndexed = idx < _tick_sub_idx.size() && (_tick_unindexed.empty() || _tick_unindexed.find(stdCode) == _tick_unindexed.end());
+	if (bIndexed)
+	{
+		const CtxList& ctxs = _tick_sub_idx[idx];
+		for (const UftContextPtr& ctx : ctxs)
+			dispatch(ctx);
+	}
+	else
 	{
 		auto sit = _tick_sub_map.find(stdCode);
 		if (sit != _tick_sub_map.end())
 		{
-			const SubList& sids = sit->second;
+			//策略在回调里订阅会改动订阅表，这里拷贝一份再遍历，走这里的tick很少，拷贝的开销可以接受
+			SubList sids = sit->second;
 			for (auto it = sids.begin(); it != sids.end(); it++)
 			{
 				uint32_t sid = *it;
@@ -344,11 +426,22 @@ void WtUftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 				if (cit != _ctx_map.end())
 				{
 					UftContextPtr& ctx = (UftContextPtr&)cit->second;
-					ctx->on_tick(stdCode, curTick);
+					dispatch(ctx);
 				}
 			}
 		}
 	}
+	_tick_dispatching = false;
+
+	if (!_tick_idx_dirty.empty())
+	{
+		std::vector<std::string> codes;
+		codes.swap(_tick_idx_dirty);
+		for (const std::string& code : codes)
+			update_tick_idx(code.c_str());
+	}
+
+	LatencyStats::set_tick_stamp(0);
 }
 
 void WtUftEngine::on_bar(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar)
@@ -369,7 +462,9 @@ void WtUftEngine::on_bar(const char* stdCode, const char* period, uint32_t times
 
 void WtUftEngine::on_minute_end(uint32_t curDate, uint32_t curTime)
 {
-
+	_minutes++;
+	if (_latency_dump != 0 && _minutes % _latency_dump == 0)
+		WTSLogger::info("Latency stats @ {}.{}: {}", curDate, curTime, LatencyStats::to_json());
 }
 
 void WtUftEngine::addContext(UftContextPtr ctx)
@@ -145,6 +145,18 @@ private:
 	StraSubMap		_trans_sub_map;		//成交明细订阅表
 	StraSubMap		_bar_sub_map;	//K线数据订阅表	
 
+	//按合约全局索引平铺的tick订阅表，tick带有合约索引时直接按下标访问，不用按代码查找
+	//分发tick的过程中策略又订阅的，先记下来，分发完了再重建，避免改动正在遍历的列表
+	typedef std::vector<UftContextPtr>	CtxList;
+	std::vector<CtxList>	_tick_sub_idx;
+	bool					_tick_dispatching;
+	std::vector<std::string>	_tick_idx_dirty;
+	//找不到合约索引的订阅代码，这些代码的tick还是按字符串订阅表分发
+	wt_hashset<std::string>	_tick_unindexed;
+
+	//按字符串订阅表重建平铺表里合约对应的项
+	void update_tick_idx(const char* stdCode);
+
 	TraderAdapterMgr*	_adapter_mgr;
 
 	typedef wt_hashmap<uint32_t, UftContextPtr> ContextMap;
@@ -155,6 +167,9 @@ private:
 
 	bool			_dependent;	//子策略独立记账
 
+	uint32_t		_latency_dump;	//延迟统计输出间隔，单位分钟
+	uint32_t		_minutes;
+
 	EventNotifier*	_notifier;
 };
 